@@ -0,0 +1,326 @@
+// 单个请求各阶段的微基准(Google Benchmark)：帧编解码、RpcHeader 解析、请求解析和响应序列化、
+// 服务/方法查找、回调闭包创建、对象池在竞争下的获取/归还、缓冲区追加/切分。
+// 每个阶段单独计时，优化其中一段时可以只看这一段的变化
+//
+// 用法: prpc_micro_bench [--benchmark_filter=REGEX] [--benchmark_format=json] ...
+//
+// 消息大小参数是 Record 条数，每条约 100 字节；负载大小参数是字节数
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "crc32c.h"
+#include "echo.pb.h"
+#include "header.pb.h"
+#include "message_pool.h"
+#include "object_pool.h"
+#include "provider.h"
+#include "rpc_frame.h"
+#include "test_data_generator.h"
+#include "trace.h"
+
+namespace {
+
+// 与 Pchannel 发出的请求头相同：带 trace 和超时
+Prpc::RpcHeader makeHeader(uint32_t args_size) {
+    Prpc::RpcHeader header;
+    header.set_service_name("EchoService");
+    header.set_method_name("Echo");
+    header.set_args_size(args_size);
+    header.set_trace_id(0x1234567890abcdefULL);
+    header.set_span_id(0xfedcba0987654321ULL);
+    header.set_sampled(true);
+    header.set_priority(1);
+    header.set_timeout_ms(500);
+    return header;
+}
+
+// records 条 Record，内容来自 TestDataGenerator
+Pbench::EchoRequest makeRequest(int records) {
+    auto& generator = TestDataGenerator::getInstance();
+    Pbench::EchoRequest request;
+    for (int i = 0; i < records; ++i) {
+        Pbench::Record* record = request.add_records();
+        record->set_id(generator.generateRandomInt(0, 1 << 30));
+        record->set_name(generator.generateRandomString(32));
+        for (int j = 0; j < 4; ++j) {
+            record->add_tags(generator.generateRandomString(12));
+        }
+        record->set_score(generator.generateRandomInt() / 7.0);
+    }
+    return request;
+}
+
+std::string randomBytes(size_t size) {
+    auto data = TestDataGenerator::getInstance().generateNetworkData(size);
+    return std::string(data.begin(), data.end());
+}
+
+// ---- 帧编解码 ----
+
+void BM_RequestFrameEncode(benchmark::State& state) {
+    std::string args = randomBytes(state.range(0));
+    Prpc::RpcHeader header = makeHeader(args.size());
+    for (auto _ : state) {
+        std::string frame;
+        prpc::encodeRequestFrame(header, args, &frame);
+        benchmark::DoNotOptimize(frame.data());
+    }
+    state.SetBytesProcessed(state.iterations() * args.size());
+}
+BENCHMARK(BM_RequestFrameEncode)->Arg(0)->Arg(64)->Arg(4 << 10)->Arg(64 << 10);
+
+// Pprovider 读到帧之后的工作：长度、RpcHeader、取出参数
+void BM_RequestFrameDecode(benchmark::State& state) {
+    std::string args = randomBytes(state.range(0));
+    std::string frame;
+    prpc::encodeRequestFrame(makeHeader(args.size()), args, &frame);
+    for (auto _ : state) {
+        uint32_t header_size = prpc::decodeFrameLength(frame.data());
+        Prpc::RpcHeader header;
+        header.ParseFromArray(frame.data() + prpc::kFrameLengthSize, header_size);
+        std::string args_str(frame.data() + prpc::kFrameLengthSize + header_size,
+                             header.args_size());
+        benchmark::DoNotOptimize(args_str.data());
+    }
+    state.SetBytesProcessed(state.iterations() * frame.size());
+}
+BENCHMARK(BM_RequestFrameDecode)->Arg(0)->Arg(64)->Arg(4 << 10)->Arg(64 << 10);
+
+// 帧校验：参数 1 为 crc32c()(有 SSE4.2 时用硬件指令)，0 为查表实现
+void BM_Crc32c(benchmark::State& state) {
+    std::string data = randomBytes(state.range(1));
+    auto impl = state.range(0) ? prpc::crc32c : prpc::crc32cPortable;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(impl(data.data(), data.size(), 0));
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_Crc32c)->RangeMultiplier(64)->Ranges({{0, 1}, {64, 64 << 10}});
+
+// 参数 0 为只有服务名、方法名和长度的请求头，1 为带 trace、优先级和超时的请求头
+void BM_RpcHeaderParse(benchmark::State& state) {
+    Prpc::RpcHeader header = makeHeader(128);
+    if (state.range(0) == 0) {
+        header.clear_trace_id();
+        header.clear_span_id();
+        header.clear_sampled();
+        header.clear_priority();
+        header.clear_timeout_ms();
+    }
+    std::string bytes = header.SerializeAsString();
+    for (auto _ : state) {
+        Prpc::RpcHeader parsed;
+        benchmark::DoNotOptimize(parsed.ParseFromString(bytes));
+    }
+    state.SetLabel(std::to_string(bytes.size()) + " bytes");
+}
+BENCHMARK(BM_RpcHeaderParse)->Arg(0)->Arg(1);
+
+void BM_RpcHeaderSerialize(benchmark::State& state) {
+    Prpc::RpcHeader header = makeHeader(128);
+    for (auto _ : state) {
+        std::string bytes;
+        header.SerializeToString(&bytes);
+        benchmark::DoNotOptimize(bytes.data());
+    }
+}
+BENCHMARK(BM_RpcHeaderSerialize);
+
+// ---- 请求解析和响应序列化 ----
+
+// 与 ProcessRequest 相同：从原型 New() 一个请求再解析
+void BM_RequestParse(benchmark::State& state) {
+    Pbench::EchoRequest request = makeRequest(state.range(0));
+    std::string bytes = request.SerializeAsString();
+    const google::protobuf::Message& prototype = Pbench::EchoRequest::default_instance();
+    for (auto _ : state) {
+        std::unique_ptr<google::protobuf::Message> parsed(prototype.New());
+        benchmark::DoNotOptimize(parsed->ParseFromString(bytes));
+    }
+    state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_RequestParse)->Arg(0)->Arg(1)->Arg(10)->Arg(100)->Arg(1000);
+
+// 负载是一个 bytes 字段时的解析，对比结构化消息
+void BM_RequestParseBytes(benchmark::State& state) {
+    Pbench::EchoRequest request;
+    request.set_payload(randomBytes(state.range(0)));
+    std::string bytes = request.SerializeAsString();
+    for (auto _ : state) {
+        Pbench::EchoRequest parsed;
+        benchmark::DoNotOptimize(parsed.ParseFromString(bytes));
+    }
+    state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_RequestParseBytes)->Arg(64)->Arg(4 << 10)->Arg(64 << 10)->Arg(1 << 20);
+
+// 与 done 回调相同：序列化成带长度的响应帧
+void BM_ResponseSerialize(benchmark::State& state) {
+    Pbench::EchoResponse response;
+    response.mutable_records()->CopyFrom(makeRequest(state.range(0)).records());
+    for (auto _ : state) {
+        std::string frame;
+        prpc::encodeResponseFrame(response, &frame);
+        benchmark::DoNotOptimize(frame.data());
+    }
+    state.SetBytesProcessed(state.iterations() * response.ByteSizeLong());
+}
+BENCHMARK(BM_ResponseSerialize)->Arg(0)->Arg(1)->Arg(10)->Arg(100)->Arg(1000);
+
+// ---- 服务/方法查找 ----
+
+// 与 HandleClientRequest 相同的查找：服务、方法，之后的优先级、统计和调优项都是字段。参数是服务数，每个服务 8 个方法
+void BM_ServiceMethodLookup(benchmark::State& state) {
+    const int services = state.range(0);
+    const int methods = 8;
+    std::unordered_map<std::string, ServiceInfo> service_map;
+    std::vector<std::pair<std::string, std::string>> names;
+    for (int i = 0; i < services; ++i) {
+        std::string service_name = "prpc.bench.Service" + std::to_string(i);
+        ServiceInfo& info = service_map[service_name];
+        info.m_service = nullptr;
+        for (int j = 0; j < methods; ++j) {
+            std::string method_name = "Method" + std::to_string(j);
+            MethodInfo& method = info.m_methodMap[method_name];
+            method.m_descriptor = nullptr;
+            method.m_stats = nullptr;
+            method.m_priority = RpcPriority::kNormal;
+            names.emplace_back(service_name, method_name);
+        }
+    }
+    size_t i = 0;
+    for (auto _ : state) {
+        const auto& name = names[i++ % names.size()];
+        auto sit = service_map.find(name.first);
+        const MethodInfo* method = &sit->second.m_methodMap.find(name.second)->second;
+        RpcPriority priority = method->m_priority;
+        prpc::MethodStats* stats = method->m_stats;
+        benchmark::DoNotOptimize(priority);
+        benchmark::DoNotOptimize(stats);
+    }
+}
+BENCHMARK(BM_ServiceMethodLookup)->Arg(1)->Arg(16)->Arg(256);
+
+// ---- 回调闭包 ----
+
+// 捕获与 ProcessRequest 的 done 回调相近(约 100 字节，超出 std::function 的内联存储)
+void BM_ClosureCreateRun(benchmark::State& state) {
+    int fd = 7;
+    void* request = &fd;
+    void* response = &fd;
+    auto start = std::chrono::steady_clock::now();
+    auto enqueued = start;
+    prpc::TraceContext span;
+    int64_t span_start_us = 0;
+    uint64_t parent_span_id = 0;
+    size_t args_size = 128;
+    uint64_t sink = 0;
+    for (auto _ : state) {
+        google::protobuf::Closure* done = new LambdaClosure(
+            [fd, request, response, start, enqueued, span, span_start_us, parent_span_id,
+             args_size, &sink]() {
+                sink += fd + args_size + span.trace_id + parent_span_id + span_start_us +
+                        (request == response) + (start == enqueued);
+            });
+        done->Run();
+    }
+    benchmark::DoNotOptimize(sink);
+}
+BENCHMARK(BM_ClosureCreateRun);
+
+// ---- 对象池 ----
+
+// 参数是弹匣容量，0 为关闭线程缓存，所有获取/归还都走仓库的锁
+template<int MagazineSize>
+prpc::ObjectPool<prpc::RpcMessage>& benchPool() {
+    static prpc::ObjectPool<prpc::RpcMessage> pool(
+        [] { return std::make_unique<prpc::RpcMessage>(); },
+        [](prpc::RpcMessage* message) { message->reset(); },
+        [] {
+            prpc::ObjectPool<prpc::RpcMessage>::Config config;
+            config.initial_size = 64;
+            config.max_size = 1024;
+            config.enable_validation = false;
+            config.magazine_size = MagazineSize;
+            return config;
+        }());
+    return pool;
+}
+
+template<int MagazineSize>
+void BM_ObjectPoolAcquireRelease(benchmark::State& state) {
+    auto& pool = benchPool<MagazineSize>();
+    for (auto _ : state) {
+        auto message = pool.acquire();
+        benchmark::DoNotOptimize(message.get());
+    }
+}
+BENCHMARK_TEMPLATE(BM_ObjectPoolAcquireRelease, 0)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ObjectPoolAcquireRelease, 16)->ThreadRange(1, 8)->UseRealTime();
+
+// 每次持有几个对象再一起归还，弹匣在获取和归还之间来回切换
+template<int MagazineSize>
+void BM_ObjectPoolBatch(benchmark::State& state) {
+    auto& pool = benchPool<MagazineSize>();
+    std::vector<prpc::ObjectPool<prpc::RpcMessage>::PooledObject> held;
+    held.reserve(state.range(0));
+    for (auto _ : state) {
+        for (int64_t i = 0; i < state.range(0); ++i) {
+            held.push_back(pool.acquire());
+        }
+        held.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_ObjectPoolBatch, 0)->Arg(32)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ObjectPoolBatch, 16)->Arg(32)->ThreadRange(1, 8)->UseRealTime();
+
+// ---- 缓冲区 ----
+
+void BM_MessagePoolAcquireBuffer(benchmark::State& state) {
+    auto& pool = prpc::MessagePool::getInstance();
+    for (auto _ : state) {
+        auto buffer = pool.acquireBufferFor(state.range(0));
+        benchmark::DoNotOptimize(buffer.get());
+    }
+}
+BENCHMARK(BM_MessagePoolAcquireBuffer)->Arg(512)->Arg(8 << 10)->ThreadRange(1, 8)->UseRealTime();
+
+// 按块追加收到的数据，每次凑够一帧就切走，剩余不足一帧的部分由 compact() 移到开头。
+// 参数：每次追加的字节数，帧大小
+void BM_BufferAppendCut(benchmark::State& state) {
+    const size_t chunk = state.range(0);
+    const size_t frame = state.range(1);
+    std::string input = randomBytes(chunk);
+    prpc::NetworkBuffer buffer;
+    std::string cut;
+    for (auto _ : state) {
+        buffer.resize(buffer.write_pos + chunk);
+        memcpy(buffer.writePtr(), input.data(), chunk);
+        buffer.advance_write(chunk);
+        while (buffer.available() >= frame) {
+            cut.assign(reinterpret_cast<const char*>(buffer.readPtr()), frame);
+            buffer.advance_read(frame);
+        }
+        buffer.compact();
+        benchmark::DoNotOptimize(cut.data());
+    }
+    state.SetBytesProcessed(state.iterations() * chunk);
+}
+BENCHMARK(BM_BufferAppendCut)
+    ->Args({1500, 100})
+    ->Args({1500, 1000})
+    ->Args({16 << 10, 4 << 10})
+    ->Args({16 << 10, 12 << 10})
+    ->Args({64 << 10, 64 << 10});
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,418 @@
+// 端到端 RPC 基准测试：在本进程内启动 provider(内存注册中心)，caller 经回环连接调用 Echo，
+// 按 负载大小 x 并发数 x 连接数 x 速率 扫描，输出吞吐和延迟分位数(JSON)，用于不同版本之间对比
+//
+// 用法: prpc_rpc_bench [选项]
+//   --payload=LIST       请求和响应的负载字节数，默认 16,1024,16384
+//   --concurrency=LIST   同时进行的调用数(调用线程数)，默认 1,8,32
+//   --connections=LIST   连接数，默认 1,8，多于并发数的组合跳过。协议不支持同一连接上并发的调用，
+//                        并发数多于连接数时调用在连接上排队，排队时间计入延迟
+//   --rate=LIST          总请求速率(次/秒)。0 为闭环(默认)：每个调用线程收到响应后立即发起下一次；
+//                        大于 0 为开环：请求按固定间隔排定，延迟从排定时间算起，
+//                        服务端变慢导致的发送推迟也计入延迟(校正协调遗漏)
+//   --duration=S         每个点的测量时长(秒)，默认 5
+//   --warmup=S           每个点测量前的预热时长(秒)，默认 1
+//   --port=N             provider 监听端口，默认 18090
+//   --executor=NAME      provider 执行器 threadpool|fiber，默认 threadpool
+//   --checksum=NAME      帧校验 none|crc32c，默认 none
+//   --label=TEXT         写入结果的标签，例如版本号
+//   --output=FILE        JSON 输出文件，默认标准输出
+//
+// 延迟分位数来自 prpc::Histogram，相对误差不超过 1/16
+#include <getopt.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "application.h"
+#include "controller.h"
+#include "echo.pb.h"
+#include "metrics.h"
+#include "provider.h"
+#include "registry.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+class EchoServiceImpl : public Pbench::EchoService {
+public:
+    void Echo(google::protobuf::RpcController* controller, const Pbench::EchoRequest* request,
+              Pbench::EchoResponse* response, google::protobuf::Closure* done) override {
+        response->set_payload(request->payload());
+        done->Run();
+    }
+};
+
+struct Options {
+    std::vector<uint64_t> payloads{16, 1024, 16384};
+    std::vector<uint64_t> concurrency{1, 8, 32};
+    std::vector<uint64_t> connections{1, 8};
+    std::vector<uint64_t> rates{0};
+    double duration_s = 5;
+    double warmup_s = 1;
+    int port = 18090;
+    std::string executor = "threadpool";
+    std::string checksum = "none";
+    std::string label;
+    std::string output;
+};
+
+// 一条连接：Pchannel 为每个目标地址缓存一个 socket，同一连接上的调用必须串行
+struct Connection {
+    Pchannel channel{false};
+    Pbench::EchoService_Stub stub{&channel};
+    std::mutex mutex;
+};
+
+struct Point {
+    uint64_t payload;
+    uint64_t concurrency;
+    uint64_t connections;
+    uint64_t rate;   // 0 为闭环
+};
+
+struct PointResult {
+    Point point;
+    uint64_t requests = 0;      // 成功的调用
+    uint64_t errors = 0;
+    double seconds = 0;
+    uint64_t max_ns = 0;
+    prpc::HistogramSnapshot latency;
+};
+
+bool parseList(const char* text, std::vector<uint64_t>& values) {
+    values.clear();
+    std::stringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        char* end = nullptr;
+        unsigned long long value = strtoull(item.c_str(), &end, 10);
+        if (item.empty() || *end != '\0') {
+            return false;
+        }
+        values.push_back(value);
+    }
+    return !values.empty();
+}
+
+void usage(const char* program) {
+    std::cerr << "usage: " << program
+              << " [--payload=LIST] [--concurrency=LIST] [--connections=LIST] [--rate=LIST]\n"
+                 "       [--duration=S] [--warmup=S] [--port=N] [--executor=threadpool|fiber]\n"
+                 "       [--checksum=none|crc32c] [--label=TEXT] [--output=FILE]\n";
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    static const option kOptions[] = {
+        {"payload", required_argument, nullptr, 'p'},
+        {"concurrency", required_argument, nullptr, 'c'},
+        {"connections", required_argument, nullptr, 'n'},
+        {"rate", required_argument, nullptr, 'r'},
+        {"duration", required_argument, nullptr, 'd'},
+        {"warmup", required_argument, nullptr, 'w'},
+        {"port", required_argument, nullptr, 'P'},
+        {"executor", required_argument, nullptr, 'e'},
+        {"checksum", required_argument, nullptr, 'k'},
+        {"label", required_argument, nullptr, 'l'},
+        {"output", required_argument, nullptr, 'o'},
+        {nullptr, 0, nullptr, 0},
+    };
+    int o;
+    while ((o = getopt_long(argc, argv, "", kOptions, nullptr)) != -1) {
+        switch (o) {
+            case 'p':
+                if (!parseList(optarg, options.payloads)) return false;
+                break;
+            case 'c':
+                if (!parseList(optarg, options.concurrency)) return false;
+                break;
+            case 'n':
+                if (!parseList(optarg, options.connections)) return false;
+                break;
+            case 'r':
+                if (!parseList(optarg, options.rates)) return false;
+                break;
+            case 'd':
+                options.duration_s = atof(optarg);
+                break;
+            case 'w':
+                options.warmup_s = atof(optarg);
+                break;
+            case 'P':
+                options.port = atoi(optarg);
+                break;
+            case 'e':
+                options.executor = optarg;
+                break;
+            case 'k':
+                options.checksum = optarg;
+                break;
+            case 'l':
+                options.label = optarg;
+                break;
+            case 'o':
+                options.output = optarg;
+                break;
+            default:
+                return false;
+        }
+    }
+    for (uint64_t value : options.concurrency) {
+        if (value == 0) return false;
+    }
+    for (uint64_t value : options.connections) {
+        if (value == 0) return false;
+    }
+    if (options.checksum != "none" && options.checksum != "crc32c") {
+        return false;
+    }
+    return optind == argc && options.duration_s > 0 && options.warmup_s >= 0 &&
+           options.port > 0 && options.port < 65536;
+}
+
+// provider 从配置文件读取地址和执行器，这里生成一个临时配置
+bool initApplication(const Options& options, char* program) {
+    char path[] = "/tmp/prpc_rpc_bench.XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return false;
+    }
+    close(fd);
+    {
+        std::ofstream config(path);
+        config << "rpcserverip=127.0.0.1\n"
+               << "rpcserverport=" << options.port << "\n"
+               << "registry=memory\n"
+               << "rpcserver_executor=" << options.executor << "\n"
+               << "checksum=" << options.checksum << "\n"
+               << "log_level=warn\n";
+    }
+    char flag[] = "-i";
+    char* args[] = {program, flag, path, nullptr};
+    auto result = Papplication::Init(3, args);
+    unlink(path);
+    if (!result.isSuccess()) {
+        std::cerr << result.getErrorMessage() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 运行一个阶段，stats 为空时只预热
+void runPhase(const Point& point, std::vector<std::unique_ptr<Connection>>& connections,
+              double seconds, PointResult* stats) {
+    prpc::Histogram latency;
+    std::atomic<uint64_t> next_slot{0};
+    auto start = Clock::now();
+    auto end = start + std::chrono::duration_cast<Clock::duration>(
+                           std::chrono::duration<double>(seconds));
+    auto interval = point.rate > 0 ? std::chrono::nanoseconds(1000000000 / point.rate)
+                                   : std::chrono::nanoseconds(0);
+
+    struct WorkerStats {
+        uint64_t requests = 0;
+        uint64_t errors = 0;
+        uint64_t max_ns = 0;
+    };
+    std::vector<WorkerStats> worker_stats(point.concurrency);
+    std::vector<std::thread> workers;
+    for (uint64_t w = 0; w < point.concurrency; ++w) {
+        workers.emplace_back([&, w] {
+            Connection& connection = *connections[w % connections.size()];
+            WorkerStats& mine = worker_stats[w];
+            Pbench::EchoRequest request;
+            request.set_payload(std::string(point.payload, 'x'));
+            Pbench::EchoResponse response;
+            while (true) {
+                Clock::time_point intended;
+                if (point.rate > 0) {
+                    // 过载时排定时间落后于当前时间，到结束时间仍未发出的请求不再发送
+                    intended = start + interval * next_slot.fetch_add(1);
+                    if (intended >= end || Clock::now() >= end) {
+                        break;
+                    }
+                    std::this_thread::sleep_until(intended);
+                } else {
+                    intended = Clock::now();
+                    if (intended >= end) {
+                        break;
+                    }
+                }
+
+                Pcontroller controller;
+                {
+                    std::lock_guard<std::mutex> lock(connection.mutex);
+                    connection.stub.Echo(&controller, &request, &response, nullptr);
+                }
+                auto elapsed = Clock::now() - intended;
+                if (controller.Failed() || response.payload().size() != point.payload) {
+                    ++mine.errors;
+                    continue;
+                }
+                ++mine.requests;
+                uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+                mine.max_ns = std::max(mine.max_ns, ns);
+                latency.record(ns);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    if (stats == nullptr) {
+        return;
+    }
+    stats->seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    for (const auto& mine : worker_stats) {
+        stats->requests += mine.requests;
+        stats->errors += mine.errors;
+        stats->max_ns = std::max(stats->max_ns, mine.max_ns);
+    }
+    stats->latency = latency.snapshot();
+}
+
+PointResult runPoint(const Point& point, const Options& options) {
+    std::vector<std::unique_ptr<Connection>> connections;
+    for (uint64_t i = 0; i < point.connections; ++i) {
+        connections.push_back(std::make_unique<Connection>());
+    }
+    PointResult result;
+    result.point = point;
+    runPhase(point, connections, options.warmup_s, nullptr);
+    runPhase(point, connections, options.duration_s, &result);
+    return result;
+}
+
+std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+void writeJson(std::ostream& out, const Options& options, const std::vector<PointResult>& results) {
+    std::time_t now = std::time(nullptr);
+    std::tm tm;
+    gmtime_r(&now, &tm);
+    char timestamp[32];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &tm);
+
+    out << std::fixed << std::setprecision(1);
+    out << "{\n"
+        << "  \"label\": " << jsonString(options.label) << ",\n"
+        << "  \"timestamp\": \"" << timestamp << "\",\n"
+        << "  \"executor\": " << jsonString(options.executor) << ",\n"
+        << "  \"checksum\": " << jsonString(options.checksum) << ",\n"
+        << "  \"duration_s\": " << options.duration_s << ",\n"
+        << "  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const PointResult& r = results[i];
+        double throughput = r.seconds > 0 ? r.requests / r.seconds : 0;
+        out << (i == 0 ? "\n" : ",\n")
+            << "    {\"payload_bytes\": " << r.point.payload
+            << ", \"concurrency\": " << r.point.concurrency
+            << ", \"connections\": " << r.point.connections
+            << ", \"mode\": \"" << (r.point.rate > 0 ? "open" : "closed") << "\""
+            << ", \"target_rps\": " << r.point.rate
+            << ", \"requests\": " << r.requests
+            << ", \"errors\": " << r.errors
+            << ", \"throughput_rps\": " << throughput
+            << ", \"latency_us\": {\"mean\": " << r.latency.mean() / 1e3
+            << ", \"p50\": " << r.latency.percentile(0.5) / 1e3
+            << ", \"p99\": " << r.latency.percentile(0.99) / 1e3
+            << ", \"p999\": " << r.latency.percentile(0.999) / 1e3
+            << ", \"max\": " << r.max_ns / 1e3 << "}}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (!initApplication(options, argv[0])) {
+        return 1;
+    }
+
+    EchoServiceImpl service;
+    Pprovider provider;
+    provider.NotifyService(&service);
+    std::thread server([&provider] { provider.Run(); });
+    // provider 开始监听后才登记服务
+    auto deadline = Clock::now() + std::chrono::seconds(5);
+    while (ServiceRegistry::Default().Lookup("EchoService", "Echo").empty()) {
+        if (Clock::now() > deadline) {
+            std::cerr << "provider did not start on port " << options.port << std::endl;
+            provider.Stop();
+            server.join();
+            return 1;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::vector<PointResult> results;
+    for (uint64_t payload : options.payloads) {
+        for (uint64_t concurrency : options.concurrency) {
+            for (uint64_t connections : options.connections) {
+                if (connections > concurrency) {
+                    continue;
+                }
+                for (uint64_t rate : options.rates) {
+                    PointResult r = runPoint({payload, concurrency, connections, rate}, options);
+                    std::cerr << std::fixed << std::setprecision(1) << "payload " << payload
+                              << "B concurrency " << concurrency << " connections " << connections
+                              << (rate > 0 ? " rate " + std::to_string(rate) : std::string(" closed"))
+                              << ": " << (r.seconds > 0 ? r.requests / r.seconds : 0) << " rps, p50 "
+                              << r.latency.percentile(0.5) / 1e3 << "us p99 "
+                              << r.latency.percentile(0.99) / 1e3 << "us p999 "
+                              << r.latency.percentile(0.999) / 1e3 << "us, " << r.errors
+                              << " errors" << std::endl;
+                    results.push_back(std::move(r));
+                }
+            }
+        }
+    }
+
+    provider.Stop();
+    server.join();
+
+    if (options.output.empty()) {
+        writeJson(std::cout, options, results);
+    } else {
+        std::ofstream out(options.output);
+        writeJson(out, options, results);
+        if (!out) {
+            std::cerr << options.output << ": write failed" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -1,14 +1,39 @@
 #include "application.h"
+#include "binary_log.h"
+#include "capture.h"
 #include "error.h"
+#include "logger.h"
+#include "trace.h"
 
 #include <unistd.h>
 
 #include <cstdlib>
 
 Pconfig Papplication::m_config;
-std::mutex Papplication::m_mutex;
 Papplication* Papplication::m_application = nullptr;
 
+bool Papplication::ApplyLogLevel(const ConfigSnapshot& snapshot) {
+  LogLevel level = LogLevel::INFO;
+  if (!snapshot.log_level.empty() && !PLogger::parseLevel(snapshot.log_level, level)) {
+    return false;
+  }
+  PLogger::getInstance().setLogLevel(level);
+  return true;
+}
+
+// 重新加载时只应用值有变化的项；非法值保留原设置
+void Papplication::RegisterReloadCallbacks() {
+  m_config.OnChange("log_level", [](const ConfigSnapshot& snapshot) {
+    if (!ApplyLogLevel(snapshot)) {
+      LOG(ERROR) << "invalid log_level on reload: " << snapshot.log_level;
+    }
+  });
+  m_config.OnChange("trace_sample_rate", [](const ConfigSnapshot& snapshot) {
+    prpc::Tracer::getInstance().setSampleRate(
+        snapshot.trace_sample_rate >= 0 ? snapshot.trace_sample_rate : 0);
+  });
+}
+
 prpc::Result<void> Papplication::Init(int argc, char** argv) {
   try {
     if (argc < 2) {  // none config progame
@@ -42,7 +67,72 @@ prpc::Result<void> Papplication::Init(int argc, char** argv) {
     if (!result.isSuccess()) {
       throw prpc::ConfigException("Failed to load config file: " + result.getErrorMessage());
     }
-    
+
+    // 可选：运行时日志级别 debug|info|warn|error，默认 info
+    ConfigSnapshotPtr snapshot = m_config.Snapshot();
+    if (!snapshot->log_level.empty() && !ApplyLogLevel(*snapshot)) {
+      throw prpc::ConfigException("Invalid log_level: " + snapshot->log_level);
+    }
+
+    // 可选：日志输出到文件，默认输出到控制台
+    std::string log_file = m_config.Load("log_file");
+    if (!log_file.empty() && !PLogger::getInstance().setLogFile(log_file)) {
+      throw prpc::ConfigException("Failed to open log file: " + log_file);
+    }
+
+    // 可选：二进制请求日志，大小固定的环形文件，用 prpc_blog_decode 查看
+    std::string binary_log_file = m_config.Load("binary_log_file");
+    if (!binary_log_file.empty()) {
+      size_t size_mb = atoi(m_config.Load("binary_log_size_mb").c_str());
+      size_t ring_size = size_mb > 0 ? size_mb * 1024 * 1024 : blog::kDefaultRingSize;
+      if (!PBinaryLog::getInstance().open(binary_log_file, ring_size)) {
+        throw prpc::ConfigException("Failed to open binary log file: " + binary_log_file);
+      }
+    }
+
+    // 可选：分布式追踪，根 span 的采样率 0~1，被采样的 span 以 JSON Lines 写入 trace_file
+    if (snapshot->trace_sample_rate >= 0) {
+      prpc::Tracer::getInstance().setSampleRate(snapshot->trace_sample_rate);
+    }
+    std::string trace_file = m_config.Load("trace_file");
+    if (!trace_file.empty()) {
+      auto sink = prpc::FileSpanSink::open(trace_file);
+      if (!sink) {
+        throw prpc::ConfigException("Failed to open trace file: " + trace_file);
+      }
+      prpc::Tracer::getInstance().setSink(std::move(sink));
+    }
+
+    // 可选：抓取收到的请求帧，供 prpc_rpc_replay 回放；按采样率和写入预算限制开销
+    std::string capture_file = m_config.Load("capture_file");
+    if (!capture_file.empty()) {
+      prpc::TrafficCapture::Options options;
+      std::string sample_rate = m_config.Load("capture_sample_rate");
+      if (!sample_rate.empty()) {
+        options.sample_rate = atof(sample_rate.c_str());
+      }
+      uint64_t budget_kb = strtoull(m_config.Load("capture_max_kb_per_s").c_str(), nullptr, 10);
+      if (budget_kb > 0) {
+        options.bytes_per_second = budget_kb * 1024;
+      }
+      uint64_t max_mb = strtoull(m_config.Load("capture_max_mb").c_str(), nullptr, 10);
+      if (max_mb > 0) {
+        options.max_file_bytes = max_mb * 1024 * 1024;
+      }
+      if (!prpc::TrafficCapture::getInstance().start(capture_file, options)) {
+        throw prpc::ConfigException("Failed to open capture file: " + capture_file);
+      }
+    }
+
+    // 可选：监视配置文件，改写后自动重新加载；log_level、trace_sample_rate
+    // 以及 Pprovider 的慢请求阈值、对象池告警间隔、队列权重无需重启即可生效
+    static std::once_flag reload_callbacks;
+    std::call_once(reload_callbacks, RegisterReloadCallbacks);
+    m_config.StopWatching();
+    if (m_config.Load("config_watch") == "true" && !m_config.StartWatching()) {
+      throw prpc::ConfigException("Failed to watch config file: " + config_file);
+    }
+
     return prpc::Result<void>();
   } catch (const prpc::PrpcException& e) {
     return prpc::Result<void>(e.getErrorCode(), e.what());
@@ -51,13 +141,14 @@ prpc::Result<void> Papplication::Init(int argc, char** argv) {
   }
 }
 
+// 局部静态变量只初始化一次且线程安全，之后的调用不再加锁
 Papplication& Papplication::GetInstance() {
-  std::lock_guard<std::mutex> lock(m_mutex);
-  if (m_application == nullptr) {
+  static Papplication* instance = [] {
     m_application = new Papplication();
     atexit(deleteInstance);
-  }
-  return *m_application;
+    return m_application;
+  }();
+  return *instance;
 }
 
 // Destory sample
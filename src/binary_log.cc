@@ -0,0 +1,365 @@
+#include "binary_log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <map>
+
+namespace {
+
+template <typename T>
+T load(const char* p) {
+  T value;
+  std::memcpy(&value, p, sizeof(T));
+  return value;
+}
+
+const char* levelName(int level) {
+  switch (level) {
+    case DEBUG: return "DEBUG";
+    case INFO:  return "INFO";
+    case WARN:  return "WARN";
+    case ERROR: return "ERROR";
+    case FATAL: return "FATAL";
+    default:    return "UNKNOWN";
+  }
+}
+
+}  // namespace
+
+PBinaryLog& PBinaryLog::getInstance() {
+  // 与 PLogger 一样有意不析构，刷新线程在退出阶段仍会写入
+  static PBinaryLog* instance = new PBinaryLog();
+  return *instance;
+}
+
+PBinaryLog::PBinaryLog() : fd_(-1), base_(nullptr), mappedSize_(0), header_(nullptr) {}
+
+bool PBinaryLog::open(const std::string& path, size_t ring_size, size_t format_capacity) {
+  close();
+
+  size_t blocks = std::max<size_t>((ring_size + blog::kBlockSize - 1) / blog::kBlockSize, 2);
+  ring_size = blocks * blog::kBlockSize;
+  format_capacity = (format_capacity + 4095) / 4096 * 4096;
+  size_t total = blog::kHeaderSize + format_capacity + ring_size;
+
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  if (ftruncate(fd, static_cast<off_t>(total)) != 0) {
+    ::close(fd);
+    return false;
+  }
+  void* base = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    ::close(fd);
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  fd_ = fd;
+  base_ = static_cast<char*>(base);
+  mappedSize_ = total;
+  header_ = reinterpret_cast<blog::FileHeader*>(base_);
+  std::memcpy(header_->magic, blog::kMagic, sizeof(blog::kMagic));
+  header_->version = blog::kVersion;
+  header_->block_size = static_cast<uint32_t>(blog::kBlockSize);
+  header_->format_offset = blog::kHeaderSize;
+  header_->format_capacity = format_capacity;
+  header_->format_used = 0;
+  header_->ring_offset = blog::kHeaderSize + format_capacity;
+  header_->ring_size = ring_size;
+  header_->write_pos = 0;
+
+  // 打开前已注册的格式
+  for (size_t i = 0; i < formats_.size(); ++i) {
+    writeFormatLocked(static_cast<uint32_t>(i + 1), formats_[i]);
+  }
+  enabled_.store(true, std::memory_order_release);
+  return true;
+}
+
+void PBinaryLog::close() {
+  if (!enabled_.exchange(false)) {
+    return;
+  }
+  // 写出仍在各线程缓冲区中的记录
+  PLogger::getInstance().flush();
+  std::lock_guard<std::mutex> lock(mutex_);
+  unmapLocked();
+}
+
+void PBinaryLog::unmapLocked() {
+  if (base_ == nullptr) {
+    return;
+  }
+  msync(base_, mappedSize_, MS_SYNC);
+  munmap(base_, mappedSize_);
+  ::close(fd_);
+  base_ = nullptr;
+  header_ = nullptr;
+  mappedSize_ = 0;
+  fd_ = -1;
+}
+
+uint32_t PBinaryLog::registerFormat(LogLevel level, const char* file, int line,
+                                    const char* format) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  formats_.push_back({level, file, line, format});
+  uint32_t id = static_cast<uint32_t>(formats_.size());
+  if (header_ != nullptr) {
+    writeFormatLocked(id, formats_.back());
+  }
+  return id;
+}
+
+// 调用者持有 mutex_；格式表已满时只保留在内存中，解码时显示为未知格式
+void PBinaryLog::writeFormatLocked(uint32_t id, const Format& format) {
+  uint16_t file_len = static_cast<uint16_t>(std::min<size_t>(format.file.size(), UINT16_MAX));
+  uint16_t fmt_len = static_cast<uint16_t>(std::min<size_t>(format.format.size(), UINT16_MAX));
+  uint32_t entry_len = 4 + 4 + 1 + 4 + 2 + file_len + 2 + fmt_len;
+  if (header_->format_used + entry_len > header_->format_capacity) {
+    return;
+  }
+  char* p = base_ + header_->format_offset + header_->format_used;
+  uint8_t level = static_cast<uint8_t>(format.level);
+  uint32_t line = static_cast<uint32_t>(format.line);
+  std::memcpy(p, &entry_len, 4);
+  std::memcpy(p + 4, &id, 4);
+  std::memcpy(p + 8, &level, 1);
+  std::memcpy(p + 9, &line, 4);
+  std::memcpy(p + 13, &file_len, 2);
+  std::memcpy(p + 15, format.file.data(), file_len);
+  std::memcpy(p + 15 + file_len, &fmt_len, 2);
+  std::memcpy(p + 17 + file_len, format.format.data(), fmt_len);
+  header_->format_used += entry_len;
+}
+
+void PBinaryLog::appendRecords(const char* records, size_t length) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (header_ == nullptr) {
+    return;
+  }
+  char* ring = base_ + header_->ring_offset;
+  const uint64_t ring_size = header_->ring_size;
+  uint64_t pos = header_->write_pos;
+
+  size_t offset = 0;
+  while (offset + blog::kRecordHeaderSize <= length) {
+    uint32_t len = load<uint32_t>(records + offset);
+    if (len < blog::kRecordHeaderSize || len > blog::kMaxRecordSize || offset + len > length) {
+      break;
+    }
+    // 放不下时跳到下一块，当前块以0长度或块尾结束
+    if (pos % blog::kBlockSize + len > blog::kBlockSize) {
+      pos += blog::kBlockSize - pos % blog::kBlockSize;
+    }
+    std::memcpy(ring + pos % ring_size, records + offset, len);
+    pos += len;
+    if (blog::kBlockSize - pos % blog::kBlockSize >= sizeof(uint32_t) && pos % blog::kBlockSize != 0) {
+      // 截断进入新块后残留的旧记录
+      std::memset(ring + pos % ring_size, 0, sizeof(uint32_t));
+    }
+    offset += len;
+  }
+  header_->write_pos = pos;
+}
+
+namespace blog {
+
+namespace {
+
+// 把一条记录的参数按格式串渲染
+void render(const std::string& format, const char* args, size_t length, std::string& out) {
+  size_t pos = 0;
+  auto nextArg = [&](std::string& text) -> bool {
+    if (pos >= length) {
+      return false;
+    }
+    uint8_t type = static_cast<uint8_t>(args[pos++]);
+    char buf[64];
+    switch (type) {
+      case kInt32:
+        if (pos + 4 > length) return false;
+        snprintf(buf, sizeof(buf), "%d", load<int32_t>(args + pos));
+        pos += 4;
+        break;
+      case kUInt32:
+        if (pos + 4 > length) return false;
+        snprintf(buf, sizeof(buf), "%u", load<uint32_t>(args + pos));
+        pos += 4;
+        break;
+      case kInt64:
+        if (pos + 8 > length) return false;
+        snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(load<int64_t>(args + pos)));
+        pos += 8;
+        break;
+      case kUInt64:
+        if (pos + 8 > length) return false;
+        snprintf(buf, sizeof(buf), "%llu",
+                 static_cast<unsigned long long>(load<uint64_t>(args + pos)));
+        pos += 8;
+        break;
+      case kDouble:
+        if (pos + 8 > length) return false;
+        snprintf(buf, sizeof(buf), "%g", load<double>(args + pos));
+        pos += 8;
+        break;
+      case kBool:
+        if (pos + 1 > length) return false;
+        snprintf(buf, sizeof(buf), "%s", args[pos] ? "true" : "false");
+        pos += 1;
+        break;
+      case kChar:
+        if (pos + 1 > length) return false;
+        buf[0] = args[pos];
+        buf[1] = '\0';
+        pos += 1;
+        break;
+      case kString: {
+        if (pos + 2 > length) return false;
+        uint16_t n = load<uint16_t>(args + pos);
+        pos += 2;
+        if (pos + n > length) return false;
+        text.assign(args + pos, n);
+        pos += n;
+        return true;
+      }
+      default:
+        return false;
+    }
+    text = buf;
+    return true;
+  };
+
+  std::string text;
+  for (size_t i = 0; i < format.size(); ++i) {
+    if (format[i] == '{' && i + 1 < format.size() && format[i + 1] == '}') {
+      out.append(nextArg(text) ? text : "{?}");
+      ++i;
+    } else {
+      out.push_back(format[i]);
+    }
+  }
+  // 多出的参数附在末尾
+  while (nextArg(text)) {
+    out.append(" ").append(text);
+  }
+}
+
+}  // namespace
+
+bool decodeFile(const std::string& path, std::ostream& out, std::string* error) {
+  auto fail = [error](const std::string& message) {
+    if (error) {
+      *error = message;
+    }
+    return false;
+  };
+
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return fail("cannot open " + path + ": " + strerror(errno));
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < kHeaderSize) {
+    ::close(fd);
+    return fail("file too small");
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  void* mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapped == MAP_FAILED) {
+    return fail("mmap failed");
+  }
+  const char* base = static_cast<const char*>(mapped);
+  FileHeader header;
+  std::memcpy(&header, base, sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+      header.block_size == 0 || header.ring_size % header.block_size != 0 ||
+      header.ring_offset + header.ring_size > size ||
+      header.format_offset + header.format_used > size) {
+    munmap(mapped, size);
+    return fail("not a binary log file");
+  }
+
+  struct FormatEntry {
+    int level;
+    std::string file;
+    uint32_t line;
+    std::string format;
+  };
+  std::map<uint32_t, FormatEntry> formats;
+  const char* fp = base + header.format_offset;
+  const char* fend = fp + header.format_used;
+  while (fp + 17 <= fend) {
+    uint32_t entry_len = load<uint32_t>(fp);
+    if (entry_len < 17 || fp + entry_len > fend) {
+      break;
+    }
+    uint16_t file_len = load<uint16_t>(fp + 13);
+    uint16_t fmt_len = load<uint16_t>(fp + 15 + file_len);
+    formats[load<uint32_t>(fp + 4)] = {static_cast<uint8_t>(fp[8]), std::string(fp + 15, file_len),
+                                       load<uint32_t>(fp + 9),
+                                       std::string(fp + 17 + file_len, fmt_len)};
+    fp += entry_len;
+  }
+
+  // 已回绕时，当前块之后的那一块是最旧的完整块
+  const char* ring = base + header.ring_offset;
+  uint64_t block_size = header.block_size;
+  uint64_t blocks = header.ring_size / block_size;
+  uint64_t current = header.write_pos / block_size;
+  uint64_t first = current >= blocks ? current - blocks + 1 : 0;
+
+  std::string line;
+  for (uint64_t b = first; b <= current; ++b) {
+    const char* block = ring + (b % blocks) * block_size;
+    uint64_t limit = b == current ? header.write_pos % block_size : block_size;
+    uint64_t offset = 0;
+    while (offset + kRecordHeaderSize <= limit) {
+      const char* rec = block + offset;
+      uint32_t len = load<uint32_t>(rec);
+      if (len < kRecordHeaderSize || offset + len > limit) {
+        break;
+      }
+      uint32_t id = load<uint32_t>(rec + 4);
+      uint64_t ns = load<uint64_t>(rec + 8);
+
+      time_t seconds = static_cast<time_t>(ns / 1000000000ull);
+      std::tm tm_buf;
+      localtime_r(&seconds, &tm_buf);
+      char time_buf[48];
+      size_t n = strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", &tm_buf);
+      snprintf(time_buf + n, sizeof(time_buf) - n, ".%06u",
+               static_cast<unsigned>(ns / 1000 % 1000000));
+
+      line.clear();
+      auto it = formats.find(id);
+      if (it != formats.end()) {
+        line.append("[").append(levelName(it->second.level)).append("][").append(time_buf);
+        line.append("][").append(it->second.file).append(":");
+        line.append(std::to_string(it->second.line)).append("] ");
+        render(it->second.format, rec + kRecordHeaderSize, len - kRecordHeaderSize, line);
+      } else {
+        line.append("[UNKNOWN][").append(time_buf).append("][format ");
+        line.append(std::to_string(id)).append("]");
+        render("", rec + kRecordHeaderSize, len - kRecordHeaderSize, line);
+      }
+      out << line << '\n';
+      offset += len;
+    }
+  }
+
+  munmap(mapped, size);
+  return true;
+}
+
+}  // namespace blog
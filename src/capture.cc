@@ -0,0 +1,229 @@
+#include "capture.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#include "logger.h"
+#include "trace.h"
+
+namespace prpc {
+
+namespace {
+
+template <typename T>
+void appendRaw(std::string* out, T value) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+T readRaw(const char* data) {
+  T value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+}  // namespace
+
+bool readCaptureFile(const std::string& path, int64_t* start_unix_us,
+                     std::vector<CapturedFrame>* frames, std::string* error) {
+  auto fail = [error](const std::string& reason) {
+    if (error != nullptr) {
+      *error = reason;
+    }
+    return false;
+  };
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return fail("cannot open");
+  }
+  char header[capture::kFileHeaderSize];
+  if (!in.read(header, sizeof(header)) ||
+      memcmp(header, capture::kMagic, sizeof(capture::kMagic)) != 0) {
+    return fail("not a capture file");
+  }
+  if (readRaw<uint32_t>(header + 8) != capture::kVersion) {
+    return fail("unsupported capture version");
+  }
+  if (start_unix_us != nullptr) {
+    *start_unix_us = readRaw<int64_t>(header + 16);
+  }
+
+  char record[capture::kRecordHeaderSize];
+  while (in.read(record, sizeof(record))) {
+    CapturedFrame frame;
+    frame.arrival_ns = readRaw<uint64_t>(record);
+    frame.header.resize(readRaw<uint32_t>(record + 8));
+    frame.args.resize(readRaw<uint32_t>(record + 12));
+    if (!in.read(&frame.header[0], frame.header.size()) ||
+        !in.read(&frame.args[0], frame.args.size())) {
+      break;  // 抓取中途退出时最后一条记录可能不完整
+    }
+    frames->push_back(std::move(frame));
+  }
+  return true;
+}
+
+TrafficCapture& TrafficCapture::getInstance() {
+  // 不析构：reactor 线程在退出过程中仍可能记录帧
+  static TrafficCapture* instance = new TrafficCapture();
+  return *instance;
+}
+
+TrafficCapture::TrafficCapture()
+    : sampleThreshold_(0),
+      sampleAll_(false),
+      captured_(0),
+      dropped_(0),
+      budget_(0),
+      bytesPerSecond_(0),
+      reserved_(0),
+      maxFileBytes_(0),
+      full_(false),
+      stopping_(false),
+      file_(nullptr) {
+  std::atexit(stopAtExit);
+}
+
+void TrafficCapture::stopAtExit() {
+  getInstance().stop();
+}
+
+bool TrafficCapture::start(const std::string& path, const Options& options) {
+  stop();
+  FILE* file = fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  std::string header(capture::kMagic, sizeof(capture::kMagic));
+  appendRaw(&header, capture::kVersion);
+  appendRaw(&header, uint32_t(0));
+  appendRaw(&header, static_cast<int64_t>(Tracer::nowUs()));
+  fwrite(header.data(), 1, header.size(), file);
+  {
+    std::lock_guard<std::mutex> lock(fileMutex_);
+    file_ = file;
+  }
+
+  sampleAll_.store(options.sample_rate >= 1.0, std::memory_order_relaxed);
+  sampleThreshold_.store(
+      options.sample_rate > 0 ? static_cast<uint64_t>(std::min(options.sample_rate, 1.0) *
+                                                      18446744073709551615.0)
+                              : 0,
+      std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    pending_.clear();
+    start_ = std::chrono::steady_clock::now();
+    refilled_ = start_;
+    bytesPerSecond_ = options.bytes_per_second;
+    budget_ = static_cast<double>(bytesPerSecond_);
+    reserved_ = capture::kFileHeaderSize;
+    maxFileBytes_ = options.max_file_bytes;
+    full_ = false;
+    stopping_ = false;
+  }
+  writer_ = std::thread(&TrafficCapture::writeLoop, this);
+  enabled_.store(true, std::memory_order_relaxed);
+  return true;
+}
+
+void TrafficCapture::stop() {
+  enabled_.store(false, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    stopping_ = true;
+  }
+  queueCond_.notify_all();
+  if (writer_.joinable()) {
+    writer_.join();
+  }
+  writePending();
+  std::lock_guard<std::mutex> lock(fileMutex_);
+  if (file_ != nullptr) {
+    fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+void TrafficCapture::record(std::chrono::steady_clock::time_point arrival,
+                            const std::string& header, const std::string& args) {
+  if (!sampleAll_.load(std::memory_order_relaxed) &&
+      Tracer::newId() >= sampleThreshold_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  size_t size = capture::kRecordHeaderSize + header.size() + args.size();
+  bool wake = false;
+  {
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    if (stopping_) {
+      return;
+    }
+    // 令牌桶：按预算补充，最多攒一秒
+    auto now = std::chrono::steady_clock::now();
+    budget_ = std::min(static_cast<double>(bytesPerSecond_),
+                       budget_ + std::chrono::duration<double>(now - refilled_).count() *
+                                     bytesPerSecond_);
+    refilled_ = now;
+    if (reserved_ + size > maxFileBytes_) {
+      if (!full_) {
+        full_ = true;
+        LOG(WARN) << "traffic capture reached " << maxFileBytes_ << " bytes, stopped capturing";
+      }
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    if (size > budget_ || pending_.size() + size > kMaxPendingBytes) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    budget_ -= size;
+    reserved_ += size;
+
+    uint64_t arrival_ns =
+        arrival > start_
+            ? std::chrono::duration_cast<std::chrono::nanoseconds>(arrival - start_).count()
+            : 0;
+    appendRaw(&pending_, arrival_ns);
+    appendRaw(&pending_, static_cast<uint32_t>(header.size()));
+    appendRaw(&pending_, static_cast<uint32_t>(args.size()));
+    pending_.append(header);
+    pending_.append(args);
+    wake = pending_.size() >= kWakeBytes && pending_.size() - size < kWakeBytes;
+  }
+  captured_.fetch_add(1, std::memory_order_relaxed);
+  if (wake) {
+    queueCond_.notify_one();
+  }
+}
+
+void TrafficCapture::flush() {
+  writePending();
+}
+
+void TrafficCapture::writeLoop() {
+  std::unique_lock<std::mutex> lock(queueMutex_);
+  while (!stopping_) {
+    queueCond_.wait_for(lock, std::chrono::milliseconds(kWriteIntervalMs),
+                        [this] { return stopping_ || pending_.size() >= kWakeBytes; });
+    lock.unlock();
+    writePending();
+    lock.lock();
+  }
+}
+
+void TrafficCapture::writePending() {
+  std::lock_guard<std::mutex> fileLock(fileMutex_);
+  std::string batch;
+  {
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    batch.swap(pending_);
+  }
+  if (!batch.empty() && file_ != nullptr) {
+    fwrite(batch.data(), 1, batch.size(), file_);
+    fflush(file_);
+  }
+}
+
+}  // namespace prpc
@@ -4,120 +4,277 @@
 #include <errno.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <unistd.h>
 
+#include <chrono>
+
+#include "application.h"
 #include "controller.h"
+#include "fiber.h"
 #include "header.pb.h"
 #include "logger.h"
-#include "zookeeperutil.h"
+#include "metrics.h"
+#include "registry.h"
+#include "rpc_frame.h"
+#include "trace.h"
 
 std::mutex g_data_mutx;
 
+Pchannel::MethodState *Pchannel::ResolveMethod(
+    const google::protobuf::MethodDescriptor *method, MethodProfile *profile) {
+  // Only the version is read per call; the snapshot is fetched after a reload.
+  uint64_t version = Papplication::GetConfig().Version();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::unique_ptr<MethodState> &state = m_methods[method];
+  if (!state) {
+    state = std::make_unique<MethodState>();
+    state->service_name = std::string(method->service()->name());
+    state->method_name = std::string(method->name());
+    state->stats = &prpc::MetricsRegistry::getInstance().method(
+        prpc::MetricsRegistry::kClient, state->service_name,
+        state->method_name);
+    state->config_version = version - 1;
+  }
+  if (state->config_version != version) {
+    ConfigSnapshotPtr snapshot = Papplication::Config();
+    state->profile =
+        snapshot->ResolveMethod(state->service_name, state->method_name);
+    state->config_version = snapshot->version;
+  }
+  *profile = state->profile;
+  return state.get();
+}
+
 void Pchannel::CallMethod(const google::protobuf::MethodDescriptor *method,
                           google::protobuf::RpcController *controller,
                           const google::protobuf::Message *request,
                           google::protobuf::Message *response,
                           google::protobuf::Closure *done) {
-  const google::protobuf::ServiceDescriptor *sd = method->service();
-  std::string service_name(sd->name());
-  std::string method_name(method->name());
+  MethodProfile profile;
+  MethodState *state = ResolveMethod(method, &profile);
+  const std::string &service_name = state->service_name;
+  const std::string &method_name = state->method_name;
+  prpc::MethodStats &stats = *state->stats;
+  auto start = std::chrono::steady_clock::now();
+
+  // A call made while serving a traced request joins that trace as a child.
+  prpc::TraceContext parent = prpc::Tracer::current();
+  prpc::TraceContext span = prpc::Tracer::getInstance().newSpan(parent);
+  int64_t span_start_us = span.sampled ? prpc::Tracer::nowUs() : 0;
+
+  auto finish = [&](prpc::ErrorCode code) {
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    stats.latency_ns.recordDuration(elapsed);
+    if (code != prpc::ErrorCode::SUCCESS) {
+      stats.errors.add(code);
+    }
+    if (span.sampled) {
+      prpc::Span finished;
+      finished.trace_id = span.trace_id;
+      finished.span_id = span.span_id;
+      finished.parent_span_id = parent.span_id;
+      finished.name = service_name + "." + method_name;
+      finished.kind = prpc::Span::kClient;
+      finished.start_us = span_start_us;
+      finished.duration_us =
+          std::chrono::duration_cast<std::chrono::microseconds>(elapsed)
+              .count();
+      finished.error = code;
+      prpc::Tracer::getInstance().submit(std::move(finished));
+    }
+  };
+  auto fail = [&](prpc::ErrorCode code, const std::string &reason) {
+    finish(code);
+    controller->SetFailed(reason);
+  };
+
+  // max_concurrency counts the calls to this method from every channel in
+  // the process, and fails calls beyond the limit instead of queueing them.
+  struct InflightGuard {
+    std::atomic<int64_t> &inflight;
+    ~InflightGuard() { inflight.fetch_sub(1, std::memory_order_relaxed); }
+  } inflight_guard{stats.inflight};
+  if (stats.inflight.fetch_add(1, std::memory_order_relaxed) >=
+          profile.max_concurrency &&
+      profile.max_concurrency > 0) {
+    fail(prpc::ErrorCode::RESOURCE_ERROR,
+         service_name + "." + method_name + " max concurrency reached!");
+    return;
+  }
 
   std::string args_str;
   if (!request->SerializeToString(&args_str)) {
-    controller->SetFailed("serialize request error!");
+    fail(prpc::ErrorCode::SERIALIZATION_ERROR, "serialize request error!");
     return;
   }
+  stats.request_bytes.record(args_str.size());
 
   Prpc::RpcHeader rpcHeader;
   rpcHeader.set_service_name(service_name);
   rpcHeader.set_method_name(method_name);
   rpcHeader.set_args_size(args_str.size());
-
-  std::string rpc_header_str;
-  if (!rpcHeader.SerializeToString(&rpc_header_str)) {
-    controller->SetFailed("serialize rpc header error!");
-    return;
+  if (span.valid()) {
+    rpcHeader.set_trace_id(span.trace_id);
+    rpcHeader.set_span_id(span.span_id);
+    rpcHeader.set_sampled(span.sampled);
   }
 
-  uint32_t header_size = rpc_header_str.size();
-  std::string send_rpc_str;
-  send_rpc_str.append((char *)&header_size, 4);
-  send_rpc_str += rpc_header_str;
-  send_rpc_str += args_str;
-
-  ZkClient zkCli;
-  zkCli.Start();
-  std::string method_path = "/" + service_name + "/" + method_name;
-  std::string host_data = zkCli.GetData(method_path.c_str());
-  if (host_data.empty()) {
-    controller->SetFailed(method_path + " is not exist!");
-    return;
+  // The controller's priority and timeout win over the method's profile. A
+  // Pcontroller call with neither gets the default timeout; other
+  // controllers keep waiting as long as it takes.
+  Pcontroller *p_controller = dynamic_cast<Pcontroller *>(controller);
+  uint32_t priority = profile.priority;
+  int timeout_ms = profile.timeout_ms;
+  if (p_controller) {
+    if (p_controller->GetPriority() != RpcPriority::kDefault) {
+      priority = static_cast<uint32_t>(p_controller->GetPriority());
+    }
+    if (p_controller->GetTimeout() > 0) {
+      timeout_ms = p_controller->GetTimeout();
+    } else if (timeout_ms <= 0) {
+      timeout_ms = Pcontroller::kDefaultTimeoutMs;
+    }
+  }
+  // A call made while serving a request gets no more than that request's
+  // remaining budget, and fails right away once the budget is spent.
+  if (parent.deadline != std::chrono::steady_clock::time_point::max()) {
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                         parent.deadline - std::chrono::steady_clock::now())
+                         .count();
+    if (remaining <= 0) {
+      fail(prpc::ErrorCode::TIMEOUT_ERROR, "deadline exceeded!");
+      return;
+    }
+    if (timeout_ms <= 0 || remaining < timeout_ms) {
+      timeout_ms = static_cast<int>(remaining);
+    }
+  }
+  rpcHeader.set_priority(priority);
+  // Inside a fiber the socket waits below park the fiber, not the thread.
+  int io_timeout_ms = -1;
+  if (timeout_ms > 0) {
+    rpcHeader.set_timeout_ms(timeout_ms);
+    io_timeout_ms = timeout_ms;
   }
 
-  size_t idx = host_data.find(":");
-  if (idx == std::string::npos) {
-    controller->SetFailed(method_path + " address is invalid!");
+  std::string send_rpc_str;
+  if (!prpc::encodeRequestFrame(rpcHeader, args_str, &send_rpc_str,
+                                profile.checksum)) {
+    fail(prpc::ErrorCode::SERIALIZATION_ERROR, "serialize rpc header error!");
     return;
   }
-  std::string ip = host_data.substr(0, idx);
-  uint16_t port = atoi(host_data.substr(idx + 1).c_str());
 
+  // A call whose request never left (connect or send failed) is retried up
+  // to max_retries times; the failed connection is dropped first.
+  std::string method_path = "/" + service_name + "/" + method_name;
+  std::string host_data;
   int clientfd = -1;
-  {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    if (m_connections.count(host_data)) {
-      clientfd = m_connections[host_data];
+  for (int attempt = 0;; ++attempt) {
+    host_data = ServiceRegistry::Default().Lookup(service_name, method_name);
+    if (host_data.empty()) {
+      fail(prpc::ErrorCode::SERVICE_ERROR, method_path + " is not exist!");
+      return;
     }
-  }
 
-  if (clientfd == -1) {
-    clientfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (clientfd == -1) {
-      controller->SetFailed("create socket error!");
+    size_t idx = host_data.find(":");
+    if (idx == std::string::npos) {
+      fail(prpc::ErrorCode::ZOOKEEPER_ERROR,
+           method_path + " address is invalid!");
       return;
     }
+    std::string ip = host_data.substr(0, idx);
+    uint16_t port = atoi(host_data.substr(idx + 1).c_str());
+
+    clientfd = -1;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_connections.count(host_data)) {
+        clientfd = m_connections[host_data];
+      }
+    }
 
-    sockaddr_in server_addr;
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(port);
-    server_addr.sin_addr.s_addr = inet_addr(ip.c_str());
+    if (clientfd == -1) {
+      clientfd = socket(AF_INET, SOCK_STREAM, 0);
+      if (clientfd == -1) {
+        fail(prpc::ErrorCode::NETWORK_ERROR, "create socket error!");
+        return;
+      }
 
-    if (connect(clientfd, (sockaddr *)&server_addr, sizeof(server_addr)) ==
-        -1) {
-      controller->SetFailed("connect error!");
-      close(clientfd);
-      return;
+      sockaddr_in server_addr;
+      server_addr.sin_family = AF_INET;
+      server_addr.sin_port = htons(port);
+      server_addr.sin_addr.s_addr = inet_addr(ip.c_str());
+
+      if (fiber::connect(clientfd, (sockaddr *)&server_addr,
+                         sizeof(server_addr), io_timeout_ms) == -1) {
+        close(clientfd);
+        if (attempt < profile.max_retries) {
+          continue;
+        }
+        fail(prpc::ErrorCode::NETWORK_ERROR, "connect error!");
+        return;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_connections[host_data] = clientfd;
+      }
+    }
+
+    if (p_controller || timeout_ms > 0) {
+      struct timeval tv;
+      tv.tv_sec = timeout_ms / 1000;
+      tv.tv_usec = static_cast<__suseconds_t>((timeout_ms % 1000) * 1000);
+      setsockopt(clientfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
     }
 
+    if (fiber::send(clientfd, send_rpc_str.c_str(), send_rpc_str.size(), 0,
+                    io_timeout_ms) != -1) {
+      break;
+    }
+    close(clientfd);
     {
       std::lock_guard<std::mutex> lock(m_mutex);
-      m_connections[host_data] = clientfd;
+      m_connections.erase(host_data);
+    }
+    if (attempt >= profile.max_retries) {
+      fail(prpc::ErrorCode::NETWORK_ERROR, "send error!");
+      return;
     }
   }
 
-  Pcontroller *p_controller = dynamic_cast<Pcontroller *>(controller);
-  if (p_controller) {
-    int timeout_ms = p_controller->GetTimeout();
-    struct timeval tv;
-    tv.tv_sec = timeout_ms / 1000;
-    tv.tv_usec = static_cast<__suseconds_t>((timeout_ms % 1000) * 1000);
-    setsockopt(clientfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-  }
-
-  if (send(clientfd, send_rpc_str.c_str(), send_rpc_str.size(), 0) == -1) {
-    controller->SetFailed("send error!");
+  // The response is a 4-byte length followed by the message, and by its
+  // checksum when the provider sent one. A provider that predates checksums
+  // answers without, which is accepted.
+  char length_buf[prpc::kFrameLengthSize];
+  std::string response_str;
+  ssize_t recv_size = fiber::recvAll(clientfd, length_buf, sizeof(length_buf),
+                                     0, io_timeout_ms);
+  bool checksum = false;
+  uint32_t response_size =
+      recv_size > 0 ? prpc::decodeFrameLength(length_buf, &checksum) : 0;
+  size_t trailer = checksum ? prpc::kFrameChecksumSize : 0;
+  // A corrupt or hostile length would otherwise make us allocate up to 2 GB.
+  // The rest of the frame is left unread, so the connection is dropped.
+  if (recv_size > 0 && response_size > profile.max_response_bytes) {
+    fail(prpc::ErrorCode::SERIALIZATION_ERROR,
+         "response of " + std::to_string(response_size) +
+             " bytes exceeds max_response_mb!");
     close(clientfd);
     std::lock_guard<std::mutex> lock(m_mutex);
     m_connections.erase(host_data);
     return;
   }
-
-  char recv_buf[1024] = {0};
-  int recv_size = recv(clientfd, recv_buf, sizeof(recv_buf), 0);
+  if (recv_size > 0 && response_size + trailer > 0) {
+    response_str.resize(response_size + trailer);
+    recv_size = fiber::recvAll(clientfd, &response_str[0], response_str.size(),
+                               0, io_timeout_ms);
+  }
   if (recv_size <= 0) {
     if (recv_size == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-      controller->SetFailed("recv timeout!");
+      fail(prpc::ErrorCode::TIMEOUT_ERROR, "recv timeout!");
     } else {
-      controller->SetFailed("recv error!");
+      fail(prpc::ErrorCode::NETWORK_ERROR, "recv error!");
     }
     close(clientfd);
     std::lock_guard<std::mutex> lock(m_mutex);
@@ -125,13 +282,28 @@ void Pchannel::CallMethod(const google::protobuf::MethodDescriptor *method,
     return;
   }
 
-  if (!response->ParseFromArray(recv_buf, recv_size)) {
-    controller->SetFailed("parse error!");
+  if (checksum) {
+    uint32_t expected = prpc::decodeFrameChecksum(&response_str[response_size]);
+    response_str.resize(response_size);
+    uint32_t crc = prpc::crc32c(length_buf, sizeof(length_buf));
+    if (prpc::crc32c(response_str.data(), response_size, crc) != expected) {
+      fail(prpc::ErrorCode::SERIALIZATION_ERROR, "response checksum mismatch!");
+      close(clientfd);
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_connections.erase(host_data);
+      return;
+    }
+  }
+
+  if (!response->ParseFromString(response_str)) {
+    fail(prpc::ErrorCode::SERIALIZATION_ERROR, "parse error!");
     close(clientfd);
     std::lock_guard<std::mutex> lock(m_mutex);
     m_connections.erase(host_data);
     return;
   }
+  stats.response_bytes.record(response_size);
+  finish(prpc::ErrorCode::SUCCESS);
 
   if (done != nullptr) {
     done->Run();
@@ -196,6 +368,15 @@ std::string Pchannel::QueryServiceHost(ZkClient *zkclient,
   return host_data_1;
 }
 
+Pchannel::~Pchannel() {
+  for (auto &conn : m_connections) {
+    close(conn.second);
+  }
+  if (m_clientfd != -1) {
+    close(m_clientfd);
+  }
+}
+
 // support delayed connection
 Pchannel::Pchannel(bool connectNow) : m_clientfd(-1), m_idx(0) {
   if (!connectNow) {
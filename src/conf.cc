@@ -1,26 +1,145 @@
 #include "conf.h"
 
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
 #include <memory>
 
+#include "logger.h"
+
+namespace {
+
+// 常用项在加载时解析一次
+void ParseKnownKeys(ConfigSnapshot &snapshot) {
+    snapshot.rpcserver_ip = snapshot.Get("rpcserverip");
+    snapshot.rpcserver_port = static_cast<uint16_t>(snapshot.GetInt("rpcserverport"));
+    snapshot.zookeeper_host = snapshot.Get("zookeeperip") + ":" + snapshot.Get("zookeeperport");
+    snapshot.registry = snapshot.Get("registry");
+    snapshot.log_level = snapshot.Get("log_level");
+    snapshot.status_port = snapshot.GetInt("rpcserver_status_port");
+    snapshot.slow_request_ms = snapshot.GetInt("rpcserver_slow_request_ms");
+    snapshot.pool_alert_interval_s = snapshot.GetInt("rpcserver_pool_alert_interval_s");
+    snapshot.edf_max_wait_ms = snapshot.GetInt("rpcserver_edf_max_wait_ms");
+
+    // rpcserver_queue_weights=8,4,1
+    const std::string &list = snapshot.Get("rpcserver_queue_weights");
+    for (size_t pos = 0; pos < list.size();) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) end = list.size();
+        snapshot.queue_weights.push_back(atoi(list.substr(pos, end - pos).c_str()));
+        pos = end + 1;
+    }
+
+    const std::string &rate = snapshot.Get("trace_sample_rate");
+    if (!rate.empty()) {
+        snapshot.trace_sample_rate = atof(rate.c_str());
+    }
+}
+
+uint64_t NextConfigId() {
+    static std::atomic<uint64_t> next_id{1};
+    return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+}  // namespace
+
+const std::string& ConfigSnapshot::Get(const std::string &key) const {
+    static const std::string empty;
+    auto it = values.find(key);
+    return it == values.end() ? empty : it->second;
+}
+
+int64_t ConfigSnapshot::GetInt(const std::string &key, int64_t default_value) const {
+    const std::string &value = Get(key);
+    return value.empty() ? default_value : strtoll(value.c_str(), nullptr, 10);
+}
+
+MethodProfile ConfigSnapshot::ResolveMethod(const std::string &service,
+                                            const std::string &method) const {
+    const std::string service_prefix = service + ".";
+    const std::string method_prefix = service_prefix + method + ".";
+    auto lookup = [&](const char *key) -> const std::string& {
+        const std::string &value = Get(method_prefix + key);
+        return value.empty() ? Get(service_prefix + key) : value;
+    };
+    auto lookupInt = [&](const char *key) {
+        return atoi(lookup(key).c_str());
+    };
+
+    MethodProfile profile;
+    profile.timeout_ms = lookupInt("timeout_ms");
+    profile.max_concurrency = lookupInt("max_concurrency");
+    profile.max_retries = lookupInt("max_retries");
+
+    const std::string &executor = lookup("executor");
+    if (executor == "inline") {
+        profile.run_inline = true;
+    } else if (!executor.empty() && executor != "pool") {
+        LOG(WARN) << service << "." << method << ": unknown executor " << executor;
+    }
+
+    const std::string &checksum = lookup("checksum");
+    const std::string &mode = checksum.empty() ? Get("checksum") : checksum;
+    if (mode == "crc32c") {
+        profile.checksum = true;
+    } else if (!mode.empty() && mode != "none") {
+        LOG(WARN) << service << "." << method << ": unknown checksum " << mode;
+    }
+
+    const std::string &max_response = lookup("max_response_mb");
+    const std::string &max_response_mb =
+        max_response.empty() ? Get("rpcclient_max_response_mb") : max_response;
+    int response_mb = atoi(max_response_mb.c_str());
+    if (response_mb > 0) {
+        profile.max_response_bytes = static_cast<uint64_t>(response_mb) << 20;
+    } else if (!max_response_mb.empty()) {
+        LOG(WARN) << service << "." << method << ": invalid max_response_mb " << max_response_mb;
+    }
+
+    const std::string &priority = lookup("priority");
+    if (priority == "high") {
+        profile.priority = 1;
+    } else if (priority == "normal") {
+        profile.priority = 2;
+    } else if (priority == "low") {
+        profile.priority = 3;
+    } else if (!priority.empty()) {
+        LOG(WARN) << service << "." << method << ": unknown priority " << priority;
+    }
+    return profile;
+}
+
+Pconfig::Pconfig() : id_(NextConfigId()), current_(std::make_shared<ConfigSnapshot>()) {
+}
+
+Pconfig::~Pconfig() {
+    StopWatching();
+}
+
 prpc::Result<void> Pconfig::LoadConfigFile(const char* config_file){
     try {
         // 检查配置文件路径
         if (!config_file) {
             throw prpc::ConfigException("Configuration file path is null");
         }
-        
-        // 清空现有配置，支持重新加载
-        config_map.clear();
-        
+
         std::unique_ptr<FILE, decltype(&fclose)>pf(
             fopen(config_file, "r"),
             &fclose
         );
 
-        if (pf == nullptr){ 
+        if (pf == nullptr){
             throw prpc::ConfigException("Failed to open config file: " + std::string(config_file));
         }
 
+        // 解析到新的快照，不影响正在读取旧快照的线程
+        auto snapshot = std::make_unique<ConfigSnapshot>();
+        std::string section;    // [service] 或 [service.method]，之后的键加上小节名前缀
         char buf[1024];
         while(fgets(buf, 1024, pf.get()) != nullptr) {
             std::string read_buf(buf);
@@ -28,6 +147,13 @@ prpc::Result<void> Pconfig::LoadConfigFile(const char* config_file){
 
             if(read_buf[0] == '#' || read_buf.empty()) continue;
 
+            size_t section_end = read_buf.find(']');
+            if (read_buf[0] == '[' && section_end != std::string::npos) {
+                section = read_buf.substr(1, section_end - 1);
+                Trim(section);
+                continue;
+            }
+
             int index = read_buf.find('=');
             if (index == -1) continue;
 
@@ -40,9 +166,38 @@ prpc::Result<void> Pconfig::LoadConfigFile(const char* config_file){
             std::string value = read_buf.substr(index+1, endindex-index-1);
             Trim(value);
 
-            config_map[key] = value; // 使用[]操作符支持覆盖
+            if (!section.empty()) {
+                key = section + "." + key;
+            }
+            snapshot->values[key] = value; // 使用[]操作符支持覆盖
+        }
+        ParseKnownKeys(*snapshot);
+
+        std::lock_guard<std::recursive_mutex> notify_lock(notify_mutex_);
+        ConfigSnapshotPtr now;
+        std::vector<std::shared_ptr<Watcher>> changed;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            path_ = config_file;
+            ConfigSnapshotPtr old = std::atomic_load_explicit(&current_, std::memory_order_relaxed);
+            snapshot->version = old->version + 1;
+            now = std::move(snapshot);
+            std::atomic_store_explicit(&current_, now, std::memory_order_release);
+            version_.store(now->version, std::memory_order_release);
+
+            for (const auto &watcher : watchers_) {
+                if (old->Get(watcher->key) != now->Get(watcher->key)) {
+                    changed.push_back(watcher);
+                }
+            }
+        }
+
+        // 在锁外执行回调，回调里可以增删回调或再次加载
+        for (const auto &watcher : changed) {
+            if (!watcher->removed.load(std::memory_order_acquire)) {
+                watcher->callback(*now);
+            }
         }
-        
         return prpc::Result<void>();
     } catch (const prpc::PrpcException& e) {
         return prpc::Result<void>(e.getErrorCode(), e.what());
@@ -51,13 +206,150 @@ prpc::Result<void> Pconfig::LoadConfigFile(const char* config_file){
     }
 }
 
+prpc::Result<void> Pconfig::Reload() {
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        path = path_;
+    }
+    if (path.empty()) {
+        return prpc::Result<void>(prpc::ErrorCode::CONFIG_ERROR, "No configuration file loaded");
+    }
+    return LoadConfigFile(path.c_str());
+}
+
+ConfigSnapshotPtr Pconfig::Snapshot() const {
+    struct Cache {
+        uint64_t config_id = 0;
+        uint64_t version = 0;
+        ConfigSnapshotPtr snapshot;
+    };
+    thread_local Cache cache;
+    if (cache.config_id != id_ || cache.version != Version()) {
+        cache.snapshot = std::atomic_load_explicit(&current_, std::memory_order_acquire);
+        cache.config_id = id_;
+        cache.version = cache.snapshot->version;
+    }
+    return cache.snapshot;
+}
+
 // search by key
 std::string Pconfig::Load(const std::string &key) {
-    auto it = config_map.find(key);
-    if(it == config_map.end()){
-        return "";
+    return Snapshot()->Get(key);
+}
+
+std::map<std::string, std::string> Pconfig::LoadAll() const {
+    ConfigSnapshotPtr snapshot = Snapshot();
+    return std::map<std::string, std::string>(snapshot->values.begin(), snapshot->values.end());
+}
+
+uint64_t Pconfig::OnChange(const std::string &key, ChangeCallback callback) {
+    auto watcher = std::make_shared<Watcher>();
+    watcher->key = key;
+    watcher->callback = std::move(callback);
+    std::lock_guard<std::mutex> lock(mutex_);
+    watcher->id = next_watcher_id_++;
+    uint64_t id = watcher->id;
+    watchers_.push_back(std::move(watcher));
+    return id;
+}
+
+void Pconfig::RemoveOnChange(uint64_t id) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::find_if(watchers_.begin(), watchers_.end(),
+                               [id](const std::shared_ptr<Watcher> &watcher) {
+                                   return watcher->id == id;
+                               });
+        if (it == watchers_.end()) {
+            return;
+        }
+        (*it)->removed.store(true, std::memory_order_release);
+        watchers_.erase(it);
+    }
+    // 等待其他线程上正在执行的这一轮回调结束；在回调里调用时锁可重入，不会等待自己
+    std::lock_guard<std::recursive_mutex> notify_lock(notify_mutex_);
+}
+
+bool Pconfig::StartWatching() {
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        path = path_;
     }
-    return it->second;
+    if (path.empty() || watch_thread_.joinable()) {
+        return false;
+    }
+    // 监视所在目录：编辑器和配置下发工具通常写临时文件后 rename 覆盖，
+    // 直接监视文件会在替换后失效
+    size_t slash = path.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+    int inotify_fd = inotify_init1(IN_CLOEXEC);
+    if (inotify_fd < 0 ||
+        inotify_add_watch(inotify_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        if (inotify_fd >= 0) close(inotify_fd);
+        LOG(ERROR) << "failed to watch config directory " << dir;
+        return false;
+    }
+    stop_fd_ = eventfd(0, EFD_CLOEXEC);
+    watch_thread_ = std::thread(&Pconfig::WatchLoop, this, inotify_fd);
+    return true;
+}
+
+void Pconfig::StopWatching() {
+    if (!watch_thread_.joinable()) {
+        return;
+    }
+    uint64_t one = 1;
+    if (write(stop_fd_, &one, sizeof(one)) < 0) {
+        LOG(ERROR) << "failed to stop config watcher";
+    }
+    watch_thread_.join();
+    close(stop_fd_);
+    stop_fd_ = -1;
+}
+
+void Pconfig::WatchLoop(int inotify_fd) {
+    std::string name;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t slash = path_.rfind('/');
+        name = slash == std::string::npos ? path_ : path_.substr(slash + 1);
+    }
+    pollfd fds[2] = {{inotify_fd, POLLIN, 0}, {stop_fd_, POLLIN, 0}};
+    alignas(inotify_event) char buf[4096];
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+        ssize_t len = read(inotify_fd, buf, sizeof(buf));
+        bool changed = false;
+        for (ssize_t offset = 0; offset < len;) {
+            auto *event = reinterpret_cast<inotify_event*>(buf + offset);
+            if (event->len > 0 && name == event->name) {
+                changed = true;
+            }
+            offset += sizeof(inotify_event) + event->len;
+        }
+        if (!changed) {
+            continue;
+        }
+        auto result = Reload();
+        if (result.isSuccess()) {
+            LOG(INFO) << "config reloaded, version " << Snapshot()->version;
+        } else {
+            LOG(ERROR) << "config reload failed, keeping previous values: "
+                       << result.getErrorMessage();
+        }
+    }
+    close(inotify_fd);
 }
 
 void Pconfig::Trim(std::string &buf) {
@@ -65,9 +357,9 @@ void Pconfig::Trim(std::string &buf) {
     if (index != -1) {
         buf = buf.substr(index, buf.size() - index);
     }
-    
+
     index = buf.find_last_not_of(' ');
     if (index != -1) {
         buf = buf.substr(0, index + 1);
     }
-}
\ No newline at end of file
+}
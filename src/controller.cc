@@ -1,6 +1,8 @@
 #include "controller.h"
 
-Pcontroller::Pcontroller() : m_failed(false), m_errText(""), m_timeout_ms(5000) {}
+Pcontroller::Pcontroller()
+    : m_failed(false), m_errText(""), m_timeout_ms(0),
+      m_priority(RpcPriority::kDefault) {}
 
 void Pcontroller::Reset(){
   m_failed = false;
@@ -28,6 +30,14 @@ int Pcontroller::GetTimeout() const {
   return m_timeout_ms;
 }
 
+void Pcontroller::SetPriority(RpcPriority priority) {
+  m_priority = priority;
+}
+
+RpcPriority Pcontroller::GetPriority() const {
+  return m_priority;
+}
+
 // disabled
 void Pcontroller::StartCancel(){}
 bool Pcontroller::IsCanceled() const {
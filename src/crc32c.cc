@@ -0,0 +1,215 @@
+#include "crc32c.h"
+
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace prpc {
+
+namespace {
+
+constexpr uint32_t kPoly = 0x82f63b78;  // CRC32C 多项式(位反转)
+
+// 硬件实现每轮并行计算三段，之后把前一段的结果"移过"后一段的长度再合并
+constexpr size_t kLongBlock = 8192;
+constexpr size_t kShortBlock = 256;
+
+// GF(2) 上 32x32 矩阵乘向量，mat[i] 是第 i 列
+uint32_t gf2Times(const uint32_t* mat, uint32_t vec) {
+  uint32_t sum = 0;
+  while (vec) {
+    if (vec & 1) {
+      sum ^= *mat;
+    }
+    vec >>= 1;
+    ++mat;
+  }
+  return sum;
+}
+
+void gf2Square(uint32_t* square, const uint32_t* mat) {
+  for (int n = 0; n < 32; ++n) {
+    square[n] = gf2Times(mat, mat[n]);
+  }
+}
+
+// 构造"在 crc 寄存器后追加 len 个零字节"的线性变换，len 是 2 的幂
+void zerosOperator(uint32_t* even, size_t len) {
+  uint32_t odd[32];
+  odd[0] = kPoly;  // 一个零比特
+  uint32_t row = 1;
+  for (int n = 1; n < 32; ++n) {
+    odd[n] = row;
+    row <<= 1;
+  }
+  gf2Square(even, odd);  // 两个零比特
+  gf2Square(odd, even);  // 四个零比特
+  // 每次平方长度翻倍，第一次平方得到一个零字节
+  do {
+    gf2Square(even, odd);
+    len >>= 1;
+    if (len == 0) {
+      return;
+    }
+    gf2Square(odd, even);
+    len >>= 1;
+  } while (len);
+  memcpy(even, odd, sizeof(odd));
+}
+
+struct Tables {
+  uint32_t bytes[8][256];       // slicing-by-8
+  uint32_t longShift[4][256];   // 移过 kLongBlock 个字节，按 crc 的每个字节查表
+  uint32_t shortShift[4][256];
+
+  Tables() {
+    for (uint32_t n = 0; n < 256; ++n) {
+      uint32_t crc = n;
+      for (int k = 0; k < 8; ++k) {
+        crc = crc & 1 ? (crc >> 1) ^ kPoly : crc >> 1;
+      }
+      bytes[0][n] = crc;
+    }
+    for (uint32_t n = 0; n < 256; ++n) {
+      for (int k = 1; k < 8; ++k) {
+        bytes[k][n] = (bytes[k - 1][n] >> 8) ^ bytes[0][bytes[k - 1][n] & 0xff];
+      }
+    }
+    fillShift(longShift, kLongBlock);
+    fillShift(shortShift, kShortBlock);
+  }
+
+  static void fillShift(uint32_t (*shift)[256], size_t len) {
+    uint32_t op[32];
+    zerosOperator(op, len);
+    for (uint32_t n = 0; n < 256; ++n) {
+      for (int k = 0; k < 4; ++k) {
+        shift[k][n] = gf2Times(op, n << (8 * k));
+      }
+    }
+  }
+};
+
+const Tables& tables() {
+  static const Tables instance;
+  return instance;
+}
+
+inline uint32_t shift(const uint32_t (*table)[256], uint32_t crc) {
+  return table[0][crc & 0xff] ^ table[1][(crc >> 8) & 0xff] ^ table[2][(crc >> 16) & 0xff] ^
+         table[3][crc >> 24];
+}
+
+inline uint64_t load64(const uint8_t* p) {
+  uint64_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+#if defined(__x86_64__)
+
+// crc32 指令延迟 3 个周期、吞吐 1 个周期，三段交错计算才能跑满。
+// 处理尽可能多的 3 * block 字节，返回合并后的 crc
+__attribute__((target("sse4.2"))) uint64_t crc32cInterleave(uint64_t crc0, const uint8_t*& next,
+                                                             size_t& size, size_t block,
+                                                             const uint32_t (*table)[256]) {
+  while (size >= block * 3) {
+    uint64_t crc1 = 0;
+    uint64_t crc2 = 0;
+    const uint8_t* end = next + block;
+    do {
+      crc0 = _mm_crc32_u64(crc0, load64(next));
+      crc1 = _mm_crc32_u64(crc1, load64(next + block));
+      crc2 = _mm_crc32_u64(crc2, load64(next + block * 2));
+      next += 8;
+    } while (next < end);
+    crc0 = shift(table, static_cast<uint32_t>(crc0)) ^ crc1;
+    crc0 = shift(table, static_cast<uint32_t>(crc0)) ^ crc2;
+    next += block * 2;
+    size -= block * 3;
+  }
+  return crc0;
+}
+
+// 运行时检测到 SSE4.2 才会调用，整个程序不需要用 -msse4.2 编译
+__attribute__((target("sse4.2"))) uint32_t crc32cHardwareImpl(const void* data, size_t size,
+                                                               uint32_t crc) {
+  const Tables& t = tables();
+  const uint8_t* next = static_cast<const uint8_t*>(data);
+  uint64_t crc0 = ~crc;
+  while (size > 0 && (reinterpret_cast<uintptr_t>(next) & 7) != 0) {
+    crc0 = _mm_crc32_u8(static_cast<uint32_t>(crc0), *next++);
+    --size;
+  }
+  crc0 = crc32cInterleave(crc0, next, size, kLongBlock, t.longShift);
+  crc0 = crc32cInterleave(crc0, next, size, kShortBlock, t.shortShift);
+
+  while (size >= 8) {
+    crc0 = _mm_crc32_u64(crc0, load64(next));
+    next += 8;
+    size -= 8;
+  }
+  while (size > 0) {
+    crc0 = _mm_crc32_u8(static_cast<uint32_t>(crc0), *next++);
+    --size;
+  }
+  return ~static_cast<uint32_t>(crc0);
+}
+
+#endif
+
+using Crc32cFunc = uint32_t (*)(const void*, size_t, uint32_t);
+
+Crc32cFunc selectImpl() {
+#if defined(__x86_64__)
+  if (__builtin_cpu_supports("sse4.2")) {
+    tables();
+    return crc32cHardwareImpl;
+  }
+#endif
+  return crc32cPortable;
+}
+
+const Crc32cFunc kImpl = selectImpl();
+
+}  // namespace
+
+uint32_t crc32cPortable(const void* data, size_t size, uint32_t crc) {
+  const Tables& t = tables();
+  const uint8_t* next = static_cast<const uint8_t*>(data);
+  crc = ~crc;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  while (size > 0 && (reinterpret_cast<uintptr_t>(next) & 7) != 0) {
+    crc = (crc >> 8) ^ t.bytes[0][(crc ^ *next++) & 0xff];
+    --size;
+  }
+  while (size >= 8) {
+    uint64_t word = load64(next) ^ crc;
+    crc = t.bytes[7][word & 0xff] ^ t.bytes[6][(word >> 8) & 0xff] ^
+          t.bytes[5][(word >> 16) & 0xff] ^ t.bytes[4][(word >> 24) & 0xff] ^
+          t.bytes[3][(word >> 32) & 0xff] ^ t.bytes[2][(word >> 40) & 0xff] ^
+          t.bytes[1][(word >> 48) & 0xff] ^ t.bytes[0][word >> 56];
+    next += 8;
+    size -= 8;
+  }
+#endif
+  while (size > 0) {
+    crc = (crc >> 8) ^ t.bytes[0][(crc ^ *next++) & 0xff];
+    --size;
+  }
+  return ~crc;
+}
+
+uint32_t crc32c(const void* data, size_t size, uint32_t crc) {
+  // 静态初始化之前(其他翻译单元的静态构造函数里)调用时 kImpl 还是空的
+  Crc32cFunc impl = kImpl != nullptr ? kImpl : selectImpl();
+  return impl(data, size, crc);
+}
+
+bool crc32cHardware() {
+  return selectImpl() != crc32cPortable;
+}
+
+}  // namespace prpc
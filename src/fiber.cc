@@ -0,0 +1,663 @@
+#include "fiber.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include "logger.h"
+
+#if !defined(__x86_64__)
+#include <ucontext.h>
+#endif
+
+struct Fiber;
+
+namespace {
+
+// Saved state of a suspended fiber or worker. swapcontext() also saves and
+// restores the signal mask, one rt_sigprocmask syscall per switch; fibers
+// never change their mask, so on x86-64 a switch only pushes the callee-saved
+// registers and FPU control words onto the stack it leaves.
+#if defined(__x86_64__)
+
+struct FiberContext {
+  void* sp = nullptr;
+};
+
+extern "C" void prpc_fiber_switch(void** from, void* to);
+extern "C" void prpc_fiber_start();
+
+// Saves the callee-saved registers on the current stack, stores the stack
+// pointer in *from and restores the same frame layout from the stack at to.
+// A new fiber's stack is prepared by initContext() so that the final ret
+// lands in prpc_fiber_start, which calls r13(r12).
+asm(R"(
+  .text
+  .p2align 4
+  .type prpc_fiber_switch, @function
+prpc_fiber_switch:
+  .cfi_startproc
+  pushq %rbp
+  pushq %rbx
+  pushq %r12
+  pushq %r13
+  pushq %r14
+  pushq %r15
+  subq $8, %rsp
+  stmxcsr (%rsp)
+  fnstcw 4(%rsp)
+  movq %rsp, (%rdi)
+  movq %rsi, %rsp
+  ldmxcsr (%rsp)
+  fldcw 4(%rsp)
+  addq $8, %rsp
+  popq %r15
+  popq %r14
+  popq %r13
+  popq %r12
+  popq %rbx
+  popq %rbp
+  ret
+  .cfi_endproc
+  .size prpc_fiber_switch, .-prpc_fiber_switch
+
+  .p2align 4
+  .type prpc_fiber_start, @function
+prpc_fiber_start:
+  .cfi_startproc
+  .cfi_undefined rip
+  movq %r12, %rdi
+  callq *%r13
+  ud2
+  .cfi_endproc
+  .size prpc_fiber_start, .-prpc_fiber_start
+)");
+
+void switchContext(FiberContext* from, FiberContext* to) {
+  prpc_fiber_switch(&from->sp, to->sp);
+}
+
+void initContext(FiberContext* ctx, void* stack, size_t size,
+                 void (*entry)(Fiber*), Fiber* fiber) {
+  uintptr_t top = (reinterpret_cast<uintptr_t>(stack) + size) & ~uintptr_t(15);
+  // From the saved stack pointer up: MXCSR and x87 control word, r15, r14,
+  // r13, r12, rbx, rbp, return address. The ret leaves rsp 16-byte aligned
+  // for the call in prpc_fiber_start.
+  uint64_t* frame = reinterpret_cast<uint64_t*>(top) - 8;
+  frame[0] = 0x1F80 | (uint64_t(0x037F) << 32);  // power-on defaults
+  frame[1] = 0;
+  frame[2] = 0;
+  frame[3] = reinterpret_cast<uintptr_t>(entry);
+  frame[4] = reinterpret_cast<uintptr_t>(fiber);
+  frame[5] = 0;
+  frame[6] = 0;
+  frame[7] = reinterpret_cast<uintptr_t>(&prpc_fiber_start);
+  ctx->sp = frame;
+}
+
+#else  // ucontext fallback for other architectures
+
+struct FiberContext {
+  ucontext_t uc;
+};
+
+void switchContext(FiberContext* from, FiberContext* to) {
+  swapcontext(&from->uc, &to->uc);
+}
+
+void (*g_entry)(Fiber*);
+
+void startFiber(uint32_t low, uint32_t high) {
+  g_entry(reinterpret_cast<Fiber*>((static_cast<uintptr_t>(high) << 32) |
+                                   static_cast<uintptr_t>(low)));
+}
+
+void initContext(FiberContext* ctx, void* stack, size_t size,
+                 void (*entry)(Fiber*), Fiber* fiber) {
+  g_entry = entry;
+  getcontext(&ctx->uc);
+  ctx->uc.uc_stack.ss_sp = stack;
+  ctx->uc.uc_stack.ss_size = size;
+  ctx->uc.uc_link = nullptr;
+  uintptr_t p = reinterpret_cast<uintptr_t>(fiber);
+  makecontext(&ctx->uc, reinterpret_cast<void (*)()>(&startFiber), 2,
+              static_cast<uint32_t>(p), static_cast<uint32_t>(p >> 32));
+}
+
+#endif
+
+}  // namespace
+
+struct Fiber {
+  FiberContext ctx;
+  void* stack;  // mapping base; the lowest page is the guard
+  FiberScheduler* scheduler;
+  std::function<void()> fn;
+  bool done;
+  void* context = nullptr;  // fiber::localContext()
+};
+
+struct FiberScheduler::Waiter {
+  Fiber* fiber;
+  int fd;  // -1 for a pure timer
+  uint32_t events;
+  int timeout_ms;
+  bool timed_out;
+  int error;
+  bool has_timer;
+  std::multimap<Clock::time_point, Waiter*>::iterator timer;
+};
+
+namespace {
+
+const size_t kMaxCachedStacks = 1024;
+
+// What the worker does with the fiber that just switched out.
+enum class AfterSwitch { kNone, kYield, kWait };
+
+struct WorkerContext {
+  FiberContext scheduler_ctx;
+  Fiber* current = nullptr;
+  AfterSwitch after = AfterSwitch::kNone;
+  FiberScheduler::Waiter* waiter = nullptr;
+};
+
+thread_local WorkerContext t_worker;
+// fiber::localContext() on threads that are not running a fiber.
+thread_local void* t_context = nullptr;
+
+// A fiber can resume on another worker, so the thread_local address must be
+// recomputed after every switch rather than cached by the compiler.
+__attribute__((noinline)) WorkerContext* currentWorker() { return &t_worker; }
+
+}  // namespace
+
+// Gives the private scheduling hooks to the fiber:: primitives.
+struct FiberAccess {
+  static void suspend(AfterSwitch after, FiberScheduler::Waiter* waiter) {
+    WorkerContext* worker = currentWorker();
+    Fiber* fiber = worker->current;
+    worker->after = after;
+    worker->waiter = waiter;
+    switchContext(&fiber->ctx, &worker->scheduler_ctx);
+  }
+
+  static void entry(Fiber* fiber) {
+    // Exceptions cannot unwind past the first frame of the fiber stack.
+    try {
+      fiber->fn();
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "uncaught exception in fiber: " << e.what();
+    } catch (...) {
+      LOG(ERROR) << "uncaught exception in fiber";
+    }
+    fiber->fn = nullptr;
+    fiber->done = true;
+    switchContext(&fiber->ctx, &currentWorker()->scheduler_ctx);
+  }
+};
+
+FiberScheduler::FiberScheduler(int numThreads, size_t stackSize)
+    : live(0), stop(false), poller_stop(false) {
+  page_size = sysconf(_SC_PAGESIZE);
+  stack_size = (stackSize + page_size - 1) / page_size * page_size;
+  if (numThreads <= 0) {
+    numThreads = 1;
+  }
+
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (epoll_fd == -1 || event_fd == -1) {
+    throw std::runtime_error("fiber poller setup failed");
+  }
+  epoll_event event;
+  event.events = EPOLLIN;
+  event.data.fd = event_fd;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, event_fd, &event);
+
+  poller = std::thread(&FiberScheduler::pollerLoop, this);
+  for (int i = 0; i < numThreads; ++i) {
+    workers.emplace_back(&FiberScheduler::workerLoop, this);
+  }
+}
+
+FiberScheduler::~FiberScheduler() {
+  {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    drained.wait(lock, [this] { return live == 0; });
+    stop = true;
+  }
+  condition.notify_all();
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+
+  poller_stop = true;
+  uint64_t one = 1;
+  if (write(event_fd, &one, sizeof(one)) < 0) {
+    LOG(ERROR) << "fiber poller wake-up failed";
+  }
+  poller.join();
+  close(event_fd);
+  close(epoll_fd);
+
+  for (void* stack : free_stacks) {
+    munmap(stack, stack_size + page_size);
+  }
+}
+
+void FiberScheduler::spawn(std::function<void()> fn) {
+  void* stack = allocStack();
+  if (stack == nullptr) {
+    throw std::runtime_error("fiber stack allocation failed");
+  }
+  Fiber* fiber = new Fiber;
+  fiber->stack = stack;
+  fiber->scheduler = this;
+  fiber->fn = std::move(fn);
+  fiber->done = false;
+
+  initContext(&fiber->ctx, static_cast<char*>(stack) + page_size, stack_size,
+              &FiberAccess::entry, fiber);
+
+  {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    if (stop) {
+      freeStack(stack);
+      delete fiber;
+      throw std::runtime_error("spawn on stopped FiberScheduler");
+    }
+    ++live;
+    run_queue.push_back(fiber);
+  }
+  condition.notify_one();
+}
+
+size_t FiberScheduler::liveFibers() {
+  std::unique_lock<std::mutex> lock(queue_mutex);
+  return live;
+}
+
+void FiberScheduler::schedule(Fiber* fiber) {
+  {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    run_queue.push_back(fiber);
+  }
+  condition.notify_one();
+}
+
+void FiberScheduler::workerLoop() {
+  WorkerContext* worker = currentWorker();
+  while (true) {
+    Fiber* fiber;
+    {
+      std::unique_lock<std::mutex> lock(queue_mutex);
+      condition.wait(lock, [this] { return stop || !run_queue.empty(); });
+      if (run_queue.empty()) {
+        return;
+      }
+      fiber = run_queue.front();
+      run_queue.pop_front();
+    }
+
+    worker->current = fiber;
+    worker->after = AfterSwitch::kNone;
+    switchContext(&worker->scheduler_ctx, &fiber->ctx);
+    worker->current = nullptr;
+
+    if (fiber->done) {
+      freeStack(fiber->stack);
+      delete fiber;
+      std::unique_lock<std::mutex> lock(queue_mutex);
+      if (--live == 0) {
+        drained.notify_all();
+      }
+    } else if (worker->after == AfterSwitch::kYield) {
+      schedule(fiber);
+    } else if (worker->after == AfterSwitch::kWait) {
+      arm(worker->waiter);
+    }
+  }
+}
+
+void FiberScheduler::arm(Waiter* waiter) {
+  std::unique_lock<std::mutex> lock(wait_mutex);
+  if (waiter->timeout_ms >= 0) {
+    waiter->timer = timers.emplace(
+        Clock::now() + std::chrono::milliseconds(waiter->timeout_ms), waiter);
+    waiter->has_timer = true;
+    if (waiter->timer == timers.begin()) {
+      uint64_t one = 1;
+      if (write(event_fd, &one, sizeof(one)) < 0) {
+        LOG(ERROR) << "fiber poller wake-up failed";
+      }
+    }
+  }
+  if (waiter->fd >= 0) {
+    std::vector<Waiter*>& waiters = fd_waiters[waiter->fd];
+    bool registered = !waiters.empty();
+    waiters.push_back(waiter);
+    int error = rearm(waiter->fd, registered);
+    if (error != 0) {
+      // A failed MOD leaves the other waiters' registration as it was.
+      waiters.pop_back();
+      if (waiters.empty()) {
+        fd_waiters.erase(waiter->fd);
+      }
+      waiter->error = error;
+      release(waiter, false);
+    }
+  }
+}
+
+int FiberScheduler::rearm(int fd, bool registered) {
+  auto it = fd_waiters.find(fd);
+  if (it == fd_waiters.end() || it->second.empty()) {
+    if (it != fd_waiters.end()) {
+      fd_waiters.erase(it);
+    }
+    if (registered) {
+      epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+    return 0;
+  }
+  epoll_event event;
+  event.events = EPOLLONESHOT;
+  for (Waiter* waiter : it->second) {
+    event.events |= waiter->events;
+  }
+  event.data.fd = fd;
+  if (epoll_ctl(epoll_fd, registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd,
+                &event) != 0) {
+    return errno;
+  }
+  return 0;
+}
+
+void FiberScheduler::wake(Waiter* waiter, bool timedOut) {
+  if (waiter->fd >= 0) {
+    std::vector<Waiter*>& waiters = fd_waiters[waiter->fd];
+    waiters.erase(std::find(waiters.begin(), waiters.end(), waiter));
+    int error = rearm(waiter->fd, true);
+    if (error != 0) {
+      LOG(ERROR) << "fiber poller re-arm of fd " << waiter->fd
+                 << " failed, errno " << error;
+    }
+  }
+  release(waiter, timedOut);
+}
+
+// The waiter lives on the fiber's stack: nothing may touch it once the fiber
+// is back on the run queue.
+void FiberScheduler::release(Waiter* waiter, bool timedOut) {
+  waiter->timed_out = timedOut;
+  if (waiter->has_timer) {
+    timers.erase(waiter->timer);
+  }
+  schedule(waiter->fiber);
+}
+
+void FiberScheduler::fdReady(int fd, uint32_t ready) {
+  auto it = fd_waiters.find(fd);
+  if (it == fd_waiters.end()) {
+    return;  // every waiter timed out after the event was collected
+  }
+  // The one-shot registration is now disabled. Errors and hang-ups end
+  // every wait; otherwise only waiters interested in a ready event wake and
+  // the rest are re-armed.
+  std::vector<Waiter*> woken;
+  std::vector<Waiter*>& waiters = it->second;
+  auto keep = std::stable_partition(
+      waiters.begin(), waiters.end(), [ready](Waiter* waiter) {
+        return (ready & (waiter->events | EPOLLERR | EPOLLHUP)) == 0;
+      });
+  woken.assign(keep, waiters.end());
+  waiters.erase(keep, waiters.end());
+  int error = rearm(fd, true);
+  if (error != 0) {
+    LOG(ERROR) << "fiber poller re-arm of fd " << fd << " failed, errno "
+               << error;
+    for (Waiter* waiter : fd_waiters[fd]) {
+      waiter->error = error;
+      woken.push_back(waiter);
+    }
+    fd_waiters.erase(fd);
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+  }
+  for (Waiter* waiter : woken) {
+    release(waiter, false);
+  }
+}
+
+void FiberScheduler::pollerLoop() {
+  epoll_event events[256];
+  while (!poller_stop) {
+    int timeout = -1;
+    {
+      std::unique_lock<std::mutex> lock(wait_mutex);
+      if (!timers.empty()) {
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+            timers.begin()->first - Clock::now() +
+            std::chrono::microseconds(999));
+        timeout = wait.count() > 0 ? static_cast<int>(wait.count()) : 0;
+      }
+    }
+
+    int nfds = epoll_wait(epoll_fd, events, 256, timeout);
+    if (nfds == -1 && errno != EINTR) {
+      LOG(ERROR) << "fiber poller epoll_wait error";
+      break;
+    }
+
+    std::unique_lock<std::mutex> lock(wait_mutex);
+    for (int i = 0; i < nfds; ++i) {
+      if (events[i].data.fd == event_fd) {
+        uint64_t count;
+        while (read(event_fd, &count, sizeof(count)) > 0) {
+        }
+      } else {
+        fdReady(events[i].data.fd, events[i].events);
+      }
+    }
+    Clock::time_point now = Clock::now();
+    while (!timers.empty() && timers.begin()->first <= now) {
+      wake(timers.begin()->second, true);
+    }
+  }
+}
+
+void* FiberScheduler::allocStack() {
+  {
+    std::unique_lock<std::mutex> lock(stack_mutex);
+    if (!free_stacks.empty()) {
+      void* stack = free_stacks.back();
+      free_stacks.pop_back();
+      return stack;
+    }
+  }
+  // Reserved lazily: an idle fiber only costs the pages its stack touched.
+  void* stack = mmap(nullptr, stack_size + page_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK,
+                     -1, 0);
+  if (stack == MAP_FAILED) {
+    LOG(ERROR) << "fiber stack mmap failed, errno " << errno;
+    return nullptr;
+  }
+  // Guard page, so an overflow faults instead of corrupting a neighbour.
+  mprotect(stack, page_size, PROT_NONE);
+  return stack;
+}
+
+void FiberScheduler::freeStack(void* stack) {
+  {
+    std::unique_lock<std::mutex> lock(stack_mutex);
+    if (free_stacks.size() < kMaxCachedStacks) {
+      free_stacks.push_back(stack);
+      return;
+    }
+  }
+  munmap(stack, stack_size + page_size);
+}
+
+namespace fiber {
+
+bool inFiber() { return currentWorker()->current != nullptr; }
+
+void*& localContext() {
+  Fiber* fiber = currentWorker()->current;
+  return fiber != nullptr ? fiber->context : t_context;
+}
+
+void yield() {
+  if (!inFiber()) {
+    std::this_thread::yield();
+    return;
+  }
+  FiberAccess::suspend(AfterSwitch::kYield, nullptr);
+}
+
+void sleepFor(std::chrono::milliseconds duration) {
+  if (!inFiber()) {
+    std::this_thread::sleep_for(duration);
+    return;
+  }
+  waitFd(-1, 0, static_cast<int>(duration.count()));
+}
+
+int waitFd(int fd, uint32_t events, int timeoutMs) {
+  WorkerContext* worker = currentWorker();
+  if (worker->current == nullptr) {
+    if (fd < 0) {
+      errno = EINVAL;
+      return -1;
+    }
+    // The EPOLLIN/EPOLLOUT bits match their POLL* counterparts.
+    pollfd pfd = {fd, static_cast<short>(events), 0};
+    int n = ::poll(&pfd, 1, timeoutMs);
+    return n > 0 ? 1 : n;
+  }
+  if (fd < 0 && timeoutMs < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  FiberScheduler::Waiter waiter;
+  waiter.fiber = worker->current;
+  waiter.fd = fd;
+  waiter.events = events;
+  waiter.timeout_ms = timeoutMs;
+  waiter.timed_out = false;
+  waiter.error = 0;
+  waiter.has_timer = false;
+  FiberAccess::suspend(AfterSwitch::kWait, &waiter);
+
+  if (waiter.error != 0) {
+    errno = waiter.error;
+    return -1;
+  }
+  return waiter.timed_out ? 0 : 1;
+}
+
+ssize_t recv(int fd, void* buf, size_t len, int flags, int timeoutMs) {
+  if (!inFiber()) {
+    return ::recv(fd, buf, len, flags);
+  }
+  while (true) {
+    ssize_t n = ::recv(fd, buf, len, flags | MSG_DONTWAIT);
+    if (n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+      return n;
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    int ready = waitFd(fd, EPOLLIN, timeoutMs);
+    if (ready <= 0) {
+      if (ready == 0) {
+        errno = EAGAIN;
+      }
+      return -1;
+    }
+  }
+}
+
+ssize_t recvAll(int fd, void* buf, size_t len, int flags, int timeoutMs) {
+  char* data = static_cast<char*>(buf);
+  size_t received = 0;
+  while (received < len) {
+    ssize_t n = recv(fd, data + received, len - received, flags, timeoutMs);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return n;
+    }
+    received += n;
+  }
+  return received;
+}
+
+ssize_t send(int fd, const void* buf, size_t len, int flags, int timeoutMs) {
+  bool in_fiber = inFiber();
+  const char* data = static_cast<const char*>(buf);
+  size_t sent = 0;
+  while (sent < len) {
+    ssize_t n = ::send(fd, data + sent, len - sent,
+                       in_fiber ? flags | MSG_DONTWAIT : flags);
+    if (n >= 0) {
+      sent += n;
+      continue;
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    if (!in_fiber || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+      return -1;
+    }
+    int ready = waitFd(fd, EPOLLOUT, timeoutMs);
+    if (ready <= 0) {
+      if (ready == 0) {
+        errno = EAGAIN;
+      }
+      return -1;
+    }
+  }
+  return sent;
+}
+
+int connect(int fd, const sockaddr* addr, socklen_t addrlen, int timeoutMs) {
+  if (!inFiber()) {
+    return ::connect(fd, addr, addrlen);
+  }
+  int flags = fcntl(fd, F_GETFL, 0);
+  fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+  int rc = ::connect(fd, addr, addrlen);
+  if (rc != 0 && errno == EINPROGRESS) {
+    int ready = waitFd(fd, EPOLLOUT, timeoutMs);
+    if (ready == 1) {
+      int err = 0;
+      socklen_t err_len = sizeof(err);
+      getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len);
+      rc = err == 0 ? 0 : -1;
+      errno = err;
+    } else {
+      if (ready == 0) {
+        errno = ETIMEDOUT;
+      }
+      rc = -1;
+    }
+  }
+  int saved_errno = errno;
+  fcntl(fd, F_SETFL, flags);
+  errno = saved_errno;
+  return rc;
+}
+
+}  // namespace fiber
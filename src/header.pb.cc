@@ -35,7 +35,12 @@ inline constexpr RpcHeader::Impl_::Impl_(
         method_name_(
             &::google::protobuf::internal::fixed_address_empty_string,
             ::_pbi::ConstantInitialized()),
-        args_size_{0u} {}
+        args_size_{0u},
+        priority_{0u},
+        timeout_ms_{0u},
+        trace_id_{::uint64_t{0u}},
+        span_id_{::uint64_t{0u}},
+        sampled_{false} {}
 
 template <typename>
 PROTOBUF_CONSTEXPR RpcHeader::RpcHeader(::_pbi::ConstantInitialized)
@@ -66,13 +71,23 @@ const ::uint32_t
         protodesc_cold) = {
         0x081, // bitmap
         PROTOBUF_FIELD_OFFSET(::Prpc::RpcHeader, _impl_._has_bits_),
-        6, // hasbit index offset
+        11, // hasbit index offset
         PROTOBUF_FIELD_OFFSET(::Prpc::RpcHeader, _impl_.service_name_),
         PROTOBUF_FIELD_OFFSET(::Prpc::RpcHeader, _impl_.method_name_),
         PROTOBUF_FIELD_OFFSET(::Prpc::RpcHeader, _impl_.args_size_),
+        PROTOBUF_FIELD_OFFSET(::Prpc::RpcHeader, _impl_.priority_),
+        PROTOBUF_FIELD_OFFSET(::Prpc::RpcHeader, _impl_.timeout_ms_),
+        PROTOBUF_FIELD_OFFSET(::Prpc::RpcHeader, _impl_.trace_id_),
+        PROTOBUF_FIELD_OFFSET(::Prpc::RpcHeader, _impl_.span_id_),
+        PROTOBUF_FIELD_OFFSET(::Prpc::RpcHeader, _impl_.sampled_),
         0,
         1,
         2,
+        3,
+        4,
+        5,
+        6,
+        7,
 };
 
 static const ::_pbi::MigrationSchema
@@ -84,15 +99,17 @@ static const ::_pb::Message* PROTOBUF_NONNULL const file_default_instances[] = {
 };
 const char descriptor_table_protodef_header_2eproto[] ABSL_ATTRIBUTE_SECTION_VARIABLE(
     protodesc_cold) = {
-    "\n\014header.proto\022\004Prpc\"I\n\tRpcHeader\022\024\n\014ser"
-    "vice_name\030\001 \001(\014\022\023\n\013method_name\030\002 \001(\014\022\021\n\t"
-    "args_size\030\003 \001(\rb\006proto3"
+    "\n\014header.proto\022\004Prpc\"\243\001\n\tRpcHeader\022\024\n\014se"
+    "rvice_name\030\001 \001(\014\022\023\n\013method_name\030\002 \001(\014\022\021\n"
+    "\targs_size\030\003 \001(\r\022\020\n\010priority\030\004 \001(\r\022\022\n\nti"
+    "meout_ms\030\005 \001(\r\022\020\n\010trace_id\030\006 \001(\004\022\017\n\007span"
+    "_id\030\007 \001(\004\022\017\n\007sampled\030\010 \001(\010b\006proto3"
 };
 static ::absl::once_flag descriptor_table_header_2eproto_once;
 PROTOBUF_CONSTINIT const ::_pbi::DescriptorTable descriptor_table_header_2eproto = {
     false,
     false,
-    103,
+    194,
     descriptor_table_protodef_header_2eproto,
     "header.proto",
     &descriptor_table_header_2eproto_once,
@@ -147,7 +164,13 @@ RpcHeader::RpcHeader(
   _internal_metadata_.MergeFrom<::google::protobuf::UnknownFieldSet>(
       from._internal_metadata_);
   new (&_impl_) Impl_(internal_visibility(), arena, from._impl_, from);
-  _impl_.args_size_ = from._impl_.args_size_;
+  ::memcpy(reinterpret_cast<char *>(&_impl_) +
+               offsetof(Impl_, args_size_),
+           reinterpret_cast<const char *>(&from._impl_) +
+               offsetof(Impl_, args_size_),
+           offsetof(Impl_, sampled_) -
+               offsetof(Impl_, args_size_) +
+               sizeof(Impl_::sampled_));
 
   // @@protoc_insertion_point(copy_constructor:Prpc.RpcHeader)
 }
@@ -160,7 +183,12 @@ PROTOBUF_NDEBUG_INLINE RpcHeader::Impl_::Impl_(
 
 inline void RpcHeader::SharedCtor(::_pb::Arena* PROTOBUF_NULLABLE arena) {
   new (&_impl_) Impl_(internal_visibility(), arena);
-  _impl_.args_size_ = {};
+  ::memset(reinterpret_cast<char *>(&_impl_) +
+               offsetof(Impl_, args_size_),
+           0,
+           offsetof(Impl_, sampled_) -
+               offsetof(Impl_, args_size_) +
+               sizeof(Impl_::sampled_));
 }
 RpcHeader::~RpcHeader() {
   // @@protoc_insertion_point(destructor:Prpc.RpcHeader)
@@ -218,16 +246,16 @@ RpcHeader::GetClassData() const {
   return RpcHeader_class_data_.base();
 }
 PROTOBUF_CONSTINIT PROTOBUF_ATTRIBUTE_INIT_PRIORITY1
-const ::_pbi::TcParseTable<2, 3, 0, 0, 2>
+const ::_pbi::TcParseTable<3, 8, 0, 0, 2>
 RpcHeader::_table_ = {
   {
     PROTOBUF_FIELD_OFFSET(RpcHeader, _impl_._has_bits_),
     0, // no _extensions_
-    3, 24,  // max_field_number, fast_idx_mask
+    8, 56,  // max_field_number, fast_idx_mask
     offsetof(decltype(_table_), field_lookup_table),
-    4294967288,  // skipmap
+    4294967040,  // skipmap
     offsetof(decltype(_table_), field_entries),
-    3,  // num_field_entries
+    8,  // num_field_entries
     0,  // num_aux_entries
     offsetof(decltype(_table_), field_names),  // no aux_entries
     RpcHeader_class_data_.base(),
@@ -237,7 +265,9 @@ RpcHeader::_table_ = {
     ::_pbi::TcParser::GetTable<::Prpc::RpcHeader>(),  // to_prefetch
     #endif  // PROTOBUF_PREFETCH_PARSE_TABLE
   }, {{
-    {::_pbi::TcParser::MiniParse, {}},
+    // bool sampled = 8;
+    {::_pbi::TcParser::SingularVarintNoZag1<bool, offsetof(RpcHeader, _impl_.sampled_), 7>(),
+     {64, 7, 0, PROTOBUF_FIELD_OFFSET(RpcHeader, _impl_.sampled_)}},
     // bytes service_name = 1;
     {::_pbi::TcParser::FastBS1,
      {10, 0, 0, PROTOBUF_FIELD_OFFSET(RpcHeader, _impl_.service_name_)}},
@@ -247,6 +277,18 @@ RpcHeader::_table_ = {
     // uint32 args_size = 3;
     {::_pbi::TcParser::SingularVarintNoZag1<::uint32_t, offsetof(RpcHeader, _impl_.args_size_), 2>(),
      {24, 2, 0, PROTOBUF_FIELD_OFFSET(RpcHeader, _impl_.args_size_)}},
+    // uint32 priority = 4;
+    {::_pbi::TcParser::SingularVarintNoZag1<::uint32_t, offsetof(RpcHeader, _impl_.priority_), 3>(),
+     {32, 3, 0, PROTOBUF_FIELD_OFFSET(RpcHeader, _impl_.priority_)}},
+    // uint32 timeout_ms = 5;
+    {::_pbi::TcParser::SingularVarintNoZag1<::uint32_t, offsetof(RpcHeader, _impl_.timeout_ms_), 4>(),
+     {40, 4, 0, PROTOBUF_FIELD_OFFSET(RpcHeader, _impl_.timeout_ms_)}},
+    // uint64 trace_id = 6;
+    {::_pbi::TcParser::SingularVarintNoZag1<::uint64_t, offsetof(RpcHeader, _impl_.trace_id_), 5>(),
+     {48, 5, 0, PROTOBUF_FIELD_OFFSET(RpcHeader, _impl_.trace_id_)}},
+    // uint64 span_id = 7;
+    {::_pbi::TcParser::SingularVarintNoZag1<::uint64_t, offsetof(RpcHeader, _impl_.span_id_), 6>(),
+     {56, 6, 0, PROTOBUF_FIELD_OFFSET(RpcHeader, _impl_.span_id_)}},
   }}, {{
     65535, 65535
   }}, {{
@@ -259,6 +301,21 @@ RpcHeader::_table_ = {
     // uint32 args_size = 3;
     {PROTOBUF_FIELD_OFFSET(RpcHeader, _impl_.args_size_), _Internal::kHasBitsOffset + 2, 0,
     (0 | ::_fl::kFcOptional | ::_fl::kUInt32)},
+    // uint32 priority = 4;
+    {PROTOBUF_FIELD_OFFSET(RpcHeader, _impl_.priority_), _Internal::kHasBitsOffset + 3, 0,
+    (0 | ::_fl::kFcOptional | ::_fl::kUInt32)},
+    // uint32 timeout_ms = 5;
+    {PROTOBUF_FIELD_OFFSET(RpcHeader, _impl_.timeout_ms_), _Internal::kHasBitsOffset + 4, 0,
+    (0 | ::_fl::kFcOptional | ::_fl::kUInt32)},
+    // uint64 trace_id = 6;
+    {PROTOBUF_FIELD_OFFSET(RpcHeader, _impl_.trace_id_), _Internal::kHasBitsOffset + 5, 0,
+    (0 | ::_fl::kFcOptional | ::_fl::kUInt64)},
+    // uint64 span_id = 7;
+    {PROTOBUF_FIELD_OFFSET(RpcHeader, _impl_.span_id_), _Internal::kHasBitsOffset + 6, 0,
+    (0 | ::_fl::kFcOptional | ::_fl::kUInt64)},
+    // bool sampled = 8;
+    {PROTOBUF_FIELD_OFFSET(RpcHeader, _impl_.sampled_), _Internal::kHasBitsOffset + 7, 0,
+    (0 | ::_fl::kFcOptional | ::_fl::kBool)},
   }},
   // no aux_entries
   {{
@@ -280,7 +337,11 @@ PROTOBUF_NOINLINE void RpcHeader::Clear() {
       _impl_.method_name_.ClearNonDefaultToEmpty();
     }
   }
-  _impl_.args_size_ = 0u;
+  if ((cached_has_bits & 0x000000fcu) != 0) {
+    ::memset(&_impl_.args_size_, 0, static_cast<::size_t>(
+        reinterpret_cast<char*>(&_impl_.sampled_) -
+        reinterpret_cast<char*>(&_impl_.args_size_)) + sizeof(_impl_.sampled_));
+  }
   _impl_._has_bits_.Clear();
   _internal_metadata_.Clear<::google::protobuf::UnknownFieldSet>();
 }
@@ -325,6 +386,51 @@ PROTOBUF_NOINLINE void RpcHeader::Clear() {
     }
   }
 
+  // uint32 priority = 4;
+  if ((this_._impl_._has_bits_[0] & 0x00000008u) != 0) {
+    if (this_._internal_priority() != 0) {
+      target = stream->EnsureSpace(target);
+      target = ::_pbi::WireFormatLite::WriteUInt32ToArray(
+          4, this_._internal_priority(), target);
+    }
+  }
+
+  // uint32 timeout_ms = 5;
+  if ((this_._impl_._has_bits_[0] & 0x00000010u) != 0) {
+    if (this_._internal_timeout_ms() != 0) {
+      target = stream->EnsureSpace(target);
+      target = ::_pbi::WireFormatLite::WriteUInt32ToArray(
+          5, this_._internal_timeout_ms(), target);
+    }
+  }
+
+  // uint64 trace_id = 6;
+  if ((this_._impl_._has_bits_[0] & 0x00000020u) != 0) {
+    if (this_._internal_trace_id() != 0) {
+      target = stream->EnsureSpace(target);
+      target = ::_pbi::WireFormatLite::WriteUInt64ToArray(
+          6, this_._internal_trace_id(), target);
+    }
+  }
+
+  // uint64 span_id = 7;
+  if ((this_._impl_._has_bits_[0] & 0x00000040u) != 0) {
+    if (this_._internal_span_id() != 0) {
+      target = stream->EnsureSpace(target);
+      target = ::_pbi::WireFormatLite::WriteUInt64ToArray(
+          7, this_._internal_span_id(), target);
+    }
+  }
+
+  // bool sampled = 8;
+  if ((this_._impl_._has_bits_[0] & 0x00000080u) != 0) {
+    if (this_._internal_sampled() != 0) {
+      target = stream->EnsureSpace(target);
+      target = ::_pbi::WireFormatLite::WriteBoolToArray(
+          8, this_._internal_sampled(), target);
+    }
+  }
+
   if (ABSL_PREDICT_FALSE(this_._internal_metadata_.have_unknown_fields())) {
     target =
         ::_pbi::WireFormat::InternalSerializeUnknownFieldsToArray(
@@ -350,7 +456,7 @@ PROTOBUF_NOINLINE void RpcHeader::Clear() {
 
   ::_pbi::Prefetch5LinesFrom7Lines(&this_);
   cached_has_bits = this_._impl_._has_bits_[0];
-  if ((cached_has_bits & 0x00000007u) != 0) {
+  if ((cached_has_bits & 0x000000ffu) != 0) {
     // bytes service_name = 1;
     if ((cached_has_bits & 0x00000001u) != 0) {
       if (!this_._internal_service_name().empty()) {
@@ -372,6 +478,40 @@ PROTOBUF_NOINLINE void RpcHeader::Clear() {
             this_._internal_args_size());
       }
     }
+    // uint32 priority = 4;
+    if ((cached_has_bits & 0x00000008u) != 0) {
+      if (this_._internal_priority() != 0) {
+        total_size += ::_pbi::WireFormatLite::UInt32SizePlusOne(
+            this_._internal_priority());
+      }
+    }
+    // uint32 timeout_ms = 5;
+    if ((cached_has_bits & 0x00000010u) != 0) {
+      if (this_._internal_timeout_ms() != 0) {
+        total_size += ::_pbi::WireFormatLite::UInt32SizePlusOne(
+            this_._internal_timeout_ms());
+      }
+    }
+    // uint64 trace_id = 6;
+    if ((cached_has_bits & 0x00000020u) != 0) {
+      if (this_._internal_trace_id() != 0) {
+        total_size += ::_pbi::WireFormatLite::UInt64SizePlusOne(
+            this_._internal_trace_id());
+      }
+    }
+    // uint64 span_id = 7;
+    if ((cached_has_bits & 0x00000040u) != 0) {
+      if (this_._internal_span_id() != 0) {
+        total_size += ::_pbi::WireFormatLite::UInt64SizePlusOne(
+            this_._internal_span_id());
+      }
+    }
+    // bool sampled = 8;
+    if ((cached_has_bits & 0x00000080u) != 0) {
+      if (this_._internal_sampled() != 0) {
+        total_size += 2;
+      }
+    }
   }
   return this_.MaybeComputeUnknownFieldsSize(total_size,
                                              &this_._impl_._cached_size_);
@@ -386,7 +526,7 @@ void RpcHeader::MergeImpl(::google::protobuf::MessageLite& to_msg, const ::googl
   (void) cached_has_bits;
 
   cached_has_bits = from._impl_._has_bits_[0];
-  if ((cached_has_bits & 0x00000007u) != 0) {
+  if ((cached_has_bits & 0x000000ffu) != 0) {
     if ((cached_has_bits & 0x00000001u) != 0) {
       if (!from._internal_service_name().empty()) {
         _this->_internal_set_service_name(from._internal_service_name());
@@ -410,6 +550,31 @@ void RpcHeader::MergeImpl(::google::protobuf::MessageLite& to_msg, const ::googl
         _this->_impl_.args_size_ = from._impl_.args_size_;
       }
     }
+    if ((cached_has_bits & 0x00000008u) != 0) {
+      if (from._internal_priority() != 0) {
+        _this->_impl_.priority_ = from._impl_.priority_;
+      }
+    }
+    if ((cached_has_bits & 0x00000010u) != 0) {
+      if (from._internal_timeout_ms() != 0) {
+        _this->_impl_.timeout_ms_ = from._impl_.timeout_ms_;
+      }
+    }
+    if ((cached_has_bits & 0x00000020u) != 0) {
+      if (from._internal_trace_id() != 0) {
+        _this->_impl_.trace_id_ = from._impl_.trace_id_;
+      }
+    }
+    if ((cached_has_bits & 0x00000040u) != 0) {
+      if (from._internal_span_id() != 0) {
+        _this->_impl_.span_id_ = from._impl_.span_id_;
+      }
+    }
+    if ((cached_has_bits & 0x00000080u) != 0) {
+      if (from._internal_sampled() != 0) {
+        _this->_impl_.sampled_ = from._impl_.sampled_;
+      }
+    }
   }
   _this->_impl_._has_bits_[0] |= cached_has_bits;
   _this->_internal_metadata_.MergeFrom<::google::protobuf::UnknownFieldSet>(from._internal_metadata_);
@@ -431,7 +596,12 @@ void RpcHeader::InternalSwap(RpcHeader* PROTOBUF_RESTRICT PROTOBUF_NONNULL other
   swap(_impl_._has_bits_[0], other->_impl_._has_bits_[0]);
   ::_pbi::ArenaStringPtr::InternalSwap(&_impl_.service_name_, &other->_impl_.service_name_, arena);
   ::_pbi::ArenaStringPtr::InternalSwap(&_impl_.method_name_, &other->_impl_.method_name_, arena);
-  swap(_impl_.args_size_, other->_impl_.args_size_);
+  ::google::protobuf::internal::memswap<
+      PROTOBUF_FIELD_OFFSET(RpcHeader, _impl_.sampled_)
+      + sizeof(RpcHeader::_impl_.sampled_)
+      - PROTOBUF_FIELD_OFFSET(RpcHeader, _impl_.args_size_)>(
+          reinterpret_cast<char*>(&_impl_.args_size_),
+          reinterpret_cast<char*>(&other->_impl_.args_size_));
 }
 
 ::google::protobuf::Metadata RpcHeader::GetMetadata() const {
@@ -1,8 +1,6 @@
 #ifndef _Papplication_H
 #define _Papplication_H
 
-#include <mutex>
-
 #include "channel.h"
 #include "conf.h"
 #include "controller.h"
@@ -13,11 +11,16 @@ class Papplication {
   static Papplication& GetInstance();
   static void deleteInstance();
   static Pconfig& GetConfig();
+  // Current config snapshot; lock-free, hold the pointer while reading. See
+  // Pconfig::Snapshot().
+  static ConfigSnapshotPtr Config() { return m_config.Snapshot(); }
 
  private:
+  static bool ApplyLogLevel(const ConfigSnapshot& snapshot);
+  static void RegisterReloadCallbacks();
+
   static Pconfig m_config;
   static Papplication* m_application;  // Only
-  static std::mutex m_mutex;
   Papplication() {}
   ~Papplication() {}
   Papplication(const Papplication&) = delete;
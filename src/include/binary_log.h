@@ -0,0 +1,211 @@
+#ifndef PRPC_BINARY_LOG_H
+#define PRPC_BINARY_LOG_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "logger.h"
+
+// 二进制结构化日志
+// 格式串在每个调用点注册一次，之后每条记录只保存格式编号和参数的原始字节，
+// 不在热路径上做任何文本格式化。记录经 PLogger 的每线程缓冲区交给刷新线程，
+// 写入按块组织的内存映射环形文件，由 prpc_blog_decode 离线渲染为文本。
+//
+//   BLOG(INFO, "request {}.{} args {} bytes", service, method, size);
+//
+// 格式串中的 {} 依次替换为参数，支持整数、浮点、bool、char 和字符串。
+namespace blog {
+
+// 文件布局：[文件头 kHeaderSize][格式表 format_capacity][环形区 ring_size]
+constexpr char kMagic[8] = {'P', 'R', 'P', 'C', 'B', 'L', 'O', 'G'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderSize = 4096;
+constexpr size_t kBlockSize = 64 * 1024;       // 记录不跨块，每块都从记录边界开始
+constexpr size_t kMaxRecordSize = 1024;        // 单条记录上限，超出的参数被截断
+constexpr size_t kRecordHeaderSize = 20;       // u32 长度, u32 格式编号, u64 纳秒时间戳, u32 线程号
+constexpr size_t kDefaultRingSize = 64 * 1024 * 1024;
+constexpr size_t kDefaultFormatCapacity = 1024 * 1024;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_size;
+    uint64_t format_offset;
+    uint64_t format_capacity;
+    uint64_t format_used;      // 已写入的格式表字节数
+    uint64_t ring_offset;
+    uint64_t ring_size;        // block_size 的整数倍
+    uint64_t write_pos;        // 单调递增，下一条记录位于 ring_offset + write_pos % ring_size
+};
+
+// 格式表项：u32 项长度, u32 编号, u8 级别, u32 行号, u16 文件名长度, 文件名, u16 格式串长度, 格式串
+// 记录参数：u8 类型 + 值；字符串为 u16 长度 + 字节
+enum ArgType : uint8_t {
+    kInt32 = 1,
+    kUInt32,
+    kInt64,
+    kUInt64,
+    kDouble,
+    kBool,
+    kChar,
+    kString
+};
+
+// 把参数编码到固定大小的缓冲区，空间不足时截断字符串、丢弃其余参数
+class Encoder {
+public:
+    Encoder(char* buffer, size_t capacity)
+        : buffer_(buffer), capacity_(capacity), size_(0), full_(false) {}
+
+    template <typename T>
+    void add(const T& value) {
+        using U = std::decay_t<T>;
+        if constexpr (std::is_same_v<U, bool>) {
+            putScalar(kBool, static_cast<uint8_t>(value));
+        } else if constexpr (std::is_same_v<U, char>) {
+            putScalar(kChar, value);
+        } else if constexpr (std::is_enum_v<U>) {
+            add(static_cast<std::underlying_type_t<U>>(value));
+        } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+            if constexpr (sizeof(U) <= 4) {
+                putScalar(kInt32, static_cast<int32_t>(value));
+            } else {
+                putScalar(kInt64, static_cast<int64_t>(value));
+            }
+        } else if constexpr (std::is_integral_v<U>) {
+            if constexpr (sizeof(U) <= 4) {
+                putScalar(kUInt32, static_cast<uint32_t>(value));
+            } else {
+                putScalar(kUInt64, static_cast<uint64_t>(value));
+            }
+        } else if constexpr (std::is_floating_point_v<U>) {
+            putScalar(kDouble, static_cast<double>(value));
+        } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            putString(std::string_view(value));
+        } else {
+            static_assert(sizeof(U) == 0, "BLOG argument type is not supported");
+        }
+    }
+
+    size_t size() const { return size_; }
+
+private:
+    template <typename V>
+    void putScalar(ArgType type, V value) {
+        if (full_ || capacity_ - size_ < 1 + sizeof(V)) {
+            full_ = true;  // 不再接受后续参数
+            return;
+        }
+        buffer_[size_++] = static_cast<char>(type);
+        std::memcpy(buffer_ + size_, &value, sizeof(V));
+        size_ += sizeof(V);
+    }
+
+    void putString(std::string_view value) {
+        if (full_ || capacity_ - size_ < 1 + sizeof(uint16_t)) {
+            full_ = true;
+            return;
+        }
+        size_t room = capacity_ - size_ - 1 - sizeof(uint16_t);
+        uint16_t length = static_cast<uint16_t>(std::min({value.size(), room, size_t(UINT16_MAX)}));
+        buffer_[size_++] = static_cast<char>(kString);
+        std::memcpy(buffer_ + size_, &length, sizeof(length));
+        size_ += sizeof(length);
+        std::memcpy(buffer_ + size_, value.data(), length);
+        size_ += length;
+        full_ = length < value.size();
+    }
+
+    char* buffer_;
+    size_t capacity_;
+    size_t size_;
+    bool full_;
+};
+
+template <typename... Args>
+void submit(LogLevel level, uint32_t format_id, const Args&... args) {
+    char record[kMaxRecordSize];
+    Encoder encoder(record + kRecordHeaderSize, sizeof(record) - kRecordHeaderSize);
+    (encoder.add(args), ...);
+    PLogger::getInstance().logBinary(level, format_id, record, kRecordHeaderSize + encoder.size());
+}
+
+/**
+ * 把二进制日志文件渲染为文本，每条记录一行：
+ * [级别][时间.微秒][文件:行号] 消息
+ * @return 文件无法读取或格式不符时返回false，原因写入 error
+ */
+bool decodeFile(const std::string& path, std::ostream& out, std::string* error = nullptr);
+
+}  // namespace blog
+
+// 二进制日志文件：格式注册表和内存映射的环形写入端
+class PBinaryLog {
+public:
+    static PBinaryLog& getInstance();
+
+    PBinaryLog(const PBinaryLog&) = delete;
+    PBinaryLog& operator=(const PBinaryLog&) = delete;
+
+    // 创建(覆盖)日志文件，环形区大小向上取整到块大小
+    bool open(const std::string& path, size_t ring_size = blog::kDefaultRingSize,
+              size_t format_capacity = blog::kDefaultFormatCapacity);
+
+    // 写出已缓冲的记录后关闭文件
+    void close();
+
+    // BLOG 宏的快速检查
+    static bool enabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    // 注册格式串，返回格式编号；文件已打开时立即写入格式表
+    uint32_t registerFormat(LogLevel level, const char* file, int line, const char* format);
+
+    // 由 PLogger 刷新线程调用，records 为若干条首尾相接的完整记录
+    void appendRecords(const char* records, size_t length);
+
+private:
+    struct Format {
+        LogLevel level;
+        std::string file;
+        int line;
+        std::string format;
+    };
+
+    PBinaryLog();
+    ~PBinaryLog() = default;
+
+    void writeFormatLocked(uint32_t id, const Format& format);
+    void unmapLocked();
+
+    static inline std::atomic<bool> enabled_{false};
+
+    std::mutex mutex_;
+    std::vector<Format> formats_;   // 编号从1开始
+    int fd_;
+    char* base_;
+    size_t mappedSize_;
+    blog::FileHeader* header_;
+};
+
+// 二进制日志宏：调用点第一次执行时注册格式串，未打开二进制日志时不做任何事
+#define BLOG(level, format, ...)                                                     \
+    do {                                                                             \
+        if (PRPC_LOG_ENABLED(level) && PBinaryLog::enabled()) {                      \
+            static const uint32_t prpc_blog_format_id =                              \
+                PBinaryLog::getInstance().registerFormat(level, __FILE__, __LINE__,  \
+                                                         format);                    \
+            blog::submit(level, prpc_blog_format_id, ##__VA_ARGS__);                 \
+        }                                                                            \
+    } while (0)
+
+#endif // PRPC_BINARY_LOG_H
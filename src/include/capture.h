@@ -0,0 +1,134 @@
+#ifndef PRPC_CAPTURE_H
+#define PRPC_CAPTURE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace prpc {
+
+// 流量抓取
+// Pprovider 把收到的请求帧(RpcHeader、参数和到达时间)按采样率写入抓取文件，
+// prpc_rpc_replay 按原始的到达间隔(或按比例压缩)把它们重新发给测试中的 provider，
+// 用来在不同版本之间比较真实流量下的延迟分布。
+//
+// 热路径只做一次采样判断，被采样的帧在锁内拷贝进待写缓冲区，由后台线程写文件。
+// 写入速率超过预算、待写缓冲区满或文件达到上限时丢弃并计数，不会阻塞请求处理。
+namespace capture {
+
+// 文件头：magic[8], u32 版本, u32 保留, i64 开始抓取的 Unix 时间(微秒)
+// 记录：u64 到达时间(相对开始抓取，纳秒), u32 RpcHeader 长度, u32 参数长度, RpcHeader, 参数
+constexpr char kMagic[8] = {'P', 'R', 'P', 'C', 'C', 'A', 'P', 'T'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kFileHeaderSize = 24;
+constexpr size_t kRecordHeaderSize = 16;
+
+}  // namespace capture
+
+/**
+ * @brief 抓取文件中的一帧
+ */
+struct CapturedFrame {
+    uint64_t arrival_ns = 0;    // 相对开始抓取
+    std::string header;         // 序列化的 RpcHeader，与线路上的字节相同
+    std::string args;
+};
+
+/**
+ * @brief 读取整个抓取文件，帧按到达顺序排列
+ * @return 文件无法读取或格式不符时返回 false，原因写入 error；末尾不完整的记录被忽略
+ */
+bool readCaptureFile(const std::string& path, int64_t* start_unix_us,
+                     std::vector<CapturedFrame>* frames, std::string* error = nullptr);
+
+/**
+ * @brief 请求帧的采样、写入预算和后台写文件线程
+ */
+class TrafficCapture {
+public:
+    struct Options {
+        double sample_rate;             // 0~1
+        uint64_t bytes_per_second;      // 写入预算，允许一秒的突发
+        uint64_t max_file_bytes;        // 达到后停止抓取
+
+        Options()
+            : sample_rate(1.0)
+            , bytes_per_second(4 * 1024 * 1024)
+            , max_file_bytes(256 * 1024 * 1024) {}
+    };
+
+    static TrafficCapture& getInstance();
+
+    TrafficCapture(const TrafficCapture&) = delete;
+    TrafficCapture& operator=(const TrafficCapture&) = delete;
+
+    // 创建(覆盖)抓取文件并开始抓取；已在抓取时先结束之前的文件
+    bool start(const std::string& path, const Options& options = Options{});
+
+    // 写出已缓冲的帧后关闭文件
+    void stop();
+
+    // Pprovider 热路径上的快速检查
+    static bool enabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    // 按采样率和预算记录一帧
+    void record(std::chrono::steady_clock::time_point arrival, const std::string& header,
+                const std::string& args);
+
+    // 把已记录的帧写入文件后返回
+    void flush();
+
+    uint64_t captured() const {
+        return captured_.load(std::memory_order_relaxed);
+    }
+    uint64_t dropped() const {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr size_t kMaxPendingBytes = 16 * 1024 * 1024;
+    static constexpr size_t kWakeBytes = 1024 * 1024;
+    static constexpr int kWriteIntervalMs = 200;
+
+    TrafficCapture();
+    ~TrafficCapture() = default;
+
+    static void stopAtExit();
+    void writeLoop();
+    void writePending();
+
+    static inline std::atomic<bool> enabled_{false};
+
+    std::atomic<uint64_t> sampleThreshold_;    // Tracer::newId() 小于它的帧被采样
+    std::atomic<bool> sampleAll_;
+    std::atomic<uint64_t> captured_;
+    std::atomic<uint64_t> dropped_;
+
+    std::mutex queueMutex_;
+    std::condition_variable queueCond_;
+    std::string pending_;                      // 编码好的记录
+    std::chrono::steady_clock::time_point start_;
+    double budget_;                            // 令牌桶中可用的字节数
+    uint64_t bytesPerSecond_;
+    std::chrono::steady_clock::time_point refilled_;
+    uint64_t reserved_;                        // 已写入和待写入的文件字节数
+    uint64_t maxFileBytes_;
+    bool full_;                                // 已达到文件上限
+    bool stopping_;
+
+    std::mutex fileMutex_;                     // 串行化写文件：后台线程、flush()、stop()
+    FILE* file_;
+    std::thread writer_;
+};
+
+}  // namespace prpc
+
+#endif // PRPC_CAPTURE_H
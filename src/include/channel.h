@@ -3,11 +3,20 @@
 // From google::protobuf::RpcChannel
 #include <google/protobuf/service.h>
 
+#include <memory>
+
+#include "conf.h"
 #include "zookeeperutil.h"
+
+namespace prpc {
+struct MethodStats;
+}
+
 class Pchannel : public google::protobuf::RpcChannel {
  public:
   Pchannel(bool connectNow);
-  virtual ~Pchannel() {};
+  // Closes the connections the channel opened.
+  virtual ~Pchannel();
   void CallMethod(const ::google::protobuf::MethodDescriptor *method,
                   ::google::protobuf::RpcController *controller,
                   const ::google::protobuf::Message *request,
@@ -23,6 +32,23 @@ class Pchannel : public google::protobuf::RpcChannel {
   int m_idx;
   std::unordered_map<std::string, int> m_connections;
   std::mutex m_mutex;
+
+  // Per-method state, resolved on the first call and again after a config
+  // reload; guarded by m_mutex.
+  struct MethodState {
+    std::string service_name;
+    std::string method_name;
+    prpc::MethodStats *stats;
+    MethodProfile profile;
+    uint64_t config_version;
+  };
+  std::unordered_map<const google::protobuf::MethodDescriptor *,
+                     std::unique_ptr<MethodState>>
+      m_methods;
+  // Returns the method's state and a copy of its profile.
+  MethodState *ResolveMethod(const google::protobuf::MethodDescriptor *method,
+                             MethodProfile *profile);
+
   bool newConnect(const char *ip, uint16_t port);
   std::string QueryServiceHost(ZkClient *zkclient, std::string service_name,
                                std::string method_name, int &idx);
@@ -1,18 +1,128 @@
 #ifndef _Pconfig_H
 #define _Pconfig_H
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 #include <string>
+#include <vector>
 #include "error.h"
 
+// 某个服务或方法的调优项。配置文件中用小节覆盖，方法小节优先于服务小节：
+//   [UserServiceRpc]           对整个服务生效
+//   timeout_ms=500
+//   [UserServiceRpc.Login]     只对该方法生效
+//   priority=high
+// Pprovider 在注册服务时、Pchannel 在第一次调用时解析，之后请求路径上只读字段
+struct MethodProfile {
+    int timeout_ms = 0;         // 调用方未设置超时时使用，0 表示不限制
+    bool run_inline = false;    // executor=inline：服务端在读取请求的线程上直接处理，不进入线程池
+    int max_concurrency = 0;    // 本进程对该方法同时进行的调用数上限，超出时立即失败；0 表示不限制
+    uint32_t priority = 0;      // high|normal|low，对应 RpcPriority；0 表示未配置
+    int max_retries = 0;        // 客户端连接或发送失败(请求未发出)时的重试次数
+    bool checksum = false;      // checksum=crc32c：请求和响应帧附带 CRC32C；两个小节都未配置时取顶层的 checksum
+    // max_response_mb：客户端接受的单个响应上限，超过时按序列化错误失败并断开连接；
+    // 两个小节都未配置时取顶层的 rpcclient_max_response_mb，默认 64MB
+    uint64_t max_response_bytes = 64ull << 20;
+};
+
+// 一次加载的全部配置，发布后不再修改。
+// 常用项在加载时解析一次，请求路径上直接读字段，不再查表和 atoi。
+struct ConfigSnapshot {
+    uint64_t version = 0;   // 每次加载加一
+    std::unordered_map<std::string, std::string> values;
+
+    std::string rpcserver_ip;
+    uint16_t rpcserver_port = 0;
+    std::string zookeeper_host;             // zookeeperip:zookeeperport
+    std::string registry;
+    std::string log_level;
+    int status_port = 0;
+    int slow_request_ms = 0;                // 0 表示未配置
+    int pool_alert_interval_s = 0;
+    int edf_max_wait_ms = 0;
+    std::vector<unsigned> queue_weights;
+    double trace_sample_rate = -1;          // 小于 0 表示未配置
+
+    // 未配置时返回空串；小节中的键为 "小节名.键"
+    const std::string& Get(const std::string &key) const;
+    int64_t GetInt(const std::string &key, int64_t default_value = 0) const;
+
+    // 按 [service.method]、[service] 的顺序合并调优项
+    MethodProfile ResolveMethod(const std::string &service, const std::string &method) const;
+};
+
+// 持有一个快照；重新加载后，旧快照在最后一个持有者释放时回收
+using ConfigSnapshotPtr = std::shared_ptr<const ConfigSnapshot>;
+
 class Pconfig{
     public:
+    // 某个键的值变化后调用，参数是新的快照
+    using ChangeCallback = std::function<void(const ConfigSnapshot&)>;
+
+    Pconfig();
+    ~Pconfig();
+    Pconfig(const Pconfig&) = delete;
+    Pconfig& operator=(const Pconfig&) = delete;
+
     // 使用Result返回类型，提供更好的错误处理
+    // 解析成功后整体替换当前快照，并通知值有变化的键的回调；失败时保留原配置
     prpc::Result<void> LoadConfigFile(const char *config_file);
+    // 重新读取上次加载的文件
+    prpc::Result<void> Reload();
     std::string Load(const std::string &key);
+    // 所有配置项，按键排序，用于状态页展示
+    std::map<std::string, std::string> LoadAll() const;
+
+    // 当前快照。读取方在用完之前持有返回的指针，不要只保留对快照的引用；
+    // 需要跟随重新加载的调用方每次重新获取或注册 OnChange。
+    // 无锁：每个线程缓存最近取得的快照，版本未变时只读一次 Version() 并复制指针；
+    // 重新加载后第一次读取才通过 std::atomic_load 取新快照(libstdc++ 中会加锁)。
+    // 旧快照最迟在各线程下一次读取时回收
+    ConfigSnapshotPtr Snapshot() const;
+    // 当前快照的版本，只是一次原子读取；请求路径上用它判断是否需要重新取快照
+    uint64_t Version() const {
+        return version_.load(std::memory_order_acquire);
+    }
+
+    // 返回的 id 用于 RemoveOnChange。回调在加载配置的线程上依次执行，执行时不持有
+    // mutex_，回调里可以调用 OnChange/RemoveOnChange/Reload。
+    // RemoveOnChange 返回后回调不会再被调用；在回调里移除自身时，本次调用照常执行完
+    uint64_t OnChange(const std::string &key, ChangeCallback callback);
+    void RemoveOnChange(uint64_t id);
+
+    // 用 inotify 监视配置文件，文件被改写或替换后自动 Reload
+    bool StartWatching();
+    void StopWatching();
+
     private:
-    std::unordered_map<std::string, std::string> config_map;
+    struct Watcher {
+        uint64_t id;
+        std::string key;
+        ChangeCallback callback;
+        std::atomic<bool> removed{false};   // 已复制出来待执行的回调据此跳过
+    };
+
+    void WatchLoop(int inotify_fd);
     void Trim(std::string &read_buf);
 
+    const uint64_t id_;             // 进程内唯一，线程缓存据此区分实例，不用可能被复用的地址
+    ConfigSnapshotPtr current_;     // 通过 std::atomic_load/atomic_store 访问
+    std::atomic<uint64_t> version_{0};  // current_ 的版本，在 current_ 之后发布
+    // 串行化加载和回调的执行，保证回调按版本顺序收到快照。
+    // 可重入：回调里可以再加载，RemoveOnChange 借它等待正在执行的回调
+    std::recursive_mutex notify_mutex_;
+    std::mutex mutex_;      // 保护以下成员，回调执行时不持有
+    std::string path_;
+    std::vector<std::shared_ptr<Watcher>> watchers_;
+    uint64_t next_watcher_id_ = 1;
+
+    int stop_fd_ = -1;      // eventfd，通知监视线程退出
+    std::thread watch_thread_;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -3,10 +3,19 @@
 
 #include <google/protobuf/service.h>
 
+#include <cstdint>
 #include <string>
 
+// Request priority carried in RpcHeader.priority. kDefault leaves the choice
+// to the per-method default configured on the provider.
+enum class RpcPriority : uint32_t { kDefault = 0, kHigh = 1, kNormal = 2, kLow = 3 };
+
 class Pcontroller : public google::protobuf::RpcController {
  public:
+  // Timeout of a call whose controller has none set and whose method has no
+  // timeout_ms configured.
+  static const int kDefaultTimeoutMs = 5000;
+
   Pcontroller();
   void Reset() override;
   bool Failed() const override;
@@ -17,12 +26,18 @@ class Pcontroller : public google::protobuf::RpcController {
   bool IsCanceled() const override;
   void NotifyOnCancel(google::protobuf::Closure* callback) override;
 
+  // 0, the default, leaves the timeout to the method's timeout_ms and then
+  // kDefaultTimeoutMs.
   void SetTimeout(int timeout_ms);
   int GetTimeout() const;
+
+  void SetPriority(RpcPriority priority);
+  RpcPriority GetPriority() const;
  private:
   bool m_failed;
   std::string m_errText;
   int m_timeout_ms;
+  RpcPriority m_priority;
 };
 
 #endif
\ No newline at end of file
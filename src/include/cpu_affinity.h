@@ -0,0 +1,127 @@
+#ifndef PRPC_CPU_AFFINITY_H
+#define PRPC_CPU_AFFINITY_H
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifndef SO_INCOMING_CPU
+#define SO_INCOMING_CPU 49
+#endif
+
+namespace prpc {
+namespace affinity {
+
+/**
+ * @brief 解析CPU列表，格式与 /sys 下的 cpulist 一致，如 "0-3,8,10-11"
+ * @return 升序去重后的CPU编号；格式错误时返回空列表
+ */
+inline std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        std::string item = list.substr(pos, end - pos);
+        pos = end + 1;
+
+        item.erase(0, item.find_first_not_of(' '));
+        item.erase(item.find_last_not_of(' ') + 1);
+        if (item.empty()) {
+            continue;
+        }
+
+        char* tail = nullptr;
+        long first = std::strtol(item.c_str(), &tail, 10);
+        long last = first;
+        if (*tail == '-') {
+            last = std::strtol(tail + 1, &tail, 10);
+        }
+        if (*tail != '\0' || first < 0 || last < first || last >= CPU_SETSIZE) {
+            return {};
+        }
+        for (long cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+/**
+ * @brief 将当前线程绑定到给定的CPU集合
+ * @details 应在线程分配任何线程私有数据之前调用，这样按首次访问(first-touch)
+ *          策略分配的栈和线程局部缓存都会落在本地NUMA节点上
+ */
+inline bool pinCurrentThread(const std::vector<int>& cpus) {
+    if (cpus.empty()) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+inline bool pinCurrentThread(int cpu) {
+    return pinCurrentThread(std::vector<int>{cpu});
+}
+
+/**
+ * @brief 查询CPU所属的NUMA节点
+ * @return 节点编号；非NUMA系统或无法确定时返回0
+ */
+inline int cpuToNode(int cpu) {
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* dir = opendir(path.c_str());
+    if (dir == nullptr) {
+        return 0;
+    }
+    int node = 0;
+    while (dirent* entry = readdir(dir)) {
+        if (std::string(entry->d_name).compare(0, 4, "node") == 0) {
+            node = std::atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+/**
+ * @brief 获取连接最近一次由哪个CPU处理收包软中断 (SO_INCOMING_CPU)
+ * @return CPU编号；内核不支持或尚未收包时返回-1
+ */
+inline int incomingCpu(int fd) {
+    int cpu = -1;
+    socklen_t len = sizeof(cpu);
+    if (getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) != 0) {
+        return -1;
+    }
+    return cpu;
+}
+
+/**
+ * @brief 为监听socket设置SO_INCOMING_CPU
+ * @details 配合SO_REUSEPORT使用时，内核会优先把在该CPU上收到的新连接
+ *          分配给这个监听socket，从而让连接落到同核的reactor上
+ */
+inline bool setIncomingCpu(int fd, int cpu) {
+    return setsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) == 0;
+}
+
+} // namespace affinity
+} // namespace prpc
+
+#endif // PRPC_CPU_AFFINITY_H
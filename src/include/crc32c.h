@@ -0,0 +1,27 @@
+#ifndef PRPC_CRC32C_H
+#define PRPC_CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace prpc {
+
+// CRC32C (Castagnoli)，用于帧校验(见 rpc_frame.h)
+// x86-64 上 CPU 支持 SSE4.2 时用 crc32 指令，三路交错计算以掩盖指令延迟，
+// 否则用查表(slicing-by-8)的实现。两者结果相同，启动时选择一次。
+
+/**
+ * @brief 计算 data 的 CRC32C
+ * @param crc 前一段数据的结果，用于分段计算：crc32c(b, crc32c(a)) == crc32c(a + b)
+ */
+uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0);
+
+// 查表实现，供测试和基准测试对比
+uint32_t crc32cPortable(const void* data, size_t size, uint32_t crc = 0);
+
+// crc32c() 是否使用了硬件指令
+bool crc32cHardware();
+
+} // namespace prpc
+
+#endif // PRPC_CRC32C_H
@@ -0,0 +1,136 @@
+#ifndef FIBER_H
+#define FIBER_H
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct Fiber;
+
+// M:N scheduler: runs many stackful fibers on a small, fixed set of worker
+// threads. A fiber that waits on a socket, sleeps or yields gives its worker
+// back to the scheduler instead of blocking it, so blocking-style handlers
+// (including nested Pchannel calls) cost one fiber stack, not one OS thread.
+//
+// Fibers may resume on a different worker than the one they suspended on, so
+// fiber code must not keep pointers to thread_local state across a wait.
+// std::mutex is fine for short critical sections, but a fiber must never
+// wait on a lock or condition that another fiber releases.
+class FiberScheduler {
+ public:
+  static const size_t kDefaultStackSize = 128 * 1024;
+
+  explicit FiberScheduler(
+      int numThreads = std::thread::hardware_concurrency(),
+      size_t stackSize = kDefaultStackSize);
+  // Waits for every spawned fiber to finish, then stops the workers.
+  ~FiberScheduler();
+
+  FiberScheduler(const FiberScheduler&) = delete;
+  FiberScheduler& operator=(const FiberScheduler&) = delete;
+
+  void spawn(std::function<void()> fn);
+
+  size_t size() const { return workers.size(); }
+  // Fibers spawned and not yet finished, including suspended ones.
+  size_t liveFibers();
+
+  // A parked fiber's fd and timer registration; defined in fiber.cc.
+  struct Waiter;
+
+ private:
+  friend struct FiberAccess;
+  using Clock = std::chrono::steady_clock;
+
+  void workerLoop();
+  void pollerLoop();
+  void schedule(Fiber* fiber);
+  // Run by the worker once the fiber's context is saved, so the wake-up can
+  // never resume a fiber that is still switching out.
+  void arm(Waiter* waiter);
+  // The rest are called with wait_mutex held.
+  // Points fd's one-shot registration at the union of its waiters' events,
+  // re-enabling it after it fired, or drops it once no waiter is left.
+  // Returns the epoll_ctl errno.
+  int rearm(int fd, bool registered);
+  // Ends a wait early: detaches the waiter from its fd and resumes it.
+  void wake(Waiter* waiter, bool timedOut);
+  // Resumes a waiter that is no longer registered on its fd.
+  void release(Waiter* waiter, bool timedOut);
+  // Handles an epoll event for fd and re-arms it for the waiters left.
+  void fdReady(int fd, uint32_t ready);
+  void* allocStack();
+  void freeStack(void* stack);
+
+  size_t stack_size;  // usable bytes, excluding the guard page
+  size_t page_size;
+  std::vector<std::thread> workers;
+  std::thread poller;
+
+  std::deque<Fiber*> run_queue;
+  std::mutex queue_mutex;
+  std::condition_variable condition;
+  std::condition_variable drained;
+  size_t live;
+  bool stop;
+  std::atomic<bool> poller_stop;
+
+  int epoll_fd;
+  int event_fd;  // interrupts epoll_wait when an earlier timer is armed
+  std::multimap<Clock::time_point, Waiter*> timers;
+  // Fibers parked on each fd; several may wait on one socket, e.g. one
+  // reading while another writes.
+  std::unordered_map<int, std::vector<Waiter*>> fd_waiters;
+  std::mutex wait_mutex;
+
+  std::vector<void*> free_stacks;
+  std::mutex stack_mutex;
+};
+
+// Fiber-aware blocking primitives. Inside a fiber they suspend only the
+// fiber; on a plain thread they fall back to ordinary blocking calls, so the
+// same code runs under either executor.
+namespace fiber {
+
+bool inFiber();
+void yield();
+
+// One pointer of request-scoped storage that follows the fiber across
+// workers; on a plain thread it is thread_local. Re-fetch it after any wait
+// rather than holding the reference.
+void*& localContext();
+void sleepFor(std::chrono::milliseconds duration);
+
+// Waits until fd reports one of the epoll events. timeoutMs < 0 waits
+// forever. Returns 1 when ready, 0 on timeout and -1 on error. Any number of
+// fibers may wait on the same fd, for the same or different events.
+int waitFd(int fd, uint32_t events, int timeoutMs = -1);
+
+// recv/send/connect that park the fiber while the socket would block. On a
+// plain thread they are the raw calls, and the socket's own SO_RCVTIMEO /
+// SO_SNDTIMEO apply instead of timeoutMs. A timeout fails with EAGAIN.
+// send() keeps going until the whole buffer is written.
+ssize_t recv(int fd, void* buf, size_t len, int flags, int timeoutMs = -1);
+ssize_t send(int fd, const void* buf, size_t len, int flags,
+             int timeoutMs = -1);
+// recv() until len bytes arrived. Returns len, 0 when the peer closed first
+// and -1 on error or timeout.
+ssize_t recvAll(int fd, void* buf, size_t len, int flags,
+                int timeoutMs = -1);
+int connect(int fd, const sockaddr* addr, socklen_t addrlen,
+            int timeoutMs = -1);
+
+}  // namespace fiber
+
+#endif  // FIBER_H
@@ -216,6 +216,11 @@ class RpcHeader final : public ::google::protobuf::Message
     kServiceNameFieldNumber = 1,
     kMethodNameFieldNumber = 2,
     kArgsSizeFieldNumber = 3,
+    kPriorityFieldNumber = 4,
+    kTimeoutMsFieldNumber = 5,
+    kTraceIdFieldNumber = 6,
+    kSpanIdFieldNumber = 7,
+    kSampledFieldNumber = 8,
   };
   // bytes service_name = 1;
   void clear_service_name() ;
@@ -256,12 +261,62 @@ class RpcHeader final : public ::google::protobuf::Message
   ::uint32_t _internal_args_size() const;
   void _internal_set_args_size(::uint32_t value);
 
+  public:
+  // uint32 priority = 4;
+  void clear_priority() ;
+  ::uint32_t priority() const;
+  void set_priority(::uint32_t value);
+
+  private:
+  ::uint32_t _internal_priority() const;
+  void _internal_set_priority(::uint32_t value);
+
+  public:
+  // uint32 timeout_ms = 5;
+  void clear_timeout_ms() ;
+  ::uint32_t timeout_ms() const;
+  void set_timeout_ms(::uint32_t value);
+
+  private:
+  ::uint32_t _internal_timeout_ms() const;
+  void _internal_set_timeout_ms(::uint32_t value);
+
+  public:
+  // uint64 trace_id = 6;
+  void clear_trace_id() ;
+  ::uint64_t trace_id() const;
+  void set_trace_id(::uint64_t value);
+
+  private:
+  ::uint64_t _internal_trace_id() const;
+  void _internal_set_trace_id(::uint64_t value);
+
+  public:
+  // uint64 span_id = 7;
+  void clear_span_id() ;
+  ::uint64_t span_id() const;
+  void set_span_id(::uint64_t value);
+
+  private:
+  ::uint64_t _internal_span_id() const;
+  void _internal_set_span_id(::uint64_t value);
+
+  public:
+  // bool sampled = 8;
+  void clear_sampled() ;
+  bool sampled() const;
+  void set_sampled(bool value);
+
+  private:
+  bool _internal_sampled() const;
+  void _internal_set_sampled(bool value);
+
   public:
   // @@protoc_insertion_point(class_scope:Prpc.RpcHeader)
  private:
   class _Internal;
   friend class ::google::protobuf::internal::TcParser;
-  static const ::google::protobuf::internal::TcParseTable<2, 3,
+  static const ::google::protobuf::internal::TcParseTable<3, 8,
                                    0, 0,
                                    2>
       _table_;
@@ -286,6 +341,11 @@ class RpcHeader final : public ::google::protobuf::Message
     ::google::protobuf::internal::ArenaStringPtr service_name_;
     ::google::protobuf::internal::ArenaStringPtr method_name_;
     ::uint32_t args_size_;
+    ::uint32_t priority_;
+    ::uint32_t timeout_ms_;
+    ::uint64_t trace_id_;
+    ::uint64_t span_id_;
+    bool sampled_;
     PROTOBUF_TSAN_DECLARE_MEMBER
   };
   union { Impl_ _impl_; };
@@ -464,6 +524,126 @@ inline void RpcHeader::_internal_set_args_size(::uint32_t value) {
   _impl_.args_size_ = value;
 }
 
+// uint32 priority = 4;
+inline void RpcHeader::clear_priority() {
+  ::google::protobuf::internal::TSanWrite(&_impl_);
+  _impl_.priority_ = 0u;
+  _impl_._has_bits_[0] &= ~0x00000008u;
+}
+inline ::uint32_t RpcHeader::priority() const {
+  // @@protoc_insertion_point(field_get:Prpc.RpcHeader.priority)
+  return _internal_priority();
+}
+inline void RpcHeader::set_priority(::uint32_t value) {
+  _internal_set_priority(value);
+  _impl_._has_bits_[0] |= 0x00000008u;
+  // @@protoc_insertion_point(field_set:Prpc.RpcHeader.priority)
+}
+inline ::uint32_t RpcHeader::_internal_priority() const {
+  ::google::protobuf::internal::TSanRead(&_impl_);
+  return _impl_.priority_;
+}
+inline void RpcHeader::_internal_set_priority(::uint32_t value) {
+  ::google::protobuf::internal::TSanWrite(&_impl_);
+  _impl_.priority_ = value;
+}
+
+// uint32 timeout_ms = 5;
+inline void RpcHeader::clear_timeout_ms() {
+  ::google::protobuf::internal::TSanWrite(&_impl_);
+  _impl_.timeout_ms_ = 0u;
+  _impl_._has_bits_[0] &= ~0x00000010u;
+}
+inline ::uint32_t RpcHeader::timeout_ms() const {
+  // @@protoc_insertion_point(field_get:Prpc.RpcHeader.timeout_ms)
+  return _internal_timeout_ms();
+}
+inline void RpcHeader::set_timeout_ms(::uint32_t value) {
+  _internal_set_timeout_ms(value);
+  _impl_._has_bits_[0] |= 0x00000010u;
+  // @@protoc_insertion_point(field_set:Prpc.RpcHeader.timeout_ms)
+}
+inline ::uint32_t RpcHeader::_internal_timeout_ms() const {
+  ::google::protobuf::internal::TSanRead(&_impl_);
+  return _impl_.timeout_ms_;
+}
+inline void RpcHeader::_internal_set_timeout_ms(::uint32_t value) {
+  ::google::protobuf::internal::TSanWrite(&_impl_);
+  _impl_.timeout_ms_ = value;
+}
+
+// uint64 trace_id = 6;
+inline void RpcHeader::clear_trace_id() {
+  ::google::protobuf::internal::TSanWrite(&_impl_);
+  _impl_.trace_id_ = ::uint64_t{0u};
+  _impl_._has_bits_[0] &= ~0x00000020u;
+}
+inline ::uint64_t RpcHeader::trace_id() const {
+  // @@protoc_insertion_point(field_get:Prpc.RpcHeader.trace_id)
+  return _internal_trace_id();
+}
+inline void RpcHeader::set_trace_id(::uint64_t value) {
+  _internal_set_trace_id(value);
+  _impl_._has_bits_[0] |= 0x00000020u;
+  // @@protoc_insertion_point(field_set:Prpc.RpcHeader.trace_id)
+}
+inline ::uint64_t RpcHeader::_internal_trace_id() const {
+  ::google::protobuf::internal::TSanRead(&_impl_);
+  return _impl_.trace_id_;
+}
+inline void RpcHeader::_internal_set_trace_id(::uint64_t value) {
+  ::google::protobuf::internal::TSanWrite(&_impl_);
+  _impl_.trace_id_ = value;
+}
+
+// uint64 span_id = 7;
+inline void RpcHeader::clear_span_id() {
+  ::google::protobuf::internal::TSanWrite(&_impl_);
+  _impl_.span_id_ = ::uint64_t{0u};
+  _impl_._has_bits_[0] &= ~0x00000040u;
+}
+inline ::uint64_t RpcHeader::span_id() const {
+  // @@protoc_insertion_point(field_get:Prpc.RpcHeader.span_id)
+  return _internal_span_id();
+}
+inline void RpcHeader::set_span_id(::uint64_t value) {
+  _internal_set_span_id(value);
+  _impl_._has_bits_[0] |= 0x00000040u;
+  // @@protoc_insertion_point(field_set:Prpc.RpcHeader.span_id)
+}
+inline ::uint64_t RpcHeader::_internal_span_id() const {
+  ::google::protobuf::internal::TSanRead(&_impl_);
+  return _impl_.span_id_;
+}
+inline void RpcHeader::_internal_set_span_id(::uint64_t value) {
+  ::google::protobuf::internal::TSanWrite(&_impl_);
+  _impl_.span_id_ = value;
+}
+
+// bool sampled = 8;
+inline void RpcHeader::clear_sampled() {
+  ::google::protobuf::internal::TSanWrite(&_impl_);
+  _impl_.sampled_ = false;
+  _impl_._has_bits_[0] &= ~0x00000080u;
+}
+inline bool RpcHeader::sampled() const {
+  // @@protoc_insertion_point(field_get:Prpc.RpcHeader.sampled)
+  return _internal_sampled();
+}
+inline void RpcHeader::set_sampled(bool value) {
+  _internal_set_sampled(value);
+  _impl_._has_bits_[0] |= 0x00000080u;
+  // @@protoc_insertion_point(field_set:Prpc.RpcHeader.sampled)
+}
+inline bool RpcHeader::_internal_sampled() const {
+  ::google::protobuf::internal::TSanRead(&_impl_);
+  return _impl_.sampled_;
+}
+inline void RpcHeader::_internal_set_sampled(bool value) {
+  ::google::protobuf::internal::TSanWrite(&_impl_);
+  _impl_.sampled_ = value;
+}
+
 #ifdef __GNUC__
 #pragma GCC diagnostic pop
 #endif  // __GNUC__
@@ -1,32 +1,42 @@
 #ifndef PRPC_LOGGER_H
 #define PRPC_LOGGER_H
 
-#include <iostream>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
 #include <string>
 #include <sstream> // 用于实现流式接口
-#include <chrono>
-#include <ctime>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 // 定义日志级别
 enum LogLevel {
+    DEBUG,
     INFO,
+    WARN,
     ERROR,
     FATAL
 };
 
+// 编译期最低日志级别，低于它的 LOG 语句连同参数一起被编译器消除。
+// 例如 -DPRPC_MIN_LOG_LEVEL=1 去掉所有 DEBUG 日志；FATAL 不受影响
+#ifndef PRPC_MIN_LOG_LEVEL
+#define PRPC_MIN_LOG_LEVEL 0
+#endif
+
 class LogStream; // 前向声明
+struct LogBuffer; // 每线程的日志环形缓冲区，定义见 logger.cc
 
 // 日志后端：线程安全的单例 PLogger
-// 它负责将最终格式化的字符串写入到控制台
+// 各线程把格式化好的日志写入自己的无锁环形缓冲区，后台刷新线程批量写出到
+// 控制台或日志文件。FATAL 日志在返回前同步写出。
 class PLogger {
 public:
     // 获取日志类的唯一实例
-    static PLogger& getInstance() {
-        static PLogger instance;
-        return instance;
-    }
+    static PLogger& getInstance();
 
     // 禁止拷贝和赋值
     PLogger(const PLogger&) = delete;
@@ -34,54 +44,73 @@ public:
 
     // 设置要记录的最低日志级别
     void setLogLevel(LogLevel level) {
-        logLevel_ = level;
+        logLevel_.store(level, std::memory_order_relaxed);
     }
 
-    // 由 LogStream 的析构函数调用，负责写入最终的日志消息
-    void log(LogLevel level, const char* file, int line, const std::string& message) {
-        if (level < logLevel_) {
-            return;
-        }
+    LogLevel getLogLevel() const {
+        return logLevel_.load(std::memory_order_relaxed);
+    }
 
-        // 加锁以保证多线程输出的原子性
-        std::lock_guard<std::mutex> lock(mtx_);
-
-        // 1. 获取当前时间并格式化
-        auto now = std::chrono::system_clock::now();
-        auto now_c = std::chrono::system_clock::to_time_t(now);
-        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
-        
-        char time_buf[32];
-        std::tm tm_buf;
-        localtime_r(&now_c, &tm_buf); // 使用线程安全的 localtime_r
-        std::strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", &tm_buf);
-
-        // 2. 选择输出流 (INFO -> cout, ERROR/FATAL -> cerr)
-        std::ostream& stream = (level == INFO) ? std::cout : std::cerr;
-
-        // 3. 构造日志前缀并输出
-        stream << "[" << getLevelString(level) << "]";
-        stream << "[" << time_buf << "." << ms.count() << "]";
-        stream << "[" << file << ":" << line << "] ";
-        stream << message << std::endl;
+    // LOG 宏在构造 LogStream 之前调用，不经过 getInstance()
+    static bool isEnabled(LogLevel level) {
+        return level >= logLevel_.load(std::memory_order_relaxed);
+    }
+
+    // 解析 debug/info/warn/error/fatal (不区分大小写)，失败返回false
+    static bool parseLevel(const std::string& name, LogLevel& level);
+
+    // 由 LogStream 的析构函数调用，把日志交给当前线程的缓冲区
+    void log(LogLevel level, const char* file, int line, const std::string& message);
+
+    // 提交一条二进制日志记录(见 binary_log.h)，record 前 blog::kRecordHeaderSize
+    // 字节由这里填写，记录随文本日志一起由刷新线程写入二进制日志文件
+    void logBinary(LogLevel level, uint32_t formatId, char* record, size_t length);
+
+    // 输出到文件(追加)，空路径恢复为控制台输出 (DEBUG/INFO -> stdout, WARN 及以上 -> stderr)
+    bool setLogFile(const std::string& path);
+
+    // 把此前所有线程提交的日志写出后返回
+    void flush();
+
+    // 刷新线程的最长等待间隔，缓冲区过半时会提前唤醒
+    void setFlushInterval(int ms) {
+        flushIntervalMs_.store(ms > 0 ? ms : 1, std::memory_order_relaxed);
     }
 
 private:
-    // 构造函数私有化
-    PLogger() : logLevel_(INFO) {}
+    PLogger();
     ~PLogger() = default;
 
-    const char* getLevelString(LogLevel level) {
-        switch(level) {
-            case INFO:  return "INFO";
-            case ERROR: return "ERROR";
-            case FATAL: return "FATAL";
-            default:    return "UNKNOWN";
-        }
-    }
+    static void shutdownAtExit();
 
-    LogLevel logLevel_;
-    std::mutex mtx_;
+    LogBuffer* localBuffer();
+    void append(LogBuffer* buffer, uint8_t tag, const char* data, size_t length);
+    void writeSync(LogLevel level, const std::string& record);
+    void drainLocked();
+    void writeAll(int fd, const char* data, size_t len);
+    void flushLoop();
+    void stop();
+
+    static inline std::atomic<LogLevel> logLevel_{INFO};
+    std::atomic<int> flushIntervalMs_;
+
+    // 已注册的线程缓冲区，刷新线程是唯一的消费者
+    std::mutex buffersMutex_;
+    std::vector<std::shared_ptr<LogBuffer>> buffers_;
+
+    // 串行化消费和输出：刷新线程、flush()、FATAL 和退出时的排空
+    std::mutex drainMutex_;
+    int fileFd_;                      // -1 表示输出到控制台
+    std::string outBatch_;
+    std::string errBatch_;
+    std::string binaryBatch_;
+
+    std::mutex wakeMutex_;
+    std::condition_variable wakeCond_;
+    bool wakePending_;
+    bool stopping_;
+    std::atomic<bool> synchronous_;   // 刷新线程停止后改为同步写出
+    std::thread flusher_;
 };
 
 
@@ -91,10 +120,17 @@ private:
 class LogStream {
 public:
     LogStream(LogLevel level, const char* file, int line)
-        : level_(level), file_(file), line_(line) {}
+        : level_(level), file_(file), line_(line), suppressed_(0) {}
+
+    // 限流宏使用：suppressed 为上次输出以来该调用点被抑制的条数
+    LogStream(LogLevel level, const char* file, int line, uint64_t suppressed)
+        : level_(level), file_(file), line_(line), suppressed_(suppressed) {}
 
     // 析构函数：将缓冲区中的所有数据提交给后端的 PLogger
     ~LogStream() {
+        if (suppressed_ > 0) {
+            buffer_ << " [suppressed " << suppressed_ << " messages]";
+        }
         PLogger::getInstance().log(level_, file_, line_, buffer_.str());
         // 如果是 FATAL 级别，则在打印日志后终止程序
         if (level_ == FATAL) {
@@ -113,10 +149,126 @@ private:
     LogLevel level_;
     const char* file_;
     int line_;
+    uint64_t suppressed_;
     std::stringstream buffer_; // 用于缓存流式输入的数据
 };
 
-// 定义日志宏，这是用户使用的唯一接口
-#define LOG(level) LogStream(level, __FILE__, __LINE__)
+// 限流日志宏的调用点状态，静态存储，只使用原子操作。
+// 被抑制的条数随该调用点的下一条日志输出；调用点安静下来后，
+// 由刷新线程定期补发 "suppressed N messages" 汇总，不会丢失计数。
+class LogSite {
+public:
+    constexpr LogSite(LogLevel level, const char* file, int line)
+        : level_(level), file_(file), line_(line) {}
+
+    // 第 1, n+1, 2n+1 ... 次通过
+    bool everyN(uint64_t n) {
+        uint64_t count = count_.fetch_add(1, std::memory_order_relaxed);
+        return admit(n <= 1 || count % n == 0);
+    }
+
+    // 前 n 次通过
+    bool firstN(uint64_t n) {
+        return admit(count_.fetch_add(1, std::memory_order_relaxed) < n);
+    }
+
+    // 每 seconds 秒最多通过一次
+    bool everyT(double seconds) {
+        int64_t now = nowNs();
+        int64_t next = next_.load(std::memory_order_relaxed);
+        return admit(now >= next &&
+                     next_.compare_exchange_strong(next, now + static_cast<int64_t>(seconds * 1e9),
+                                                   std::memory_order_relaxed));
+    }
+
+    // 令牌桶：平均每秒 per_second 条，允许 burst 条的突发(GCRA 实现，单个原子量)
+    bool rateLimited(double per_second, uint64_t burst) {
+        int64_t interval = static_cast<int64_t>(1e9 / (per_second > 0 ? per_second : 1e-9));
+        int64_t tolerance = interval * static_cast<int64_t>(burst > 0 ? burst - 1 : 0);
+        int64_t now = nowNs();
+        int64_t tat = next_.load(std::memory_order_relaxed);
+        while (true) {
+            int64_t base = tat > now ? tat : now;
+            if (base - now > tolerance) {
+                return admit(false);
+            }
+            if (next_.compare_exchange_weak(tat, base + interval, std::memory_order_relaxed)) {
+                return admit(true);
+            }
+        }
+    }
+
+    // 取走待报告的抑制条数
+    uint64_t takeSuppressed() {
+        lastReport_.store(nowNs(), std::memory_order_relaxed);
+        return suppressed_.exchange(0, std::memory_order_relaxed);
+    }
+
+    // 由刷新线程调用：为安静超过 quiet_ns 且仍有未报告抑制条数的调用点输出汇总
+    static void reportSuppressed(int64_t quiet_ns);
+
+private:
+    static int64_t nowNs();
+
+    bool admit(bool pass) {
+        if (!pass) {
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            if (!registered_.load(std::memory_order_relaxed) &&
+                !registered_.exchange(true, std::memory_order_acq_rel)) {
+                link();
+            }
+        }
+        return pass;
+    }
+
+    // 挂入全局的无锁单链表，调用点是静态对象，不会被移除
+    void link();
+
+    static inline std::atomic<LogSite*> head_{nullptr};
+
+    const LogLevel level_;
+    const char* const file_;
+    const int line_;
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> suppressed_{0};
+    std::atomic<int64_t> next_{0};        // everyT: 下次允许的时间; 令牌桶: 理论到达时间
+    std::atomic<int64_t> lastReport_{0};
+    std::atomic<bool> registered_{false};
+    LogSite* next_site_ = nullptr;
+};
+
+// 把 LogStream 表达式转为 void，使 LOG 宏可以写成条件表达式
+class LogVoidify {
+public:
+    // & 的优先级低于 <<，在整条语句的 << 都结合之后才求值
+    void operator&(const LogStream&) {}
+};
+
+// 日志级别是否启用：先做编译期判断，再读运行时级别
+#define PRPC_LOG_ENABLED(level) \
+    ((level) == FATAL || ((level) >= PRPC_MIN_LOG_LEVEL && PLogger::isEnabled(level)))
+
+// 定义日志宏，这是用户使用的唯一接口。
+// 级别未启用时不构造 LogStream，也不对 << 右侧的参数求值
+#define LOG(level) \
+    !PRPC_LOG_ENABLED(level) ? (void)0 : LogVoidify() & LogStream(level, __FILE__, __LINE__)
+
+// 限流日志宏，用法与 LOG 相同，例如 LOG_EVERY_T(ERROR, 1.0) << "accept error";
+// 输出的日志末尾附带上次输出以来被抑制的条数
+#define PRPC_LOG_LIMITED(level, admit)                                                  \
+    if (static LogSite prpc_log_site(level, __FILE__, __LINE__);                        \
+        !PRPC_LOG_ENABLED(level) || !prpc_log_site.admit) {                             \
+    } else                                                                              \
+        LogVoidify() & LogStream(level, __FILE__, __LINE__, prpc_log_site.takeSuppressed())
+
+// 每 n 次输出一次
+#define LOG_EVERY_N(level, n) PRPC_LOG_LIMITED(level, everyN(n))
+// 只输出前 n 次
+#define LOG_FIRST_N(level, n) PRPC_LOG_LIMITED(level, firstN(n))
+// 每 seconds 秒最多输出一次
+#define LOG_EVERY_T(level, seconds) PRPC_LOG_LIMITED(level, everyT(seconds))
+// 令牌桶：平均每秒 per_second 条，突发上限 burst 条
+#define LOG_RATE_LIMITED(level, per_second, burst) \
+    PRPC_LOG_LIMITED(level, rateLimited(per_second, burst))
 
 #endif // PRPC_LOGGER_H
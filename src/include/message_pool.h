@@ -2,9 +2,12 @@
 #define MESSAGE_POOL_H
 
 #include "object_pool.h"
+#include <array>
 #include <string>
 #include <vector>
 #include <cstring>
+#include <shared_mutex>
+#include <unordered_map>
 
 namespace prpc {
 
@@ -54,9 +57,9 @@ struct NetworkBuffer {
     
     static constexpr size_t DEFAULT_BUFFER_SIZE = 8192;
     
-    NetworkBuffer() {
+    explicit NetworkBuffer(size_t reserve_size = DEFAULT_BUFFER_SIZE) {
         reset();
-        data.reserve(DEFAULT_BUFFER_SIZE);
+        data.reserve(reserve_size);
     }
     
     void reset() {
@@ -107,12 +110,70 @@ struct NetworkBuffer {
 
 /**
  * @brief RPC消息对象池
+ * @details 缓冲区按容量分为 1K/8K/64K/1M 四个大小档，每档一个对象池。
+ *          按方法记录的负载大小直方图用于为该方法选择大小档，provider 的
+ *          请求和响应缓冲区都由此获取；各池默认开启自动调优，保留量随实际负载变化
  */
 class MessagePool {
 public:
     using MessagePoolType = ObjectPool<RpcMessage>;
     using BufferPoolType = ObjectPool<NetworkBuffer>;
     
+    static constexpr size_t kBufferClassCount = 4;
+    static constexpr std::array<size_t, kBufferClassCount> kBufferClassSizes = {
+        1024, 8 * 1024, 64 * 1024, 1024 * 1024
+    };
+    // acquireBuffer() 默认使用的大小档(8K)
+    static constexpr size_t kDefaultBufferClass = 1;
+    // 选择大小档时需要覆盖的负载比例
+    static constexpr double kPayloadCoverage = 0.9;
+    
+    /**
+     * @brief 一类负载的大小直方图，按大小档计数
+     * @details 每记录 kDecayInterval 次各档计数减半，旧负载的权重按指数衰减，
+     *          方法的负载变化后大小档随之调整。减半与并发的记录之间不加锁，
+     *          可能丢失少量计数，不影响选档
+     */
+    class PayloadHistogram {
+    public:
+        static constexpr uint64_t kDecayInterval = 1024;
+        
+        void record(size_t size) {
+            counts_[sizeClassFor(size)].fetch_add(1, std::memory_order_relaxed);
+            if (recorded_.fetch_add(1, std::memory_order_relaxed) % kDecayInterval ==
+                kDecayInterval - 1) {
+                for (auto& count : counts_) {
+                    count.store(count.load(std::memory_order_relaxed) / 2,
+                                std::memory_order_relaxed);
+                }
+            }
+        }
+        
+        /**
+         * @brief 能容纳约90%负载的最小大小档，没有记录时为默认档
+         */
+        size_t sizeClass() const {
+            std::array<uint64_t, kBufferClassCount> counts;
+            uint64_t total = 0;
+            for (size_t i = 0; i < kBufferClassCount; ++i) {
+                counts[i] = counts_[i].load(std::memory_order_relaxed);
+                total += counts[i];
+            }
+            uint64_t covered = 0;
+            for (size_t i = 0; i < kBufferClassCount; ++i) {
+                covered += counts[i];
+                if (total > 0 && covered >= total * kPayloadCoverage) {
+                    return i;
+                }
+            }
+            return kDefaultBufferClass;
+        }
+        
+    private:
+        std::array<std::atomic<uint64_t>, kBufferClassCount> counts_{};
+        std::atomic<uint64_t> recorded_{0};
+    };
+    
     static MessagePool& getInstance() {
         static MessagePool instance;
         return instance;
@@ -126,10 +187,94 @@ public:
     }
     
     /**
-     * @brief 获取网络缓冲区对象
+     * @brief 获取网络缓冲区对象(8K档)
      */
     BufferPoolType::PooledObject acquireBuffer(uint32_t timeout_ms = 0) {
-        return buffer_pool_.acquire(timeout_ms);
+        return buffer_pools_[kDefaultBufferClass]->acquire(timeout_ms);
+    }
+    
+    /**
+     * @brief 获取能容纳 expected_size 字节的最小档缓冲区
+     */
+    BufferPoolType::PooledObject acquireBufferFor(size_t expected_size, uint32_t timeout_ms = 0) {
+        return buffer_pools_[sizeClassFor(expected_size)]->acquire(timeout_ms);
+    }
+    
+    /**
+     * @brief 按直方图选择大小档，使约90%的负载无需扩容
+     * @details 供请求路径使用，不会失败：该档的池已满时返回一个不入池的
+     *          新缓冲区，用完直接释放
+     */
+    BufferPoolType::PooledObject acquireBufferFor(const PayloadHistogram& histogram) {
+        size_t size_class = histogram.sizeClass();
+        BufferPoolType::PooledObject buffer = buffer_pools_[size_class]->acquire();
+        if (!buffer) {
+            return BufferPoolType::PooledObject(
+                std::make_unique<NetworkBuffer>(kBufferClassSizes[size_class]), nullptr);
+        }
+        return buffer;
+    }
+    
+    /**
+     * @brief 按方法的负载直方图选择大小档
+     * @details 没有该方法的记录时使用默认档
+     */
+    BufferPoolType::PooledObject acquireBufferForMethod(const std::string& method_name,
+                                                        uint32_t timeout_ms = 0) {
+        return buffer_pools_[sizeClassForMethod(method_name)]->acquire(timeout_ms);
+    }
+    
+    /**
+     * @brief 方法(或其他负载类别)的直方图，不存在时创建
+     * @details 返回的指针在进程内一直有效，请求路径上应在注册时取好并保存，
+     *          避免每次按名字查找。provider 以方法全名记录请求，
+     *          以"方法全名#response"记录响应
+     */
+    PayloadHistogram* payloadHistogram(const std::string& method_name) {
+        {
+            std::shared_lock<std::shared_mutex> lock(histogram_mutex_);
+            auto it = histograms_.find(method_name);
+            if (it != histograms_.end()) {
+                return it->second.get();
+            }
+        }
+        std::unique_lock<std::shared_mutex> lock(histogram_mutex_);
+        auto& histogram = histograms_[method_name];
+        if (!histogram) {
+            histogram = std::make_unique<PayloadHistogram>();
+        }
+        return histogram.get();
+    }
+    
+    /**
+     * @brief 记录一次方法负载的大小
+     */
+    void recordPayload(const std::string& method_name, size_t size) {
+        payloadHistogram(method_name)->record(size);
+    }
+    
+    /**
+     * @brief 方法当前对应的大小档下标
+     */
+    size_t sizeClassForMethod(const std::string& method_name) const {
+        std::shared_lock<std::shared_mutex> lock(histogram_mutex_);
+        auto it = histograms_.find(method_name);
+        if (it == histograms_.end()) {
+            return kDefaultBufferClass;
+        }
+        return it->second->sizeClass();
+    }
+    
+    /**
+     * @brief 能容纳 size 字节的最小大小档下标，超过最大档时使用最大档
+     */
+    static size_t sizeClassFor(size_t size) {
+        for (size_t i = 0; i < kBufferClassCount; ++i) {
+            if (size <= kBufferClassSizes[i]) {
+                return i;
+            }
+        }
+        return kBufferClassCount - 1;
     }
     
     /**
@@ -140,26 +285,60 @@ public:
     }
     
     /**
-     * @brief 获取缓冲区池统计信息
+     * @brief 获取缓冲区池统计信息(所有大小档之和)
      */
     BufferPoolType::Statistics getBufferStats() const {
-        return buffer_pool_.getStatistics();
+        BufferPoolType::Statistics total;
+        for (const auto& pool : buffer_pools_) {
+            auto stats = pool->getStatistics();
+            total.total_created.fetch_add(stats.total_created.load());
+            total.total_acquired.fetch_add(stats.total_acquired.load());
+            total.total_returned.fetch_add(stats.total_returned.load());
+            total.total_destroyed.fetch_add(stats.total_destroyed.load());
+            total.cache_hits.fetch_add(stats.cache_hits.load());
+            total.cache_misses.fetch_add(stats.cache_misses.load());
+            total.current_size.fetch_add(stats.current_size.load());
+            total.active_objects.fetch_add(stats.active_objects.load());
+        }
+        return total;
+    }
+    
+    /**
+     * @brief 获取某个大小档的缓冲区池统计信息
+     */
+    BufferPoolType::Statistics getBufferStats(size_t size_class) const {
+        return buffer_pools_[std::min(size_class, kBufferClassCount - 1)]->getStatistics();
     }
     
     /**
-     * @brief 配置消息池
+     * @brief 配置消息池，可在运行时调用
      */
     void configureMessagePool(const ObjectPool<RpcMessage>::Config& config) {
-        // 注意：这里需要重新创建池，因为配置不能动态修改
-        // 在实际应用中，应该在启动时配置
+        message_pool_.reconfigure(config);
     }
     
     /**
-     * @brief 配置缓冲区池
+     * @brief 配置所有大小档的缓冲区池，可在运行时调用
      */
     void configureBufferPool(const ObjectPool<NetworkBuffer>::Config& config) {
-        // 注意：这里需要重新创建池，因为配置不能动态修改
-        // 在实际应用中，应该在启动时配置
+        for (auto& pool : buffer_pools_) {
+            pool->reconfigure(config);
+        }
+    }
+    
+    /**
+     * @brief 配置某个大小档的缓冲区池，可在运行时调用
+     */
+    void configureBufferPool(size_t size_class, const ObjectPool<NetworkBuffer>::Config& config) {
+        buffer_pools_[std::min(size_class, kBufferClassCount - 1)]->reconfigure(config);
+    }
+    
+    MessagePoolType::Config getMessagePoolConfig() const {
+        return message_pool_.getConfig();
+    }
+    
+    BufferPoolType::Config getBufferPoolConfig(size_t size_class) const {
+        return buffer_pools_[std::min(size_class, kBufferClassCount - 1)]->getConfig();
     }
     
     /**
@@ -186,6 +365,12 @@ public:
         printf("Cache Misses: %lu\n", buf_stats.cache_misses.load());
         printf("Current Size: %lu\n", buf_stats.current_size.load());
         printf("Active Objects: %lu\n", buf_stats.active_objects.load());
+        for (size_t i = 0; i < kBufferClassCount; ++i) {
+            auto class_stats = getBufferStats(i);
+            printf("  %7zuB class: size %lu, active %lu, max %zu\n", kBufferClassSizes[i],
+                   class_stats.current_size.load(), class_stats.active_objects.load(),
+                   getBufferPoolConfig(i).max_size);
+        }
         
         // 计算命中率
         auto msg_total = msg_stats.cache_hits.load() + msg_stats.cache_misses.load();
@@ -203,17 +388,46 @@ public:
     }
 
 private:
+    static MessagePoolType::Config autoTuned(MessagePoolType::Config config) {
+        config.auto_tune = true;
+        config.auto_tune_min = config.initial_size > 0 ? config.initial_size : 1;
+        return config;
+    }
+    
     MessagePool() 
         : message_pool_(
             []() { return std::make_unique<RpcMessage>(); },
             [](RpcMessage* msg) { msg->reset(); },
-            {20, 200, 300000, true, true}  // 初始20个，最大200个
-          )
-        , buffer_pool_(
-            []() { return std::make_unique<NetworkBuffer>(); },
-            [](NetworkBuffer* buf) { buf->reset(); },
-            {10, 100, 300000, true, true}  // 初始10个，最大100个
-          ) {}
+            autoTuned({20, 200, 300000, true, true})  // 初始20个，最大200个
+          ) {
+        // 各档的初始/最大数量，大缓冲区保留得更少
+        const size_t initial[kBufferClassCount] = {10, 10, 2, 0};
+        const size_t max_size[kBufferClassCount] = {200, 100, 32, 8};
+        for (size_t i = 0; i < kBufferClassCount; ++i) {
+            size_t reserve_size = kBufferClassSizes[i];
+            BufferPoolType::Config config;
+            config.initial_size = initial[i];
+            config.max_size = max_size[i];
+            config.auto_tune = true;
+            config.auto_tune_min = std::max<size_t>(initial[i], 1);
+            buffer_pools_[i] = std::make_unique<BufferPoolType>(
+                [reserve_size]() { return std::make_unique<NetworkBuffer>(reserve_size); },
+                [](NetworkBuffer* buf) { buf->reset(); },
+                config,
+                // 归还时收缩被撑大的缓冲区，空闲期间不保留读大请求时占用的内存
+                [reserve_size](NetworkBuffer* buf) {
+                    if (buf->capacity() > reserve_size * 2) {
+                        std::vector<uint8_t>().swap(buf->data);
+                        buf->data.reserve(reserve_size);
+                    }
+                });
+        }
+
+        message_pool_.exportMetrics("message");
+        for (size_t i = 0; i < kBufferClassCount; ++i) {
+            buffer_pools_[i]->exportMetrics("buffer_" + std::to_string(kBufferClassSizes[i]));
+        }
+    }
     
     ~MessagePool() = default;
     
@@ -225,7 +439,10 @@ private:
 
 private:
     MessagePoolType message_pool_;
-    BufferPoolType buffer_pool_;
+    std::array<std::unique_ptr<BufferPoolType>, kBufferClassCount> buffer_pools_;
+    
+    mutable std::shared_mutex histogram_mutex_;
+    std::unordered_map<std::string, std::unique_ptr<PayloadHistogram>> histograms_;
 };
 
 /**
@@ -0,0 +1,462 @@
+#ifndef PRPC_METRICS_H
+#define PRPC_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "error.h"
+
+namespace prpc {
+
+// 运行时指标：对数线性直方图和计数器
+// 写入只做几次 relaxed 原子加法，落在当前线程所属的分片上；
+// 读取时合并所有分片，再减去时间窗口起点的累计快照得到滑动窗口内的分布。
+namespace metrics {
+
+using Clock = std::chrono::steady_clock;
+
+// 桶划分：小于 16 的值各占一个桶，之后每个 2 的幂区间等分为 16 个子桶，
+// 相对误差不超过 1/16；大于 2^41 的值都计入最后一个桶
+constexpr int kSubBucketBits = 4;
+constexpr int kSubBuckets = 1 << kSubBucketBits;
+constexpr int kMaxExponent = 40;
+constexpr int kBucketCount = (kMaxExponent - kSubBucketBits + 2) * kSubBuckets;
+
+// 分片数：线程按首次写入的顺序轮流分到各分片，超过分片数的线程共享分片
+constexpr size_t kShards = 16;
+
+// 窗口快照的最小间隔和最长保留时间
+constexpr std::chrono::seconds kSampleInterval{5};
+constexpr std::chrono::seconds kRetention{300};
+
+inline int bucketIndex(uint64_t value) {
+    if (value < static_cast<uint64_t>(kSubBuckets)) {
+        return static_cast<int>(value);
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    if (exponent > kMaxExponent) {
+        return kBucketCount - 1;
+    }
+    return (exponent - kSubBucketBits + 1) * kSubBuckets +
+           static_cast<int>((value >> (exponent - kSubBucketBits)) & (kSubBuckets - 1));
+}
+
+// 桶覆盖的区间 [lower, upper)
+inline uint64_t bucketLower(int index) {
+    if (index < kSubBuckets) {
+        return static_cast<uint64_t>(index);
+    }
+    int exponent = index / kSubBuckets + kSubBucketBits - 1;
+    uint64_t sub = static_cast<uint64_t>(index % kSubBuckets);
+    return (kSubBuckets + sub) << (exponent - kSubBucketBits);
+}
+
+inline uint64_t bucketUpper(int index) {
+    if (index < kSubBuckets) {
+        return static_cast<uint64_t>(index) + 1;
+    }
+    int exponent = index / kSubBuckets + kSubBucketBits - 1;
+    return bucketLower(index) + (uint64_t(1) << (exponent - kSubBucketBits));
+}
+
+// 当前线程的分片号
+inline size_t localShard() {
+    static std::atomic<size_t> next{0};
+    thread_local size_t shard = next.fetch_add(1, std::memory_order_relaxed) % kShards;
+    return shard;
+}
+
+// 按时间保存的累计快照，用于计算滑动窗口：窗口值 = 当前累计值 - 窗口起点的快照
+template <typename Sample>
+class SampleHistory {
+public:
+    explicit SampleHistory(Clock::time_point created) {
+        samples_.push_back({created, Sample{}});
+    }
+
+    /**
+     * @brief 记录当前快照(距上一个快照不足 kSampleInterval 时跳过)，
+     *        返回不晚于 now - span 的最新快照及其时间
+     * @details 快照只在读取时产生，读取稀疏时窗口会比 span 长，
+     *          实际覆盖的时长由返回的时间给出
+     */
+    std::pair<Clock::time_point, Sample> advance(Clock::time_point now, const Sample& current,
+                                                 std::chrono::seconds span) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (now - samples_.back().first >= kSampleInterval) {
+            samples_.push_back({now, current});
+        }
+        // 保留一个早于保留期的快照，保证 span <= kRetention 时总能找到起点
+        while (samples_.size() > 1 && samples_[1].first <= now - kRetention) {
+            samples_.pop_front();
+        }
+        auto base = samples_.begin();
+        for (auto it = samples_.begin(); it != samples_.end() && it->first <= now - span; ++it) {
+            base = it;
+        }
+        return *base;
+    }
+
+private:
+    std::mutex mutex_;
+    std::deque<std::pair<Clock::time_point, Sample>> samples_;
+};
+
+}  // namespace metrics
+
+/**
+ * @brief 直方图的合并结果，可以是累计值，也可以是某个时间窗口内的增量
+ */
+struct HistogramSnapshot {
+    std::vector<uint64_t> buckets;   // 长度为 metrics::kBucketCount，累计快照为空时也可能为空
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    double seconds = 0;              // 窗口实际覆盖的时长
+
+    /**
+     * @brief 分位数，q 取 0~1，例如 0.99；在桶内按线性插值估算
+     */
+    double percentile(double q) const;
+
+    double mean() const {
+        return count > 0 ? static_cast<double>(sum) / count : 0;
+    }
+
+    // 每秒记录数
+    double rate() const {
+        return seconds > 0 ? count / seconds : 0;
+    }
+
+    void subtract(const HistogramSnapshot& base);
+};
+
+/**
+ * @brief 对数线性直方图，记录延迟(纳秒)或大小(字节)等非负整数
+ * @details 每个分片是一组原子计数，在线程第一次写入时分配；
+ *          record 无锁，读取(snapshot/window)合并所有分片
+ */
+class Histogram {
+public:
+    Histogram();
+    ~Histogram();
+
+    Histogram(const Histogram&) = delete;
+    Histogram& operator=(const Histogram&) = delete;
+
+    void record(uint64_t value) {
+        Shard* shard = shards_[metrics::localShard()].load(std::memory_order_acquire);
+        if (shard == nullptr) {
+            shard = createShard(metrics::localShard());
+        }
+        shard->buckets[metrics::bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        shard->sum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    void recordDuration(metrics::Clock::duration duration) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+        record(ns > 0 ? static_cast<uint64_t>(ns) : 0);
+    }
+
+    // 创建以来的累计分布
+    HistogramSnapshot snapshot() const;
+
+    // 最近 span 内的分布，span 不超过 metrics::kRetention
+    HistogramSnapshot window(std::chrono::seconds span) {
+        return window(span, metrics::Clock::now());
+    }
+    HistogramSnapshot window(std::chrono::seconds span, metrics::Clock::time_point now);
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> buckets[metrics::kBucketCount] = {};
+        std::atomic<uint64_t> sum{0};
+    };
+
+    // 窗口快照只保存非空桶
+    struct Sample {
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        std::vector<std::pair<uint16_t, uint64_t>> buckets;
+    };
+
+    Shard* createShard(size_t index);
+
+    std::atomic<Shard*> shards_[metrics::kShards];
+    metrics::SampleHistory<Sample> history_;
+};
+
+/**
+ * @brief 分片计数器
+ */
+class Counter {
+public:
+    Counter();
+
+    Counter(const Counter&) = delete;
+    Counter& operator=(const Counter&) = delete;
+
+    void add(uint64_t n = 1) {
+        shards_[metrics::localShard()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const;
+
+    struct Window {
+        uint64_t delta = 0;
+        double seconds = 0;
+        double rate() const { return seconds > 0 ? delta / seconds : 0; }
+    };
+
+    // 最近 span 内的增量
+    Window window(std::chrono::seconds span) {
+        return window(span, metrics::Clock::now());
+    }
+    Window window(std::chrono::seconds span, metrics::Clock::time_point now);
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value{0};
+    };
+
+    Shard shards_[metrics::kShards];
+    metrics::SampleHistory<uint64_t> history_;
+};
+
+/**
+ * @brief 按错误码分类的错误计数，计数器在某个错误码第一次出现时创建
+ */
+class ErrorCounters {
+public:
+    ErrorCounters();
+    ~ErrorCounters();
+
+    ErrorCounters(const ErrorCounters&) = delete;
+    ErrorCounters& operator=(const ErrorCounters&) = delete;
+
+    void add(ErrorCode code) {
+        size_t slot = slotOf(code);
+        Counter* counter = counters_[slot].load(std::memory_order_acquire);
+        if (counter == nullptr) {
+            counter = createCounter(slot);
+        }
+        counter->add();
+    }
+
+    // 已出现过的错误码及其计数器
+    std::vector<std::pair<ErrorCode, Counter*>> counters() const;
+
+    uint64_t total() const;
+
+private:
+    // 错误码按千位分类，UNKNOWN_ERROR(9999) 落在最后一个槽
+    static constexpr size_t kSlots = 10;
+
+    static size_t slotOf(ErrorCode code) {
+        size_t slot = static_cast<size_t>(code) / 1000;
+        return slot < kSlots ? slot : kSlots - 1;
+    }
+
+    Counter* createCounter(size_t slot);
+
+    std::atomic<Counter*> counters_[kSlots];
+};
+
+/**
+ * @brief 一个 rpc 方法在服务端或客户端的指标
+ */
+struct MethodStats {
+    Histogram latency_ns;       // 服务端：开始处理到 done 回调；客户端：CallMethod 端到端
+    Histogram queue_wait_ns;    // 服务端：读完请求到工作线程开始处理
+    Histogram request_bytes;
+    Histogram response_bytes;
+    ErrorCounters errors;
+    std::atomic<int64_t> inflight{0};   // 客户端：进行中的调用数，max_concurrency 按它限制
+};
+
+/**
+ * @brief 最近的慢请求，耗时超过阈值的请求进入固定容量的环形记录
+ */
+class SlowRequestLog {
+public:
+    struct Entry {
+        std::chrono::system_clock::time_point time;   // 请求完成时间
+        std::string method;                           // Service.Method
+        uint64_t latency_ns = 0;
+        uint64_t queue_wait_ns = 0;
+        uint64_t request_bytes = 0;
+        uint64_t response_bytes = 0;
+    };
+
+    explicit SlowRequestLog(size_t capacity = 64)
+        : capacity_(capacity > 0 ? capacity : 1), threshold_ns_(100 * 1000 * 1000) {}
+
+    void setThreshold(std::chrono::milliseconds threshold) {
+        threshold_ns_.store(static_cast<uint64_t>(threshold.count()) * 1000 * 1000,
+                            std::memory_order_relaxed);
+    }
+
+    // 热路径上只做这一次比较，慢请求才加锁
+    bool isSlow(uint64_t latency_ns) const {
+        return latency_ns >= threshold_ns_.load(std::memory_order_relaxed);
+    }
+
+    void record(Entry entry);
+
+    // 最新的在前
+    std::vector<Entry> recent() const;
+
+private:
+    const size_t capacity_;
+    std::atomic<uint64_t> threshold_ns_;
+    mutable std::mutex mutex_;
+    std::deque<Entry> entries_;
+};
+
+/**
+ * @brief 对象池的累计计数和当前状态
+ */
+struct PoolSample {
+    uint64_t acquired = 0;
+    uint64_t hits = 0;          // 复用池中对象的获取
+    uint64_t misses = 0;        // 新建对象或失败的获取
+    uint64_t rejected = 0;      // 池满且等待超时(或不等待)而失败的获取
+    uint64_t idle = 0;          // 以下为当前值
+    uint64_t active = 0;
+    uint64_t max_size = 0;
+};
+
+/**
+ * @brief 一个对象池的指标
+ * @details 计数沿用池自己的统计(线程缓存上的计数，不在获取路径上重复计数)，
+ *          读取时通过 sampler 取累计值，再减去窗口起点的快照得到窗口内的速率；
+ *          池满时的等待时间由池直接记入 acquire_wait_ns
+ */
+class PoolMetrics {
+public:
+    using Sampler = std::function<PoolSample()>;
+
+    explicit PoolMetrics(Sampler sampler);
+
+    PoolMetrics(const PoolMetrics&) = delete;
+    PoolMetrics& operator=(const PoolMetrics&) = delete;
+
+    Histogram acquire_wait_ns;   // 带超时的 acquire 在池满时等待的时间，含等待后失败的
+
+    PoolSample current() const;
+
+    struct Window {
+        PoolSample delta;        // 计数为窗口内增量，idle/active/max_size 为当前值
+        double seconds = 0;
+
+        double rate(uint64_t count) const {
+            return seconds > 0 ? count / seconds : 0;
+        }
+
+        // 窗口内复用对象的比例，没有获取时为1
+        double hitRate() const {
+            uint64_t total = delta.hits + delta.misses;
+            return total > 0 ? static_cast<double>(delta.hits) / total : 1.0;
+        }
+
+        // 当前在用对象占上限的比例
+        double usage() const {
+            return delta.max_size > 0 ? static_cast<double>(delta.active) / delta.max_size : 0;
+        }
+    };
+
+    Window window(std::chrono::seconds span) {
+        return window(span, metrics::Clock::now());
+    }
+    Window window(std::chrono::seconds span, metrics::Clock::time_point now);
+
+    /**
+     * @brief 断开与池的联系，之后 current() 返回最后一次读到的值
+     * @details 池析构时调用；会等待正在进行的读取结束
+     */
+    void detach();
+
+private:
+    mutable std::mutex samplerMutex_;
+    Sampler sampler_;
+    mutable PoolSample last_;
+    metrics::SampleHistory<PoolSample> history_;
+};
+
+/**
+ * @brief 指标注册表，按 (服务端/客户端, "Service.Method") 保存方法指标
+ * @details 返回的引用在进程生命周期内有效，调用方可以缓存
+ */
+class MetricsRegistry {
+public:
+    enum Side { kServer, kClient };
+
+    static MetricsRegistry& getInstance();
+
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    MethodStats& method(Side side, const std::string& service, const std::string& method);
+
+    // 无法归属到已注册方法的服务端错误，如请求头解析失败、方法不存在
+    ErrorCounters& serverErrors() {
+        return serverErrors_;
+    }
+
+    SlowRequestLog& slowRequests() {
+        return slowRequests_;
+    }
+
+    /**
+     * @brief 按名称顺序遍历所有方法指标
+     */
+    void forEachMethod(
+        const std::function<void(Side, const std::string&, MethodStats&)>& visitor);
+
+    /**
+     * @brief 注册对象池，同名的旧池被替换
+     * @details 池析构时应调用 removePool()；之后已取得的 shared_ptr 仍然可用
+     */
+    std::shared_ptr<PoolMetrics> addPool(const std::string& name, PoolMetrics::Sampler sampler);
+
+    // 只有 name 仍对应 metrics 时才移除，并 detach 它
+    void removePool(const std::string& name, const std::shared_ptr<PoolMetrics>& metrics);
+
+    /**
+     * @brief 按名称顺序遍历所有对象池
+     */
+    void forEachPool(const std::function<void(const std::string&, PoolMetrics&)>& visitor);
+
+    /**
+     * @brief Prometheus 文本格式：分位数取最近 window 内的分布，_sum/_count 和错误数为累计值
+     */
+    void writePrometheus(std::ostream& out, std::chrono::seconds window);
+
+    /**
+     * @brief 可读的方法指标表，所有数值取最近 window 内
+     */
+    void writeText(std::ostream& out, std::chrono::seconds window);
+
+private:
+    MetricsRegistry() = default;
+    ~MetricsRegistry() = default;
+
+    std::mutex mutex_;
+    std::map<std::pair<Side, std::string>, std::unique_ptr<MethodStats>> methods_;
+    std::map<std::string, std::shared_ptr<PoolMetrics>> pools_;
+    ErrorCounters serverErrors_;
+    SlowRequestLog slowRequests_;
+};
+
+}  // namespace prpc
+
+#endif // PRPC_METRICS_H
@@ -2,7 +2,7 @@
 #define OBJECT_POOL_H
 
 #include <memory>
-#include <queue>
+#include <deque>
 #include <mutex>
 #include <condition_variable>
 #include <functional>
@@ -11,11 +11,18 @@
 #include <vector>
 #include <unordered_set>
 #include <thread>
+#include <algorithm>
+
+#include "metrics.h"
+#include "pool_reclaimer.h"
+#include "profiler.h"
 
 namespace prpc {
 
 /**
  * @brief 线程安全的通用对象池
+ * @details 每个线程持有两个弹匣(magazine)的本地缓存，大多数获取/归还在本地完成；
+ *          弹匣满或空时才与共享仓库(depot)成批交换，仓库操作需要加锁
  * @tparam T 对象类型
  */
 template<typename T>
@@ -34,6 +41,11 @@ public:
         size_t max_idle_time_ms = 300000;  // 最大空闲时间(5分钟)
         bool enable_validation = true;     // 启用对象验证
         bool enable_statistics = true;     // 启用统计信息
+        size_t magazine_size = 16;         // 线程缓存弹匣容量，0表示关闭(不超过 max_size/8)
+        bool auto_tune = false;            // 按观测到的需求和命中率自动调整大小
+        size_t auto_tune_min = 8;          // 自动调优时 max_size 的下限
+        size_t auto_tune_max = 4096;       // 自动调优时 max_size 的上限
+        size_t auto_tune_interval_ms = 1000; // 自动调优周期
     };
     
     /**
@@ -129,218 +141,665 @@ public:
     /**
      * @brief 构造对象池
      * @param factory 对象工厂函数
-     * @param reset 对象重置函数(可选)
+     * @param reset 对象重置函数(可选)，复用的对象被取出时调用
      * @param config 配置参数
+     * @param on_return 归还时调用(可选)，在放入线程缓存或仓库之前、不持有锁；
+     *        用于释放对象在使用中多占的资源，使其在空闲期间不被保留
      */
-    ObjectPool(FactoryFunc factory, ResetFunc reset = nullptr, const Config& config = Config{})
+    ObjectPool(FactoryFunc factory, ResetFunc reset = nullptr, const Config& config = Config{},
+               ResetFunc on_return = nullptr)
         : factory_(std::move(factory))
         , reset_(std::move(reset))
+        , on_return_(std::move(on_return))
         , config_(config)
-        , shutdown_(false) {
-        
+        , magazine_size_(std::min(config.magazine_size, config.max_size / 8))
+        , uid_(nextPoolId())
+        , depot_(std::make_shared<Depot>())
+        , epoch_(0)
+        , waiters_(0)
+        , shutdown_(false)
+        , reclaim_id_(0)
+        , tune_id_(0) {
+        depot_->stats = &stats_;
+
         // 预创建初始对象
         for (size_t i = 0; i < config_.initial_size; ++i) {
-            auto obj = createObject();
+            auto obj = createObject(nullptr);
             if (obj) {
-                available_.push({std::move(obj), std::chrono::steady_clock::now()});
-                stats_.current_size.fetch_add(1);
+                ++depot_->live;
+                pushToDepot(std::move(obj));
             }
         }
-        
-        // 启动清理线程
-        if (config_.max_idle_time_ms > 0) {
-            cleanup_thread_ = std::thread(&ObjectPool::cleanupLoop, this);
-        }
+
+        // 在共享回收调度器上注册空闲清理和自动调优
+        auto guard = profiledLock(tune_mutex_, "object_pool.tune");
+        updateReclaimTasksLocked();
     }
-    
+
     /**
      * @brief 析构函数
      */
     ~ObjectPool() {
         shutdown();
+
+        // 此时不应再有线程使用该池，可以直接回收各线程缓存中的对象
+        auto lock = profiledLock(depot_->mutex, "object_pool.depot");
+        depot_->stats = nullptr;
+        for (auto& cache : depot_->caches) {
+            cache->loaded.clear();
+            cache->previous.clear();
+            cache->cached.store(0, std::memory_order_relaxed);
+        }
+        depot_->caches.clear();
     }
-    
+
     /**
      * @brief 获取对象
+     * @details 优先从当前线程的弹匣缓存中取，不写任何共享内存；
+     *          弹匣为空时才加锁从仓库批量补充
      * @param timeout_ms 超时时间(毫秒)，0表示不等待
      * @return RAII对象包装器
      */
     PooledObject acquire(uint32_t timeout_ms = 0) {
-        std::unique_lock<std::mutex> lock(mutex_);
-        
-        // 尝试从池中获取
-        if (!available_.empty()) {
-            auto item = std::move(available_.front());
-            available_.pop();
-            lock.unlock();
-            
-            auto obj = std::move(item.first);
-            if (reset_ && obj) {
-                reset_(obj.get());
-            }
-            
-            stats_.total_acquired.fetch_add(1);
-            stats_.cache_hits.fetch_add(1);
-            stats_.active_objects.fetch_add(1);
-            stats_.current_size.fetch_sub(1);
-            
-            return PooledObject(std::move(obj), this);
+        LocalCache* cache = magazine_size_ > 0 ? localCache() : nullptr;
+        ObjectPtr obj;
+        if (cache) {
+            syncEpoch(cache);
+            obj = popLocal(cache);
         }
-        
-        // 池为空，检查是否可以创建新对象
-        if (stats_.current_size.load() + stats_.active_objects.load() >= config_.max_size) {
-            if (timeout_ms == 0) {
-                lock.unlock();
-                stats_.cache_misses.fetch_add(1);
-                return PooledObject(nullptr, this);
-            }
-            
-            // 等待对象归还
-            auto deadline = std::chrono::steady_clock::now() + 
-                           std::chrono::milliseconds(timeout_ms);
-            
-            if (condition_.wait_until(lock, deadline, [this] { return !available_.empty() || shutdown_; })) {
-                if (!available_.empty()) {
-                    auto item = std::move(available_.front());
-                    available_.pop();
-                    lock.unlock();
-                    
-                    auto obj = std::move(item.first);
-                    if (reset_ && obj) {
-                        reset_(obj.get());
-                    }
-                    
-                    stats_.total_acquired.fetch_add(1);
-                    stats_.cache_hits.fetch_add(1);
-                    stats_.active_objects.fetch_add(1);
-                    stats_.current_size.fetch_sub(1);
-                    
-                    return PooledObject(std::move(obj), this);
-                }
-            }
-            
-            lock.unlock();
-            stats_.cache_misses.fetch_add(1);
+
+        bool reused = true;
+        if (!obj) {
+            obj = acquireSlow(cache, timeout_ms, reused);
+        }
+
+        if (!obj) {
+            count(cache, &LocalCache::misses, &Statistics::cache_misses);
             return PooledObject(nullptr, this);
         }
-        
-        lock.unlock();
-        
-        // 创建新对象
-        auto obj = createObject();
-        if (obj) {
-            stats_.total_acquired.fetch_add(1);
-            stats_.cache_misses.fetch_add(1);
-            stats_.active_objects.fetch_add(1);
+
+        if (reused && reset_) {
+            reset_(obj.get());
+        }
+        count(cache, &LocalCache::acquired, &Statistics::total_acquired);
+        if (reused) {
+            count(cache, &LocalCache::hits, &Statistics::cache_hits);
+        } else {
+            count(cache, &LocalCache::misses, &Statistics::cache_misses);
         }
-        
         return PooledObject(std::move(obj), this);
     }
-    
+
     /**
      * @brief 获取统计信息
+     * @details 汇总共享计数与各线程缓存的计数；current_size 包含线程缓存中的空闲对象
      */
     Statistics getStatistics() const {
-        return stats_;
+        auto lock = profiledLock(depot_->mutex, "object_pool.depot");
+        Statistics result(stats_);
+
+        uint64_t current_epoch = epoch_.load(std::memory_order_relaxed);
+        size_t idle = depot_->idle;
+        size_t parked = depot_->idle;
+        for (const auto& cache : depot_->caches) {
+            result.total_created.fetch_add(cache->created.load(std::memory_order_relaxed));
+            result.total_acquired.fetch_add(cache->acquired.load(std::memory_order_relaxed));
+            result.total_returned.fetch_add(cache->returned.load(std::memory_order_relaxed));
+            result.total_destroyed.fetch_add(cache->destroyed.load(std::memory_order_relaxed));
+            result.cache_hits.fetch_add(cache->hits.load(std::memory_order_relaxed));
+            result.cache_misses.fetch_add(cache->misses.load(std::memory_order_relaxed));
+
+            size_t cached = cache->cached.load(std::memory_order_relaxed);
+            parked += cached;
+            // clear() 之后尚未清理的线程缓存不再算作池中对象
+            if (cache->epoch.load(std::memory_order_relaxed) == current_epoch) {
+                idle += cached;
+            }
+        }
+        result.current_size.store(idle);
+        result.active_objects.store(depot_->live > parked ? depot_->live - parked : 0);
+        return result;
     }
-    
+
     /**
      * @brief 清空对象池
+     * @details 仓库中的对象立即销毁；各线程缓存在其下次访问时丢弃
      */
     void clear() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        while (!available_.empty()) {
-            available_.pop();
-            stats_.total_destroyed.fetch_add(1);
+        auto lock = profiledLock(depot_->mutex, "object_pool.depot");
+        for (auto& magazine : depot_->magazines) {
+            destroyLocked(magazine.objects.size(), nullptr);
         }
-        stats_.current_size.store(0);
+        depot_->magazines.clear();
+        depot_->idle = 0;
+        epoch_.fetch_add(1, std::memory_order_relaxed);
     }
-    
+
     /**
      * @brief 获取当前池大小
      */
     size_t size() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return available_.size();
+        return getStatistics().current_size.load();
     }
-    
+
     /**
      * @brief 检查池是否为空
      */
     bool empty() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return available_.empty();
+        return size() == 0;
     }
-    
+
     /**
      * @brief 关闭对象池
      */
     void shutdown() {
         {
-            std::lock_guard<std::mutex> lock(mutex_);
+            auto lock = profiledLock(depot_->mutex, "object_pool.depot");
             shutdown_ = true;
+            depot_->shutdown = true;
         }
-        condition_.notify_all();
-        
-        if (cleanup_thread_.joinable()) {
-            cleanup_thread_.join();
+        depot_->condition.notify_all();
+
+        {
+            auto guard = profiledLock(tune_mutex_, "object_pool.tune");
+            for (uint64_t* id : {&reclaim_id_, &tune_id_}) {
+                if (*id != 0) {
+                    PoolReclaimer::getInstance().remove(*id);
+                    *id = 0;
+                }
+            }
+            if (metrics_) {
+                MetricsRegistry::getInstance().removePool(metrics_name_, metrics_);
+                metrics_wait_.store(nullptr);
+                metrics_.reset();
+            }
         }
-        
+
         clear();
     }
 
+    /**
+     * @brief 以 name 注册到 MetricsRegistry，导出窗口内的命中率、获取速率和等待时间
+     * @details 再次调用会换成新名字；池关闭时自动注销
+     */
+    void exportMetrics(const std::string& name) {
+        auto guard = profiledLock(tune_mutex_, "object_pool.tune");
+        if (shutdown_) {
+            return;
+        }
+        if (metrics_) {
+            MetricsRegistry::getInstance().removePool(metrics_name_, metrics_);
+        }
+        metrics_name_ = name;
+        metrics_ = MetricsRegistry::getInstance().addPool(name, [this] { return metricsSample(); });
+        metrics_wait_.store(&metrics_->acquire_wait_ns);
+    }
+
+    /**
+     * @brief 运行时调整池配置
+     * @details 生效的字段为 max_size、max_idle_time_ms 和自动调优相关字段；
+     *          initial_size、magazine_size 和 enable_validation 只在构造时使用。
+     *          缩小 max_size 时立即从仓库最冷的一端销毁超出的空闲对象
+     */
+    void reconfigure(const Config& config) {
+        auto guard = profiledLock(tune_mutex_, "object_pool.tune");
+        if (shutdown_) {
+            return;
+        }
+        std::vector<ObjectPtr> excess;
+        {
+            auto lock = profiledLock(depot_->mutex, "object_pool.depot");
+            config_.max_size = config.max_size;
+            config_.max_idle_time_ms = config.max_idle_time_ms;
+            config_.auto_tune = config.auto_tune;
+            config_.auto_tune_min = config.auto_tune_min;
+            config_.auto_tune_max = config.auto_tune_max;
+            config_.auto_tune_interval_ms = config.auto_tune_interval_ms;
+            if (depot_->live > config_.max_size) {
+                shrinkIdleLocked(depot_->live - config_.max_size, excess);
+            }
+        }
+        depot_->condition.notify_all();
+        updateReclaimTasksLocked();
+    }
+
+    /**
+     * @brief 获取当前配置(包含自动调优后的 max_size)
+     */
+    Config getConfig() const {
+        auto lock = profiledLock(depot_->mutex, "object_pool.depot");
+        return config_;
+    }
+
 private:
+    /**
+     * @brief 弹匣：一批空闲对象
+     */
+    struct Magazine {
+        std::vector<ObjectPtr> objects;
+        std::chrono::steady_clock::time_point last_used;
+    };
+
+    struct Depot;
+
+    /**
+     * @brief 线程本地缓存
+     * @details 对象只由所属线程读写；计数器只由所属线程写入(relaxed store)，
+     *          汇总统计时由其他线程读取，因此热路径上没有原子读改写。
+     *          按缓存行对齐，避免相邻线程的缓存伪共享
+     */
+    struct alignas(64) LocalCache {
+        std::vector<ObjectPtr> loaded;     // 当前弹匣
+        std::vector<ObjectPtr> previous;   // 上一个弹匣，满或空
+        std::atomic<uint64_t> epoch{0};
+        std::atomic<size_t> cached{0};
+        std::atomic<bool> drain{false};    // 其他线程达到上限时置位，所属线程下次访问时把缓存交回仓库
+        std::atomic<uint64_t> created{0};
+        std::atomic<uint64_t> acquired{0};
+        std::atomic<uint64_t> returned{0};
+        std::atomic<uint64_t> destroyed{0};
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+        std::weak_ptr<Depot> depot;
+    };
+
+    /**
+     * @brief 共享仓库，各线程缓存与其成批交换弹匣
+     */
+    struct Depot {
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<Magazine> magazines;                  // 前端最冷，后端最热
+        std::vector<std::vector<ObjectPtr>> spares;      // 空弹匣，避免重复分配
+        size_t idle = 0;                                 // 仓库中的空闲对象数
+        size_t live = 0;                                 // 已创建且未销毁的对象数
+        size_t peak_demand = 0;                          // 本调优周期内仓库外对象数的峰值
+        uint64_t rejected = 0;                           // 因达到 max_size 而失败的获取次数
+        bool shutdown = false;
+        std::vector<std::shared_ptr<LocalCache>> caches;
+        Statistics* stats = nullptr;                     // 线程退出时并入的计数
+    };
+
+    /**
+     * @brief 线程退出时把缓存归还给仍然存在的池
+     */
+    struct ThreadCaches {
+        std::vector<std::pair<uint64_t, std::shared_ptr<LocalCache>>> entries;
+
+        ~ThreadCaches() {
+            for (auto& entry : entries) {
+                retireCache(entry.second);
+            }
+        }
+    };
+
+    static uint64_t nextPoolId() {
+        static std::atomic<uint64_t> next_id{1};
+        return next_id.fetch_add(1);
+    }
+
+    static ThreadCaches& threadCaches() {
+        static thread_local ThreadCaches caches;
+        return caches;
+    }
+
+    LocalCache* localCache() {
+        auto& entries = threadCaches().entries;
+        for (auto& entry : entries) {
+            if (entry.first == uid_) {
+                return entry.second.get();
+            }
+        }
+
+        // 首次访问：顺便丢弃已销毁池的缓存
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [](const auto& entry) { return entry.second->depot.expired(); }),
+                      entries.end());
+
+        auto cache = std::make_shared<LocalCache>();
+        cache->loaded.reserve(magazine_size_);
+        cache->previous.reserve(magazine_size_);
+        cache->depot = depot_;
+        cache->epoch.store(epoch_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        {
+            auto lock = profiledLock(depot_->mutex, "object_pool.depot");
+            depot_->caches.push_back(cache);
+        }
+        entries.emplace_back(uid_, cache);
+        return cache.get();
+    }
+
+    static void retireCache(const std::shared_ptr<LocalCache>& cache) {
+        auto depot = cache->depot.lock();
+        if (!depot) {
+            return;
+        }
+        auto lock = profiledLock(depot->mutex, "object_pool.depot");
+        auto it = std::find(depot->caches.begin(), depot->caches.end(), cache);
+        if (it == depot->caches.end()) {
+            return;
+        }
+        depot->caches.erase(it);
+
+        if (depot->stats) {
+            depot->stats->total_created.fetch_add(cache->created.load());
+            depot->stats->total_acquired.fetch_add(cache->acquired.load());
+            depot->stats->total_returned.fetch_add(cache->returned.load());
+            depot->stats->total_destroyed.fetch_add(cache->destroyed.load());
+            depot->stats->cache_hits.fetch_add(cache->hits.load());
+            depot->stats->cache_misses.fetch_add(cache->misses.load());
+        }
+
+        for (auto* objects : {&cache->loaded, &cache->previous}) {
+            if (objects->empty()) {
+                continue;
+            }
+            if (depot->shutdown) {
+                depot->live -= objects->size();
+                if (depot->stats) {
+                    depot->stats->total_destroyed.fetch_add(objects->size());
+                }
+                objects->clear();
+            } else {
+                depot->idle += objects->size();
+                depot->magazines.push_back({std::move(*objects), std::chrono::steady_clock::now()});
+            }
+        }
+        cache->cached.store(0, std::memory_order_relaxed);
+        depot->condition.notify_all();
+    }
+
+    /**
+     * @brief 单写者计数：有线程缓存时写本线程计数，否则写共享统计
+     */
+    void count(LocalCache* cache, std::atomic<uint64_t> LocalCache::*local,
+               std::atomic<uint64_t> Statistics::*shared, uint64_t n = 1) {
+        if (cache) {
+            auto& counter = cache->*local;
+            counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        } else {
+            (stats_.*shared).fetch_add(n);
+        }
+    }
+
+    void updateCached(LocalCache* cache) {
+        cache->cached.store(cache->loaded.size() + cache->previous.size(), std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief clear() 之后丢弃本线程缓存中的旧对象；被要求交回时把缓存放回仓库
+     */
+    void syncEpoch(LocalCache* cache) {
+        uint64_t current = epoch_.load(std::memory_order_relaxed);
+        if (cache->epoch.load(std::memory_order_relaxed) == current &&
+            !cache->drain.load(std::memory_order_relaxed)) {
+            return;
+        }
+        auto lock = profiledLock(depot_->mutex, "object_pool.depot");
+        cache->drain.store(false, std::memory_order_relaxed);
+        if (cache->epoch.load(std::memory_order_relaxed) != current) {
+            destroyLocked(cache->loaded.size() + cache->previous.size(), cache);
+            cache->epoch.store(current, std::memory_order_relaxed);
+        } else {
+            // 上限之外多创建的对象在这里销毁，其余交给仓库，唤醒等待者
+            for (auto* objects : {&cache->loaded, &cache->previous}) {
+                for (auto& obj : *objects) {
+                    if (depot_->live > config_.max_size) {
+                        destroyLocked(1, cache);
+                    } else {
+                        pushToDepot(std::move(obj));
+                    }
+                }
+            }
+            depot_->condition.notify_all();
+        }
+        cache->loaded.clear();
+        cache->previous.clear();
+        updateCached(cache);
+    }
+
+    /**
+     * @brief 是否达到 max_size
+     * @details 其他线程缓存中的空闲对象不计入：它们随时可以交回，不应让获取失败。
+     *          缓存计数由各线程单独写入，这里读到的是近似值
+     * @note 调用者持有 depot_->mutex
+     */
+    bool atCapacityLocked() const {
+        if (depot_->live < config_.max_size) {
+            return false;
+        }
+        size_t cached = 0;
+        for (const auto& cache : depot_->caches) {
+            cached += cache->cached.load(std::memory_order_relaxed);
+        }
+        return depot_->live - std::min(cached, depot_->live) >= config_.max_size;
+    }
+
+    /**
+     * @brief 要求持有空闲对象的线程缓存在下次访问时交回仓库
+     * @note 调用者持有 depot_->mutex
+     */
+    void requestDrainLocked() {
+        for (const auto& cache : depot_->caches) {
+            if (cache->cached.load(std::memory_order_relaxed) > 0) {
+                cache->drain.store(true, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    ObjectPtr popLocal(LocalCache* cache) {
+        if (cache->loaded.empty()) {
+            if (cache->previous.empty()) {
+                return nullptr;
+            }
+            std::swap(cache->loaded, cache->previous);
+        }
+        ObjectPtr obj = std::move(cache->loaded.back());
+        cache->loaded.pop_back();
+        updateCached(cache);
+        return obj;
+    }
+
+    bool pushLocal(LocalCache* cache, ObjectPtr& obj) {
+        if (cache->loaded.size() >= magazine_size_) {
+            if (!cache->previous.empty()) {
+                return false;
+            }
+            std::swap(cache->loaded, cache->previous);
+        }
+        cache->loaded.push_back(std::move(obj));
+        updateCached(cache);
+        return true;
+    }
+
+    std::vector<ObjectPtr> takeSpareLocked() {
+        std::vector<ObjectPtr> spare;
+        if (!depot_->spares.empty()) {
+            spare = std::move(depot_->spares.back());
+            depot_->spares.pop_back();
+        }
+        spare.reserve(magazine_size_);
+        return spare;
+    }
+
+    /**
+     * @brief 从仓库最热的一端取对象，有线程缓存时一次补满一个弹匣
+     * @note 调用者持有 depot_->mutex
+     */
+    ObjectPtr takeFromDepotLocked(LocalCache* cache) {
+        if (depot_->magazines.empty()) {
+            return nullptr;
+        }
+        auto& objects = depot_->magazines.back().objects;
+        ObjectPtr obj = std::move(objects.back());
+        objects.pop_back();
+        --depot_->idle;
+
+        if (cache) {
+            while (!objects.empty() && cache->loaded.size() < magazine_size_) {
+                cache->loaded.push_back(std::move(objects.back()));
+                objects.pop_back();
+                --depot_->idle;
+            }
+            updateCached(cache);
+        }
+        if (objects.empty()) {
+            depot_->spares.push_back(std::move(objects));
+            depot_->magazines.pop_back();
+        }
+        return obj;
+    }
+
+    ObjectPtr acquireSlow(LocalCache* cache, uint32_t timeout_ms, bool& reused) {
+        auto lock = profiledLock(depot_->mutex, "object_pool.depot");
+        ObjectPtr obj = takeFromDepotLocked(cache);
+        if (obj) {
+            depot_->peak_demand = std::max(depot_->peak_demand, depot_->live - depot_->idle);
+            return obj;
+        }
+
+        // 超出上限的对象由线程缓存交回仓库时销毁，live 随之回到 max_size 以内
+        if (depot_->live >= config_.max_size) {
+            requestDrainLocked();
+        }
+
+        // 池已满：正在使用的对象达到上限
+        if (atCapacityLocked()) {
+            if (timeout_ms == 0) {
+                ++depot_->rejected;
+                return nullptr;
+            }
+
+            // 有等待者时，归还的对象直接进入仓库而不是线程缓存
+            waiters_.fetch_add(1);
+            auto wait_start = std::chrono::steady_clock::now();
+            auto deadline = wait_start + std::chrono::milliseconds(timeout_ms);
+            depot_->condition.wait_until(lock, deadline, [this] {
+                return depot_->idle > 0 || !atCapacityLocked() || depot_->shutdown;
+            });
+            waiters_.fetch_sub(1);
+            if (Histogram* wait = metrics_wait_.load(std::memory_order_acquire)) {
+                wait->recordDuration(std::chrono::steady_clock::now() - wait_start);
+            }
+
+            obj = takeFromDepotLocked(cache);
+            if (obj || atCapacityLocked()) {
+                if (!obj) {
+                    ++depot_->rejected;
+                }
+                return obj;
+            }
+        }
+
+        ++depot_->live;
+        depot_->peak_demand = std::max(depot_->peak_demand, depot_->live - depot_->idle);
+        lock.unlock();
+
+        reused = false;
+        obj = createObject(cache);
+        if (!obj) {
+            lock.lock();
+            --depot_->live;
+        }
+        return obj;
+    }
+
+    /**
+     * @brief 把单个对象放回仓库最热的弹匣
+     * @note 调用者持有 depot_->mutex (构造期间除外)
+     */
+    void pushToDepot(ObjectPtr obj) {
+        size_t chunk = std::max<size_t>(magazine_size_, 16);
+        if (depot_->magazines.empty() || depot_->magazines.back().objects.size() >= chunk) {
+            depot_->magazines.push_back({takeSpareLocked(), {}});
+        }
+        auto& magazine = depot_->magazines.back();
+        magazine.objects.push_back(std::move(obj));
+        magazine.last_used = std::chrono::steady_clock::now();
+        ++depot_->idle;
+    }
+
+    /**
+     * @brief 记录销毁的对象
+     * @note 调用者持有 depot_->mutex
+     */
+    void destroyLocked(size_t n, LocalCache* cache) {
+        depot_->live -= n;
+        count(cache, &LocalCache::destroyed, &Statistics::total_destroyed, n);
+    }
+
     /**
      * @brief 归还对象到池中
+     * @details 先放入当前线程的弹匣；两个弹匣都满时，把满弹匣整体交给仓库
      */
     void returnObject(ObjectPtr obj) {
         if (!obj) return;
-        
-        std::lock_guard<std::mutex> lock(mutex_);
-        
-        if (shutdown_) {
-            stats_.total_destroyed.fetch_add(1);
-            stats_.active_objects.fetch_sub(1);
-            return;
+        if (on_return_) {
+            on_return_(obj.get());
         }
-        
-        // 验证对象(如果启用)
-        if (config_.enable_validation && !validateObject(obj.get())) {
-            stats_.total_destroyed.fetch_add(1);
-            stats_.active_objects.fetch_sub(1);
-            return;
+
+        LocalCache* cache = nullptr;
+        if (magazine_size_ > 0 && waiters_.load(std::memory_order_relaxed) == 0 && !shutdown_) {
+            cache = localCache();
+            syncEpoch(cache);
+            // 验证对象(如果启用)
+            if (!config_.enable_validation || validateObject(obj.get())) {
+                if (pushLocal(cache, obj)) {
+                    count(cache, &LocalCache::returned, &Statistics::total_returned);
+                    return;
+                }
+            }
         }
-        
-        // 检查池大小限制
-        if (available_.size() >= config_.max_size) {
-            stats_.total_destroyed.fetch_add(1);
-            stats_.active_objects.fetch_sub(1);
+
+        auto lock = profiledLock(depot_->mutex, "object_pool.depot");
+
+        if (depot_->shutdown || (obj && config_.enable_validation && !validateObject(obj.get()))) {
+            destroyLocked(1, cache);
             return;
         }
-        
-        available_.push({std::move(obj), std::chrono::steady_clock::now()});
-        stats_.total_returned.fetch_add(1);
-        stats_.active_objects.fetch_sub(1);
-        stats_.current_size.fetch_add(1);
-        
-        condition_.notify_one();
+
+        if (cache) {
+            // 满弹匣交给仓库，超出上限的部分直接销毁
+            if (depot_->idle + cache->previous.size() <= config_.max_size) {
+                depot_->idle += cache->previous.size();
+                depot_->magazines.push_back({std::move(cache->previous), std::chrono::steady_clock::now()});
+            } else {
+                destroyLocked(cache->previous.size(), cache);
+                cache->previous.clear();
+                depot_->spares.push_back(std::move(cache->previous));
+            }
+            cache->previous = std::move(cache->loaded);
+            cache->loaded = takeSpareLocked();
+            cache->loaded.push_back(std::move(obj));
+            updateCached(cache);
+        } else {
+            // 检查池大小限制；线程缓存交回前多创建的对象在这里销毁
+            if (depot_->idle >= config_.max_size || depot_->live > config_.max_size) {
+                destroyLocked(1, cache);
+                return;
+            }
+            pushToDepot(std::move(obj));
+        }
+        count(cache, &LocalCache::returned, &Statistics::total_returned);
+
+        depot_->condition.notify_one();
     }
-    
+
     /**
      * @brief 创建新对象
      */
-    ObjectPtr createObject() {
+    ObjectPtr createObject(LocalCache* cache) {
         try {
             auto obj = factory_();
             if (obj) {
-                stats_.total_created.fetch_add(1);
+                count(cache, &LocalCache::created, &Statistics::total_created);
             }
             return obj;
         } catch (...) {
             return nullptr;
         }
     }
-    
+
     /**
      * @brief 验证对象有效性
      */
@@ -348,54 +807,201 @@ private:
         // 默认验证：检查对象是否为空
         return obj != nullptr;
     }
-    
+
     /**
-     * @brief 清理循环
+     * @brief 增量清理空闲对象，由 PoolReclaimer 调用
+     * @details 仓库按最近使用时间排列，只需从最冷的一端检查。仓库锁被占用时
+     *          不等待，稍后重试；每次最多摘下 kTrimBatch 个弹匣，对象在锁外析构，
+     *          因此不会长时间阻塞获取者。线程缓存不参与
+     * @return 距下一次清理的延迟
      */
-    void cleanupLoop() {
-        while (!shutdown_) {
-            std::this_thread::sleep_for(std::chrono::seconds(30)); // 每30秒清理一次
-            
-            std::lock_guard<std::mutex> lock(mutex_);
-            if (shutdown_) break;
-            
-            auto now = std::chrono::steady_clock::now();
+    std::chrono::milliseconds trimIdle() {
+        const size_t kTrimBatch = 4;
+        const auto kRetryDelay = std::chrono::milliseconds(10);
+
+        std::vector<Magazine> expired;
+        std::chrono::milliseconds next;
+        {
+            std::unique_lock<std::mutex> lock(depot_->mutex, std::try_to_lock);
+            if (!lock.owns_lock()) {
+                return kRetryDelay;
+            }
             auto max_idle = std::chrono::milliseconds(config_.max_idle_time_ms);
-            
-            // 清理过期对象
-            std::queue<std::pair<ObjectPtr, std::chrono::steady_clock::time_point>> temp;
-            
-            while (!available_.empty()) {
-                auto& item = available_.front();
-                if (now - item.second > max_idle) {
-                    available_.pop();
-                    stats_.total_destroyed.fetch_add(1);
-                    stats_.current_size.fetch_sub(1);
-                } else {
-                    temp.push(std::move(item));
-                    available_.pop();
+            if (max_idle.count() == 0) {
+                // 清理刚被 reconfigure() 关闭，任务即将注销
+                return std::chrono::seconds(1);
+            }
+            next = max_idle;
+            auto now = std::chrono::steady_clock::now();
+            while (!depot_->magazines.empty() && now - depot_->magazines.front().last_used > max_idle) {
+                if (expired.size() == kTrimBatch) {
+                    next = kRetryDelay;
+                    break;
                 }
+                auto& magazine = depot_->magazines.front();
+                depot_->idle -= magazine.objects.size();
+                destroyLocked(magazine.objects.size(), nullptr);
+                expired.push_back(std::move(magazine));
+                depot_->magazines.pop_front();
+            }
+            if (next != kRetryDelay && !depot_->magazines.empty()) {
+                // 下一次恰好在最冷的弹匣过期时运行
+                auto until = depot_->magazines.front().last_used + max_idle - now;
+                next = std::max(kRetryDelay,
+                                std::chrono::duration_cast<std::chrono::milliseconds>(until) +
+                                std::chrono::milliseconds(1));
+            }
+        }
+        return next;
+    }
+
+    /**
+     * @brief 从仓库最冷的一端摘下最多 count 个空闲对象，由调用者在锁外析构
+     * @note 调用者持有 depot_->mutex
+     */
+    void shrinkIdleLocked(size_t count, std::vector<ObjectPtr>& out) {
+        size_t removed = 0;
+        while (removed < count && !depot_->magazines.empty()) {
+            auto& objects = depot_->magazines.front().objects;
+            while (removed < count && !objects.empty()) {
+                out.push_back(std::move(objects.back()));
+                objects.pop_back();
+                ++removed;
+            }
+            if (objects.empty()) {
+                depot_->spares.push_back(std::move(objects));
+                depot_->magazines.pop_front();
             }
-            
-            available_ = std::move(temp);
         }
+        depot_->idle -= removed;
+        destroyLocked(removed, nullptr);
+    }
+
+    /**
+     * @brief 按当前配置注册或注销回收任务
+     * @note 调用者持有 tune_mutex_
+     */
+    void updateReclaimTasksLocked() {
+        size_t idle_ms, interval_ms;
+        bool tune;
+        {
+            auto lock = profiledLock(depot_->mutex, "object_pool.depot");
+            idle_ms = config_.max_idle_time_ms;
+            tune = config_.auto_tune;
+            interval_ms = std::max<size_t>(config_.auto_tune_interval_ms, 1);
+        }
+        auto& reclaimer = PoolReclaimer::getInstance();
+        if (idle_ms > 0 && reclaim_id_ == 0) {
+            reclaim_id_ = reclaimer.add([this]() { return trimIdle(); },
+                                        std::chrono::milliseconds(idle_ms));
+        } else if (idle_ms == 0 && reclaim_id_ != 0) {
+            reclaimer.remove(reclaim_id_);
+            reclaim_id_ = 0;
+        }
+        if (tune && tune_id_ == 0) {
+            tune_id_ = reclaimer.add([this]() { return tuneSize(); },
+                                     std::chrono::milliseconds(interval_ms));
+        } else if (!tune && tune_id_ != 0) {
+            reclaimer.remove(tune_id_);
+            tune_id_ = 0;
+        }
+    }
+
+    /**
+     * @brief 自动调优，由 PoolReclaimer 周期调用
+     * @details 每个周期观察仓库外对象数的峰值(需求)、命中率和因上限失败的次数：
+     *          - 有获取因上限失败时 max_size 翻倍，直到 auto_tune_max；
+     *          - 需求长期低于 max_size 的一半时 max_size 减半，不低于 auto_tune_min；
+     *          - 保留的对象数收缩到需求加余量，命中率低于95%时余量加倍
+     * @return 距下一次调优的延迟
+     */
+    std::chrono::milliseconds tuneSize() {
+        std::vector<ObjectPtr> excess;
+        auto lock = profiledLock(depot_->mutex, "object_pool.depot");
+        auto interval = std::chrono::milliseconds(std::max<size_t>(config_.auto_tune_interval_ms, 1));
+        if (!config_.auto_tune) {
+            return interval;
+        }
+
+        uint64_t acquired = stats_.total_acquired.load();
+        uint64_t misses = stats_.cache_misses.load();
+        for (const auto& cache : depot_->caches) {
+            acquired += cache->acquired.load(std::memory_order_relaxed);
+            misses += cache->misses.load(std::memory_order_relaxed);
+        }
+        uint64_t acquired_delta = acquired - tune_state_.acquired;
+        uint64_t misses_delta = misses - tune_state_.misses;
+        uint64_t rejected_delta = depot_->rejected - tune_state_.rejected;
+        tune_state_.acquired = acquired;
+        tune_state_.misses = misses;
+        tune_state_.rejected = depot_->rejected;
+
+        size_t outstanding = depot_->live - depot_->idle;
+        size_t demand = std::max(depot_->peak_demand, outstanding);
+        depot_->peak_demand = outstanding;
+
+        if (rejected_delta > 0) {
+            config_.max_size = std::min(config_.auto_tune_max, std::max<size_t>(config_.max_size * 2, 1));
+            depot_->condition.notify_all();
+        } else if (demand * 2 < config_.max_size) {
+            config_.max_size = std::max(config_.auto_tune_min, config_.max_size / 2);
+        }
+
+        bool missing = acquired_delta > 0 && misses_delta * 20 > acquired_delta;
+        size_t target = demand + (missing ? demand / 2 : demand / 4) + 1;
+        target = std::min(target, config_.max_size);
+        if (depot_->live > target) {
+            shrinkIdleLocked(depot_->live - target, excess);
+        }
+        return interval;
     }
 
 private:
+    PoolSample metricsSample() const {
+        Statistics stats = getStatistics();
+        PoolSample sample;
+        sample.acquired = stats.total_acquired.load();
+        sample.hits = stats.cache_hits.load();
+        sample.misses = stats.cache_misses.load();
+        sample.idle = stats.current_size.load();
+        sample.active = stats.active_objects.load();
+        auto lock = profiledLock(depot_->mutex, "object_pool.depot");
+        sample.rejected = depot_->rejected;
+        sample.max_size = config_.max_size;
+        return sample;
+    }
+
     FactoryFunc factory_;
     ResetFunc reset_;
+    ResetFunc on_return_;
     Config config_;
-    
-    mutable std::mutex mutex_;
-    std::condition_variable condition_;
-    std::queue<std::pair<ObjectPtr, std::chrono::steady_clock::time_point>> available_;
-    
+    size_t magazine_size_;   // 0 表示不使用线程缓存
+    uint64_t uid_;           // 进程内唯一，不随地址复用
+
+    std::shared_ptr<Depot> depot_;
+    std::atomic<uint64_t> epoch_;   // clear() 时递增
+    std::atomic<int> waiters_;
+
     std::atomic<bool> shutdown_;
-    std::thread cleanup_thread_;
-    
+    uint64_t reclaim_id_;    // PoolReclaimer 任务编号，0 表示未注册
+    uint64_t tune_id_;
+    std::mutex tune_mutex_;  // 串行化任务注册的变更
+
+    // exportMetrics() 注册的指标，由 tune_mutex_ 保护；获取路径只读 metrics_wait_
+    std::string metrics_name_;
+    std::shared_ptr<PoolMetrics> metrics_;
+    std::atomic<Histogram*> metrics_wait_{nullptr};
+
+    // 自动调优上一周期的累计值
+    struct TuneState {
+        uint64_t acquired = 0;
+        uint64_t misses = 0;
+        uint64_t rejected = 0;
+    } tune_state_;
+
     mutable Statistics stats_;
 };
 
 } // namespace prpc
 
-#endif // OBJECT_POOL_H 
\ No newline at end of file
+#endif // OBJECT_POOL_H
@@ -1,130 +1,150 @@
 #ifndef POOL_MONITOR_H
 #define POOL_MONITOR_H
 
-#include "object_pool.h"
+#include "logger.h"
 #include "message_pool.h"
-#include <memory>
-#include <thread>
-#include <atomic>
+#include "metrics.h"
+#include "pool_reclaimer.h"
+#include <algorithm>
 #include <chrono>
-#include <fstream>
-#include <sstream>
+#include <cstdint>
 #include <iomanip>
-#include <iostream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
 
 namespace prpc {
 
 /**
  * @brief 对象池监控器
+ * @details 读取 MetricsRegistry 中注册的所有对象池(exportMetrics())，
+ *          报告和健康检查都基于最近一个时间窗口内的速率，而不是启动以来的累计值。
+ *          本身没有线程：报告按需生成，告警检查作为任务运行在共享的 PoolReclaimer 线程上
  */
 class PoolMonitor {
 public:
     struct MonitorConfig {
-        uint32_t report_interval_seconds;       // 报告间隔(秒)
-        bool enable_file_logging;               // 启用文件日志
-        bool enable_console_output;             // 启用控制台输出
-        std::string log_file_path;
-        bool enable_alerts;                     // 启用告警
-        double high_usage_threshold;            // 高使用率阈值
-        double low_hit_rate_threshold;          // 低命中率阈值
-        
-        MonitorConfig() 
-            : report_interval_seconds(60)
-            , enable_file_logging(true)
-            , enable_console_output(false)
-            , log_file_path("pool_monitor.log")
+        uint32_t window_seconds;                // 速率、命中率和告警的统计窗口(秒)，不超过 300
+        uint32_t check_interval_seconds;        // 告警检查间隔(秒)
+        bool enable_alerts;                     // 启用告警日志
+        double high_usage_threshold;            // 在用对象占上限的比例
+        double low_hit_rate_threshold;          // 窗口内命中率
+        uint64_t min_acquires;                  // 窗口内获取次数少于它时不检查命中率
+        double wait_p99_threshold_ms;           // 窗口内池满等待时间的 p99
+
+        MonitorConfig()
+            : window_seconds(60)
+            , check_interval_seconds(10)
             , enable_alerts(true)
             , high_usage_threshold(0.8)
-            , low_hit_rate_threshold(0.5) {}
+            , low_hit_rate_threshold(0.5)
+            , min_acquires(100)
+            , wait_p99_threshold_ms(10) {}
     };
-    
+
     static PoolMonitor& getInstance() {
         static PoolMonitor instance;
         return instance;
     }
-    
+
     /**
-     * @brief 启动监控
+     * @brief 应用配置并开始周期性告警检查
      */
     void start(const MonitorConfig& config = MonitorConfig{}) {
-        if (running_.load()) {
-            return;
-        }
-        
+        std::lock_guard<std::mutex> lock(mutex_);
         config_ = config;
-        running_.store(true);
-        
-        monitor_thread_ = std::thread(&PoolMonitor::monitorLoop, this);
+        if (task_id_ == 0 && config_.enable_alerts) {
+            auto interval = checkInterval();
+            task_id_ = PoolReclaimer::getInstance().add([this] {
+                checkAndSendAlerts();
+                std::lock_guard<std::mutex> lock(mutex_);
+                return checkInterval();
+            }, interval);
+        }
     }
-    
+
     /**
-     * @brief 停止监控
+     * @brief 停止告警检查
      */
     void stop() {
-        running_.store(false);
-        if (monitor_thread_.joinable()) {
-            monitor_thread_.join();
+        uint64_t id;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            id = task_id_;
+            task_id_ = 0;
+        }
+        if (id != 0) {
+            PoolReclaimer::getInstance().remove(id);
         }
     }
-    
+
+    MonitorConfig getConfig() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return config_;
+    }
+
+    /**
+     * @brief 一个池在窗口内的状态
+     */
+    struct PoolReport {
+        std::string name;
+        PoolMetrics::Window window;
+        HistogramSnapshot acquire_wait;     // 窗口内池满等待时间(纳秒)
+    };
+
+    /**
+     * @brief 所有已注册池在最近窗口内的状态，按名称排序
+     */
+    std::vector<PoolReport> collect() const {
+        std::chrono::seconds span(getConfig().window_seconds);
+        std::vector<PoolReport> reports;
+        MetricsRegistry::getInstance().forEachPool([&](const std::string& name, PoolMetrics& pool) {
+            reports.push_back({name, pool.window(span), pool.acquire_wait_ns.window(span)});
+        });
+        return reports;
+    }
+
     /**
      * @brief 生成即时报告
      */
     std::string generateReport() const {
-        auto& msg_pool = MessagePool::getInstance();
-        auto msg_stats = msg_pool.getMessageStats();
-        auto buf_stats = msg_pool.getBufferStats();
-        
+        MonitorConfig config = getConfig();
+        auto reports = collect();
+
         std::ostringstream oss;
-        auto now = std::chrono::system_clock::now();
-        auto time_t = std::chrono::system_clock::to_time_t(now);
-        
-        oss << "=== Pool Monitor Report ===\n";
-        oss << "Timestamp: " << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S") << "\n\n";
-        
-        // 消息池统计
-        oss << "Message Pool:\n";
-        oss << "  Total Created: " << msg_stats.total_created.load() << "\n";
-        oss << "  Total Acquired: " << msg_stats.total_acquired.load() << "\n";
-        oss << "  Total Returned: " << msg_stats.total_returned.load() << "\n";
-        oss << "  Current Size: " << msg_stats.current_size.load() << "\n";
-        oss << "  Active Objects: " << msg_stats.active_objects.load() << "\n";
-        
-        auto msg_total = msg_stats.cache_hits.load() + msg_stats.cache_misses.load();
-        if (msg_total > 0) {
-            double hit_rate = (double)msg_stats.cache_hits.load() / msg_total;
-            oss << "  Hit Rate: " << std::fixed << std::setprecision(2) << (hit_rate * 100) << "%\n";
+        oss << "object pools, last " << config.window_seconds << "s\n";
+        oss << std::left << std::setw(14) << "pool" << std::right
+            << std::setw(8) << "idle" << std::setw(8) << "active" << std::setw(8) << "max"
+            << std::setw(12) << "acquire/s" << std::setw(10) << "create/s"
+            << std::setw(10) << "hit_rate" << std::setw(10) << "rejected"
+            << std::setw(12) << "wait_p50ms" << std::setw(12) << "wait_p99ms" << "\n";
+        oss << std::fixed;
+        for (const auto& report : reports) {
+            const PoolMetrics::Window& window = report.window;
+            oss << std::left << std::setw(14) << report.name << std::right
+                << std::setw(8) << window.delta.idle
+                << std::setw(8) << window.delta.active
+                << std::setw(8) << window.delta.max_size
+                << std::setprecision(1)
+                << std::setw(12) << window.rate(window.delta.acquired)
+                << std::setw(10) << window.rate(created(window))
+                << std::setw(9) << window.hitRate() * 100 << "%"
+                << std::setw(10) << window.delta.rejected
+                << std::setprecision(3)
+                << std::setw(12) << report.acquire_wait.percentile(0.5) / 1e6
+                << std::setw(12) << report.acquire_wait.percentile(0.99) / 1e6 << "\n";
         }
-        
-        // 缓冲区池统计
-        oss << "\nBuffer Pool:\n";
-        oss << "  Total Created: " << buf_stats.total_created.load() << "\n";
-        oss << "  Total Acquired: " << buf_stats.total_acquired.load() << "\n";
-        oss << "  Total Returned: " << buf_stats.total_returned.load() << "\n";
-        oss << "  Current Size: " << buf_stats.current_size.load() << "\n";
-        oss << "  Active Objects: " << buf_stats.active_objects.load() << "\n";
-        
-        auto buf_total = buf_stats.cache_hits.load() + buf_stats.cache_misses.load();
-        if (buf_total > 0) {
-            double hit_rate = (double)buf_stats.cache_hits.load() / buf_total;
-            oss << "  Hit Rate: " << std::fixed << std::setprecision(2) << (hit_rate * 100) << "%\n";
-        }
-        
-        // 健康状态检查
-        oss << "\nHealth Status:\n";
-        auto health = checkHealth();
-        oss << "  Overall Status: " << (health.is_healthy ? "HEALTHY" : "WARNING") << "\n";
-        
-        if (!health.warnings.empty()) {
-            oss << "  Warnings:\n";
-            for (const auto& warning : health.warnings) {
-                oss << "    - " << warning << "\n";
-            }
+
+        auto health = evaluate(config, reports);
+        oss << "\nstatus: " << (health.is_healthy ? "HEALTHY" : "WARNING") << "\n";
+        for (const auto& warning : health.warnings) {
+            oss << "  - " << warning << "\n";
         }
-        
         return oss.str();
     }
-    
+
     /**
      * @brief 健康状态结构
      */
@@ -132,171 +152,141 @@ public:
         bool is_healthy = true;
         std::vector<std::string> warnings;
     };
-    
+
     /**
-     * @brief 检查池健康状态
+     * @brief 按最近窗口检查池健康状态
      */
     HealthStatus checkHealth() const {
-        HealthStatus health;
-        auto& msg_pool = MessagePool::getInstance();
-        auto msg_stats = msg_pool.getMessageStats();
-        auto buf_stats = msg_pool.getBufferStats();
-        
-        // 检查消息池使用率
-        auto msg_total_capacity = msg_stats.current_size.load() + msg_stats.active_objects.load();
-        if (msg_total_capacity > 0) {
-            double msg_usage = (double)msg_stats.active_objects.load() / msg_total_capacity;
-            if (msg_usage > config_.high_usage_threshold) {
-                health.is_healthy = false;
-                health.warnings.push_back("Message pool high usage: " + 
-                    std::to_string(int(msg_usage * 100)) + "%");
-            }
-        }
-        
-        // 检查缓冲区池使用率
-        auto buf_total_capacity = buf_stats.current_size.load() + buf_stats.active_objects.load();
-        if (buf_total_capacity > 0) {
-            double buf_usage = (double)buf_stats.active_objects.load() / buf_total_capacity;
-            if (buf_usage > config_.high_usage_threshold) {
-                health.is_healthy = false;
-                health.warnings.push_back("Buffer pool high usage: " + 
-                    std::to_string(int(buf_usage * 100)) + "%");
-            }
-        }
-        
-        // 检查命中率
-        auto msg_total = msg_stats.cache_hits.load() + msg_stats.cache_misses.load();
-        if (msg_total > 100) { // 至少有100次操作才检查命中率
-            double hit_rate = (double)msg_stats.cache_hits.load() / msg_total;
-            if (hit_rate < config_.low_hit_rate_threshold) {
-                health.is_healthy = false;
-                health.warnings.push_back("Message pool low hit rate: " + 
-                    std::to_string(int(hit_rate * 100)) + "%");
-            }
-        }
-        
-        auto buf_total = buf_stats.cache_hits.load() + buf_stats.cache_misses.load();
-        if (buf_total > 100) {
-            double hit_rate = (double)buf_stats.cache_hits.load() / buf_total;
-            if (hit_rate < config_.low_hit_rate_threshold) {
-                health.is_healthy = false;
-                health.warnings.push_back("Buffer pool low hit rate: " + 
-                    std::to_string(int(hit_rate * 100)) + "%");
-            }
-        }
-        
-        return health;
+        return evaluate(getConfig(), collect());
     }
-    
+
     /**
-     * @brief 获取性能指标
+     * @brief 获取性能指标(最近窗口内)
      */
     struct PerformanceMetrics {
-        double message_pool_efficiency;    // 消息池效率
-        double buffer_pool_efficiency;     // 缓冲区池效率
-        uint64_t total_operations;         // 总操作数
-        double operations_per_second;      // 每秒操作数
+        double message_pool_efficiency;    // 消息池命中率
+        double buffer_pool_efficiency;     // 各缓冲区池合计的命中率
+        uint64_t total_operations;         // 获取次数
+        double operations_per_second;      // 每秒获取次数
     };
-    
+
     PerformanceMetrics getPerformanceMetrics() const {
-        auto& msg_pool = MessagePool::getInstance();
-        auto msg_stats = msg_pool.getMessageStats();
-        auto buf_stats = msg_pool.getBufferStats();
-        
-        PerformanceMetrics metrics;
-        
-        // 计算效率(命中率)
-        auto msg_total = msg_stats.cache_hits.load() + msg_stats.cache_misses.load();
-        metrics.message_pool_efficiency = msg_total > 0 ? 
-            (double)msg_stats.cache_hits.load() / msg_total : 0.0;
-        
-        auto buf_total = buf_stats.cache_hits.load() + buf_stats.cache_misses.load();
-        metrics.buffer_pool_efficiency = buf_total > 0 ? 
-            (double)buf_stats.cache_hits.load() / buf_total : 0.0;
-        
-        metrics.total_operations = msg_total + buf_total;
-        
-        // 计算每秒操作数(基于启动时间)
-        auto now = std::chrono::steady_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - start_time_);
-        metrics.operations_per_second = duration.count() > 0 ? 
-            (double)metrics.total_operations / duration.count() : 0.0;
-        
+        PerformanceMetrics metrics{1.0, 1.0, 0, 0.0};
+        uint64_t buffer_hits = 0;
+        uint64_t buffer_total = 0;
+        double seconds = 0;
+        for (const auto& report : collect()) {
+            const PoolMetrics::Window& window = report.window;
+            if (report.name == "message") {
+                metrics.message_pool_efficiency = window.hitRate();
+            } else if (report.name.compare(0, 7, "buffer_") == 0) {
+                buffer_hits += window.delta.hits;
+                buffer_total += window.delta.hits + window.delta.misses;
+            }
+            metrics.total_operations += window.delta.acquired;
+            seconds = std::max(seconds, window.seconds);
+        }
+        if (buffer_total > 0) {
+            metrics.buffer_pool_efficiency = static_cast<double>(buffer_hits) / buffer_total;
+        }
+        metrics.operations_per_second = seconds > 0 ? metrics.total_operations / seconds : 0.0;
         return metrics;
     }
 
+    /**
+     * @brief 检查一次并输出告警
+     * @details 只在告警出现和消失时写日志，持续存在的告警不会每个周期重复
+     */
+    void checkAndSendAlerts() {
+        MonitorConfig config = getConfig();
+        std::vector<std::string> keys;
+        auto health = evaluate(config, collect(), &keys);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::set<std::string> firing(keys.begin(), keys.end());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (!firing_.count(keys[i])) {
+                LOG(WARN) << "[POOL ALERT] " << health.warnings[i];
+            }
+        }
+        for (const auto& key : firing_) {
+            if (!firing.count(key)) {
+                LOG(INFO) << "[POOL ALERT] resolved: " << key;
+            }
+        }
+        firing_.swap(firing);
+    }
+
 private:
-    PoolMonitor() : running_(false), start_time_(std::chrono::steady_clock::now()) {}
-    
+    // 先构造回收调度器，保证它在监控器之后析构
+    PoolMonitor() : task_id_(0) {
+        PoolReclaimer::getInstance();
+    }
+
     ~PoolMonitor() {
         stop();
     }
-    
+
     // 禁用拷贝和移动
     PoolMonitor(const PoolMonitor&) = delete;
     PoolMonitor& operator=(const PoolMonitor&) = delete;
-    
-    /**
-     * @brief 监控循环
-     */
-    void monitorLoop() {
-        while (running_.load()) {
-            try {
-                auto report = generateReport();
-                
-                // 输出到控制台
-                if (config_.enable_console_output) {
-                    std::cout << report << std::endl;
-                }
-                
-                // 写入文件
-                if (config_.enable_file_logging) {
-                    writeToFile(report);
-                }
-                
-                // 检查告警
-                if (config_.enable_alerts) {
-                    checkAndSendAlerts();
-                }
-                
-            } catch (const std::exception& e) {
-                std::cerr << "Pool monitor error: " << e.what() << std::endl;
-            }
-            
-            // 等待下一个报告间隔
-            std::this_thread::sleep_for(std::chrono::seconds(config_.report_interval_seconds));
-        }
+
+    // 窗口内新建的对象数：未命中中除去失败的获取
+    static uint64_t created(const PoolMetrics::Window& window) {
+        const PoolSample& delta = window.delta;
+        return delta.misses > delta.rejected ? delta.misses - delta.rejected : 0;
     }
-    
-    /**
-     * @brief 写入文件
-     */
-    void writeToFile(const std::string& report) {
-        std::ofstream file(config_.log_file_path, std::ios::app);
-        if (file.is_open()) {
-            file << report << "\n" << std::string(50, '=') << "\n\n";
-            file.close();
-        }
+
+    // 调用者持有 mutex_
+    std::chrono::milliseconds checkInterval() const {
+        return std::chrono::seconds(std::max<uint32_t>(config_.check_interval_seconds, 1));
     }
-    
+
     /**
-     * @brief 检查并发送告警
+     * @brief 按窗口内的数据计算健康状态
+     * @param keys 非空时为每条告警填入稳定的标识(池名:类型)，用于判断告警的出现和消失
      */
-    void checkAndSendAlerts() {
-        auto health = checkHealth();
-        if (!health.is_healthy) {
-            for (const auto& warning : health.warnings) {
-                std::cerr << "[POOL ALERT] " << warning << std::endl;
-                // 这里可以集成更复杂的告警系统，如发送邮件、Slack通知等
+    static HealthStatus evaluate(const MonitorConfig& config, const std::vector<PoolReport>& reports,
+                                 std::vector<std::string>* keys = nullptr) {
+        HealthStatus health;
+        auto warn = [&](const std::string& name, const char* kind, const std::string& message) {
+            health.is_healthy = false;
+            health.warnings.push_back(name + " pool " + message);
+            if (keys) {
+                keys->push_back(name + ":" + kind);
+            }
+        };
+        for (const auto& report : reports) {
+            const PoolMetrics::Window& window = report.window;
+            if (window.usage() > config.high_usage_threshold) {
+                warn(report.name, "usage", "high usage: " +
+                     std::to_string(static_cast<int>(window.usage() * 100)) + "%");
+            }
+            uint64_t lookups = window.delta.hits + window.delta.misses;
+            if (lookups >= config.min_acquires && window.hitRate() < config.low_hit_rate_threshold) {
+                warn(report.name, "hit_rate", "low hit rate: " +
+                     std::to_string(static_cast<int>(window.hitRate() * 100)) + "% over " +
+                     std::to_string(lookups) + " acquires");
+            }
+            if (window.delta.rejected > 0) {
+                warn(report.name, "rejected", "rejected " + std::to_string(window.delta.rejected) +
+                     " acquires on a full pool");
+            }
+            double wait_p99_ms = report.acquire_wait.percentile(0.99) / 1e6;
+            if (report.acquire_wait.count > 0 && wait_p99_ms > config.wait_p99_threshold_ms) {
+                std::ostringstream message;
+                message << "slow acquire: p99 wait " << std::fixed << std::setprecision(1)
+                        << wait_p99_ms << "ms";
+                warn(report.name, "wait", message.str());
             }
         }
+        return health;
     }
 
-private:
-    std::atomic<bool> running_;
-    std::thread monitor_thread_;
+    mutable std::mutex mutex_;
     MonitorConfig config_;
-    std::chrono::steady_clock::time_point start_time_;
+    uint64_t task_id_;                  // PoolReclaimer 任务编号，0 表示未启动
+    std::set<std::string> firing_;      // 上次检查时的告警
 };
 
 /**
@@ -322,4 +312,4 @@ inline std::string getPoolReport() {
 
 } // namespace prpc
 
-#endif // POOL_MONITOR_H 
\ No newline at end of file
+#endif // POOL_MONITOR_H
@@ -0,0 +1,146 @@
+#ifndef POOL_RECLAIMER_H
+#define POOL_RECLAIMER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace prpc {
+
+/**
+ * @brief 所有对象池共享的回收调度器
+ * @details 单个后台线程按各任务返回的延迟调度回收任务。等待可被新任务和
+ *          关闭立即打断，因此不会因为长周期的睡眠拖慢池的析构
+ */
+class PoolReclaimer {
+public:
+    /**
+     * @brief 回收任务，返回距下一次运行的延迟
+     */
+    using Task = std::function<std::chrono::milliseconds()>;
+
+    static PoolReclaimer& getInstance() {
+        static PoolReclaimer instance;
+        return instance;
+    }
+
+    /**
+     * @brief 注册回收任务
+     * @param task 回收任务
+     * @param first_delay 首次运行前的延迟
+     * @return 任务编号，用于 remove()
+     */
+    uint64_t add(Task task, std::chrono::milliseconds first_delay) {
+        uint64_t id;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            id = next_id_++;
+            tasks_[id] = {std::move(task), Clock::now() + first_delay};
+            if (!worker_.joinable()) {
+                worker_ = std::thread(&PoolReclaimer::run, this);
+            }
+        }
+        condition_.notify_one();
+        return id;
+    }
+
+    /**
+     * @brief 注销回收任务
+     * @details 返回后任务不会再运行；若任务正在运行则等待其结束
+     */
+    void remove(uint64_t id) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        tasks_.erase(id);
+        if (std::this_thread::get_id() == worker_.get_id()) {
+            return;
+        }
+        finished_.wait(lock, [this, id] { return running_id_ != id; });
+    }
+
+    /**
+     * @brief 当前注册的任务数
+     */
+    size_t taskCount() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return tasks_.size();
+    }
+
+    // 禁用拷贝和移动
+    PoolReclaimer(const PoolReclaimer&) = delete;
+    PoolReclaimer& operator=(const PoolReclaimer&) = delete;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        Task task;
+        Clock::time_point next_run;
+    };
+
+    PoolReclaimer() : next_id_(1), running_id_(0), shutdown_(false) {}
+
+    ~PoolReclaimer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            shutdown_ = true;
+        }
+        condition_.notify_all();
+        if (worker_.joinable()) {
+            worker_.join();
+        }
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!shutdown_) {
+            auto due = tasks_.end();
+            for (auto it = tasks_.begin(); it != tasks_.end(); ++it) {
+                if (due == tasks_.end() || it->second.next_run < due->second.next_run) {
+                    due = it;
+                }
+            }
+            if (due == tasks_.end()) {
+                condition_.wait(lock);
+                continue;
+            }
+            if (due->second.next_run > Clock::now()) {
+                // 按值等待：等待期间任务可能被 remove()
+                Clock::time_point next_run = due->second.next_run;
+                condition_.wait_until(lock, next_run);
+                continue;
+            }
+
+            // 在锁外运行任务，运行期间 remove() 会等待
+            uint64_t id = due->first;
+            Task task = due->second.task;
+            running_id_ = id;
+            lock.unlock();
+            std::chrono::milliseconds delay = task();
+            lock.lock();
+            running_id_ = 0;
+
+            auto it = tasks_.find(id);
+            if (it != tasks_.end()) {
+                it->second.next_run = Clock::now() + delay;
+            }
+            finished_.notify_all();
+        }
+    }
+
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    std::condition_variable finished_;
+    std::map<uint64_t, Entry> tasks_;
+    uint64_t next_id_;
+    uint64_t running_id_;
+    bool shutdown_;
+    std::thread worker_;
+};
+
+} // namespace prpc
+
+#endif // POOL_RECLAIMER_H
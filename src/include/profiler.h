@@ -0,0 +1,85 @@
+#ifndef PRPC_PROFILER_H
+#define PRPC_PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "error.h"
+
+namespace prpc {
+
+// 按需采集的性能剖析，结果为 folded stack 格式(每行 "根;...;叶 权重")，
+// 可直接交给 flamegraph.pl 或 speedscope。同一时间每种剖析只能有一个在运行。
+
+/**
+ * @brief CPU 采样剖析
+ * @details 用 ITIMER_PROF 按进程消耗的 CPU 时间发送 SIGPROF，信号处理函数只把
+ *          调用栈写入预先分配的缓冲区；采集结束后再符号化和聚合。
+ *          N 个线程都忙时每秒约产生 N * hz 个样本，缓冲区满后的样本被丢弃并计数。
+ */
+class CpuProfiler {
+public:
+    static constexpr int kMaxSeconds = 60;
+    static constexpr int kMaxHz = 1000;
+    static constexpr size_t kMaxSamples = 64 * 1024;
+
+    /**
+     * @brief 阻塞采集 duration 后返回 folded stack，权重为样本数
+     * @details 已有采集在运行、参数越界或无法安装信号处理函数时返回错误
+     */
+    static Result<std::string> collect(std::chrono::seconds duration, int hz);
+};
+
+/**
+ * @brief 锁竞争剖析
+ * @details 被 profiledLock() 保护的锁在 try_lock 失败时才计时，采集期间按
+ *          采样率记录等待者的调用栈，权重为等待的微秒数；叶子帧是锁的名字。
+ *          未采集时的额外开销只有一次 relaxed 原子读，且只发生在竞争路径上。
+ */
+class ContentionProfiler {
+public:
+    static constexpr int kMaxSeconds = 60;
+    static constexpr size_t kMaxStacks = 8192;     // 超出后新调用栈归入 [other]
+
+    /**
+     * @brief 阻塞采集 duration 后返回 folded stack
+     * @param sampleRate 记录的竞争事件比例，0~1
+     */
+    static Result<std::string> collect(std::chrono::seconds duration, double sampleRate);
+
+    static bool active() {
+        return active_.load(std::memory_order_relaxed);
+    }
+
+    // 由 profiledLock() 在竞争路径上调用
+    static void record(const char* lockName, std::chrono::steady_clock::duration wait);
+
+private:
+    static std::atomic<bool> active_;
+};
+
+/**
+ * @brief 加锁并在发生竞争时报告给 ContentionProfiler
+ * @details 返回 unique_lock，可以直接配合 condition_variable 使用。
+ *          lockName 必须是字符串字面量
+ */
+inline std::unique_lock<std::mutex> profiledLock(std::mutex& mutex, const char* lockName) {
+    std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        if (ContentionProfiler::active()) {
+            auto start = std::chrono::steady_clock::now();
+            lock.lock();
+            ContentionProfiler::record(lockName, std::chrono::steady_clock::now() - start);
+        } else {
+            lock.lock();
+        }
+    }
+    return lock;
+}
+
+} // namespace prpc
+
+#endif // PRPC_PROFILER_H
@@ -3,14 +3,42 @@
 
 #include <google/protobuf/service.h>
 
-#include "zookeeperutil.h"
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
 
+#include "conf.h"
+#include "controller.h"
+#include "message_pool.h"
+#include "metrics.h"
+#include "registry.h"
+#include "trace.h"
+
+class FiberScheduler;
+class StatusServer;
 class ThreadPool;
 
+// Everything the request path needs for one method, resolved when the
+// service is registered so that a request costs the two name lookups below.
+struct MethodInfo {
+  const google::protobuf::MethodDescriptor* m_descriptor;
+  // Server-side latency, size and error metrics, owned by MetricsRegistry.
+  prpc::MethodStats* m_stats;
+  // Request and response size histograms, owned by MessagePool. They pick
+  // the size class of the pooled buffers frames are read into and encoded in.
+  prpc::MessagePool::PayloadHistogram* m_requestSizes;
+  prpc::MessagePool::PayloadHistogram* m_responseSizes;
+  // [service] / [service.method] sections of the config file.
+  MethodProfile m_profile;
+  // Used when a request arrives without an explicit priority.
+  RpcPriority m_priority;
+};
+
 struct ServiceInfo {
   google::protobuf::Service* m_service;
-  std::unordered_map<std::string, const google::protobuf::MethodDescriptor*>
-      m_methodMap;
+  std::unordered_map<std::string, MethodInfo> m_methodMap;
 };
 
 class Pprovider {
@@ -19,17 +47,75 @@ class Pprovider {
   ~Pprovider();
 
   void NotifyService(google::protobuf::Service* servuce);
+  // Default priority class for requests to this method that do not carry one.
+  // Overrides the priority from the method's config section.
+  void SetMethodPriority(const std::string& service_name,
+                         const std::string& method_name,
+                         RpcPriority priority);
+  // Serves until Stop(). Listens on rpcserverip:rpcserverport and publishes
+  // the services in the configured registry.
   void Run();
+  // Makes Run() return; callable from any thread, including before Run().
+  // Open connections are shut down and closed once their handlers finish.
+  void Stop();
 
  private:
+  // Workers pinned to the CPUs of one NUMA node (node -1 when unpinned).
+  struct WorkerGroup {
+    int node;
+    std::unique_ptr<ThreadPool> pool;
+  };
+
+  // Open client connection, shown on the status pages.
+  struct ConnectionInfo {
+    std::string peer;
+    int reactor_cpu;
+    std::chrono::system_clock::time_point accepted;
+  };
+
   void RegisterServices();
-  void OnZkSessionExpired();
-  void HandleClientRequest(int clientfd);
+  void OnRegistryExpired();
+  // pool is null under the fiber executor: the request is then handled
+  // inline on the fiber that read it. Connections are armed one-shot in the
+  // reactor's epollfd, so one frame is read at a time; the connection is
+  // re-armed once its frame has been read.
+  void HandleClientRequest(int clientfd, int epollfd, ThreadPool* pool);
+  void ProcessRequest(int clientfd, google::protobuf::Service* service,
+                      const MethodInfo* method,
+                      const prpc::TraceContext& caller,
+                      std::chrono::steady_clock::time_point enqueued,
+                      bool checksum,
+                      prpc::MessagePool::BufferPoolType::PooledObject args);
+  void CreateExecutor();
+  void CreateWorkerGroups();
+  void ApplyQueueWeights(const ConfigSnapshot &config);
+  void ApplyEdfMaxWait(const ConfigSnapshot &config);
+  ThreadPool *PoolForCpu(int cpu);
+  int CreateListenFd(const std::string &ip, uint16_t port, int incoming_cpu);
+  void EventLoop(int listenfd, int reactor_cpu);
+  void CloseConnection(int clientfd);
+  // rpcserver_status_port enables the HTTP status and metrics pages.
+  void StartStatusServer(const std::string &ip);
+  std::string ConnectionsPage();
+  std::string ThreadsPage();
+  std::string PoolsPage();
+  std::string ConfigPage();
+  std::string SlowRequestsPage();
+  std::string PrometheusPage();
 
   std::unordered_map<std::string, ServiceInfo>
       m_serviceMap;  // 保存服务对象和rpc方法
-  std::unique_ptr<ThreadPool> m_threadPool;
-  std::unique_ptr<ZkClient> m_zkClient;
+  std::vector<WorkerGroup> m_workerGroups;
+  std::unique_ptr<FiberScheduler> m_fiberScheduler;
+  std::unique_ptr<ServiceRegistry> m_registry;
+  int m_stopFd;  // eventfd, readable once Stop() was called
+  uint64_t m_maxRequestBytes;  // rpcserver_max_request_mb
+  std::unique_ptr<StatusServer> m_statusServer;
+  std::mutex m_connMutex;
+  std::map<int, ConnectionInfo> m_connections;
+  std::vector<int> m_epollFds;  // one per reactor, guarded by m_connMutex
+  // Pconfig::OnChange ids, removed before the worker groups are destroyed.
+  std::vector<uint64_t> m_configWatchers;
 };
 
 class LambdaClosure : public google::protobuf::Closure {
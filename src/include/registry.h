@@ -0,0 +1,71 @@
+#ifndef PRPC_REGISTRY_H
+#define PRPC_REGISTRY_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "zookeeperutil.h"
+
+// Where providers publish the "ip:port" serving each method and callers look
+// it up. The "registry" config key picks the implementation: zookeeper (the
+// default) or memory, a table inside the process for tests and benchmarks
+// that run the provider and the caller together.
+class ServiceRegistry {
+ public:
+  virtual ~ServiceRegistry() = default;
+
+  // session_expired_cb runs when the registrations were lost and have to be
+  // made again.
+  virtual void Start(std::function<void()> session_expired_cb = nullptr) = 0;
+  virtual void Register(const std::string &service, const std::string &method,
+                        const std::string &host) = 0;
+  // Empty when nothing serves the method.
+  virtual std::string Lookup(const std::string &service,
+                             const std::string &method) = 0;
+
+  // A new, not yet started registry of the configured kind.
+  static std::unique_ptr<ServiceRegistry> Create();
+  // The started registry callers share for lookups.
+  static ServiceRegistry &Default();
+};
+
+// Methods are ephemeral nodes /service/method holding "ip:port"; they go
+// away with the session.
+class ZkServiceRegistry : public ServiceRegistry {
+ public:
+  void Start(std::function<void()> session_expired_cb = nullptr) override;
+  void Register(const std::string &service, const std::string &method,
+                const std::string &host) override;
+  std::string Lookup(const std::string &service,
+                     const std::string &method) override;
+
+ private:
+  ZkClient m_zkClient;
+};
+
+// One table per process. Like the ephemeral nodes, a registry's entries are
+// removed when it is destroyed.
+class MemoryServiceRegistry : public ServiceRegistry {
+ public:
+  ~MemoryServiceRegistry() override;
+
+  void Start(std::function<void()> session_expired_cb = nullptr) override {}
+  void Register(const std::string &service, const std::string &method,
+                const std::string &host) override;
+  std::string Lookup(const std::string &service,
+                     const std::string &method) override;
+
+ private:
+  struct Entry {
+    std::string host;
+    const MemoryServiceRegistry *owner;
+  };
+
+  static std::mutex s_mutex;
+  static std::map<std::string, Entry> s_methods;  // "service/method"
+};
+
+#endif // PRPC_REGISTRY_H
@@ -0,0 +1,127 @@
+#ifndef PRPC_RPC_FRAME_H
+#define PRPC_RPC_FRAME_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <google/protobuf/message.h>
+
+#include "crc32c.h"
+
+namespace prpc {
+
+// 线路格式
+// 请求：4 字节 RpcHeader 长度，RpcHeader，然后是 args_size 字节的请求参数
+// 响应：4 字节长度，然后是响应消息
+// 长度按本机字节序。Pchannel 和 Pprovider 都通过这里编码，基准测试测的也是这段代码
+//
+// 校验(可选)：长度的最高位为 1 时帧末尾多 4 字节 CRC32C，覆盖从长度字段(含该位)到帧末尾
+// 的全部字节。请求是否携带由调用方配置(checksum=crc32c)；provider 只对携带校验的请求
+// 返回带校验的响应，未开启时帧中没有校验字段。
+//
+// 帧里没有版本或标志字段，而 protobuf 不序列化超过 2GB 的消息，长度的最高位原本恒为 0，
+// 借用它不用改变帧头大小。代价是长度只剩 31 位：单帧的 RpcHeader 或响应消息上限从 4GB
+// 减半为 kMaxFrameLength，编码时超过的直接拒绝，以免长度写进标志位。
+// 两端之间没有协商，客户端无法得知 provider 是否认识这一位：两端都必须运行这一版本，
+// 不能对旧的 provider 开启 checksum。旧 provider 把带标志的长度读成负数，不会按损坏的帧
+// 断开，而是在 reactor 中抛出未捕获的异常。
+
+constexpr size_t kFrameLengthSize = 4;
+constexpr uint32_t kFrameChecksumFlag = 0x80000000u;
+constexpr uint32_t kMaxFrameLength = ~kFrameChecksumFlag;   // 2GB - 1
+constexpr size_t kFrameChecksumSize = 4;
+// RpcHeader 只有服务名、方法名和几个整数，超过这个长度说明长度字段已损坏
+constexpr uint32_t kMaxHeaderSize = 64 * 1024;
+
+/**
+ * @brief 读取帧开头的长度
+ * @param data 至少 kFrameLengthSize 字节
+ * @param checksum 非空时写入帧末尾是否带 CRC32C
+ */
+inline uint32_t decodeFrameLength(const void* data, bool* checksum = nullptr) {
+    uint32_t length;
+    memcpy(&length, data, kFrameLengthSize);
+    if (checksum != nullptr) {
+        *checksum = (length & kFrameChecksumFlag) != 0;
+    }
+    return length & ~kFrameChecksumFlag;
+}
+
+/**
+ * @brief 读取帧末尾的 CRC32C
+ */
+inline uint32_t decodeFrameChecksum(const void* data) {
+    uint32_t crc;
+    memcpy(&crc, data, kFrameChecksumSize);
+    return crc;
+}
+
+// 对 out 中从 start 开始的整帧计算 CRC32C 并追加在末尾
+inline void appendFrameChecksum(std::string* out, size_t start) {
+    uint32_t crc = crc32c(out->data() + start, out->size() - start);
+    out->append(reinterpret_cast<const char*>(&crc), kFrameChecksumSize);
+}
+
+/**
+ * @brief 编码请求帧并追加到 out，只分配一次内存
+ * @param header Prpc::RpcHeader
+ * @param checksum 是否在帧末尾附带 CRC32C
+ * @return RpcHeader 序列化失败或超过 kMaxHeaderSize 时返回 false
+ */
+inline bool encodeRequestFrame(const google::protobuf::Message& header, const std::string& args,
+                               std::string* out, bool checksum = false) {
+    size_t header_size = header.ByteSizeLong();
+    // provider 会断开超过 kMaxHeaderSize 的请求；这也保证长度不会写进标志位
+    if (header_size > kMaxHeaderSize) {
+        return false;
+    }
+    size_t start = out->size();
+    out->reserve(start + kFrameLengthSize + header_size + args.size() +
+                 (checksum ? kFrameChecksumSize : 0));
+    uint32_t length = static_cast<uint32_t>(header_size) | (checksum ? kFrameChecksumFlag : 0);
+    out->append(reinterpret_cast<const char*>(&length), kFrameLengthSize);
+    if (!header.AppendToString(out)) {
+        out->resize(start);
+        return false;
+    }
+    out->append(args);
+    if (checksum) {
+        appendFrameChecksum(out, start);
+    }
+    return true;
+}
+
+/**
+ * @brief 编码响应帧并追加到 out，消息直接序列化到长度之后，只分配一次内存
+ * @tparam Buffer std::string 或 std::vector<uint8_t>(池化的 NetworkBuffer)
+ * @param checksum 是否在帧末尾附带 CRC32C，与请求一致
+ * @return 序列化失败或超过 kMaxFrameLength 时返回 false，out 不变
+ */
+template<typename Buffer>
+inline bool encodeResponseFrame(const google::protobuf::Message& response, Buffer* out,
+                                bool checksum = false) {
+    if (!response.IsInitialized()) {
+        return false;
+    }
+    size_t body_size = response.ByteSizeLong();
+    // 长度只有 31 位，最高位是校验标志
+    if (body_size > kMaxFrameLength) {
+        return false;
+    }
+    size_t start = out->size();
+    out->resize(start + kFrameLengthSize + body_size + (checksum ? kFrameChecksumSize : 0));
+    uint8_t* frame = reinterpret_cast<uint8_t*>(&(*out)[start]);
+    uint32_t length = static_cast<uint32_t>(body_size) | (checksum ? kFrameChecksumFlag : 0);
+    memcpy(frame, &length, kFrameLengthSize);
+    response.SerializeWithCachedSizesToArray(frame + kFrameLengthSize);
+    if (checksum) {
+        uint32_t crc = crc32c(frame, kFrameLengthSize + body_size);
+        memcpy(frame + kFrameLengthSize + body_size, &crc, kFrameChecksumSize);
+    }
+    return true;
+}
+
+} // namespace prpc
+
+#endif // PRPC_RPC_FRAME_H
@@ -0,0 +1,274 @@
+#ifndef SLAB_POOL_H
+#define SLAB_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace prpc {
+
+/**
+ * @brief 基于slab的定长对象池，以64位句柄引用对象
+ * @details 对象连续存放在按缓存行对齐的块(chunk)中，空闲槽位通过槽内存储的
+ *          下标串成空闲链表，不需要额外的节点分配。句柄由槽位下标(低32位)和
+ *          代数(generation，高32位)组成，对象销毁后旧句柄自动失效，适合异步
+ *          回调中持有连接、请求等上下文的引用。
+ *
+ *          代数用尽(回绕到0)的槽位不再回收，因此旧句柄永远不会与新对象的
+ *          句柄相同。32位代数下一个槽位要复用约21亿次才会被退役。
+ *
+ *          create()/destroy() 串行化；get() 无锁，可与其他句柄的创建和销毁
+ *          并发执行。同一句柄的 get() 与 destroy() 之间的先后由调用者保证。
+ * @tparam T 对象类型
+ * @tparam ChunkSlots 每块的槽位数
+ * @tparam Generation 每个槽位的代数类型，决定槽位退役前可复用的次数
+ */
+template<typename T, size_t ChunkSlots = 256, typename Generation = uint32_t>
+class SlabPool {
+public:
+    using Handle = uint64_t;
+
+    static_assert(std::is_unsigned<Generation>::value && sizeof(Generation) <= sizeof(uint32_t),
+                  "Generation must be an unsigned type of at most 32 bits");
+
+    static constexpr int kIndexBits = 32;
+    static constexpr Handle kIndexMask = (Handle(1) << kIndexBits) - 1;
+    static constexpr size_t kMaxObjects = size_t(1) << 20;
+    static constexpr size_t kCacheLine = 64;
+
+    // 代数为偶数的槽位是空闲的，0号句柄因此永远无效
+    static constexpr Handle kInvalidHandle = 0;
+
+    static_assert(ChunkSlots > 0 && kMaxObjects % ChunkSlots == 0,
+                  "ChunkSlots must divide the handle index space");
+
+    /**
+     * @brief 构造slab池
+     * @param max_objects 最大对象数，不超过 kMaxObjects；按块向上取整
+     */
+    explicit SlabPool(size_t max_objects = kMaxObjects)
+        : max_chunks_((std::min(max_objects, kMaxObjects) + ChunkSlots - 1) / ChunkSlots)
+        , chunks_(new std::atomic<Chunk*>[max_chunks_])
+        , chunk_count_(0)
+        , free_head_(kNoSlot)
+        , size_(0) {
+        for (size_t i = 0; i < max_chunks_; ++i) {
+            chunks_[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~SlabPool() {
+        for (size_t c = 0; c < chunk_count_; ++c) {
+            Chunk* chunk = chunks_[c].load(std::memory_order_relaxed);
+            for (size_t i = 0; i < ChunkSlots; ++i) {
+                Slot& slot = chunk->slots[i];
+                if (slot.generation.load(std::memory_order_relaxed) & 1) {
+                    slot.object()->~T();
+                }
+            }
+            delete chunk;
+        }
+    }
+
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    /**
+     * @brief 在空闲槽位上构造对象
+     * @return 对象句柄；池已满或构造抛出异常时返回 kInvalidHandle
+     */
+    template<typename... Args>
+    Handle create(Args&&... args) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_head_ == kNoSlot && !growLocked()) {
+            return kInvalidHandle;
+        }
+
+        uint32_t index = free_head_;
+        Slot& slot = slotAt(index);
+        uint32_t next = slot.nextFree();
+        try {
+            new (slot.storage) T(std::forward<Args>(args)...);
+        } catch (...) {
+            return kInvalidHandle;
+        }
+        free_head_ = next;
+        ++size_;
+
+        // 空闲槽位的代数为偶数，加一后为奇数，句柄因此不为0
+        Generation generation = slot.generation.load(std::memory_order_relaxed) + 1;
+        slot.generation.store(generation, std::memory_order_release);
+        return makeHandle(index, generation);
+    }
+
+    /**
+     * @brief 通过句柄查找对象
+     * @return 对象指针；句柄无效或对象已销毁时返回 nullptr
+     */
+    T* get(Handle handle) {
+        Slot* slot = slotFor(handle);
+        return slot ? slot->object() : nullptr;
+    }
+
+    const T* get(Handle handle) const {
+        Slot* slot = slotFor(handle);
+        return slot ? slot->object() : nullptr;
+    }
+
+    /**
+     * @brief 句柄是否仍指向存活的对象
+     */
+    bool valid(Handle handle) const {
+        return slotFor(handle) != nullptr;
+    }
+
+    /**
+     * @brief 销毁对象并回收槽位，之后该句柄失效
+     * @return 句柄已失效时返回false
+     */
+    bool destroy(Handle handle) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Slot* slot = slotFor(handle);
+        if (!slot) {
+            return false;
+        }
+        Generation generation = slot->generation.load(std::memory_order_relaxed) + 1;
+        slot->generation.store(generation, std::memory_order_release);
+        slot->object()->~T();
+        --size_;
+        if (generation == 0) {
+            // 代数回绕，再用这个槽位会让最早的旧句柄重新生效
+            ++retired_;
+            return true;
+        }
+        slot->setNextFree(free_head_);
+        free_head_ = static_cast<uint32_t>(handle & kIndexMask);
+        return true;
+    }
+
+    /**
+     * @brief 存活对象数
+     */
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return size_;
+    }
+
+    /**
+     * @brief 已分配的槽位数
+     */
+    size_t capacity() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return chunk_count_ * ChunkSlots;
+    }
+
+    size_t maxObjects() const {
+        return max_chunks_ * ChunkSlots;
+    }
+
+    /**
+     * @brief 因代数用尽而不再使用的槽位数
+     */
+    size_t retired() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return retired_;
+    }
+
+private:
+    static constexpr uint32_t kNoSlot = UINT32_MAX;
+
+    /**
+     * @brief 槽位：空闲时存储区的前4字节保存下一个空闲槽位的下标
+     */
+    struct Slot {
+        alignas(T) alignas(uint32_t) unsigned char storage[sizeof(T) < sizeof(uint32_t) ? sizeof(uint32_t) : sizeof(T)];
+        std::atomic<Generation> generation;
+
+        T* object() {
+            return std::launder(reinterpret_cast<T*>(storage));
+        }
+
+        uint32_t nextFree() const {
+            uint32_t next;
+            std::memcpy(&next, storage, sizeof(next));
+            return next;
+        }
+
+        void setNextFree(uint32_t next) {
+            std::memcpy(storage, &next, sizeof(next));
+        }
+    };
+
+    struct alignas(kCacheLine) Chunk {
+        Slot slots[ChunkSlots];
+    };
+
+    static Handle makeHandle(uint32_t index, Generation generation) {
+        return (Handle(generation) << kIndexBits) | index;
+    }
+
+    Slot& slotAt(uint32_t index) const {
+        Chunk* chunk = chunks_[index / ChunkSlots].load(std::memory_order_acquire);
+        return chunk->slots[index % ChunkSlots];
+    }
+
+    Slot* slotFor(Handle handle) const {
+        uint32_t index = static_cast<uint32_t>(handle & kIndexMask);
+        Handle generation = handle >> kIndexBits;
+        if ((generation & 1) == 0 || index / ChunkSlots >= max_chunks_) {
+            return nullptr;
+        }
+        Chunk* chunk = chunks_[index / ChunkSlots].load(std::memory_order_acquire);
+        if (!chunk) {
+            return nullptr;
+        }
+        Slot& slot = chunk->slots[index % ChunkSlots];
+        if (slot.generation.load(std::memory_order_acquire) != generation) {
+            return nullptr;
+        }
+        return &slot;
+    }
+
+    /**
+     * @brief 追加一个块，并把它的槽位按顺序串入空闲链表
+     * @note 调用者持有 mutex_
+     */
+    bool growLocked() {
+        if (chunk_count_ == max_chunks_) {
+            return false;
+        }
+        Chunk* chunk = new (std::nothrow) Chunk;
+        if (!chunk) {
+            return false;
+        }
+        uint32_t base = static_cast<uint32_t>(chunk_count_ * ChunkSlots);
+        for (size_t i = 0; i < ChunkSlots; ++i) {
+            Slot& slot = chunk->slots[i];
+            slot.generation.store(0, std::memory_order_relaxed);
+            slot.setNextFree(i + 1 < ChunkSlots ? base + static_cast<uint32_t>(i) + 1 : free_head_);
+        }
+        chunks_[chunk_count_].store(chunk, std::memory_order_release);
+        ++chunk_count_;
+        free_head_ = base;
+        return true;
+    }
+
+    const size_t max_chunks_;
+    std::unique_ptr<std::atomic<Chunk*>[]> chunks_;   // 只增不减，get() 无锁读取
+    size_t chunk_count_;
+    uint32_t free_head_;
+    size_t size_;
+    size_t retired_ = 0;
+    mutable std::mutex mutex_;
+};
+
+} // namespace prpc
+
+#endif // SLAB_POOL_H
@@ -0,0 +1,62 @@
+#ifndef _StatusServer_H
+#define _StatusServer_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+
+// Minimal HTTP/1.1 listener for runtime status pages and Prometheus scrapes.
+// One background thread accepts and serves requests one at a time, each on a
+// fresh connection (Connection: close). Only GET and HEAD are supported.
+// A page that takes a while to render, such as a profile, holds up the
+// pages requested after it.
+class StatusServer {
+ public:
+  using Handler = std::function<std::string()>;
+  // Decoded query parameters, e.g. "/profile?seconds=5" -> {seconds: "5"}.
+  using Params = std::map<std::string, std::string>;
+  using ParamHandler = std::function<std::string(const Params &)>;
+
+  StatusServer();
+  ~StatusServer();
+
+  StatusServer(const StatusServer &) = delete;
+  StatusServer &operator=(const StatusServer &) = delete;
+
+  // Pages are matched on the exact path, ignoring any query string. A page
+  // with a title is linked from the generated index at "/". Register pages
+  // before Start().
+  void AddPage(const std::string &path, const std::string &title,
+               const std::string &content_type, Handler handler);
+  void AddPage(const std::string &path, const std::string &title,
+               const std::string &content_type, ParamHandler handler);
+
+  // Port 0 binds an ephemeral port, see GetPort().
+  bool Start(const std::string &ip, uint16_t port);
+  void Stop();
+
+  uint16_t GetPort() const { return m_port; }
+
+ private:
+  struct Page {
+    std::string title;
+    std::string content_type;
+    ParamHandler handler;
+  };
+
+  void ServeLoop();
+  void ServeConnection(int connfd);
+  std::string IndexPage() const;
+
+  std::map<std::string, Page> m_pages;
+  int m_listenfd;
+  int m_wakefd;  // eventfd that interrupts poll() on Stop()
+  uint16_t m_port;
+  std::atomic<bool> m_running;
+  std::thread m_thread;
+};
+
+#endif
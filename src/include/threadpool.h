@@ -1,5 +1,8 @@
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <functional>
 #include <future>
@@ -8,54 +11,167 @@
 #include <thread>
 #include <vector>
 
+#include "cpu_affinity.h"
+#include "profiler.h"
+
 class ThreadPool {
  public:
+  // Priority levels, highest first. submit() enqueues at kNormal.
+  enum Priority { kHigh = 0, kNormal = 1, kLow = 2, kPriorityLevels = 3 };
+
+  // kStrictPriority always drains the highest non-empty level first, so low
+  // priority work is deferred for as long as there is anything above it.
+  // kWeighted serves the levels round-robin, up to weights[level] tasks per
+  // turn, which bounds how long lower levels can be starved.
+  // kEarliestDeadline runs the task with the nearest deadline first. No task
+  // is ordered later than enqueue time + starvation limit, so requests with
+  // generous (or no) deadlines still make progress under a stream of tight
+  // ones. kHigh tasks are treated as already due.
+  enum class QueuePolicy { kStrictPriority, kWeighted, kEarliestDeadline };
+
+  using Clock = std::chrono::steady_clock;
+
   ThreadPool(int numThreads = std::thread::hardware_concurrency())
-      : stop(false) {
+      : ThreadPool(numThreads, {}) {}
+
+  // Pins worker i to cpus[i % cpus.size()] before it starts taking tasks, so
+  // its stack and any thread-local caches are first-touched on the local NUMA
+  // node. An empty cpu list leaves the workers floating.
+  ThreadPool(int numThreads, std::vector<int> cpus)
+      : tasks(kPriorityLevels),
+        policy(QueuePolicy::kStrictPriority),
+        weights{8, 4, 1},
+        current_level(kPriorityLevels - 1),
+        credits(0),
+        starvation_limit(std::chrono::milliseconds(1000)),
+        next_seq(0),
+        pending(0),
+        stop(false) {
     if (numThreads <= 0) {
       numThreads = 1;
     }
     for (int i = 0; i < numThreads; ++i) {
-      workers.emplace_back([this] {
+      int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+      workers.emplace_back([this, cpu] {
+        if (cpu >= 0) {
+          prpc::affinity::pinCurrentThread(cpu);
+        }
         while (true) {
           std::function<void()> task;
           {
-            std::unique_lock<std::mutex> lock(this->queue_mutex);
+            auto lock =
+                prpc::profiledLock(this->queue_mutex, "threadpool.queue");
             this->condition.wait(
-                lock, [this] { return this->stop || !this->tasks.empty(); });
-            if (this->stop && this->tasks.empty()) {
+                lock, [this] { return this->stop || this->pending > 0; });
+            if (this->stop && this->pending == 0) {
               return;
             }
-            task = std::move(this->tasks.front());
-            this->tasks.pop();
+            task = popTask();
           }
+          this->busy.fetch_add(1, std::memory_order_relaxed);
           task();
+          this->busy.fetch_sub(1, std::memory_order_relaxed);
         }
       });
     }
   }
 
+  // Weights are only used by kWeighted; a missing or zero weight counts as 1.
+  void setQueuePolicy(QueuePolicy new_policy,
+                      std::vector<unsigned> new_weights = {}) {
+    auto lock = prpc::profiledLock(queue_mutex, "threadpool.queue");
+    policy = new_policy;
+    for (int level = 0; level < kPriorityLevels; ++level) {
+      if (level < static_cast<int>(new_weights.size())) {
+        weights[level] = new_weights[level] > 0 ? new_weights[level] : 1;
+      }
+    }
+    credits = 0;
+  }
+
+  void setStarvationLimit(std::chrono::milliseconds limit) {
+    auto lock = prpc::profiledLock(queue_mutex, "threadpool.queue");
+    starvation_limit = limit;
+  }
+
   template <class F, class... Args>
   auto submit(F&& f, Args&&... args)
       -> std::future<typename std::invoke_result<F, Args...>::type> {
+    return submitWithPriority(kNormal, std::forward<F>(f),
+                              std::forward<Args>(args)...);
+  }
+
+  template <class F, class... Args>
+  auto submitWithPriority(int level, F&& f, Args&&... args)
+      -> std::future<typename std::invoke_result<F, Args...>::type> {
+    return submitWithDeadline(Clock::time_point::max(), level,
+                              std::forward<F>(f), std::forward<Args>(args)...);
+  }
+
+  // The deadline orders the task under kEarliestDeadline; the other policies
+  // only look at the level.
+  template <class F, class... Args>
+  auto submitWithDeadline(Clock::time_point deadline, int level, F&& f,
+                          Args&&... args)
+      -> std::future<typename std::invoke_result<F, Args...>::type> {
     using return_type = typename std::invoke_result<F, Args...>::type;
     auto task = std::make_shared<std::packaged_task<return_type()>>(
         std::bind(std::forward<F>(f), std::forward<Args>(args)...));
     std::future<return_type> res = task->get_future();
+    if (level < kHigh || level >= kPriorityLevels) {
+      level = kNormal;
+    }
     {
-      std::unique_lock<std::mutex> lock(queue_mutex);
+      auto lock = prpc::profiledLock(queue_mutex, "threadpool.queue");
       if (stop) {
         throw std::runtime_error("enqueue on stopped ThreadPool");
       }
-      tasks.emplace([task]() { (*task)(); });
+      if (policy == QueuePolicy::kEarliestDeadline) {
+        Clock::time_point now = Clock::now();
+        if (level == kHigh) {
+          deadline = now;
+        } else if (deadline - now > starvation_limit) {
+          deadline = now + starvation_limit;
+        }
+        deadline_tasks.push_back({deadline, next_seq++, [task]() { (*task)(); }});
+        std::push_heap(deadline_tasks.begin(), deadline_tasks.end(),
+                       std::greater<DeadlineTask>());
+      } else {
+        tasks[level].emplace([task]() { (*task)(); });
+      }
+      ++pending;
     }
     condition.notify_one();
     return res;
   }
 
+  size_t size() const { return workers.size(); }
+
+  // Point-in-time view for the status pages.
+  struct Stats {
+    size_t threads;
+    size_t busy;                      // workers currently running a task
+    size_t queued[kPriorityLevels];   // per level queue
+    size_t deadline_queued;           // queued under kEarliestDeadline
+    QueuePolicy policy;
+  };
+
+  Stats stats() {
+    auto lock = prpc::profiledLock(queue_mutex, "threadpool.queue");
+    Stats result;
+    result.threads = workers.size();
+    result.busy = busy.load(std::memory_order_relaxed);
+    for (int level = 0; level < kPriorityLevels; ++level) {
+      result.queued[level] = tasks[level].size();
+    }
+    result.deadline_queued = deadline_tasks.size();
+    result.policy = policy;
+    return result;
+  }
+
   ~ThreadPool() {
     {
-      std::unique_lock<std::mutex> lock(queue_mutex);
+      auto lock = prpc::profiledLock(queue_mutex, "threadpool.queue");
       stop = true;
     }
     condition.notify_all();
@@ -65,11 +181,70 @@ class ThreadPool {
   }
 
  private:
+  struct DeadlineTask {
+    Clock::time_point deadline;
+    uint64_t seq;  // FIFO among equal deadlines
+    std::function<void()> fn;
+
+    bool operator>(const DeadlineTask& other) const {
+      return deadline != other.deadline ? deadline > other.deadline
+                                        : seq > other.seq;
+    }
+  };
+
+  // Called with queue_mutex held and pending > 0.
+  std::function<void()> popTask() {
+    if (!deadline_tasks.empty()) {
+      std::pop_heap(deadline_tasks.begin(), deadline_tasks.end(),
+                    std::greater<DeadlineTask>());
+      std::function<void()> task = std::move(deadline_tasks.back().fn);
+      deadline_tasks.pop_back();
+      --pending;
+      return task;
+    }
+
+    // Level queues may still hold tasks queued before a switch to EDF.
+    int level = 0;
+    if (policy != QueuePolicy::kWeighted) {
+      while (tasks[level].empty()) {
+        ++level;
+      }
+    } else {
+      // Stay on the current level while it has credits and work, otherwise
+      // move on to the next non-empty level with a fresh quantum.
+      if (credits == 0 || tasks[current_level].empty()) {
+        do {
+          current_level = (current_level + 1) % kPriorityLevels;
+        } while (tasks[current_level].empty());
+        credits = weights[current_level];
+      }
+      --credits;
+      level = current_level;
+    }
+    std::function<void()> task = std::move(tasks[level].front());
+    tasks[level].pop();
+    if (--pending == 0) {
+      // Queue drained: the next busy period starts a fresh round at kHigh.
+      current_level = kPriorityLevels - 1;
+      credits = 0;
+    }
+    return task;
+  }
+
   std::vector<std::thread> workers;
-  std::queue<std::function<void()>> tasks;
+  std::vector<std::queue<std::function<void()>>> tasks;
+  std::vector<DeadlineTask> deadline_tasks;  // min-heap on (deadline, seq)
+  QueuePolicy policy;
+  unsigned weights[kPriorityLevels];
+  int current_level;
+  unsigned credits;
+  Clock::duration starvation_limit;
+  uint64_t next_seq;
+  size_t pending;
+  std::atomic<size_t> busy{0};
   std::mutex queue_mutex;
   std::condition_variable condition;
   bool stop;
 };
 
-#endif  // THREADPOOL_H
\ No newline at end of file
+#endif  // THREADPOOL_H
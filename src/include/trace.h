@@ -0,0 +1,170 @@
+#ifndef PRPC_TRACE_H
+#define PRPC_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "error.h"
+
+namespace prpc {
+
+// 分布式追踪
+// 请求头携带 trace_id、调用方的 span_id 和采样标记。Pchannel 为每次调用创建
+// 客户端 span，Pprovider 为每个请求创建服务端 span；处理函数里发起的嵌套调用
+// 通过纤程/线程局部的当前上下文自动继承 trace。只有被采样的 span 才会导出，
+// 未采样的请求只多生成一个 id。
+// 同一个上下文还带着当前请求的截止时间，嵌套调用的超时不超过请求剩余的时间。
+
+/**
+ * @brief 追踪上下文，trace_id 为0表示不追踪
+ */
+struct TraceContext {
+    uint64_t trace_id = 0;
+    uint64_t span_id = 0;
+    bool sampled = false;
+    // 正在处理的请求的截止时间，与 trace 是否有效无关；max() 表示没有
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+
+    bool valid() const {
+        return trace_id != 0;
+    }
+};
+
+/**
+ * @brief 一个已结束的 span
+ */
+struct Span {
+    enum Kind { kClient, kServer };
+
+    uint64_t trace_id = 0;
+    uint64_t span_id = 0;
+    uint64_t parent_span_id = 0;       // 0 表示根 span
+    std::string name;                  // Service.Method
+    Kind kind = kServer;
+    int64_t start_us = 0;              // Unix 时间，微秒
+    int64_t duration_us = 0;
+    ErrorCode error = ErrorCode::SUCCESS;
+};
+
+/**
+ * @brief span 的导出目标，由后台线程成批调用
+ */
+class SpanSink {
+public:
+    virtual ~SpanSink() = default;
+    virtual void exportSpans(const std::vector<Span>& spans) = 0;
+};
+
+/**
+ * @brief 以 JSON Lines 追加写入本地文件
+ */
+class FileSpanSink : public SpanSink {
+public:
+    explicit FileSpanSink(FILE* file) : file_(file) {}
+    ~FileSpanSink() override;
+
+    // 打开(追加)失败时返回 nullptr
+    static std::unique_ptr<FileSpanSink> open(const std::string& path);
+
+    void exportSpans(const std::vector<Span>& spans) override;
+
+private:
+    FILE* file_;
+};
+
+/**
+ * @brief 采样决策、span 队列和后台导出线程
+ */
+class Tracer {
+public:
+    static Tracer& getInstance();
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    // 根 span 的采样率，0~1；为0且请求未携带 trace 时不生成任何追踪信息
+    void setSampleRate(double rate);
+    double getSampleRate() const;
+
+    // 设置导出目标，之前排队的 span 先写给旧目标；nullptr 表示丢弃
+    void setSink(std::unique_ptr<SpanSink> sink);
+
+    // 当前纤程/线程上正在处理的 span，没有时返回无效上下文
+    static TraceContext current();
+
+    /**
+     * @brief 为一次调用或一个请求创建新 span 的上下文
+     * @details parent 有效时沿用其 trace_id 和采样标记，否则作为根 span 按采样率决定；
+     *          采样率为0且 parent 无效时返回无效上下文
+     */
+    TraceContext newSpan(const TraceContext& parent);
+
+    static uint64_t newId();
+
+    static int64_t nowUs();
+
+    // 提交已采样的 span；队列满时丢弃并计数
+    void submit(Span span);
+
+    // 把已提交的 span 写给导出目标后返回
+    void flush();
+
+    uint64_t dropped() const {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr size_t kBatchSize = 256;
+    static constexpr size_t kMaxPending = 64 * 1024;
+    static constexpr int kExportIntervalMs = 1000;
+
+    Tracer();
+    ~Tracer() = default;
+
+    static void shutdownAtExit();
+    void exportLoop();
+    void exportPending();
+
+    std::atomic<uint64_t> sampleThreshold_;    // newId() 小于它的根 span 被采样
+    std::atomic<bool> alwaysSample_;
+    std::atomic<uint64_t> dropped_;
+
+    std::mutex queueMutex_;
+    std::condition_variable queueCond_;
+    std::vector<Span> pending_;
+    bool stopping_;
+
+    std::mutex exportMutex_;               // 串行化导出：后台线程、flush()、setSink()
+    std::unique_ptr<SpanSink> sink_;
+    std::thread exporter_;
+};
+
+/**
+ * @brief 在作用域内把 context 设为当前纤程/线程的追踪上下文，析构时恢复
+ * @details 处理函数把工作交给其他线程时，可以先取 Tracer::current()，
+ *          在新线程上用它构造一个 ScopedTraceContext 继续传递
+ */
+class ScopedTraceContext {
+public:
+    explicit ScopedTraceContext(const TraceContext& context);
+    ~ScopedTraceContext();
+
+    ScopedTraceContext(const ScopedTraceContext&) = delete;
+    ScopedTraceContext& operator=(const ScopedTraceContext&) = delete;
+
+private:
+    TraceContext context_;
+    void* previous_;
+};
+
+}  // namespace prpc
+
+#endif // PRPC_TRACE_H
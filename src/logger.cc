@@ -0,0 +1,417 @@
+#include "logger.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+#include "binary_log.h"
+#include "profiler.h"
+
+// 每线程的单生产者单消费者环形缓冲区。
+// 记录格式：[uint32 长度][uint8 级别][文本]，文本已带换行。
+// 级别带 kBinaryTag 时内容为二进制日志记录。
+struct LogBuffer {
+  static constexpr uint8_t kBinaryTag = 0x80;
+  static constexpr size_t kCapacity = 256 * 1024;  // 2的幂
+  static constexpr size_t kHeaderSize = sizeof(uint32_t) + 1;
+
+  alignas(64) std::atomic<size_t> head{0};  // 生产者写入位置
+  alignas(64) std::atomic<size_t> tail{0};  // 消费者读取位置
+  std::atomic<bool> retired{false};         // 所属线程已退出
+  char data[kCapacity];
+
+  void copyIn(size_t pos, const void* src, size_t len) {
+    size_t offset = pos & (kCapacity - 1);
+    size_t first = std::min(len, kCapacity - offset);
+    std::memcpy(data + offset, src, first);
+    std::memcpy(data, static_cast<const char*>(src) + first, len - first);
+  }
+
+  void copyOut(size_t pos, void* dst, size_t len) const {
+    size_t offset = pos & (kCapacity - 1);
+    size_t first = std::min(len, kCapacity - offset);
+    std::memcpy(dst, data + offset, first);
+    std::memcpy(static_cast<char*>(dst) + first, data, len - first);
+  }
+};
+
+namespace {
+
+// 线程退出时标记缓冲区，由刷新线程排空后注销
+struct LocalBufferHolder {
+  std::shared_ptr<LogBuffer> buffer;
+  std::string scratch;  // 复用的格式化缓冲
+  ~LocalBufferHolder();
+};
+
+thread_local LocalBufferHolder t_holder;
+// 平凡析构，线程局部对象析构后仍可安全读取
+thread_local bool t_holderDestroyed = false;
+
+LocalBufferHolder::~LocalBufferHolder() {
+  t_holderDestroyed = true;
+  if (buffer) {
+    buffer->retired.store(true, std::memory_order_release);
+  }
+}
+
+const char* levelString(LogLevel level) {
+  switch (level) {
+    case DEBUG: return "DEBUG";
+    case INFO:  return "INFO";
+    case WARN:  return "WARN";
+    case ERROR: return "ERROR";
+    case FATAL: return "FATAL";
+    default:    return "UNKNOWN";
+  }
+}
+
+// 每线程缓存到秒的时间前缀，每秒只调用一次 localtime_r/strftime。
+// 平凡析构，线程局部对象析构阶段仍可使用
+struct TimestampCache {
+  time_t second = -1;
+  size_t length = 0;
+  char text[32];  // "2006-01-02 15:04:05."
+};
+
+thread_local TimestampCache t_timestamp;
+
+void appendTimestamp(std::string& out) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  if (ts.tv_sec != t_timestamp.second) {
+    std::tm tm_buf;
+    localtime_r(&ts.tv_sec, &tm_buf);  // 使用线程安全的 localtime_r
+    t_timestamp.length = std::strftime(t_timestamp.text, sizeof(t_timestamp.text),
+                                       "%Y-%m-%d %H:%M:%S.", &tm_buf);
+    t_timestamp.second = ts.tv_sec;
+  }
+  // 只补上毫秒
+  int ms = static_cast<int>(ts.tv_nsec / 1000000);
+  char digits[3] = {static_cast<char>('0' + ms / 100), static_cast<char>('0' + ms / 10 % 10),
+                    static_cast<char>('0' + ms % 10)};
+  out.append(t_timestamp.text, t_timestamp.length);
+  out.append(digits, sizeof(digits));
+}
+
+// 格式化一条完整的日志行：[级别][时间][文件:行号] 消息
+void formatRecord(LogLevel level, const char* file, int line, const std::string& message,
+                  std::string& out) {
+  out.clear();
+  out.push_back('[');
+  out.append(levelString(level));
+  out.append("][", 2);
+  appendTimestamp(out);
+  out.append("][", 2);
+  out.append(file);
+  out.push_back(':');
+  char line_buf[16];
+  char* end = line_buf + sizeof(line_buf);
+  char* p = end;
+  unsigned value = line > 0 ? static_cast<unsigned>(line) : 0;
+  do {
+    *--p = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  out.append(p, end - p);
+  out.append("] ", 2);
+  out.append(message);
+  out.push_back('\n');
+}
+
+}  // namespace
+
+PLogger& PLogger::getInstance() {
+  // 有意不析构：其他静态对象析构时仍可能写日志
+  static PLogger* instance = new PLogger();
+  return *instance;
+}
+
+PLogger::PLogger()
+    : flushIntervalMs_(50),
+      fileFd_(-1),
+      wakePending_(false),
+      stopping_(false),
+      synchronous_(false) {
+  flusher_ = std::thread(&PLogger::flushLoop, this);
+  std::atexit(&PLogger::shutdownAtExit);
+}
+
+void PLogger::shutdownAtExit() { getInstance().stop(); }
+
+bool PLogger::parseLevel(const std::string& name, LogLevel& level) {
+  static const struct {
+    const char* name;
+    LogLevel level;
+  } kLevels[] = {{"debug", DEBUG}, {"info", INFO}, {"warn", WARN}, {"error", ERROR}, {"fatal", FATAL}};
+  for (const auto& entry : kLevels) {
+    if (strcasecmp(name.c_str(), entry.name) == 0) {
+      level = entry.level;
+      return true;
+    }
+  }
+  return false;
+}
+
+void PLogger::log(LogLevel level, const char* file, int line, const std::string& message) {
+  if (!isEnabled(level) && level != FATAL) {
+    return;
+  }
+
+  std::string fallback;
+  std::string& record = t_holderDestroyed ? fallback : t_holder.scratch;
+  formatRecord(level, file, line, message, record);
+
+  LogBuffer* buffer = nullptr;
+  if (level != FATAL && !synchronous_.load(std::memory_order_acquire)) {
+    buffer = localBuffer();
+  }
+  if (buffer == nullptr || record.size() + LogBuffer::kHeaderSize > LogBuffer::kCapacity / 2) {
+    // FATAL、退出阶段和超长记录：先写出已缓冲的日志以保持顺序，再同步写出
+    writeSync(level, record);
+    return;
+  }
+  append(buffer, static_cast<uint8_t>(level), record.data(), record.size());
+}
+
+void PLogger::logBinary(LogLevel level, uint32_t formatId, char* record, size_t length) {
+  thread_local uint32_t tid = static_cast<uint32_t>(syscall(SYS_gettid));
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  uint32_t len = static_cast<uint32_t>(length);
+  uint64_t ns = static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+  std::memcpy(record, &len, sizeof(len));
+  std::memcpy(record + 4, &formatId, sizeof(formatId));
+  std::memcpy(record + 8, &ns, sizeof(ns));
+  std::memcpy(record + 16, &tid, sizeof(tid));
+
+  LogBuffer* buffer = synchronous_.load(std::memory_order_acquire) ? nullptr : localBuffer();
+  if (buffer == nullptr) {
+    auto lock = prpc::profiledLock(drainMutex_, "logger.drain");
+    drainLocked();
+    PBinaryLog::getInstance().appendRecords(record, length);
+    return;
+  }
+  append(buffer, LogBuffer::kBinaryTag | static_cast<uint8_t>(level), record, length);
+}
+
+LogBuffer* PLogger::localBuffer() {
+  if (t_holderDestroyed) {
+    return nullptr;
+  }
+  if (!t_holder.buffer) {
+    t_holder.buffer = std::make_shared<LogBuffer>();
+    auto lock = prpc::profiledLock(buffersMutex_, "logger.buffers");
+    buffers_.push_back(t_holder.buffer);
+  }
+  return t_holder.buffer.get();
+}
+
+void PLogger::append(LogBuffer* buffer, uint8_t tag, const char* data, size_t length) {
+  size_t need = LogBuffer::kHeaderSize + length;
+  size_t head = buffer->head.load(std::memory_order_relaxed);
+
+  // 缓冲区满时唤醒刷新线程并等待空间，不丢弃日志
+  while (LogBuffer::kCapacity - (head - buffer->tail.load(std::memory_order_acquire)) < need) {
+    if (synchronous_.load(std::memory_order_acquire)) {
+      if (tag & LogBuffer::kBinaryTag) {
+        auto lock = prpc::profiledLock(drainMutex_, "logger.drain");
+        drainLocked();
+        PBinaryLog::getInstance().appendRecords(data, length);
+      } else {
+        writeSync(static_cast<LogLevel>(tag), std::string(data, length));
+      }
+      return;
+    }
+    {
+      auto lock = prpc::profiledLock(wakeMutex_, "logger.wake");
+      wakePending_ = true;
+    }
+    wakeCond_.notify_one();
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+
+  uint32_t len = static_cast<uint32_t>(length);
+  buffer->copyIn(head, &len, sizeof(len));
+  buffer->copyIn(head + sizeof(len), &tag, 1);
+  buffer->copyIn(head + LogBuffer::kHeaderSize, data, length);
+  buffer->head.store(head + need, std::memory_order_release);
+
+  // 只在跨过半满时唤醒，其余情况由刷新线程按周期拉取
+  size_t used = head + need - buffer->tail.load(std::memory_order_relaxed);
+  if (used >= LogBuffer::kCapacity / 2 && used - need < LogBuffer::kCapacity / 2) {
+    {
+      auto lock = prpc::profiledLock(wakeMutex_, "logger.wake");
+      wakePending_ = true;
+    }
+    wakeCond_.notify_one();
+  }
+}
+
+void PLogger::writeSync(LogLevel level, const std::string& record) {
+  auto lock = prpc::profiledLock(drainMutex_, "logger.drain");
+  drainLocked();
+  writeAll(fileFd_ >= 0 ? fileFd_ : (level <= INFO ? STDOUT_FILENO : STDERR_FILENO),
+           record.data(), record.size());
+  if (level == FATAL && fileFd_ >= 0) {
+    fsync(fileFd_);
+  }
+}
+
+bool PLogger::setLogFile(const std::string& path) {
+  int fd = -1;
+  if (!path.empty()) {
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      return false;
+    }
+  }
+  auto lock = prpc::profiledLock(drainMutex_, "logger.drain");
+  drainLocked();
+  if (fileFd_ >= 0) {
+    close(fileFd_);
+  }
+  fileFd_ = fd;
+  return true;
+}
+
+void PLogger::flush() {
+  auto lock = prpc::profiledLock(drainMutex_, "logger.drain");
+  drainLocked();
+}
+
+// 调用者持有 drainMutex_
+void PLogger::drainLocked() {
+  std::vector<std::shared_ptr<LogBuffer>> buffers;
+  {
+    auto lock = prpc::profiledLock(buffersMutex_, "logger.buffers");
+    buffers = buffers_;
+  }
+
+  outBatch_.clear();
+  errBatch_.clear();
+  binaryBatch_.clear();
+  for (const auto& buffer : buffers) {
+    size_t tail = buffer->tail.load(std::memory_order_relaxed);
+    size_t head = buffer->head.load(std::memory_order_acquire);
+    while (tail != head) {
+      uint32_t len;
+      uint8_t lvl;
+      buffer->copyOut(tail, &len, sizeof(len));
+      buffer->copyOut(tail + sizeof(len), &lvl, 1);
+      std::string& batch = (lvl & LogBuffer::kBinaryTag)   ? binaryBatch_
+                           : (fileFd_ >= 0 || lvl <= INFO) ? outBatch_
+                                                           : errBatch_;
+      size_t offset = batch.size();
+      batch.resize(offset + len);
+      buffer->copyOut(tail + LogBuffer::kHeaderSize, &batch[offset], len);
+      tail += LogBuffer::kHeaderSize + len;
+    }
+    buffer->tail.store(tail, std::memory_order_release);
+  }
+
+  if (fileFd_ >= 0) {
+    writeAll(fileFd_, outBatch_.data(), outBatch_.size());
+  } else {
+    writeAll(STDOUT_FILENO, outBatch_.data(), outBatch_.size());
+    writeAll(STDERR_FILENO, errBatch_.data(), errBatch_.size());
+  }
+  if (!binaryBatch_.empty()) {
+    PBinaryLog::getInstance().appendRecords(binaryBatch_.data(), binaryBatch_.size());
+  }
+
+  // 注销已退出且排空的线程缓冲区
+  auto lock = prpc::profiledLock(buffersMutex_, "logger.buffers");
+  for (auto it = buffers_.begin(); it != buffers_.end();) {
+    LogBuffer* buffer = it->get();
+    if (buffer->retired.load(std::memory_order_acquire) &&
+        buffer->tail.load(std::memory_order_relaxed) ==
+            buffer->head.load(std::memory_order_acquire)) {
+      it = buffers_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void PLogger::writeAll(int fd, const char* data, size_t len) {
+  while (len > 0) {
+    ssize_t n = ::write(fd, data, len);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    data += n;
+    len -= n;
+  }
+}
+
+void PLogger::flushLoop() {
+  const int64_t kSummaryQuietNs = 5LL * 1000 * 1000 * 1000;
+  auto lock = prpc::profiledLock(wakeMutex_, "logger.wake");
+  while (!stopping_) {
+    wakeCond_.wait_for(lock, std::chrono::milliseconds(flushIntervalMs_.load()),
+                       [this] { return wakePending_ || stopping_; });
+    wakePending_ = false;
+    lock.unlock();
+    LogSite::reportSuppressed(kSummaryQuietNs);
+    flush();
+    lock.lock();
+  }
+}
+
+int64_t LogSite::nowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void LogSite::link() {
+  LogSite* head = head_.load(std::memory_order_relaxed);
+  do {
+    next_site_ = head;
+  } while (!head_.compare_exchange_weak(head, this, std::memory_order_release,
+                                        std::memory_order_relaxed));
+}
+
+void LogSite::reportSuppressed(int64_t quiet_ns) {
+  int64_t now = nowNs();
+  for (LogSite* site = head_.load(std::memory_order_acquire); site != nullptr;
+       site = site->next_site_) {
+    if (site->suppressed_.load(std::memory_order_relaxed) == 0 ||
+        now - site->lastReport_.load(std::memory_order_relaxed) < quiet_ns) {
+      continue;
+    }
+    uint64_t suppressed = site->takeSuppressed();
+    if (suppressed > 0 && PLogger::isEnabled(site->level_)) {
+      PLogger::getInstance().log(site->level_, site->file_, site->line_,
+                                 "suppressed " + std::to_string(suppressed) + " messages");
+    }
+  }
+}
+
+void PLogger::stop() {
+  // 之后的日志直接同步写出
+  synchronous_.store(true, std::memory_order_release);
+  {
+    auto lock = prpc::profiledLock(wakeMutex_, "logger.wake");
+    if (stopping_) {
+      return;
+    }
+    stopping_ = true;
+  }
+  wakeCond_.notify_one();
+  if (flusher_.joinable()) {
+    flusher_.join();
+  }
+  flush();
+}
@@ -0,0 +1,492 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace prpc {
+
+double HistogramSnapshot::percentile(double q) const {
+  if (count == 0 || buckets.empty()) {
+    return 0;
+  }
+  q = std::min(std::max(q, 0.0), 1.0);
+  // 第 rank 个样本(从1开始)所在的桶，桶内假设均匀分布
+  double rank = std::max(1.0, std::ceil(q * count));
+  uint64_t seen = 0;
+  for (int i = 0; i < metrics::kBucketCount; ++i) {
+    if (buckets[i] == 0) {
+      continue;
+    }
+    if (seen + buckets[i] >= rank) {
+      double lower = static_cast<double>(metrics::bucketLower(i));
+      double upper = static_cast<double>(metrics::bucketUpper(i));
+      return lower + (upper - lower) * (rank - seen) / buckets[i];
+    }
+    seen += buckets[i];
+  }
+  return static_cast<double>(metrics::bucketUpper(metrics::kBucketCount - 1));
+}
+
+void HistogramSnapshot::subtract(const HistogramSnapshot& base) {
+  if (base.buckets.empty()) {
+    return;
+  }
+  buckets.resize(metrics::kBucketCount);
+  for (int i = 0; i < metrics::kBucketCount; ++i) {
+    buckets[i] -= std::min(buckets[i], base.buckets[i]);
+  }
+  count -= std::min(count, base.count);
+  sum -= std::min(sum, base.sum);
+}
+
+Histogram::Histogram() : history_(metrics::Clock::now()) {
+  for (auto& shard : shards_) {
+    shard.store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+Histogram::~Histogram() {
+  for (auto& shard : shards_) {
+    delete shard.load(std::memory_order_relaxed);
+  }
+}
+
+Histogram::Shard* Histogram::createShard(size_t index) {
+  Shard* shard = new Shard();
+  Shard* expected = nullptr;
+  if (!shards_[index].compare_exchange_strong(expected, shard, std::memory_order_acq_rel)) {
+    delete shard;  // 同一分片上的另一个线程先装好了
+    return expected;
+  }
+  return shard;
+}
+
+HistogramSnapshot Histogram::snapshot() const {
+  HistogramSnapshot result;
+  result.buckets.assign(metrics::kBucketCount, 0);
+  for (const auto& slot : shards_) {
+    const Shard* shard = slot.load(std::memory_order_acquire);
+    if (shard == nullptr) {
+      continue;
+    }
+    for (int i = 0; i < metrics::kBucketCount; ++i) {
+      result.buckets[i] += shard->buckets[i].load(std::memory_order_relaxed);
+    }
+    result.sum += shard->sum.load(std::memory_order_relaxed);
+  }
+  for (uint64_t n : result.buckets) {
+    result.count += n;
+  }
+  return result;
+}
+
+HistogramSnapshot Histogram::window(std::chrono::seconds span, metrics::Clock::time_point now) {
+  HistogramSnapshot current = snapshot();
+
+  Sample sample;
+  sample.count = current.count;
+  sample.sum = current.sum;
+  for (int i = 0; i < metrics::kBucketCount; ++i) {
+    if (current.buckets[i] != 0) {
+      sample.buckets.emplace_back(static_cast<uint16_t>(i), current.buckets[i]);
+    }
+  }
+  auto base = history_.advance(now, sample, span);
+
+  HistogramSnapshot start;
+  start.buckets.assign(metrics::kBucketCount, 0);
+  for (const auto& bucket : base.second.buckets) {
+    start.buckets[bucket.first] = bucket.second;
+  }
+  start.count = base.second.count;
+  start.sum = base.second.sum;
+
+  current.subtract(start);
+  current.seconds = std::chrono::duration<double>(now - base.first).count();
+  return current;
+}
+
+Counter::Counter() : history_(metrics::Clock::now()) {}
+
+uint64_t Counter::value() const {
+  uint64_t total = 0;
+  for (const auto& shard : shards_) {
+    total += shard.value.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+Counter::Window Counter::window(std::chrono::seconds span, metrics::Clock::time_point now) {
+  uint64_t current = value();
+  auto base = history_.advance(now, current, span);
+  Window result;
+  result.delta = current - std::min(current, base.second);
+  result.seconds = std::chrono::duration<double>(now - base.first).count();
+  return result;
+}
+
+ErrorCounters::ErrorCounters() {
+  for (auto& counter : counters_) {
+    counter.store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+ErrorCounters::~ErrorCounters() {
+  for (auto& counter : counters_) {
+    delete counter.load(std::memory_order_relaxed);
+  }
+}
+
+Counter* ErrorCounters::createCounter(size_t slot) {
+  Counter* counter = new Counter();
+  Counter* expected = nullptr;
+  if (!counters_[slot].compare_exchange_strong(expected, counter, std::memory_order_acq_rel)) {
+    delete counter;
+    return expected;
+  }
+  return counter;
+}
+
+std::vector<std::pair<ErrorCode, Counter*>> ErrorCounters::counters() const {
+  static const ErrorCode kCodes[kSlots] = {
+      ErrorCode::SUCCESS,           ErrorCode::CONFIG_ERROR,   ErrorCode::NETWORK_ERROR,
+      ErrorCode::ZOOKEEPER_ERROR,   ErrorCode::SERIALIZATION_ERROR,
+      ErrorCode::SERVICE_ERROR,     ErrorCode::TIMEOUT_ERROR,  ErrorCode::INVALID_ARGUMENT,
+      ErrorCode::RESOURCE_ERROR,    ErrorCode::UNKNOWN_ERROR};
+  std::vector<std::pair<ErrorCode, Counter*>> result;
+  for (size_t i = 0; i < kSlots; ++i) {
+    Counter* counter = counters_[i].load(std::memory_order_acquire);
+    if (counter != nullptr) {
+      result.emplace_back(kCodes[i], counter);
+    }
+  }
+  return result;
+}
+
+uint64_t ErrorCounters::total() const {
+  uint64_t total = 0;
+  for (const auto& entry : counters()) {
+    total += entry.second->value();
+  }
+  return total;
+}
+
+void SlowRequestLog::record(Entry entry) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (entries_.size() >= capacity_) {
+    entries_.pop_front();
+  }
+  entries_.push_back(std::move(entry));
+}
+
+std::vector<SlowRequestLog::Entry> SlowRequestLog::recent() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::vector<Entry>(entries_.rbegin(), entries_.rend());
+}
+
+PoolMetrics::PoolMetrics(Sampler sampler)
+    : sampler_(std::move(sampler)), history_(metrics::Clock::now()) {}
+
+PoolSample PoolMetrics::current() const {
+  std::lock_guard<std::mutex> lock(samplerMutex_);
+  if (sampler_) {
+    last_ = sampler_();
+  }
+  return last_;
+}
+
+void PoolMetrics::detach() {
+  std::lock_guard<std::mutex> lock(samplerMutex_);
+  if (sampler_) {
+    last_ = sampler_();
+    sampler_ = nullptr;
+  }
+}
+
+PoolMetrics::Window PoolMetrics::window(std::chrono::seconds span,
+                                        metrics::Clock::time_point now) {
+  PoolSample current = this->current();
+  auto base = history_.advance(now, current, span);
+  auto delta = [](uint64_t value, uint64_t start) {
+    return value - std::min(value, start);
+  };
+  Window result;
+  result.delta = current;
+  result.delta.acquired = delta(current.acquired, base.second.acquired);
+  result.delta.hits = delta(current.hits, base.second.hits);
+  result.delta.misses = delta(current.misses, base.second.misses);
+  result.delta.rejected = delta(current.rejected, base.second.rejected);
+  result.seconds = std::chrono::duration<double>(now - base.first).count();
+  return result;
+}
+
+MetricsRegistry& MetricsRegistry::getInstance() {
+  // 不析构：工作线程在进程退出过程中仍可能记录指标
+  static MetricsRegistry* instance = new MetricsRegistry();
+  return *instance;
+}
+
+MethodStats& MetricsRegistry::method(Side side, const std::string& service,
+                                     const std::string& method) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& stats = methods_[{side, service + "." + method}];
+  if (!stats) {
+    stats = std::make_unique<MethodStats>();
+  }
+  return *stats;
+}
+
+void MetricsRegistry::forEachMethod(
+    const std::function<void(Side, const std::string&, MethodStats&)>& visitor) {
+  std::vector<std::pair<std::pair<Side, std::string>, MethodStats*>> entries;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& entry : methods_) {
+      entries.emplace_back(entry.first, entry.second.get());
+    }
+  }
+  for (const auto& entry : entries) {
+    visitor(entry.first.first, entry.first.second, *entry.second);
+  }
+}
+
+std::shared_ptr<PoolMetrics> MetricsRegistry::addPool(const std::string& name,
+                                                     PoolMetrics::Sampler sampler) {
+  auto metrics = std::make_shared<PoolMetrics>(std::move(sampler));
+  std::shared_ptr<PoolMetrics> replaced;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    replaced = std::move(pools_[name]);
+    pools_[name] = metrics;
+  }
+  if (replaced) {
+    replaced->detach();
+  }
+  return metrics;
+}
+
+void MetricsRegistry::removePool(const std::string& name,
+                                 const std::shared_ptr<PoolMetrics>& metrics) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = pools_.find(name);
+    if (it != pools_.end() && it->second == metrics) {
+      pools_.erase(it);
+    }
+  }
+  metrics->detach();
+}
+
+void MetricsRegistry::forEachPool(
+    const std::function<void(const std::string&, PoolMetrics&)>& visitor) {
+  std::vector<std::pair<std::string, std::shared_ptr<PoolMetrics>>> entries;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries.assign(pools_.begin(), pools_.end());
+  }
+  for (const auto& entry : entries) {
+    visitor(entry.first, *entry.second);
+  }
+}
+
+namespace {
+
+// 一个方法的四个直方图在同一次读取中的窗口值和累计值
+struct MethodRow {
+  MetricsRegistry::Side side;
+  std::string name;
+  MethodStats* stats;
+  HistogramSnapshot window[4];
+  HistogramSnapshot total[4];
+};
+
+Histogram& histogramOf(MethodStats& stats, int index) {
+  switch (index) {
+    case 0: return stats.latency_ns;
+    case 1: return stats.queue_wait_ns;
+    case 2: return stats.request_bytes;
+    default: return stats.response_bytes;
+  }
+}
+
+const char* sideName(MetricsRegistry::Side side) {
+  return side == MetricsRegistry::kServer ? "server" : "client";
+}
+
+std::string escapeLabel(const std::string& value) {
+  std::string out;
+  for (char c : value) {
+    if (c == '\\' || c == '"') {
+      out += '\\';
+      out += c;
+    } else if (c == '\n') {
+      out += "\\n";
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+const double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+}  // namespace
+
+void MetricsRegistry::writePrometheus(std::ostream& out, std::chrono::seconds window) {
+  std::vector<MethodRow> rows;
+  forEachMethod([&](Side side, const std::string& name, MethodStats& stats) {
+    MethodRow row{side, name, &stats, {}, {}};
+    for (int i = 0; i < 4; ++i) {
+      row.window[i] = histogramOf(stats, i).window(window);
+      row.total[i] = histogramOf(stats, i).snapshot();
+    }
+    rows.push_back(std::move(row));
+  });
+
+  struct Family {
+    int histogram;
+    const char* suffix;
+    const char* help;
+    double scale;   // 纳秒换算为秒
+    bool server_only;
+  };
+  static const Family kFamilies[] = {
+      {0, "latency_seconds", "Handler time (server) or end-to-end call time (client)", 1e-9, false},
+      {1, "queue_wait_seconds", "Time from request read to handler start", 1e-9, true},
+      {2, "request_bytes", "Serialized request size", 1, false},
+      {3, "response_bytes", "Serialized response size", 1, false},
+  };
+
+  for (Side side : {kServer, kClient}) {
+    for (const Family& family : kFamilies) {
+      if (family.server_only && side != kServer) {
+        continue;
+      }
+      std::string metric = std::string("prpc_") + sideName(side) + "_" + family.suffix;
+      out << "# HELP " << metric << " " << family.help << ", quantiles over the last "
+          << window.count() << "s\n";
+      out << "# TYPE " << metric << " summary\n";
+      for (const MethodRow& row : rows) {
+        if (row.side != side) {
+          continue;
+        }
+        std::string label = "method=\"" + escapeLabel(row.name) + "\"";
+        for (double q : kQuantiles) {
+          out << metric << "{" << label << ",quantile=\"" << q << "\"} "
+              << row.window[family.histogram].percentile(q) * family.scale << "\n";
+        }
+        out << metric << "_sum{" << label << "} "
+            << row.total[family.histogram].sum * family.scale << "\n";
+        out << metric << "_count{" << label << "} " << row.total[family.histogram].count
+            << "\n";
+      }
+    }
+
+    std::string metric = std::string("prpc_") + sideName(side) + "_errors_total";
+    out << "# HELP " << metric << " Failed calls by error code\n";
+    out << "# TYPE " << metric << " counter\n";
+    for (const MethodRow& row : rows) {
+      if (row.side != side) {
+        continue;
+      }
+      for (const auto& entry : row.stats->errors.counters()) {
+        out << metric << "{method=\"" << escapeLabel(row.name) << "\",code=\""
+            << ErrorCodeToString(entry.first) << "\"} " << entry.second->value() << "\n";
+      }
+    }
+  }
+
+  out << "# HELP prpc_server_frame_errors_total Requests rejected before reaching a method\n";
+  out << "# TYPE prpc_server_frame_errors_total counter\n";
+  for (const auto& entry : serverErrors_.counters()) {
+    out << "prpc_server_frame_errors_total{code=\"" << ErrorCodeToString(entry.first) << "\"} "
+        << entry.second->value() << "\n";
+  }
+
+  std::ostringstream objects, hits, misses, rejected, wait;
+  forEachPool([&](const std::string& name, PoolMetrics& pool) {
+    std::string label = "pool=\"" + escapeLabel(name) + "\"";
+    PoolSample sample = pool.current();
+    objects << "prpc_object_pool_objects{" << label << ",state=\"idle\"} " << sample.idle
+            << "\n"
+            << "prpc_object_pool_objects{" << label << ",state=\"active\"} " << sample.active
+            << "\n";
+    hits << "prpc_object_pool_hits_total{" << label << "} " << sample.hits << "\n";
+    misses << "prpc_object_pool_misses_total{" << label << "} " << sample.misses << "\n";
+    rejected << "prpc_object_pool_rejected_total{" << label << "} " << sample.rejected << "\n";
+    HistogramSnapshot recent = pool.acquire_wait_ns.window(window);
+    HistogramSnapshot total = pool.acquire_wait_ns.snapshot();
+    for (double q : kQuantiles) {
+      wait << "prpc_object_pool_acquire_wait_seconds{" << label << ",quantile=\"" << q
+           << "\"} " << recent.percentile(q) * 1e-9 << "\n";
+    }
+    wait << "prpc_object_pool_acquire_wait_seconds_sum{" << label << "} " << total.sum * 1e-9
+         << "\n"
+         << "prpc_object_pool_acquire_wait_seconds_count{" << label << "} " << total.count
+         << "\n";
+  });
+  out << "# HELP prpc_object_pool_objects Pooled objects by state\n"
+      << "# TYPE prpc_object_pool_objects gauge\n"
+      << objects.str()
+      << "# HELP prpc_object_pool_hits_total Acquires served from the pool\n"
+      << "# TYPE prpc_object_pool_hits_total counter\n"
+      << hits.str()
+      << "# HELP prpc_object_pool_misses_total Acquires that created an object or failed\n"
+      << "# TYPE prpc_object_pool_misses_total counter\n"
+      << misses.str()
+      << "# HELP prpc_object_pool_rejected_total Acquires that failed on a full pool\n"
+      << "# TYPE prpc_object_pool_rejected_total counter\n"
+      << rejected.str()
+      << "# HELP prpc_object_pool_acquire_wait_seconds Wait on a full pool, quantiles over the last "
+      << window.count() << "s\n"
+      << "# TYPE prpc_object_pool_acquire_wait_seconds summary\n"
+      << wait.str();
+}
+
+void MetricsRegistry::writeText(std::ostream& out, std::chrono::seconds window) {
+  std::ios_base::fmtflags flags = out.flags();
+  out << std::fixed << std::setprecision(3);
+  for (Side side : {kServer, kClient}) {
+    out << sideName(side) << " methods, last " << window.count() << "s (latency in ms)\n";
+    out << std::left << std::setw(40) << "method" << std::right << std::setw(10) << "qps"
+        << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99"
+        << std::setw(10) << "p999" << std::setw(10) << "mean";
+    if (side == kServer) {
+      out << std::setw(12) << "queue_p99";
+    }
+    out << std::setw(10) << "req_avg" << std::setw(10) << "resp_avg" << std::setw(8) << "errors"
+        << "\n";
+    forEachMethod([&](Side row_side, const std::string& name, MethodStats& stats) {
+      if (row_side != side) {
+        return;
+      }
+      HistogramSnapshot latency = stats.latency_ns.window(window);
+      uint64_t errors = 0;
+      for (const auto& entry : stats.errors.counters()) {
+        errors += entry.second->window(window).delta;
+      }
+      out << std::left << std::setw(40) << name << std::right << std::setw(10)
+          << latency.rate();
+      for (double q : kQuantiles) {
+        out << std::setw(10) << latency.percentile(q) / 1e6;
+      }
+      out << std::setw(10) << latency.mean() / 1e6;
+      if (side == kServer) {
+        out << std::setw(12) << stats.queue_wait_ns.window(window).percentile(0.99) / 1e6;
+      }
+      out << std::setw(10) << std::setprecision(0) << stats.request_bytes.window(window).mean()
+          << std::setw(10) << stats.response_bytes.window(window).mean() << std::setw(8)
+          << errors << std::setprecision(3) << "\n";
+    });
+    out << "\n";
+  }
+  uint64_t frame_errors = serverErrors_.total();
+  if (frame_errors > 0) {
+    out << "server frame errors (total): " << frame_errors << "\n";
+  }
+  out.flags(flags);
+}
+
+}  // namespace prpc
@@ -0,0 +1,323 @@
+#include "profiler.h"
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace prpc {
+
+namespace {
+
+constexpr int kMaxDepth = 48;
+
+using Stack = std::vector<void*>;
+
+// Resolves return addresses to "function" or "module+0xoffset". Only symbols
+// in the dynamic symbol table are named, so link executables with -rdynamic
+// to see their own functions.
+class Symbolizer {
+ public:
+  const std::string& name(void* pc) {
+    auto it = cache_.find(pc);
+    if (it != cache_.end()) {
+      return it->second;
+    }
+    return cache_.emplace(pc, resolve(pc)).first->second;
+  }
+
+ private:
+  static std::string resolve(void* pc) {
+    Dl_info info;
+    if (dladdr(pc, &info) == 0) {
+      char buf[32];
+      snprintf(buf, sizeof(buf), "%p", pc);
+      return buf;
+    }
+    if (info.dli_sname != nullptr) {
+      int status = 0;
+      char* demangled =
+          abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+      std::string name = status == 0 ? demangled : info.dli_sname;
+      free(demangled);
+      // ';' separates frames in the folded format.
+      std::replace(name.begin(), name.end(), ';', ':');
+      return name;
+    }
+    const char* module = info.dli_fname ? info.dli_fname : "?";
+    const char* slash = strrchr(module, '/');
+    char buf[64];
+    snprintf(buf, sizeof(buf), "+0x%zx",
+             static_cast<size_t>(static_cast<char*>(pc) -
+                                 static_cast<char*>(info.dli_fbase)));
+    return std::string(slash ? slash + 1 : module) + buf;
+  }
+
+  std::unordered_map<void*, std::string> cache_;
+};
+
+// frames[0] is the innermost frame. Return addresses point after the call,
+// so they are moved back by one to land inside the calling line. The leaf of
+// a CPU sample is the exact interrupted pc instead.
+std::string FoldStack(const Stack& frames, Symbolizer& symbols,
+                      bool exact_leaf) {
+  std::string folded;
+  for (size_t i = frames.size(); i-- > 0;) {
+    void* pc = i == 0 && exact_leaf ? frames[i]
+                                    : static_cast<char*>(frames[i]) - 1;
+    if (!folded.empty()) folded += ';';
+    folded += symbols.name(pc);
+  }
+  return folded;
+}
+
+std::string WriteFolded(std::map<std::string, uint64_t>& weights) {
+  std::vector<std::pair<std::string, uint64_t>> sorted(weights.begin(),
+                                                       weights.end());
+  std::sort(sorted.begin(), sorted.end(),
+            [](const std::pair<std::string, uint64_t>& a,
+               const std::pair<std::string, uint64_t>& b) {
+              return a.second > b.second;
+            });
+  std::ostringstream out;
+  for (const auto& entry : sorted) {
+    out << entry.first << ' ' << entry.second << '\n';
+  }
+  return out.str();
+}
+
+// ---- CPU sampling ----
+
+struct CpuSample {
+  int depth;
+  void* pcs[kMaxDepth];
+};
+
+std::atomic<bool> g_cpuRunning{false};
+std::atomic<bool> g_cpuCollecting{false};
+std::atomic<int> g_inHandler{0};
+std::atomic<size_t> g_nextSample{0};
+std::atomic<uint64_t> g_cpuDropped{0};
+CpuSample* g_samples = nullptr;
+
+void OnSigprof(int) {
+  int saved_errno = errno;
+  // Paired with the teardown in CpuProfiler::collect(): either the teardown
+  // sees this handler in flight and waits for it, or the handler sees
+  // collection stopped and leaves the buffer alone.
+  g_inHandler.fetch_add(1);
+  if (g_cpuCollecting.load()) {
+    size_t slot = g_nextSample.fetch_add(1, std::memory_order_relaxed);
+    if (slot < CpuProfiler::kMaxSamples) {
+      g_samples[slot].depth = backtrace(g_samples[slot].pcs, kMaxDepth);
+    } else {
+      g_cpuDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  g_inHandler.fetch_sub(1);
+  errno = saved_errno;
+}
+
+// ---- lock contention ----
+
+struct ContentionKey {
+  const char* lock;
+  Stack frames;
+
+  bool operator<(const ContentionKey& other) const {
+    return lock != other.lock ? lock < other.lock : frames < other.frames;
+  }
+};
+
+std::atomic<bool> g_contentionRunning{false};
+std::atomic<uint64_t> g_contentionThreshold{0};  // sampled when random < it
+std::mutex g_contentionMutex;
+std::map<ContentionKey, uint64_t> g_contentionWaitNs;
+uint64_t g_contentionOtherNs = 0;
+
+uint64_t NextRandom() {
+  thread_local uint64_t state =
+      reinterpret_cast<uintptr_t>(&state) ^
+      static_cast<uint64_t>(
+          std::chrono::steady_clock::now().time_since_epoch().count());
+  uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+}  // namespace
+
+Result<std::string> CpuProfiler::collect(std::chrono::seconds duration,
+                                         int hz) {
+  if (duration.count() < 1 || duration.count() > kMaxSeconds || hz < 1 ||
+      hz > kMaxHz) {
+    return Result<std::string>(ErrorCode::INVALID_ARGUMENT,
+                               "seconds must be 1-" +
+                                   std::to_string(kMaxSeconds) +
+                                   " and hz 1-" + std::to_string(kMaxHz));
+  }
+  if (g_cpuRunning.exchange(true)) {
+    return Result<std::string>(ErrorCode::RESOURCE_ERROR,
+                               "a cpu profile is already running");
+  }
+
+  std::unique_ptr<CpuSample[]> samples(new CpuSample[kMaxSamples]);
+  g_samples = samples.get();
+  g_nextSample.store(0);
+  g_cpuDropped.store(0);
+
+  // The first backtrace() loads the unwinder, which is not safe to do from
+  // a signal handler.
+  void* warmup[4];
+  backtrace(warmup, 4);
+
+  struct sigaction action;
+  struct sigaction previous;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = OnSigprof;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, &previous) != 0) {
+    g_cpuRunning.store(false);
+    return Result<std::string>(ErrorCode::RESOURCE_ERROR,
+                               "install SIGPROF handler failed");
+  }
+  g_cpuCollecting.store(true);
+
+  struct itimerval timer;
+  timer.it_interval.tv_sec = 0;
+  timer.it_interval.tv_usec = 1000000 / hz;
+  timer.it_value = timer.it_interval;
+  setitimer(ITIMER_PROF, &timer, nullptr);
+
+  std::this_thread::sleep_for(duration);
+
+  memset(&timer, 0, sizeof(timer));
+  setitimer(ITIMER_PROF, &timer, nullptr);
+  g_cpuCollecting.store(false);
+  // A SIGPROF still pending must not reach the previous disposition, which
+  // is usually the default action of terminating the process.
+  signal(SIGPROF, SIG_IGN);
+  while (g_inHandler.load() != 0) {
+    std::this_thread::yield();
+  }
+  sigaction(SIGPROF, &previous, nullptr);
+
+  size_t collected = std::min(g_nextSample.load(), kMaxSamples);
+  // Frame 0 is the handler and frame 1 the signal trampoline; frame 2 is
+  // the interrupted pc.
+  const int kSkip = 2;
+  std::map<Stack, uint64_t> stacks;
+  for (size_t i = 0; i < collected; ++i) {
+    const CpuSample& sample = samples[i];
+    if (sample.depth > kSkip) {
+      ++stacks[Stack(sample.pcs + kSkip, sample.pcs + sample.depth)];
+    }
+  }
+  Symbolizer symbols;
+  std::map<std::string, uint64_t> folded;
+  for (const auto& stack : stacks) {
+    folded[FoldStack(stack.first, symbols, true)] +=
+        stack.second;
+  }
+  uint64_t dropped = g_cpuDropped.load();
+  if (dropped > 0) {
+    folded["[dropped]"] = dropped;
+  }
+
+  g_samples = nullptr;
+  g_cpuRunning.store(false);
+  return Result<std::string>(WriteFolded(folded));
+}
+
+std::atomic<bool> ContentionProfiler::active_{false};
+
+Result<std::string> ContentionProfiler::collect(std::chrono::seconds duration,
+                                                double sampleRate) {
+  if (duration.count() < 1 || duration.count() > kMaxSeconds ||
+      !(sampleRate > 0 && sampleRate <= 1)) {
+    return Result<std::string>(ErrorCode::INVALID_ARGUMENT,
+                               "seconds must be 1-" +
+                                   std::to_string(kMaxSeconds) +
+                                   " and rate in (0, 1]");
+  }
+  if (g_contentionRunning.exchange(true)) {
+    return Result<std::string>(ErrorCode::RESOURCE_ERROR,
+                               "a contention profile is already running");
+  }
+  {
+    std::lock_guard<std::mutex> lock(g_contentionMutex);
+    g_contentionWaitNs.clear();
+    g_contentionOtherNs = 0;
+  }
+  g_contentionThreshold.store(
+      sampleRate >= 1 ? UINT64_MAX
+                      : static_cast<uint64_t>(sampleRate *
+                                              18446744073709551616.0));
+  active_.store(true);
+  std::this_thread::sleep_for(duration);
+  active_.store(false);
+
+  std::map<ContentionKey, uint64_t> waits;
+  uint64_t other_ns;
+  {
+    std::lock_guard<std::mutex> lock(g_contentionMutex);
+    waits.swap(g_contentionWaitNs);
+    other_ns = g_contentionOtherNs;
+  }
+  Symbolizer symbols;
+  std::map<std::string, uint64_t> folded;
+  for (const auto& wait : waits) {
+    std::string stack = FoldStack(wait.first.frames, symbols, false);
+    stack += stack.empty() ? "[lock:" : ";[lock:";
+    stack += wait.first.lock;
+    stack += ']';
+    folded[stack] += std::max<uint64_t>(wait.second / 1000, 1);
+  }
+  if (other_ns > 0) {
+    folded["[other]"] = std::max<uint64_t>(other_ns / 1000, 1);
+  }
+
+  g_contentionRunning.store(false);
+  return Result<std::string>(WriteFolded(folded));
+}
+
+void ContentionProfiler::record(const char* lockName,
+                                std::chrono::steady_clock::duration wait) {
+  uint64_t threshold = g_contentionThreshold.load(std::memory_order_relaxed);
+  if (threshold != UINT64_MAX && NextRandom() >= threshold) {
+    return;
+  }
+  void* pcs[kMaxDepth];
+  int depth = backtrace(pcs, kMaxDepth);
+  // Skip this function so the innermost frame is the lock's caller.
+  ContentionKey key{lockName, Stack(pcs + std::min(depth, 1), pcs + depth)};
+  uint64_t wait_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(wait).count();
+
+  std::lock_guard<std::mutex> lock(g_contentionMutex);
+  auto it = g_contentionWaitNs.find(key);
+  if (it != g_contentionWaitNs.end()) {
+    it->second += wait_ns;
+  } else if (g_contentionWaitNs.size() < kMaxStacks) {
+    g_contentionWaitNs.emplace(std::move(key), wait_ns);
+  } else {
+    g_contentionOtherNs += wait_ns;
+  }
+}
+
+}  // namespace prpc
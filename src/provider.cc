@@ -4,26 +4,159 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <chrono>
+#include <cstring>
+#include <ctime>
 #include <functional>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "application.h"
+#include "binary_log.h"
+#include "capture.h"
+#include "cpu_affinity.h"
+#include "fiber.h"
 #include "header.pb.h"
 #include "logger.h"
+#include "message_pool.h"
+#include "pool_monitor.h"
+#include "profiler.h"
+#include "rpc_frame.h"
+#include "status_server.h"
 #include "threadpool.h"
-#include "zookeeperutil.h"
+#include "trace.h"
 
 // Constructor definition
 Pprovider::Pprovider()
-    : m_threadPool(std::make_unique<ThreadPool>()),
-      m_zkClient(std::make_unique<ZkClient>()) {}
+    : m_registry(ServiceRegistry::Create()),
+      m_stopFd(eventfd(0, EFD_CLOEXEC)),
+      m_maxRequestBytes(static_cast<uint64_t>(Papplication::Config()->GetInt(
+                            "rpcserver_max_request_mb", 64))
+                        << 20) {
+  CreateExecutor();
+}
 
 // Destructor definition - THIS IS IMPORTANT
-Pprovider::~Pprovider() {}
+Pprovider::~Pprovider() {
+  for (uint64_t id : m_configWatchers) {
+    Papplication::GetConfig().RemoveOnChange(id);
+  }
+  m_statusServer.reset();
+  // Let queued and running handlers finish before their connections close.
+  m_fiberScheduler.reset();
+  m_workerGroups.clear();
+  for (auto &conn : m_connections) {
+    close(conn.first);
+  }
+  for (int epollfd : m_epollFds) {
+    close(epollfd);
+  }
+  close(m_stopFd);
+}
+
+// rpcserver_executor=fiber runs every request on its own fiber, so handlers
+// that block on nested rpcs hold a fiber stack instead of a worker thread.
+// The fiber run queue is FIFO; the priority and deadline policies only apply
+// to the default thread pool executor.
+void Pprovider::CreateExecutor() {
+  ConfigSnapshotPtr snapshot = Papplication::Config();
+  const ConfigSnapshot &config = *snapshot;
+  if (config.Get("rpcserver_executor") != "fiber") {
+    CreateWorkerGroups();
+    return;
+  }
+  int threads = config.GetInt("rpcserver_fiber_threads");
+  if (threads <= 0) {
+    threads = std::thread::hardware_concurrency();
+  }
+  size_t stack_kb = config.GetInt("rpcserver_fiber_stack_kb");
+  m_fiberScheduler = std::make_unique<FiberScheduler>(
+      threads,
+      stack_kb > 0 ? stack_kb * 1024 : FiberScheduler::kDefaultStackSize);
+  LOG(INFO) << "fiber executor: " << threads << " threads";
+}
+
+// rpcserver_worker_cpus pins one worker per listed cpu and groups the workers
+// by NUMA node, so a request is handled on the node that received it.
+void Pprovider::CreateWorkerGroups() {
+  ConfigSnapshotPtr snapshot = Papplication::Config();
+  const ConfigSnapshot &config = *snapshot;
+  std::vector<int> cpus =
+      prpc::affinity::parseCpuList(config.Get("rpcserver_worker_cpus"));
+  if (cpus.empty()) {
+    m_workerGroups.push_back({-1, std::make_unique<ThreadPool>()});
+  } else {
+    std::map<int, std::vector<int>> node_cpus;
+    for (int cpu : cpus) {
+      node_cpus[prpc::affinity::cpuToNode(cpu)].push_back(cpu);
+    }
+    for (auto &nc : node_cpus) {
+      LOG(INFO) << "worker group node " << nc.first << ": "
+                << nc.second.size() << " pinned workers";
+      m_workerGroups.push_back(
+          {nc.first,
+           std::make_unique<ThreadPool>(nc.second.size(), nc.second)});
+    }
+  }
+
+  // rpcserver_queue_policy=strict|weighted|edf,
+  // rpcserver_queue_weights=8,4,1, rpcserver_edf_max_wait_ms=1000
+  const std::string &policy = config.Get("rpcserver_queue_policy");
+  if (policy == "edf") {
+    for (auto &group : m_workerGroups) {
+      group.pool->setQueuePolicy(ThreadPool::QueuePolicy::kEarliestDeadline);
+    }
+    ApplyEdfMaxWait(config);
+    m_configWatchers.push_back(Papplication::GetConfig().OnChange(
+        "rpcserver_edf_max_wait_ms",
+        [this](const ConfigSnapshot &now) { ApplyEdfMaxWait(now); }));
+  } else if (policy == "weighted") {
+    ApplyQueueWeights(config);
+    m_configWatchers.push_back(Papplication::GetConfig().OnChange(
+        "rpcserver_queue_weights",
+        [this](const ConfigSnapshot &now) { ApplyQueueWeights(now); }));
+  }
+}
+
+// The queue policy and the number of workers are fixed for the life of the
+// provider; the weights and the edf wait limit can be retuned by a reload.
+void Pprovider::ApplyQueueWeights(const ConfigSnapshot &config) {
+  for (auto &group : m_workerGroups) {
+    group.pool->setQueuePolicy(ThreadPool::QueuePolicy::kWeighted,
+                               config.queue_weights);
+  }
+}
+
+void Pprovider::ApplyEdfMaxWait(const ConfigSnapshot &config) {
+  if (config.edf_max_wait_ms <= 0) {
+    return;
+  }
+  for (auto &group : m_workerGroups) {
+    group.pool->setStarvationLimit(
+        std::chrono::milliseconds(config.edf_max_wait_ms));
+  }
+}
+
+ThreadPool *Pprovider::PoolForCpu(int cpu) {
+  if (cpu >= 0 && m_workerGroups.size() > 1) {
+    int node = prpc::affinity::cpuToNode(cpu);
+    for (auto &group : m_workerGroups) {
+      if (group.node == node) {
+        return group.pool.get();
+      }
+    }
+  }
+  return m_workerGroups.front().pool.get();
+}
 
 void Pprovider::NotifyService(google::protobuf::Service *service) {
   ServiceInfo service_info;
@@ -35,44 +168,116 @@ void Pprovider::NotifyService(google::protobuf::Service *service) {
 
   LOG(INFO) << "service_name: " << service_name;
 
+  ConfigSnapshotPtr snapshot = Papplication::Config();
+  const ConfigSnapshot &config = *snapshot;
   for (int i = 0; i < method_cnt; ++i) {
     const google::protobuf::MethodDescriptor *pmethodDesc =
         pserviceDesc->method(i);
     std::string method_name(pmethodDesc->name());
-    service_info.m_methodMap.insert({method_name, pmethodDesc});
+    MethodInfo method_info;
+    method_info.m_descriptor = pmethodDesc;
+    method_info.m_stats = &prpc::MetricsRegistry::getInstance().method(
+        prpc::MetricsRegistry::kServer, service_name, method_name);
+    std::string full_name(pmethodDesc->full_name());
+    prpc::MessagePool &message_pool = prpc::MessagePool::getInstance();
+    method_info.m_requestSizes = message_pool.payloadHistogram(full_name);
+    method_info.m_responseSizes =
+        message_pool.payloadHistogram(full_name + "#response");
+    method_info.m_profile = config.ResolveMethod(service_name, method_name);
+    method_info.m_priority =
+        method_info.m_profile.priority != 0
+            ? static_cast<RpcPriority>(method_info.m_profile.priority)
+            : RpcPriority::kNormal;
+    service_info.m_methodMap.insert({method_name, method_info});
     LOG(INFO) << "method_name: " << method_name;
   }
   service_info.m_service = service;
   m_serviceMap.insert({service_name, service_info});
 }
+void Pprovider::SetMethodPriority(const std::string &service_name,
+                                  const std::string &method_name,
+                                  RpcPriority priority) {
+  auto sit = m_serviceMap.find(service_name);
+  if (sit == m_serviceMap.end() ||
+      !sit->second.m_methodMap.count(method_name)) {
+    LOG(ERROR) << service_name << ":" << method_name << " is not exist!";
+    return;
+  }
+  sit->second.m_methodMap[method_name].m_priority = priority;
+}
+
 void Pprovider::RegisterServices() {
-  std::string ip = Papplication::GetInstance().GetConfig().Load("rpcserverip");
-  uint16_t port = atoi(
-      Papplication::GetInstance().GetConfig().Load("rpcserverport").c_str());
+  ConfigSnapshotPtr snapshot = Papplication::Config();
+  const ConfigSnapshot &config = *snapshot;
+  std::string host =
+      config.rpcserver_ip + ":" + std::to_string(config.rpcserver_port);
   for (auto &sp : m_serviceMap) {
-    std::string service_path = "/" + sp.first;
-    m_zkClient->Create(service_path.c_str(), nullptr, 0);
     for (auto &mp : sp.second.m_methodMap) {
-      std::string method_path = service_path + "/" + mp.first;
-      char method_path_data[128] = {0};
-      sprintf(method_path_data, "%s:%d", ip.c_str(), port);
-      m_zkClient->Create(method_path.c_str(), method_path_data,
-                         strlen(method_path_data), ZOO_EPHEMERAL);
+      m_registry->Register(sp.first, mp.first, host);
     }
   }
 }
 
-void Pprovider::OnZkSessionExpired() {
+void Pprovider::OnRegistryExpired() {
   LOG(ERROR)
-      << "ZK session expired, re-connecting and re-registering services...";
-  m_zkClient->Start(std::bind(&Pprovider::OnZkSessionExpired, this));
+      << "registry session expired, re-connecting and re-registering services...";
+  m_registry->Start(std::bind(&Pprovider::OnRegistryExpired, this));
   RegisterServices();
 }
 
 void Pprovider::Run() {
-  std::string ip = Papplication::GetInstance().GetConfig().Load("rpcserverip");
-  uint16_t port = atoi(
-      Papplication::GetInstance().GetConfig().Load("rpcserverport").c_str());
+  ConfigSnapshotPtr snapshot = Papplication::Config();
+  const ConfigSnapshot &config = *snapshot;
+  const std::string ip = config.rpcserver_ip;
+  uint16_t port = config.rpcserver_port;
+  std::vector<int> reactor_cpus =
+      prpc::affinity::parseCpuList(config.Get("rpcserver_reactor_cpus"));
+
+  // One listening socket per reactor cpu. With SO_REUSEPORT and
+  // SO_INCOMING_CPU the kernel hands each connection to the reactor on the
+  // core that services its interrupts.
+  std::vector<int> listenfds;
+  if (reactor_cpus.empty()) {
+    listenfds.push_back(CreateListenFd(ip, port, -1));
+  } else {
+    for (int cpu : reactor_cpus) {
+      listenfds.push_back(CreateListenFd(ip, port, cpu));
+    }
+  }
+  LOG(INFO) << "Rpc provider start service at ip:" << ip << " port:" << port;
+  StartStatusServer(ip);
+
+  m_registry->Start(std::bind(&Pprovider::OnRegistryExpired, this));
+  RegisterServices();
+
+  std::vector<std::thread> reactors;
+  for (size_t i = 1; i < listenfds.size(); ++i) {
+    reactors.emplace_back(&Pprovider::EventLoop, this, listenfds[i],
+                          reactor_cpus[i]);
+  }
+  EventLoop(listenfds[0], reactor_cpus.empty() ? -1 : reactor_cpus[0]);
+  for (auto &reactor : reactors) {
+    reactor.join();
+  }
+
+  // Wakes handlers blocked on a connection; the destructor closes the
+  // connections left once they are done.
+  std::lock_guard<std::mutex> lock(m_connMutex);
+  for (auto &conn : m_connections) {
+    shutdown(conn.first, SHUT_RDWR);
+  }
+  LOG(INFO) << "Rpc provider stopped";
+}
+
+void Pprovider::Stop() {
+  uint64_t one = 1;
+  if (write(m_stopFd, &one, sizeof(one)) < 0) {
+    LOG(ERROR) << "rpc provider stop failed, errno " << errno;
+  }
+}
+
+int Pprovider::CreateListenFd(const std::string &ip, uint16_t port,
+                              int incoming_cpu) {
   struct sockaddr_in server_addr;
   server_addr.sin_family = AF_INET;
   server_addr.sin_port = htons(port);
@@ -85,28 +290,50 @@ void Pprovider::Run() {
 
   int opt = 1;
   setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+  if (incoming_cpu >= 0) {
+    setsockopt(listenfd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+    if (!prpc::affinity::setIncomingCpu(listenfd, incoming_cpu)) {
+      LOG(WARN) << "SO_INCOMING_CPU not supported, cpu " << incoming_cpu;
+    }
+  }
 
   if (bind(listenfd, (struct sockaddr *)&server_addr, sizeof(server_addr)) ==
       -1) {
     LOG(FATAL) << "bind error!";
   }
 
-  if (listen(listenfd, 20) == -1) {
+  if (listen(listenfd, SOMAXCONN) == -1) {
     LOG(FATAL) << "listen error!";
   }
-  LOG(INFO) << "Rpc provider start service at ip:" << ip << " port:" << port;
+  // Accepted sockets do not inherit O_NONBLOCK; handlers read them blocking.
+  fcntl(listenfd, F_SETFL, fcntl(listenfd, F_GETFL, 0) | O_NONBLOCK);
+  return listenfd;
+}
 
-  m_zkClient->Start(std::bind(&Pprovider::OnZkSessionExpired, this));
-  RegisterServices();
+void Pprovider::EventLoop(int listenfd, int reactor_cpu) {
+  if (reactor_cpu >= 0) {
+    prpc::affinity::pinCurrentThread(reactor_cpu);
+  }
+  // Worker group chosen per connection from the cpu that received it.
+  std::unordered_map<int, ThreadPool *> conn_pools;
 
   int epollfd = epoll_create1(0);
+  {
+    std::lock_guard<std::mutex> lock(m_connMutex);
+    m_epollFds.push_back(epollfd);
+  }
   epoll_event events[1024];
   epoll_event event;
   event.events = EPOLLIN | EPOLLET;
   event.data.fd = listenfd;
   epoll_ctl(epollfd, EPOLL_CTL_ADD, listenfd, &event);
+  // Level-triggered and never read, so every reactor sees it.
+  event.events = EPOLLIN;
+  event.data.fd = m_stopFd;
+  epoll_ctl(epollfd, EPOLL_CTL_ADD, m_stopFd, &event);
 
-  while (true) {
+  bool stopping = false;
+  while (!stopping) {
     int nfds = epoll_wait(epollfd, events, 1024, -1);
     if (nfds == -1) {
       if (errno == EINTR) continue;
@@ -116,103 +343,593 @@ void Pprovider::Run() {
 
     for (int i = 0; i < nfds; ++i) {
       int sockfd = events[i].data.fd;
-      if (sockfd == listenfd) {
-        struct sockaddr_in client_addr;
-        socklen_t client_addr_len = sizeof(client_addr);
-        int connfd =
-            accept(listenfd, (struct sockaddr *)&client_addr, &client_addr_len);
-        if (connfd < 0) {
-          LOG(ERROR) << "accept error";
-          continue;
-        }
-        LOG(INFO) << "new connection accepted.";
+      if (sockfd == m_stopFd) {
+        stopping = true;
+      } else if (sockfd == listenfd) {
+        // Edge-triggered: accept everything queued, or connections that
+        // arrived together wait in the backlog until the next one.
+        while (true) {
+          struct sockaddr_in client_addr;
+          socklen_t client_addr_len = sizeof(client_addr);
+          int connfd = accept(listenfd, (struct sockaddr *)&client_addr,
+                              &client_addr_len);
+          if (connfd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+              LOG_EVERY_T(ERROR, 1.0) << "accept error, errno " << errno;
+            }
+            break;
+          }
+          LOG(DEBUG) << "new connection accepted, fd " << connfd;
+          {
+            char addr[INET_ADDRSTRLEN] = {0};
+            inet_ntop(AF_INET, &client_addr.sin_addr, addr, sizeof(addr));
+            std::lock_guard<std::mutex> lock(m_connMutex);
+            m_connections[connfd] = {
+                std::string(addr) + ":" +
+                    std::to_string(ntohs(client_addr.sin_port)),
+                reactor_cpu, std::chrono::system_clock::now()};
+          }
+
+          if (!m_fiberScheduler) {
+            int cpu = prpc::affinity::incomingCpu(connfd);
+            conn_pools[connfd] = PoolForCpu(cpu >= 0 ? cpu : reactor_cpu);
+          }
 
-        event.data.fd = connfd;
-        event.events = EPOLLIN | EPOLLET;
-        epoll_ctl(epollfd, EPOLL_CTL_ADD, connfd, &event);
+          event.data.fd = connfd;
+          event.events = EPOLLIN | EPOLLET | EPOLLONESHOT;
+          epoll_ctl(epollfd, EPOLL_CTL_ADD, connfd, &event);
+        }
+      } else if ((events[i].events & EPOLLIN) && m_fiberScheduler) {
+        m_fiberScheduler->spawn([this, sockfd, epollfd]() {
+          HandleClientRequest(sockfd, epollfd, nullptr);
+        });
       } else if (events[i].events & EPOLLIN) {
-        m_threadPool->submit(
-            std::bind(&Pprovider::HandleClientRequest, this, sockfd));
+        auto it = conn_pools.find(sockfd);
+        ThreadPool *pool =
+            it != conn_pools.end() ? it->second : PoolForCpu(reactor_cpu);
+        pool->submitWithPriority(
+            ThreadPool::kHigh,
+            std::bind(&Pprovider::HandleClientRequest, this, sockfd, epollfd,
+                      pool));
       }
     }
   }
   close(listenfd);
-  close(epollfd);
+  // Handlers still running re-arm their connections in epollfd, so it is
+  // closed by the destructor once they are done.
 }
 
-void Pprovider::HandleClientRequest(int clientfd) {
-  int header_size = 0;
-  int n = recv(clientfd, &header_size, 4, 0);
+// Stage one, submitted at high priority by the reactor: read and route the
+// frame. The handler itself is queued at the request's priority class.
+void Pprovider::HandleClientRequest(int clientfd, int epollfd,
+                                    ThreadPool *pool) {
+  auto arrival = std::chrono::steady_clock::now();
+  char length_buf[prpc::kFrameLengthSize];
+  int n = fiber::recvAll(clientfd, length_buf, sizeof(length_buf), 0);
   if (n <= 0) {
-    close(clientfd);
+    CloseConnection(clientfd);
+    return;
+  }
+  bool checksum = false;
+  uint32_t header_size = prpc::decodeFrameLength(length_buf, &checksum);
+  // A corrupted length must not turn into a huge allocation; the stream can
+  // not be resynchronized, so the connection is dropped.
+  if (header_size == 0 || header_size > prpc::kMaxHeaderSize) {
+    prpc::MetricsRegistry::getInstance().serverErrors().add(
+        prpc::ErrorCode::SERIALIZATION_ERROR);
+    LOG_RATE_LIMITED(ERROR, 10, 20) << "invalid rpc header size " << header_size;
+    CloseConnection(clientfd);
     return;
   }
 
   std::string rpc_header_str(header_size, '\0');
-  n = recv(clientfd, &rpc_header_str[0], header_size, 0);
+  n = fiber::recvAll(clientfd, &rpc_header_str[0], header_size, 0);
   if (n <= 0) {
-    close(clientfd);
+    CloseConnection(clientfd);
     return;
   }
 
   Prpc::RpcHeader rpcHeader;
   if (!rpcHeader.ParseFromString(rpc_header_str)) {
-    LOG(ERROR) << "rpc_header_str parse error!";
-    close(clientfd);
+    prpc::MetricsRegistry::getInstance().serverErrors().add(
+        prpc::ErrorCode::SERIALIZATION_ERROR);
+    LOG_RATE_LIMITED(ERROR, 10, 20) << "rpc_header_str parse error!";
+    CloseConnection(clientfd);
     return;
   }
 
   std::string service_name = rpcHeader.service_name();
   std::string method_name = rpcHeader.method_name();
   uint32_t args_size = rpcHeader.args_size();
-
-  std::string args_str(args_size, '\0');
-  n = recv(clientfd, &args_str[0], args_size, 0);
-  if (n <= 0) {
-    close(clientfd);
+  if (args_size > m_maxRequestBytes) {
+    prpc::MetricsRegistry::getInstance().serverErrors().add(
+        prpc::ErrorCode::RESOURCE_ERROR);
+    LOG_RATE_LIMITED(ERROR, 10, 20)
+        << service_name << ":" << method_name << " request of " << args_size
+        << " bytes exceeds rpcserver_max_request_mb";
+    CloseConnection(clientfd);
     return;
   }
 
+  // The args are read into a pooled buffer of the size class the method's
+  // recent requests fit in. Frames for unknown methods are still read, into
+  // an unpooled buffer, so they can be captured before being rejected below.
+  const MethodInfo *method = nullptr;
   auto sit = m_serviceMap.find(service_name);
+  if (sit != m_serviceMap.end()) {
+    auto mit = sit->second.m_methodMap.find(method_name);
+    if (mit != sit->second.m_methodMap.end()) {
+      method = &mit->second;
+    }
+  }
+  // The checksum trailer is read together with the args.
+  size_t trailer = checksum ? prpc::kFrameChecksumSize : 0;
+  prpc::MessagePool::BufferPoolType::PooledObject args =
+      method != nullptr
+          ? prpc::MessagePool::getInstance().acquireBufferFor(
+                *method->m_requestSizes)
+          : prpc::MessagePool::BufferPoolType::PooledObject(
+                std::make_unique<prpc::NetworkBuffer>(args_size + trailer),
+                nullptr);
+  args->data.resize(args_size + trailer);
+  n = fiber::recvAll(clientfd, args->data.data(), args->data.size(), 0);
+  if (n < 0 || (n == 0 && !args->data.empty())) {
+    CloseConnection(clientfd);
+    return;
+  }
+  if (checksum) {
+    uint32_t expected = prpc::decodeFrameChecksum(&args->data[args_size]);
+    args->data.resize(args_size);
+    uint32_t crc = prpc::crc32c(length_buf, sizeof(length_buf));
+    crc = prpc::crc32c(rpc_header_str.data(), rpc_header_str.size(), crc);
+    crc = prpc::crc32c(args->data.data(), args_size, crc);
+    if (crc != expected) {
+      prpc::MetricsRegistry::getInstance().serverErrors().add(
+          prpc::ErrorCode::SERIALIZATION_ERROR);
+      LOG_RATE_LIMITED(ERROR, 10, 20) << service_name << ":" << method_name
+                                      << " request checksum mismatch";
+      CloseConnection(clientfd);
+      return;
+    }
+  }
+  epoll_event rearm;
+  rearm.events = EPOLLIN | EPOLLET | EPOLLONESHOT;
+  rearm.data.fd = clientfd;
+  epoll_ctl(epollfd, EPOLL_CTL_MOD, clientfd, &rearm);
+
+  if (prpc::TrafficCapture::enabled()) {
+    prpc::TrafficCapture::getInstance().record(
+        arrival, rpc_header_str,
+        std::string(reinterpret_cast<const char *>(args->data.data()),
+                    args_size));
+  }
+
   if (sit == m_serviceMap.end()) {
-    LOG(ERROR) << service_name << " is not exist!";
-    close(clientfd);
+    prpc::MetricsRegistry::getInstance().serverErrors().add(
+        prpc::ErrorCode::SERVICE_ERROR);
+    LOG_RATE_LIMITED(ERROR, 10, 20) << service_name << " is not exist!";
+    CloseConnection(clientfd);
     return;
   }
-  auto mit = sit->second.m_methodMap.find(method_name);
-  if (mit == sit->second.m_methodMap.end()) {
-    LOG(ERROR) << service_name << ":" << method_name << " is not exist!";
-    close(clientfd);
+  if (method == nullptr) {
+    prpc::MetricsRegistry::getInstance().serverErrors().add(
+        prpc::ErrorCode::SERVICE_ERROR);
+    LOG_RATE_LIMITED(ERROR, 10, 20) << service_name << ":" << method_name
+                                    << " is not exist!";
+    CloseConnection(clientfd);
     return;
   }
 
-  google::protobuf::Service *service = sit->second.m_service;
-  const google::protobuf::MethodDescriptor *methodDesc = mit->second;
+  RpcPriority priority = static_cast<RpcPriority>(rpcHeader.priority());
+  if (priority < RpcPriority::kHigh || priority > RpcPriority::kLow) {
+    priority = method->m_priority;
+  }
+  int level = static_cast<int>(priority) - static_cast<int>(RpcPriority::kHigh);
+  BLOG(INFO, "request {}.{} fd {} args {} bytes priority {} timeout {}ms",
+       service_name, method_name, clientfd, args_size, level, rpcHeader.timeout_ms());
+
+  // The caller's remaining budget, measured from when the frame was picked up.
+  // Callers that send none get the method's configured timeout_ms.
+  uint32_t timeout_ms = rpcHeader.timeout_ms() > 0 ? rpcHeader.timeout_ms()
+                                                   : method->m_profile.timeout_ms;
+  auto deadline = std::chrono::steady_clock::time_point::max();
+  if (timeout_ms > 0) {
+    deadline = arrival + std::chrono::milliseconds(timeout_ms);
+  }
+
+  method->m_stats->request_bytes.record(args_size);
+  method->m_requestSizes->record(args_size);
+
+  prpc::TraceContext caller;
+  caller.trace_id = rpcHeader.trace_id();
+  caller.span_id = rpcHeader.span_id();
+  caller.sampled = rpcHeader.sampled();
+  caller.deadline = deadline;
+
+  // executor=inline methods are short enough to run right here, skipping the
+  // second queue hop and its priority scheduling.
+  auto enqueued = std::chrono::steady_clock::now();
+  if (pool == nullptr || method->m_profile.run_inline) {
+    ProcessRequest(clientfd, sit->second.m_service, method, caller, enqueued,
+                   checksum, std::move(args));
+    return;
+  }
+  pool->submitWithDeadline(
+      deadline, level,
+      [this, clientfd, service = sit->second.m_service, method, caller,
+       enqueued, checksum, args = std::move(args)]() mutable {
+        ProcessRequest(clientfd, service, method, caller, enqueued, checksum,
+                       std::move(args));
+      });
+}
+
+namespace {
+
+void SubmitServerSpan(const prpc::TraceContext &span, uint64_t parent_span_id,
+                      const google::protobuf::MethodDescriptor *methodDesc,
+                      int64_t start_us, prpc::ErrorCode error) {
+  prpc::Span finished;
+  finished.trace_id = span.trace_id;
+  finished.span_id = span.span_id;
+  finished.parent_span_id = parent_span_id;
+  finished.name = methodDesc->service()->name() + "." + methodDesc->name();
+  finished.kind = prpc::Span::kServer;
+  finished.start_us = start_us;
+  finished.duration_us = prpc::Tracer::nowUs() - start_us;
+  finished.error = error;
+  prpc::Tracer::getInstance().submit(std::move(finished));
+}
+
+}  // namespace
+
+void Pprovider::ProcessRequest(
+    int clientfd, google::protobuf::Service *service, const MethodInfo *method,
+    const prpc::TraceContext &caller,
+    std::chrono::steady_clock::time_point enqueued, bool checksum,
+    prpc::MessagePool::BufferPoolType::PooledObject args) {
+  const google::protobuf::MethodDescriptor *methodDesc = method->m_descriptor;
+  prpc::MethodStats *stats = method->m_stats;
+  auto start = std::chrono::steady_clock::now();
+  stats->queue_wait_ns.recordDuration(start - enqueued);
+
+  // The server span is a child of the caller's client span; rpcs the handler
+  // makes pick it up through the current trace context.
+  prpc::TraceContext span = prpc::Tracer::getInstance().newSpan(caller);
+  int64_t span_start_us = span.sampled ? prpc::Tracer::nowUs() : 0;
+  // Nested calls from the handler are bounded by this request's deadline.
+  span.deadline = caller.deadline;
 
   google::protobuf::Message *request =
       service->GetRequestPrototype(methodDesc).New();
-  if (!request->ParseFromString(args_str)) {
-    LOG(ERROR) << "request parse error, content:" << args_str;
+  if (!request->ParseFromArray(args->data.data(),
+                               static_cast<int>(args->data.size()))) {
+    stats->errors.add(prpc::ErrorCode::SERIALIZATION_ERROR);
+    if (span.sampled) {
+      SubmitServerSpan(span, caller.span_id, methodDesc, span_start_us,
+                       prpc::ErrorCode::SERIALIZATION_ERROR);
+    }
+    LOG_RATE_LIMITED(ERROR, 10, 20)
+        << "request parse error, content:"
+        << std::string(reinterpret_cast<const char *>(args->data.data()),
+                       args->data.size());
     delete request;
-    close(clientfd);
+    CloseConnection(clientfd);
     return;
   }
   google::protobuf::Message *response =
       service->GetResponsePrototype(methodDesc).New();
 
   google::protobuf::Closure *done = new LambdaClosure([this, clientfd, request,
-                                                       response]() {
-    std::string response_str;
-    if (response->SerializeToString(&response_str)) {
-      if (send(clientfd, response_str.c_str(), response_str.size(), 0) < 0) {
-        LOG(ERROR) << "send response error!";
+                                                       response, stats, start,
+                                                       enqueued, methodDesc,
+                                                       span, span_start_us,
+                                                       checksum,
+                                                       response_sizes =
+                                                           method->m_responseSizes,
+                                                       parent_span_id =
+                                                           caller.span_id,
+                                                       args_size =
+                                                           args->data.size()]() {
+    auto now = std::chrono::steady_clock::now();
+    stats->latency_ns.recordDuration(now - start);
+    prpc::ErrorCode error = prpc::ErrorCode::SUCCESS;
+    prpc::MessagePool::BufferPoolType::PooledObject frame =
+        prpc::MessagePool::getInstance().acquireBufferFor(*response_sizes);
+    size_t response_bytes = 0;
+    if (prpc::encodeResponseFrame(*response, &frame->data, checksum)) {
+      response_bytes = frame->data.size() - prpc::kFrameLengthSize -
+                       (checksum ? prpc::kFrameChecksumSize : 0);
+      stats->response_bytes.record(response_bytes);
+      response_sizes->record(response_bytes);
+      if (fiber::send(clientfd, frame->data.data(), frame->data.size(), 0) <
+          0) {
+        error = prpc::ErrorCode::NETWORK_ERROR;
+        stats->errors.add(error);
+        LOG_RATE_LIMITED(ERROR, 10, 20) << "send response error!";
       }
     } else {
-      LOG(ERROR) << "serialize response error!";
+      error = prpc::ErrorCode::SERIALIZATION_ERROR;
+      stats->errors.add(error);
+      LOG_RATE_LIMITED(ERROR, 10, 20) << "serialize response error!";
+    }
+    if (span.sampled) {
+      SubmitServerSpan(span, parent_span_id, methodDesc, span_start_us, error);
+    }
+    prpc::SlowRequestLog &slow =
+        prpc::MetricsRegistry::getInstance().slowRequests();
+    uint64_t latency_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - start)
+            .count();
+    if (slow.isSlow(latency_ns)) {
+      prpc::SlowRequestLog::Entry entry;
+      entry.time = std::chrono::system_clock::now();
+      entry.method = methodDesc->service()->name() + "." + methodDesc->name();
+      entry.latency_ns = latency_ns;
+      entry.queue_wait_ns =
+          std::chrono::duration_cast<std::chrono::nanoseconds>(start - enqueued)
+              .count();
+      entry.request_bytes = args_size;
+      entry.response_bytes = response_bytes;
+      slow.record(std::move(entry));
     }
     delete request;
     delete response;
   });
 
+  prpc::ScopedTraceContext trace_scope(span);
   service->CallMethod(methodDesc, nullptr, request, response, done);
 }
+
+
+void Pprovider::CloseConnection(int clientfd) {
+  {
+    std::lock_guard<std::mutex> lock(m_connMutex);
+    m_connections.erase(clientfd);
+  }
+  close(clientfd);
+}
+
+namespace {
+
+// Window the status pages and the Prometheus quantiles are computed over.
+constexpr std::chrono::seconds kStatusWindow(60);
+
+std::string FormatTime(std::chrono::system_clock::time_point time) {
+  std::time_t t = std::chrono::system_clock::to_time_t(time);
+  std::tm tm;
+  localtime_r(&t, &tm);
+  char buf[32];
+  strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+  return buf;
+}
+
+std::string Param(const StatusServer::Params &params, const std::string &key,
+                  const std::string &fallback) {
+  auto it = params.find(key);
+  return it == params.end() || it->second.empty() ? fallback : it->second;
+}
+
+// Profiles block the status server for their whole duration.
+std::string CpuProfilePage(const StatusServer::Params &params) {
+  auto result = prpc::CpuProfiler::collect(
+      std::chrono::seconds(atoi(Param(params, "seconds", "5").c_str())),
+      atoi(Param(params, "hz", "99").c_str()));
+  if (!result.isSuccess()) {
+    throw std::runtime_error(result.getErrorMessage());
+  }
+  return result.getValue();
+}
+
+std::string ContentionProfilePage(const StatusServer::Params &params) {
+  auto result = prpc::ContentionProfiler::collect(
+      std::chrono::seconds(atoi(Param(params, "seconds", "5").c_str())),
+      atof(Param(params, "rate", "1").c_str()));
+  if (!result.isSuccess()) {
+    throw std::runtime_error(result.getErrorMessage());
+  }
+  return result.getValue();
+}
+
+const char *PolicyName(ThreadPool::QueuePolicy policy) {
+  switch (policy) {
+    case ThreadPool::QueuePolicy::kWeighted:
+      return "weighted";
+    case ThreadPool::QueuePolicy::kEarliestDeadline:
+      return "edf";
+    default:
+      return "strict";
+  }
+}
+
+// Unset means the SlowRequestLog default of 100ms.
+void ApplySlowRequestThreshold(const ConfigSnapshot &config) {
+  prpc::MetricsRegistry::getInstance().slowRequests().setThreshold(
+      std::chrono::milliseconds(
+          config.slow_request_ms > 0 ? config.slow_request_ms : 100));
+}
+
+// Starting a running monitor only changes its interval; the next check uses
+// the new one.
+void ApplyPoolAlerts(const ConfigSnapshot &config) {
+  if (config.pool_alert_interval_s <= 0) {
+    prpc::PoolMonitor::getInstance().stop();
+    return;
+  }
+  prpc::PoolMonitor::MonitorConfig monitor;
+  monitor.check_interval_seconds = config.pool_alert_interval_s;
+  prpc::PoolMonitor::getInstance().start(monitor);
+}
+
+}  // namespace
+
+void Pprovider::StartStatusServer(const std::string &ip) {
+  ConfigSnapshotPtr snapshot = Papplication::Config();
+  const ConfigSnapshot &config = *snapshot;
+  ApplySlowRequestThreshold(config);
+  // Creating the message pool registers its pools with the metrics registry,
+  // so /metrics and /pools list them before the first request arrives.
+  prpc::MessagePool::getInstance();
+  if (config.pool_alert_interval_s > 0) {
+    ApplyPoolAlerts(config);
+  }
+  m_configWatchers.push_back(Papplication::GetConfig().OnChange(
+      "rpcserver_slow_request_ms",
+      [](const ConfigSnapshot &now) { ApplySlowRequestThreshold(now); }));
+  m_configWatchers.push_back(Papplication::GetConfig().OnChange(
+      "rpcserver_pool_alert_interval_s",
+      [](const ConfigSnapshot &now) { ApplyPoolAlerts(now); }));
+  int port = config.status_port;
+  if (port <= 0) {
+    return;
+  }
+
+  m_statusServer = std::make_unique<StatusServer>();
+  m_statusServer->AddPage("/metrics", "Prometheus text exposition",
+                          "text/plain; version=0.0.4",
+                          [this]() { return PrometheusPage(); });
+  m_statusServer->AddPage("/status", "per-method latency, sizes and errors",
+                          "text/plain; charset=utf-8", []() {
+                            std::ostringstream out;
+                            prpc::MetricsRegistry::getInstance().writeText(
+                                out, kStatusWindow);
+                            return out.str();
+                          });
+  m_statusServer->AddPage("/connections", "open client connections",
+                          "text/plain; charset=utf-8",
+                          [this]() { return ConnectionsPage(); });
+  m_statusServer->AddPage("/threads", "executor and worker queues",
+                          "text/plain; charset=utf-8",
+                          [this]() { return ThreadsPage(); });
+  m_statusServer->AddPage("/pools", "object pool statistics",
+                          "text/plain; charset=utf-8",
+                          [this]() { return PoolsPage(); });
+  m_statusServer->AddPage("/config", "loaded configuration",
+                          "text/plain; charset=utf-8",
+                          [this]() { return ConfigPage(); });
+  m_statusServer->AddPage("/slow", "recent slow requests",
+                          "text/plain; charset=utf-8",
+                          [this]() { return SlowRequestsPage(); });
+  m_statusServer->AddPage(
+      "/profile/cpu", "cpu profile, folded stacks (?seconds=5&hz=99)",
+      "text/plain; charset=utf-8", CpuProfilePage);
+  m_statusServer->AddPage(
+      "/profile/contention",
+      "lock wait profile in microseconds, folded stacks (?seconds=5&rate=1)",
+      "text/plain; charset=utf-8", ContentionProfilePage);
+  if (!m_statusServer->Start(ip, static_cast<uint16_t>(port))) {
+    m_statusServer.reset();
+  }
+}
+
+std::string Pprovider::ConnectionsPage() {
+  std::ostringstream out;
+  auto now = std::chrono::system_clock::now();
+  std::lock_guard<std::mutex> lock(m_connMutex);
+  out << m_connections.size() << " connections\n\n";
+  out << std::left << std::setw(8) << "fd" << std::setw(24) << "peer"
+      << std::setw(10) << "reactor" << "age_s\n";
+  for (const auto &conn : m_connections) {
+    out << std::setw(8) << conn.first << std::setw(24) << conn.second.peer
+        << std::setw(10) << conn.second.reactor_cpu
+        << std::chrono::duration_cast<std::chrono::seconds>(
+               now - conn.second.accepted)
+               .count()
+        << "\n";
+  }
+  return out.str();
+}
+
+std::string Pprovider::ThreadsPage() {
+  std::ostringstream out;
+  if (m_fiberScheduler) {
+    out << "executor: fiber, " << m_fiberScheduler->size() << " threads, "
+        << m_fiberScheduler->liveFibers() << " live fibers\n";
+    return out.str();
+  }
+  out << "executor: thread pool, " << m_workerGroups.size() << " groups\n\n";
+  out << std::left << std::setw(6) << "node" << std::setw(10) << "policy"
+      << std::setw(9) << "threads" << std::setw(6) << "busy" << std::setw(8)
+      << "high" << std::setw(8) << "normal" << std::setw(8) << "low"
+      << "deadline\n";
+  for (const auto &group : m_workerGroups) {
+    ThreadPool::Stats stats = group.pool->stats();
+    out << std::setw(6) << group.node << std::setw(10)
+        << PolicyName(stats.policy) << std::setw(9) << stats.threads
+        << std::setw(6) << stats.busy << std::setw(8)
+        << stats.queued[ThreadPool::kHigh] << std::setw(8)
+        << stats.queued[ThreadPool::kNormal] << std::setw(8)
+        << stats.queued[ThreadPool::kLow] << stats.deadline_queued << "\n";
+  }
+  return out.str();
+}
+
+std::string Pprovider::PoolsPage() {
+  return prpc::PoolMonitor::getInstance().generateReport();
+}
+
+std::string Pprovider::ConfigPage() {
+  std::ostringstream out;
+  for (const auto &entry :
+       Papplication::GetInstance().GetConfig().LoadAll()) {
+    out << entry.first << "=" << entry.second << "\n";
+  }
+  return out.str();
+}
+
+std::string Pprovider::SlowRequestsPage() {
+  std::ostringstream out;
+  auto entries = prpc::MetricsRegistry::getInstance().slowRequests().recent();
+  out << entries.size() << " recent slow requests, newest first\n\n";
+  out << std::left << std::setw(21) << "time" << std::setw(40) << "method"
+      << std::right << std::setw(12) << "latency_ms" << std::setw(12)
+      << "queue_ms" << std::setw(10) << "req_b" << std::setw(10) << "resp_b"
+      << "\n";
+  out << std::fixed << std::setprecision(3);
+  for (const auto &entry : entries) {
+    out << std::left << std::setw(21) << FormatTime(entry.time)
+        << std::setw(40) << entry.method << std::right << std::setw(12)
+        << entry.latency_ns / 1e6 << std::setw(12)
+        << entry.queue_wait_ns / 1e6 << std::setw(10) << entry.request_bytes
+        << std::setw(10) << entry.response_bytes << "\n";
+  }
+  return out.str();
+}
+
+std::string Pprovider::PrometheusPage() {
+  std::ostringstream out;
+  prpc::MetricsRegistry::getInstance().writePrometheus(out, kStatusWindow);
+
+  size_t connections;
+  {
+    std::lock_guard<std::mutex> lock(m_connMutex);
+    connections = m_connections.size();
+  }
+  out << "# HELP prpc_server_connections Open client connections\n"
+      << "# TYPE prpc_server_connections gauge\n"
+      << "prpc_server_connections " << connections << "\n";
+
+  if (!m_workerGroups.empty()) {
+    std::ostringstream busy, queued;
+    for (const auto &group : m_workerGroups) {
+      ThreadPool::Stats stats = group.pool->stats();
+      std::string node = "node=\"" + std::to_string(group.node) + "\"";
+      busy << "prpc_threadpool_busy_threads{" << node << "} " << stats.busy
+           << "\n";
+      static const char *kLevels[] = {"high", "normal", "low"};
+      for (int level = 0; level < ThreadPool::kPriorityLevels; ++level) {
+        queued << "prpc_threadpool_queued_tasks{" << node << ",priority=\""
+               << kLevels[level] << "\"} " << stats.queued[level] << "\n";
+      }
+      queued << "prpc_threadpool_queued_tasks{" << node
+             << ",priority=\"deadline\"} " << stats.deadline_queued << "\n";
+    }
+    out << "# HELP prpc_threadpool_busy_threads Workers running a task\n"
+        << "# TYPE prpc_threadpool_busy_threads gauge\n"
+        << busy.str()
+        << "# HELP prpc_threadpool_queued_tasks Tasks waiting for a worker\n"
+        << "# TYPE prpc_threadpool_queued_tasks gauge\n"
+        << queued.str();
+  }
+  return out.str();
+}
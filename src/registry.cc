@@ -0,0 +1,74 @@
+#include "registry.h"
+
+#include "application.h"
+#include "logger.h"
+
+std::unique_ptr<ServiceRegistry> ServiceRegistry::Create() {
+  const std::string kind = Papplication::Config()->registry;
+  if (kind == "memory") {
+    return std::make_unique<MemoryServiceRegistry>();
+  }
+  if (!kind.empty() && kind != "zookeeper") {
+    LOG(ERROR) << "unknown registry " << kind << ", using zookeeper";
+  }
+  return std::make_unique<ZkServiceRegistry>();
+}
+
+ServiceRegistry &ServiceRegistry::Default() {
+  // Never destroyed: callers may still look up services during exit.
+  static ServiceRegistry *registry = [] {
+    ServiceRegistry *created = Create().release();
+    created->Start();
+    return created;
+  }();
+  return *registry;
+}
+
+void ZkServiceRegistry::Start(std::function<void()> session_expired_cb) {
+  m_zkClient.Start(std::move(session_expired_cb));
+}
+
+void ZkServiceRegistry::Register(const std::string &service,
+                                 const std::string &method,
+                                 const std::string &host) {
+  std::string service_path = "/" + service;
+  m_zkClient.Create(service_path.c_str(), nullptr, 0);
+  std::string method_path = service_path + "/" + method;
+  m_zkClient.Create(method_path.c_str(), host.c_str(), host.size(),
+                    ZOO_EPHEMERAL);
+}
+
+std::string ZkServiceRegistry::Lookup(const std::string &service,
+                                      const std::string &method) {
+  std::string method_path = "/" + service + "/" + method;
+  return m_zkClient.GetData(method_path.c_str());
+}
+
+std::mutex MemoryServiceRegistry::s_mutex;
+std::map<std::string, MemoryServiceRegistry::Entry>
+    MemoryServiceRegistry::s_methods;
+
+MemoryServiceRegistry::~MemoryServiceRegistry() {
+  std::lock_guard<std::mutex> lock(s_mutex);
+  for (auto it = s_methods.begin(); it != s_methods.end();) {
+    if (it->second.owner == this) {
+      it = s_methods.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void MemoryServiceRegistry::Register(const std::string &service,
+                                     const std::string &method,
+                                     const std::string &host) {
+  std::lock_guard<std::mutex> lock(s_mutex);
+  s_methods[service + "/" + method] = {host, this};
+}
+
+std::string MemoryServiceRegistry::Lookup(const std::string &service,
+                                          const std::string &method) {
+  std::lock_guard<std::mutex> lock(s_mutex);
+  auto it = s_methods.find(service + "/" + method);
+  return it == s_methods.end() ? std::string() : it->second.host;
+}
@@ -0,0 +1,250 @@
+#include "status_server.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <exception>
+#include <sstream>
+
+#include "logger.h"
+
+namespace {
+
+constexpr size_t kMaxRequestSize = 8192;
+constexpr int kIoTimeoutMs = 2000;
+
+void SendAll(int fd, const std::string &data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return;
+    sent += n;
+  }
+}
+
+void SendResponse(int fd, const char *status, const std::string &content_type,
+                  const std::string &body, bool head_only) {
+  std::ostringstream response;
+  response << "HTTP/1.1 " << status << "\r\n"
+           << "Content-Type: " << content_type << "\r\n"
+           << "Content-Length: " << body.size() << "\r\n"
+           << "Connection: close\r\n\r\n";
+  if (!head_only) {
+    response << body;
+  }
+  SendAll(fd, response.str());
+}
+
+std::string UrlDecode(const std::string &text) {
+  std::string decoded;
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (text[i] == '+') {
+      decoded += ' ';
+    } else if (text[i] == '%' && i + 2 < text.size() &&
+               isxdigit(text[i + 1]) && isxdigit(text[i + 2])) {
+      decoded += static_cast<char>(std::stoi(text.substr(i + 1, 2), nullptr, 16));
+      i += 2;
+    } else {
+      decoded += text[i];
+    }
+  }
+  return decoded;
+}
+
+StatusServer::Params ParseQuery(const std::string &query) {
+  StatusServer::Params params;
+  std::istringstream in(query);
+  std::string pair;
+  while (std::getline(in, pair, '&')) {
+    if (pair.empty()) continue;
+    size_t eq = pair.find('=');
+    if (eq == std::string::npos) {
+      params[UrlDecode(pair)] = "";
+    } else {
+      params[UrlDecode(pair.substr(0, eq))] = UrlDecode(pair.substr(eq + 1));
+    }
+  }
+  return params;
+}
+
+}  // namespace
+
+StatusServer::StatusServer()
+    : m_listenfd(-1), m_wakefd(-1), m_port(0), m_running(false) {}
+
+StatusServer::~StatusServer() { Stop(); }
+
+void StatusServer::AddPage(const std::string &path, const std::string &title,
+                           const std::string &content_type, Handler handler) {
+  m_pages[path] = Page{title, content_type,
+                       [handler](const Params &) { return handler(); }};
+}
+
+void StatusServer::AddPage(const std::string &path, const std::string &title,
+                           const std::string &content_type,
+                           ParamHandler handler) {
+  m_pages[path] = Page{title, content_type, std::move(handler)};
+}
+
+bool StatusServer::Start(const std::string &ip, uint16_t port) {
+  if (m_running.load()) {
+    return true;
+  }
+  int listenfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listenfd == -1) {
+    LOG(ERROR) << "status server: create socket error, errno " << errno;
+    return false;
+  }
+  int opt = 1;
+  setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+  sockaddr_in addr;
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = inet_addr(ip.c_str());
+  if (bind(listenfd, (sockaddr *)&addr, sizeof(addr)) == -1 ||
+      listen(listenfd, 16) == -1) {
+    LOG(ERROR) << "status server: bind " << ip << ":" << port
+               << " error, errno " << errno;
+    close(listenfd);
+    return false;
+  }
+  socklen_t len = sizeof(addr);
+  getsockname(listenfd, (sockaddr *)&addr, &len);
+
+  m_listenfd = listenfd;
+  m_wakefd = eventfd(0, EFD_CLOEXEC);
+  m_port = ntohs(addr.sin_port);
+  m_running.store(true);
+  m_thread = std::thread(&StatusServer::ServeLoop, this);
+  LOG(INFO) << "status server listening on " << ip << ":" << m_port;
+  return true;
+}
+
+void StatusServer::Stop() {
+  if (!m_running.exchange(false)) {
+    return;
+  }
+  uint64_t one = 1;
+  if (write(m_wakefd, &one, sizeof(one)) < 0) {
+    LOG(WARN) << "status server: wake error, errno " << errno;
+  }
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+  close(m_listenfd);
+  close(m_wakefd);
+  m_listenfd = -1;
+  m_wakefd = -1;
+}
+
+void StatusServer::ServeLoop() {
+  pollfd fds[2];
+  fds[0].fd = m_listenfd;
+  fds[0].events = POLLIN;
+  fds[1].fd = m_wakefd;
+  fds[1].events = POLLIN;
+  while (m_running.load()) {
+    int n = poll(fds, 2, -1);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      LOG(ERROR) << "status server: poll error, errno " << errno;
+      return;
+    }
+    if (fds[1].revents & POLLIN) {
+      return;
+    }
+    if (!(fds[0].revents & POLLIN)) {
+      continue;
+    }
+    int connfd = accept4(m_listenfd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (connfd < 0) {
+      LOG_EVERY_T(WARN, 1.0) << "status server: accept error, errno " << errno;
+      continue;
+    }
+    ServeConnection(connfd);
+    close(connfd);
+  }
+}
+
+void StatusServer::ServeConnection(int connfd) {
+  // A slow or idle client must not hold up the single serving thread.
+  struct timeval tv;
+  tv.tv_sec = kIoTimeoutMs / 1000;
+  tv.tv_usec = (kIoTimeoutMs % 1000) * 1000;
+  setsockopt(connfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(connfd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+  std::string request;
+  char buf[1024];
+  while (request.find("\r\n\r\n") == std::string::npos) {
+    if (request.size() >= kMaxRequestSize) {
+      SendResponse(connfd, "431 Request Header Fields Too Large", "text/plain",
+                   "request too large\n", false);
+      return;
+    }
+    ssize_t n = recv(connfd, buf, sizeof(buf), 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return;
+    request.append(buf, n);
+  }
+
+  // Request line: METHOD SP TARGET SP VERSION
+  std::istringstream line(request.substr(0, request.find("\r\n")));
+  std::string method, target, version;
+  line >> method >> target >> version;
+  if (version.compare(0, 5, "HTTP/") != 0 || target.empty()) {
+    SendResponse(connfd, "400 Bad Request", "text/plain", "bad request\n",
+                 false);
+    return;
+  }
+  bool head_only = method == "HEAD";
+  if (method != "GET" && !head_only) {
+    SendResponse(connfd, "405 Method Not Allowed", "text/plain",
+                 "only GET and HEAD are supported\n", false);
+    return;
+  }
+  size_t query = target.find('?');
+  std::string path = target.substr(0, query);
+
+  if (path == "/" && !m_pages.count("/")) {
+    SendResponse(connfd, "200 OK", "text/plain; charset=utf-8", IndexPage(),
+                 head_only);
+    return;
+  }
+  auto it = m_pages.find(path);
+  if (it == m_pages.end()) {
+    SendResponse(connfd, "404 Not Found", "text/plain", "no such page\n",
+                 head_only);
+    return;
+  }
+  std::string body;
+  try {
+    body = it->second.handler(
+        ParseQuery(query == std::string::npos ? "" : target.substr(query + 1)));
+  } catch (const std::exception &e) {
+    LOG_EVERY_T(ERROR, 1.0) << "status page " << path << " failed: " << e.what();
+    SendResponse(connfd, "500 Internal Server Error", "text/plain",
+                 std::string(e.what()) + "\n", head_only);
+    return;
+  }
+  SendResponse(connfd, "200 OK", it->second.content_type, body, head_only);
+}
+
+std::string StatusServer::IndexPage() const {
+  std::ostringstream out;
+  out << "prpc status\n\n";
+  for (const auto &page : m_pages) {
+    if (!page.second.title.empty()) {
+      out << page.first << "\t" << page.second.title << "\n";
+    }
+  }
+  return out.str();
+}
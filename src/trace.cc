@@ -0,0 +1,199 @@
+#include "trace.h"
+
+#include <cinttypes>
+#include <cstdlib>
+#include <random>
+
+#include "fiber.h"
+
+namespace prpc {
+
+namespace {
+
+// splitmix64，每个线程独立的状态，首次使用时随机播种
+uint64_t nextRandom() {
+  thread_local uint64_t state = std::random_device{}() ^
+                                (static_cast<uint64_t>(std::random_device{}()) << 32) ^
+                                static_cast<uint64_t>(Tracer::nowUs());
+  uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+}  // namespace
+
+FileSpanSink::~FileSpanSink() {
+  if (file_ != nullptr) {
+    fclose(file_);
+  }
+}
+
+std::unique_ptr<FileSpanSink> FileSpanSink::open(const std::string& path) {
+  FILE* file = fopen(path.c_str(), "a");
+  if (file == nullptr) {
+    return nullptr;
+  }
+  return std::make_unique<FileSpanSink>(file);
+}
+
+void FileSpanSink::exportSpans(const std::vector<Span>& spans) {
+  for (const Span& span : spans) {
+    fprintf(file_,
+            "{\"trace_id\":\"%016" PRIx64 "\",\"span_id\":\"%016" PRIx64
+            "\",\"parent_id\":\"%016" PRIx64 "\",\"name\":\"%s\",\"kind\":\"%s\","
+            "\"start_us\":%" PRId64 ",\"duration_us\":%" PRId64 ",\"error\":\"%s\"}\n",
+            span.trace_id, span.span_id, span.parent_span_id, span.name.c_str(),
+            span.kind == Span::kClient ? "client" : "server", span.start_us,
+            span.duration_us,
+            span.error == ErrorCode::SUCCESS ? "" : ErrorCodeToString(span.error).c_str());
+  }
+  fflush(file_);
+}
+
+Tracer& Tracer::getInstance() {
+  // 不析构：工作线程在退出过程中仍可能提交 span
+  static Tracer* instance = new Tracer();
+  return *instance;
+}
+
+Tracer::Tracer()
+    : sampleThreshold_(0), alwaysSample_(false), dropped_(0), stopping_(false) {
+  std::atexit(shutdownAtExit);
+}
+
+void Tracer::shutdownAtExit() {
+  Tracer& tracer = getInstance();
+  {
+    std::lock_guard<std::mutex> lock(tracer.queueMutex_);
+    tracer.stopping_ = true;
+  }
+  tracer.queueCond_.notify_all();
+  if (tracer.exporter_.joinable()) {
+    tracer.exporter_.join();
+  }
+  tracer.exportPending();
+}
+
+void Tracer::setSampleRate(double rate) {
+  if (rate >= 1.0) {
+    alwaysSample_.store(true, std::memory_order_relaxed);
+    return;
+  }
+  alwaysSample_.store(false, std::memory_order_relaxed);
+  sampleThreshold_.store(rate > 0 ? static_cast<uint64_t>(rate * 18446744073709551616.0) : 0,
+                         std::memory_order_relaxed);
+}
+
+double Tracer::getSampleRate() const {
+  if (alwaysSample_.load(std::memory_order_relaxed)) {
+    return 1.0;
+  }
+  return sampleThreshold_.load(std::memory_order_relaxed) / 18446744073709551616.0;
+}
+
+void Tracer::setSink(std::unique_ptr<SpanSink> sink) {
+  exportPending();
+  {
+    std::lock_guard<std::mutex> lock(exportMutex_);
+    sink_ = std::move(sink);
+  }
+  std::lock_guard<std::mutex> lock(queueMutex_);
+  if (!exporter_.joinable() && !stopping_) {
+    exporter_ = std::thread(&Tracer::exportLoop, this);
+  }
+}
+
+TraceContext Tracer::current() {
+  void* slot = fiber::localContext();
+  return slot != nullptr ? *static_cast<TraceContext*>(slot) : TraceContext();
+}
+
+TraceContext Tracer::newSpan(const TraceContext& parent) {
+  TraceContext span;
+  if (parent.valid()) {
+    span.trace_id = parent.trace_id;
+    span.sampled = parent.sampled;
+  } else {
+    bool always = alwaysSample_.load(std::memory_order_relaxed);
+    uint64_t threshold = sampleThreshold_.load(std::memory_order_relaxed);
+    if (!always && threshold == 0) {
+      return span;
+    }
+    span.trace_id = newId();
+    span.sampled = always || nextRandom() < threshold;
+  }
+  span.span_id = newId();
+  return span;
+}
+
+uint64_t Tracer::newId() {
+  uint64_t id;
+  do {
+    id = nextRandom();
+  } while (id == 0);
+  return id;
+}
+
+int64_t Tracer::nowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+void Tracer::submit(Span span) {
+  bool wake = false;
+  {
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    if (pending_.size() >= kMaxPending || (!exporter_.joinable() && !stopping_)) {
+      // 还没有导出目标，或导出跟不上
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    pending_.push_back(std::move(span));
+    wake = pending_.size() == kBatchSize;
+  }
+  if (wake) {
+    queueCond_.notify_one();
+  }
+}
+
+void Tracer::flush() {
+  exportPending();
+}
+
+void Tracer::exportLoop() {
+  std::unique_lock<std::mutex> lock(queueMutex_);
+  while (!stopping_) {
+    queueCond_.wait_for(lock, std::chrono::milliseconds(kExportIntervalMs),
+                        [this] { return stopping_ || pending_.size() >= kBatchSize; });
+    lock.unlock();
+    exportPending();
+    lock.lock();
+  }
+}
+
+void Tracer::exportPending() {
+  std::lock_guard<std::mutex> exportLock(exportMutex_);
+  std::vector<Span> batch;
+  {
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    batch.swap(pending_);
+  }
+  if (!batch.empty() && sink_) {
+    sink_->exportSpans(batch);
+  }
+}
+
+ScopedTraceContext::ScopedTraceContext(const TraceContext& context)
+    : context_(context) {
+  void*& slot = fiber::localContext();
+  previous_ = slot;
+  slot = &context_;
+}
+
+ScopedTraceContext::~ScopedTraceContext() {
+  fiber::localContext() = previous_;
+}
+
+}  // namespace prpc
@@ -27,11 +27,7 @@ ZkClient::~ZkClient() {
 void ZkClient::Start(std::function<void()> session_expired_cb) {
   m_session_expired_cb = session_expired_cb;
 
-  std::string host =
-      Papplication::GetInstance().GetConfig().Load("zookeeperip");
-  std::string port =
-      Papplication::GetInstance().GetConfig().Load("zookeeperport");
-  std::string connstr = host + ":" + port;
+  const std::string connstr = Papplication::Config()->zookeeper_host;
   if (m_zhandle != nullptr) {
     zookeeper_close(m_zhandle);
     m_zhandle = nullptr;
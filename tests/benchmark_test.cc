@@ -67,6 +67,52 @@ public:
         std::cout << "Thread pool performance: " << ops_per_sec << " ops/sec" << std::endl;
     }
     
+    // 突发负载下FIFO与EDF调度的截止时间错过率对比
+    static double runBurstyDeadlineLoad(ThreadPool::QueuePolicy policy) {
+        ThreadPool pool(2);
+        pool.setQueuePolicy(policy);
+        
+        const int bursts = 20;
+        const int tasks_per_burst = 60;
+        const auto service_time = std::chrono::microseconds(250);
+        const auto tight = std::chrono::milliseconds(3);
+        const auto loose = std::chrono::milliseconds(50);
+        
+        std::atomic<int> missed{0};
+        std::vector<std::future<void>> futures;
+        std::mt19937 rng(42);
+        
+        for (int b = 0; b < bursts; ++b) {
+            for (int i = 0; i < tasks_per_burst; ++i) {
+                auto deadline = ThreadPool::Clock::now() + (rng() % 4 == 0 ? tight : loose);
+                futures.push_back(pool.submitWithDeadline(deadline, ThreadPool::kNormal,
+                    [deadline, service_time, &missed]() {
+                        auto until = ThreadPool::Clock::now() + service_time;
+                        while (ThreadPool::Clock::now() < until) {
+                        }
+                        if (ThreadPool::Clock::now() > deadline) {
+                            missed.fetch_add(1);
+                        }
+                    }));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        for (auto& future : futures) {
+            future.get();
+        }
+        return (double)missed.load() / (bursts * tasks_per_burst) * 100.0;
+    }
+    
+    static void benchmarkDeadlineScheduling() {
+        std::cout << "Benchmarking deadline scheduling under bursty load..." << std::endl;
+        
+        double fifo_miss = runBurstyDeadlineLoad(ThreadPool::QueuePolicy::kStrictPriority);
+        double edf_miss = runBurstyDeadlineLoad(ThreadPool::QueuePolicy::kEarliestDeadline);
+        
+        std::cout << "FIFO deadline miss rate: " << fifo_miss << "%" << std::endl;
+        std::cout << "EDF deadline miss rate: " << edf_miss << "%" << std::endl;
+    }
+    
     static void benchmarkConfigReadPerformance() {
         std::cout << "Benchmarking config read performance..." << std::endl;
         
@@ -271,6 +317,9 @@ public:
         benchmarkThreadPoolPerformance();
         std::cout << std::endl;
         
+        benchmarkDeadlineScheduling();
+        std::cout << std::endl;
+        
         benchmarkConfigReadPerformance();
         std::cout << std::endl;
         
@@ -4,6 +4,9 @@
 #include <cassert>
 #include <fstream>
 #include <cstdio>
+#include <chrono>
+#include <thread>
+#include "logger.h"
 
 class ApplicationTest {
 public:
@@ -210,6 +213,49 @@ public:
         
         std::cout << "Instance lifecycle test passed!" << std::endl;
     }
+    
+    static void testConfigHotReload() {
+        std::cout << "Testing config hot reload..." << std::endl;
+        
+        const char* test_config = "test_app_reload.conf";
+        std::ofstream file(test_config);
+        file << "rpcserverip=127.0.0.1\n";
+        file << "log_level=warn\n";
+        file << "config_watch=true\n";
+        file.close();
+        
+        const char* argv[] = {"test_program", "-i", test_config};
+        assert(Papplication::Init(3, const_cast<char**>(argv)).isSuccess());
+        assert(PLogger::getInstance().getLogLevel() == WARN);
+        
+        // 改写配置文件后日志级别自动更新
+        std::ofstream file2(test_config, std::ios::trunc);
+        file2 << "rpcserverip=127.0.0.1\n";
+        file2 << "log_level=error\n";
+        file2 << "config_watch=true\n";
+        file2.close();
+        for (int i = 0; i < 200 && PLogger::getInstance().getLogLevel() != ERROR; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        assert(PLogger::getInstance().getLogLevel() == ERROR);
+        assert(Papplication::Config()->log_level == "error");
+        
+        // 非法值不生效
+        std::ofstream file3(test_config, std::ios::trunc);
+        file3 << "log_level=verbose\n";
+        file3.close();
+        for (int i = 0; i < 200 && Papplication::Config()->log_level != "verbose"; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        assert(Papplication::Config()->log_level == "verbose");
+        assert(PLogger::getInstance().getLogLevel() == ERROR);
+        
+        Papplication::GetConfig().StopWatching();
+        PLogger::getInstance().setLogLevel(INFO);
+        std::remove(test_config);
+        
+        std::cout << "Config hot reload test passed!" << std::endl;
+    }
 };
 
 int main() {
@@ -225,6 +271,7 @@ int main() {
         ApplicationTest::testArgumentParsing();
         ApplicationTest::testErrorPropagation();
         ApplicationTest::testInstanceLifecycle();
+        ApplicationTest::testConfigHotReload();
         
         std::cout << "All application tests passed!" << std::endl;
         return 0;
@@ -0,0 +1,220 @@
+#include "binary_log.h"
+#include <iostream>
+#include <cassert>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <sys/stat.h>
+#include <unistd.h>
+
+class BinaryLogTest {
+public:
+    static std::string tempPath(const char* name) {
+        return std::string("/tmp/prpc_blog_") + name + "_" + std::to_string(getpid()) + ".bin";
+    }
+
+    static std::vector<std::string> decodeLines(const std::string& path) {
+        std::ostringstream out;
+        std::string error;
+        bool ok = blog::decodeFile(path, out, &error);
+        assert(ok);
+        std::vector<std::string> lines;
+        std::istringstream in(out.str());
+        std::string line;
+        while (std::getline(in, line)) {
+            lines.push_back(line);
+        }
+        return lines;
+    }
+
+    static void testDisabledByDefault() {
+        std::cout << "Testing binary log disabled by default..." << std::endl;
+
+        int evaluations = 0;
+        auto expensive = [&evaluations]() {
+            ++evaluations;
+            return 1;
+        };
+        assert(!PBinaryLog::enabled());
+        BLOG(INFO, "not written {}", expensive());
+        assert(evaluations == 0);
+
+        std::cout << "Binary log disabled test passed!" << std::endl;
+    }
+
+    static void testRoundTrip() {
+        std::cout << "Testing binary log round trip..." << std::endl;
+
+        std::string path = tempPath("roundtrip");
+        assert(PBinaryLog::getInstance().open(path, 256 * 1024));
+
+        std::string method = "UserService.Login";
+        BLOG(INFO, "request {} args {} bytes", method, 42);
+        BLOG(WARN, "mixed {} {} {} {} {}", -7, 123456789012ull, 2.5, true, 'x');
+        BLOG(ERROR, "no arguments");
+        BLOG(INFO, "extra {}", 1, "tail");
+        PBinaryLog::getInstance().close();
+        assert(!PBinaryLog::enabled());
+
+        auto lines = decodeLines(path);
+        assert(lines.size() == 4);
+        assert(lines[0].compare(0, 7, "[INFO][") == 0);
+        assert(lines[0].find("test_binary_log.cc:") != std::string::npos);
+        assert(lines[0].find("] request UserService.Login args 42 bytes") != std::string::npos);
+        assert(lines[1].compare(0, 7, "[WARN][") == 0);
+        assert(lines[1].find("mixed -7 123456789012 2.5 true x") != std::string::npos);
+        assert(lines[2].find("[ERROR]") == 0);
+        assert(lines[2].find("] no arguments") != std::string::npos);
+        assert(lines[3].find("extra 1 tail") != std::string::npos);
+
+        std::remove(path.c_str());
+        std::cout << "Binary log round trip test passed!" << std::endl;
+    }
+
+    static void testLongStringTruncated() {
+        std::cout << "Testing binary log truncation..." << std::endl;
+
+        std::string path = tempPath("truncate");
+        assert(PBinaryLog::getInstance().open(path, 256 * 1024));
+        std::string payload(4000, 'p');
+        BLOG(INFO, "payload {} after {}", payload, 1);
+        PBinaryLog::getInstance().close();
+
+        auto lines = decodeLines(path);
+        assert(lines.size() == 1);
+        // 记录被限制在 kMaxRecordSize 内，截断后的参数不再解码
+        assert(lines[0].size() < blog::kMaxRecordSize + 100);
+        assert(lines[0].find("after {?}") != std::string::npos);
+
+        std::remove(path.c_str());
+        std::cout << "Binary log truncation test passed!" << std::endl;
+    }
+
+    static void testRingKeepsNewest() {
+        std::cout << "Testing binary log ring wrap..." << std::endl;
+
+        std::string path = tempPath("ring");
+        // 4个块的环形区，写入远超容量的记录
+        assert(PBinaryLog::getInstance().open(path, 4 * blog::kBlockSize));
+        const int total = 50000;
+        for (int i = 0; i < total; ++i) {
+            BLOG(INFO, "seq {}", i);
+            if (i % 1000 == 0) {
+                PLogger::getInstance().flush();
+            }
+        }
+        PBinaryLog::getInstance().close();
+
+        auto lines = decodeLines(path);
+        assert(!lines.empty());
+        assert(lines.size() < static_cast<size_t>(total));
+        int expected = -1;
+        for (const auto& line : lines) {
+            int seq = -1;
+            size_t pos = line.find("seq ");
+            assert(pos != std::string::npos);
+            assert(sscanf(line.c_str() + pos, "seq %d", &seq) == 1);
+            if (expected >= 0) {
+                assert(seq == expected);
+            }
+            expected = seq + 1;
+        }
+        // 保留的是最新的记录
+        assert(expected == total);
+
+        // 文件大小固定，不随写入量增长
+        struct stat st;
+        assert(stat(path.c_str(), &st) == 0);
+        assert(static_cast<size_t>(st.st_size) ==
+               blog::kHeaderSize + blog::kDefaultFormatCapacity + 4 * blog::kBlockSize);
+
+        std::remove(path.c_str());
+        std::cout << "Binary log ring wrap test passed! (" << lines.size() << " records kept)" << std::endl;
+    }
+
+    static void testConcurrentWriters() {
+        std::cout << "Testing binary log concurrent writers..." << std::endl;
+
+        std::string path = tempPath("threads");
+        assert(PBinaryLog::getInstance().open(path, 16 * 1024 * 1024));
+        const int num_threads = 4;
+        const int per_thread = 5000;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < num_threads; ++t) {
+            threads.emplace_back([t, per_thread]() {
+                for (int i = 0; i < per_thread; ++i) {
+                    BLOG(INFO, "thread {} seq {}", t, i);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        PBinaryLog::getInstance().close();
+
+        auto lines = decodeLines(path);
+        assert(lines.size() == static_cast<size_t>(num_threads * per_thread));
+        std::vector<int> next(num_threads, 0);
+        for (const auto& line : lines) {
+            int t = -1, seq = -1;
+            assert(sscanf(line.c_str() + line.find("thread "), "thread %d seq %d", &t, &seq) == 2);
+            assert(next[t] == seq);
+            next[t] = seq + 1;
+        }
+
+        std::remove(path.c_str());
+        std::cout << "Binary log concurrent writers test passed!" << std::endl;
+    }
+
+    static void testPerformance() {
+        std::cout << "Testing binary vs text logging cost..." << std::endl;
+
+        std::string text_path = tempPath("text_perf");
+        std::string bin_path = tempPath("bin_perf");
+        assert(PLogger::getInstance().setLogFile(text_path));
+        assert(PBinaryLog::getInstance().open(bin_path));
+
+        const int iterations = 200000;
+        std::string service = "UserService";
+        std::string method = "Login";
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            LOG(INFO) << "request " << service << "." << method << " args " << i << " bytes";
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        double text_ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            BLOG(INFO, "request {}.{} args {} bytes", service, method, i);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        double bin_ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+
+        PBinaryLog::getInstance().close();
+        assert(PLogger::getInstance().setLogFile(""));
+        std::remove(text_path.c_str());
+        std::remove(bin_path.c_str());
+
+        std::cout << "Text LOG: " << text_ns << " ns/call, binary BLOG: " << bin_ns << " ns/call" << std::endl;
+        std::cout << "Binary logging performance test passed!" << std::endl;
+    }
+};
+
+int main() {
+    std::cout << "Running binary log tests..." << std::endl;
+
+    BinaryLogTest::testDisabledByDefault();
+    BinaryLogTest::testRoundTrip();
+    BinaryLogTest::testLongStringTruncated();
+    BinaryLogTest::testRingKeepsNewest();
+    BinaryLogTest::testConcurrentWriters();
+    BinaryLogTest::testPerformance();
+
+    std::cout << "All binary log tests passed!" << std::endl;
+    return 0;
+}
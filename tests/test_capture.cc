@@ -0,0 +1,215 @@
+#include "capture.h"
+#include "header.pb.h"
+#include <iostream>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+class CaptureTest {
+public:
+    static std::string tempPath() {
+        return "/tmp/prpc_test_capture_" + std::to_string(getpid()) + ".bin";
+    }
+
+    static std::string makeHeader(const std::string& method, uint32_t args_size) {
+        Prpc::RpcHeader header;
+        header.set_service_name("UserService");
+        header.set_method_name(method);
+        header.set_args_size(args_size);
+        return header.SerializeAsString();
+    }
+
+    static std::vector<prpc::CapturedFrame> readBack(const std::string& path) {
+        std::vector<prpc::CapturedFrame> frames;
+        std::string error;
+        bool ok = prpc::readCaptureFile(path, nullptr, &frames, &error);
+        assert(ok);
+        return frames;
+    }
+
+    static void testRoundTrip() {
+        std::cout << "Testing capture round trip..." << std::endl;
+
+        std::string path = tempPath();
+        auto& capture = prpc::TrafficCapture::getInstance();
+        auto start = std::chrono::steady_clock::now();
+        assert(capture.start(path));
+        assert(prpc::TrafficCapture::enabled());
+        uint64_t captured = capture.captured();
+
+        std::string args_a(100, 'a');
+        std::string args_b(3000, '\0');
+        capture.record(start + std::chrono::milliseconds(5), makeHeader("Login", 100), args_a);
+        capture.record(start + std::chrono::milliseconds(20), makeHeader("Register", 3000), args_b);
+        capture.record(start + std::chrono::milliseconds(21), makeHeader("Login", 0), "");
+        assert(capture.captured() == captured + 3);
+        capture.stop();
+        assert(!prpc::TrafficCapture::enabled());
+        capture.record(start, makeHeader("Login", 0), "");
+
+        int64_t start_us = 0;
+        std::vector<prpc::CapturedFrame> frames;
+        assert(prpc::readCaptureFile(path, &start_us, &frames));
+        assert(start_us > 0);
+        assert(frames.size() == 3);
+        assert(frames[0].args == args_a && frames[1].args == args_b && frames[2].args.empty());
+        Prpc::RpcHeader header;
+        assert(header.ParseFromString(frames[1].header));
+        assert(header.method_name() == "Register" && header.args_size() == 3000);
+        // 到达时间相对开始抓取，保留原始间隔
+        assert(frames[0].arrival_ns <= frames[1].arrival_ns);
+        uint64_t gap_ms = (frames[1].arrival_ns - frames[0].arrival_ns) / 1000000;
+        assert(gap_ms == 15 || gap_ms == 14);
+
+        remove(path.c_str());
+        std::cout << "Capture round trip test passed!" << std::endl;
+    }
+
+    static void testSampling() {
+        std::cout << "Testing capture sampling..." << std::endl;
+
+        std::string path = tempPath();
+        auto& capture = prpc::TrafficCapture::getInstance();
+        prpc::TrafficCapture::Options options;
+        options.sample_rate = 0;
+        assert(capture.start(path, options));
+        for (int i = 0; i < 100; ++i) {
+            capture.record(std::chrono::steady_clock::now(), makeHeader("Login", 8), "12345678");
+        }
+        capture.stop();
+        assert(readBack(path).empty());
+
+        options.sample_rate = 0.25;
+        assert(capture.start(path, options));
+        for (int i = 0; i < 4000; ++i) {
+            capture.record(std::chrono::steady_clock::now(), makeHeader("Login", 8), "12345678");
+        }
+        capture.stop();
+        size_t sampled = readBack(path).size();
+        assert(sampled > 800 && sampled < 1200);
+
+        remove(path.c_str());
+        std::cout << "Capture sampling test passed!" << std::endl;
+    }
+
+    static void testBudget() {
+        std::cout << "Testing capture budget..." << std::endl;
+
+        std::string path = tempPath();
+        auto& capture = prpc::TrafficCapture::getInstance();
+        std::string args(1000, 'x');
+        std::string header = makeHeader("Login", 1000);
+        size_t frame_bytes = prpc::capture::kRecordHeaderSize + header.size() + args.size();
+
+        // 每秒预算约 10 帧，一次写 100 帧时只有预算内的被记录
+        prpc::TrafficCapture::Options options;
+        options.bytes_per_second = frame_bytes * 10;
+        assert(capture.start(path, options));
+        uint64_t dropped = capture.dropped();
+        for (int i = 0; i < 100; ++i) {
+            capture.record(std::chrono::steady_clock::now(), header, args);
+        }
+        capture.stop();
+        size_t kept = readBack(path).size();
+        assert(kept >= 10 && kept <= 11);
+        assert(capture.dropped() == dropped + 100 - kept);
+
+        // 文件上限：达到后不再记录
+        options = prpc::TrafficCapture::Options();
+        options.max_file_bytes = prpc::capture::kFileHeaderSize + frame_bytes * 5;
+        assert(capture.start(path, options));
+        for (int i = 0; i < 20; ++i) {
+            capture.record(std::chrono::steady_clock::now(), header, args);
+        }
+        capture.stop();
+        assert(readBack(path).size() == 5);
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        assert(static_cast<uint64_t>(in.tellg()) <= options.max_file_bytes);
+
+        remove(path.c_str());
+        std::cout << "Capture budget test passed!" << std::endl;
+    }
+
+    static void testTruncatedFile() {
+        std::cout << "Testing truncated capture file..." << std::endl;
+
+        std::string path = tempPath();
+        auto& capture = prpc::TrafficCapture::getInstance();
+        assert(capture.start(path));
+        capture.record(std::chrono::steady_clock::now(), makeHeader("Login", 4), "abcd");
+        capture.record(std::chrono::steady_clock::now(), makeHeader("Login", 4), "efgh");
+        capture.stop();
+
+        // 抓取进程中途退出时最后一条记录可能只写了一部分
+        std::ifstream in(path, std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        in.close();
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(content.data(), content.size() - 3);
+        out.close();
+        std::vector<prpc::CapturedFrame> frames = readBack(path);
+        assert(frames.size() == 1 && frames[0].args == "abcd");
+
+        // 不是抓取文件
+        std::ofstream bad(path, std::ios::trunc);
+        bad << "hello world, not a capture file";
+        bad.close();
+        std::string error;
+        frames.clear();
+        assert(!prpc::readCaptureFile(path, nullptr, &frames, &error));
+        assert(!error.empty());
+
+        remove(path.c_str());
+        std::cout << "Truncated capture file test passed!" << std::endl;
+    }
+
+    static void testConcurrentRecord() {
+        std::cout << "Testing concurrent capture..." << std::endl;
+
+        std::string path = tempPath();
+        auto& capture = prpc::TrafficCapture::getInstance();
+        prpc::TrafficCapture::Options options;
+        options.bytes_per_second = 1ull << 40;
+        assert(capture.start(path, options));
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&capture, t] {
+                std::string args(64, static_cast<char>('a' + t));
+                for (int i = 0; i < 5000; ++i) {
+                    capture.record(std::chrono::steady_clock::now(), makeHeader("Login", 64), args);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        capture.stop();
+        std::vector<prpc::CapturedFrame> frames = readBack(path);
+        assert(frames.size() == 20000);
+        for (const auto& frame : frames) {
+            assert(frame.args.size() == 64 && frame.args.find_first_not_of(frame.args[0]) ==
+                                                  std::string::npos);
+        }
+
+        remove(path.c_str());
+        std::cout << "Concurrent capture test passed!" << std::endl;
+    }
+};
+
+int main() {
+    std::cout << "Running capture tests..." << std::endl;
+
+    CaptureTest::testRoundTrip();
+    CaptureTest::testSampling();
+    CaptureTest::testBudget();
+    CaptureTest::testTruncatedFile();
+    CaptureTest::testConcurrentRecord();
+
+    std::cout << "All capture tests passed!" << std::endl;
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include "crc32c.h"
+#include "header.pb.h"
+#include "rpc_frame.h"
+#include <iostream>
+#include <cassert>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+class ChecksumTest {
+public:
+    static void testKnownValues() {
+        std::cout << "Testing CRC32C known values..." << std::endl;
+
+        // RFC 3720 附录 B.4 的测试向量
+        std::string digits = "123456789";
+        assert(prpc::crc32c(digits.data(), digits.size()) == 0xE3069283u);
+        std::string zeros(32, '\0');
+        assert(prpc::crc32c(zeros.data(), zeros.size()) == 0x8A9136AAu);
+        std::string ones(32, '\xff');
+        assert(prpc::crc32c(ones.data(), ones.size()) == 0x62A8AB43u);
+        std::string ascending(32, '\0');
+        for (int i = 0; i < 32; ++i) {
+            ascending[i] = static_cast<char>(i);
+        }
+        assert(prpc::crc32c(ascending.data(), ascending.size()) == 0x46DD794Eu);
+        assert(prpc::crc32cPortable(digits.data(), digits.size()) == 0xE3069283u);
+        assert(prpc::crc32c(nullptr, 0) == 0);
+
+        std::cout << "CRC32C known values test passed! (hardware: "
+                  << (prpc::crc32cHardware() ? "yes" : "no") << ")" << std::endl;
+    }
+
+    static void testHardwareMatchesPortable() {
+        std::cout << "Testing CRC32C implementations agree..." << std::endl;
+
+        std::mt19937 rng(42);
+        std::vector<char> buffer(200000);
+        for (auto& c : buffer) {
+            c = static_cast<char>(rng());
+        }
+        // 覆盖未对齐的开头、三路交错的长块和短块边界以及尾部
+        std::vector<size_t> sizes = {0, 1, 7, 8, 9, 255, 256, 767, 768, 769,
+                                     8191, 24575, 24576, 24577, 65536, 100003};
+        for (size_t size : sizes) {
+            for (size_t offset = 0; offset < 8; ++offset) {
+                const char* data = buffer.data() + offset;
+                assert(prpc::crc32c(data, size) == prpc::crc32cPortable(data, size));
+            }
+        }
+        for (int i = 0; i < 200; ++i) {
+            size_t offset = rng() % 64;
+            size_t size = rng() % (buffer.size() - offset);
+            const char* data = buffer.data() + offset;
+            assert(prpc::crc32c(data, size) == prpc::crc32cPortable(data, size));
+        }
+
+        std::cout << "CRC32C implementations agree test passed!" << std::endl;
+    }
+
+    static void testIncremental() {
+        std::cout << "Testing incremental CRC32C..." << std::endl;
+
+        std::mt19937 rng(7);
+        std::string data(70000, '\0');
+        for (auto& c : data) {
+            c = static_cast<char>(rng());
+        }
+        uint32_t whole = prpc::crc32c(data.data(), data.size());
+        for (size_t split : {size_t(0), size_t(1), size_t(4), size_t(333), size_t(30000),
+                             data.size()}) {
+            uint32_t crc = prpc::crc32c(data.data(), split);
+            crc = prpc::crc32c(data.data() + split, data.size() - split, crc);
+            assert(crc == whole);
+            uint32_t portable = prpc::crc32cPortable(data.data(), split);
+            portable = prpc::crc32cPortable(data.data() + split, data.size() - split, portable);
+            assert(portable == whole);
+        }
+
+        std::cout << "Incremental CRC32C test passed!" << std::endl;
+    }
+
+    static void testRequestFrame() {
+        std::cout << "Testing request frame checksum..." << std::endl;
+
+        Prpc::RpcHeader header;
+        header.set_service_name("UserService");
+        header.set_method_name("Login");
+        std::string args(65536, 'x');
+        header.set_args_size(args.size());
+
+        // 未开启时线路格式不变
+        std::string plain;
+        assert(prpc::encodeRequestFrame(header, args, &plain));
+        bool checksum = true;
+        uint32_t header_size = prpc::decodeFrameLength(plain.data(), &checksum);
+        assert(!checksum);
+        assert(plain.size() == prpc::kFrameLengthSize + header_size + args.size());
+
+        std::string frame;
+        assert(prpc::encodeRequestFrame(header, args, &frame, true));
+        assert(frame.size() == plain.size() + prpc::kFrameChecksumSize);
+        assert(prpc::decodeFrameLength(frame.data(), &checksum) == header_size);
+        assert(checksum);
+        size_t body = frame.size() - prpc::kFrameChecksumSize;
+        assert(prpc::decodeFrameChecksum(frame.data() + body) ==
+               prpc::crc32c(frame.data(), body));
+        Prpc::RpcHeader parsed;
+        assert(parsed.ParseFromArray(frame.data() + prpc::kFrameLengthSize, header_size));
+        assert(parsed.args_size() == args.size());
+
+        // 任意一个比特翻转都能发现，包括长度字段
+        for (size_t pos : {size_t(0), size_t(2), size_t(prpc::kFrameLengthSize + 3),
+                           body - 1}) {
+            std::string corrupted = frame;
+            corrupted[pos] ^= 0x10;
+            assert(prpc::decodeFrameChecksum(corrupted.data() + body) !=
+                   prpc::crc32c(corrupted.data(), body));
+        }
+
+        // 超长的 RpcHeader 不编码，out 不变
+        Prpc::RpcHeader oversized;
+        oversized.set_service_name(std::string(prpc::kMaxHeaderSize, 's'));
+        std::string rejected = "prefix";
+        assert(!prpc::encodeRequestFrame(oversized, args, &rejected, true));
+        assert(rejected == "prefix");
+
+        std::cout << "Request frame checksum test passed!" << std::endl;
+    }
+
+    static void testResponseFrame() {
+        std::cout << "Testing response frame checksum..." << std::endl;
+
+        Prpc::RpcHeader message;
+        message.set_service_name(std::string(1000, 's'));
+
+        std::string plain;
+        assert(prpc::encodeResponseFrame(message, &plain));
+        bool checksum = true;
+        uint32_t size = prpc::decodeFrameLength(plain.data(), &checksum);
+        assert(!checksum && size == plain.size() - prpc::kFrameLengthSize);
+
+        std::string frame;
+        assert(prpc::encodeResponseFrame(message, &frame, true));
+        assert(prpc::decodeFrameLength(frame.data(), &checksum) == size);
+        assert(checksum);
+        assert(frame.size() == plain.size() + prpc::kFrameChecksumSize);
+        size_t body = prpc::kFrameLengthSize + size;
+        assert(prpc::decodeFrameChecksum(frame.data() + body) ==
+               prpc::crc32c(frame.data(), body));
+        assert(memcmp(frame.data() + prpc::kFrameLengthSize,
+                      plain.data() + prpc::kFrameLengthSize, size) == 0);
+
+        std::cout << "Response frame checksum test passed!" << std::endl;
+    }
+};
+
+int main() {
+    std::cout << "Running checksum tests..." << std::endl;
+
+    ChecksumTest::testKnownValues();
+    ChecksumTest::testHardwareMatchesPortable();
+    ChecksumTest::testIncremental();
+    ChecksumTest::testRequestFrame();
+    ChecksumTest::testResponseFrame();
+
+    std::cout << "All checksum tests passed!" << std::endl;
+    return 0;
+}
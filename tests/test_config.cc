@@ -3,7 +3,13 @@
 #include <iostream>
 #include <cassert>
 #include <fstream>
+#include <memory>
+#include <optional>
 #include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
 
 class ConfigTest {
 public:
@@ -148,6 +154,369 @@ public:
         
         std::cout << "Config reload test passed!" << std::endl;
     }
+
+    static void testTypedSnapshot() {
+        std::cout << "Testing typed config snapshot..." << std::endl;
+        
+        const char* test_config = "test_snapshot_config.conf";
+        std::ofstream file(test_config);
+        file << "rpcserverip=127.0.0.1\n";
+        file << "rpcserverport=8000\n";
+        file << "zookeeperip=10.0.0.1\n";
+        file << "zookeeperport=2181\n";
+        file << "rpcserver_queue_weights=8,4,1\n";
+        file << "rpcserver_slow_request_ms=250\n";
+        file << "trace_sample_rate=0.5\n";
+        file.close();
+        
+        Pconfig config;
+        ConfigSnapshotPtr empty = config.Snapshot();
+        assert(empty->version == 0 && empty->values.empty());
+        assert(config.LoadConfigFile(test_config).isSuccess());
+        
+        ConfigSnapshotPtr held = config.Snapshot();
+        const ConfigSnapshot& snapshot = *held;
+        assert(snapshot.version == 1);
+        assert(snapshot.rpcserver_ip == "127.0.0.1");
+        assert(snapshot.rpcserver_port == 8000);
+        assert(snapshot.zookeeper_host == "10.0.0.1:2181");
+        assert((snapshot.queue_weights == std::vector<unsigned>{8, 4, 1}));
+        assert(snapshot.slow_request_ms == 250);
+        assert(snapshot.trace_sample_rate == 0.5);
+        assert(snapshot.status_port == 0);
+        assert(snapshot.GetInt("rpcserverport") == 8000);
+        assert(snapshot.GetInt("missing", 42) == 42);
+        assert(snapshot.Get("missing").empty());
+        
+        // 加载失败时保留原配置
+        assert(!config.LoadConfigFile("nonexistent_file.conf").isSuccess());
+        assert(config.Snapshot() == held);
+        
+        // 重新加载后，持有的旧快照仍然有效，没有持有者的旧快照被回收
+        std::weak_ptr<const ConfigSnapshot> released = empty;
+        empty.reset();
+        assert(released.expired());
+        std::ofstream file2(test_config);
+        file2 << "rpcserverport=9000\n";
+        file2.close();
+        assert(config.Reload().isSuccess());
+        assert(config.Snapshot()->version == 2);
+        assert(config.Snapshot()->rpcserver_port == 9000);
+        assert(snapshot.rpcserver_port == 8000);
+        std::weak_ptr<const ConfigSnapshot> old = held;
+        held.reset();
+        assert(old.expired());
+        
+        std::remove(test_config);
+        
+        std::cout << "Typed config snapshot test passed!" << std::endl;
+    }
+    
+    static void testChangeCallbacks() {
+        std::cout << "Testing config change callbacks..." << std::endl;
+        
+        const char* test_config = "test_callback_config.conf";
+        std::ofstream file(test_config);
+        file << "log_level=info\n";
+        file << "rpcserver_slow_request_ms=100\n";
+        file.close();
+        
+        Pconfig config;
+        assert(config.LoadConfigFile(test_config).isSuccess());
+        
+        int level_changes = 0;
+        int slow_changes = 0;
+        std::string level;
+        config.OnChange("log_level", [&](const ConfigSnapshot& now) {
+            ++level_changes;
+            level = now.log_level;
+        });
+        uint64_t slow_id = config.OnChange("rpcserver_slow_request_ms",
+                                           [&](const ConfigSnapshot&) { ++slow_changes; });
+        
+        // 值没有变化的键不通知
+        assert(config.Reload().isSuccess());
+        assert(level_changes == 0 && slow_changes == 0);
+        
+        std::ofstream file2(test_config);
+        file2 << "log_level=debug\n";
+        file2 << "rpcserver_slow_request_ms=100\n";
+        file2.close();
+        assert(config.Reload().isSuccess());
+        assert(level_changes == 1 && level == "debug" && slow_changes == 0);
+        
+        // 删除的键也算变化；取消后不再通知
+        config.RemoveOnChange(slow_id);
+        std::ofstream file3(test_config);
+        file3 << "log_level=warn\n";
+        file3.close();
+        assert(config.Reload().isSuccess());
+        assert(level_changes == 2 && level == "warn" && slow_changes == 0);
+        
+        std::remove(test_config);
+        
+        std::cout << "Config change callbacks test passed!" << std::endl;
+    }
+    
+    static void testCallbackReentry() {
+        std::cout << "Testing config calls from change callbacks..." << std::endl;
+        
+        const char* test_config = "test_reentry_config.conf";
+        auto writeConfig = [&](int ms) {
+            std::ofstream file(test_config, std::ios::trunc);
+            file << "rpcserver_slow_request_ms=" << ms << "\n";
+            file.close();
+        };
+        writeConfig(100);
+        
+        Pconfig config;
+        assert(config.LoadConfigFile(test_config).isSuccess());
+        
+        // 回调里移除自身、注册新回调、再次加载都不会死锁
+        int once_calls = 0;
+        int added_calls = 0;
+        uint64_t once_id = 0;
+        once_id = config.OnChange("rpcserver_slow_request_ms", [&](const ConfigSnapshot&) {
+            ++once_calls;
+            config.RemoveOnChange(once_id);
+            config.OnChange("rpcserver_slow_request_ms",
+                            [&](const ConfigSnapshot&) { ++added_calls; });
+        });
+        // 同一轮中排在后面、被前面的回调移除的回调不再执行
+        int removed_calls = 0;
+        uint64_t removed_id = 0;
+        config.OnChange("rpcserver_slow_request_ms", [&](const ConfigSnapshot& now) {
+            if (now.slow_request_ms == 200) {
+                config.RemoveOnChange(removed_id);
+            }
+        });
+        removed_id = config.OnChange("rpcserver_slow_request_ms",
+                                     [&](const ConfigSnapshot&) { ++removed_calls; });
+        
+        writeConfig(200);
+        assert(config.Reload().isSuccess());
+        assert(once_calls == 1 && added_calls == 0 && removed_calls == 0);
+        
+        writeConfig(300);
+        assert(config.Reload().isSuccess());
+        assert(once_calls == 1 && added_calls == 1 && removed_calls == 0);
+        
+        int reloads = 0;
+        config.OnChange("rpcserver_slow_request_ms", [&](const ConfigSnapshot& now) {
+            if (now.slow_request_ms == 400 && reloads++ == 0) {
+                writeConfig(500);
+                assert(config.Reload().isSuccess());
+            }
+        });
+        writeConfig(400);
+        assert(config.Reload().isSuccess());
+        assert(config.Snapshot()->slow_request_ms == 500);
+        assert(config.Snapshot()->version == 5);
+        
+        std::remove(test_config);
+        
+        std::cout << "Config calls from change callbacks test passed!" << std::endl;
+    }
+    
+    static void testWatchFile() {
+        std::cout << "Testing config file watching..." << std::endl;
+        
+        const char* test_config = "test_watch_config.conf";
+        const char* temp_config = "test_watch_config.conf.tmp";
+        std::ofstream file(test_config);
+        file << "rpcserver_slow_request_ms=100\n";
+        file.close();
+        
+        Pconfig config;
+        assert(!config.StartWatching());  // 尚未加载文件
+        assert(config.LoadConfigFile(test_config).isSuccess());
+        std::atomic<int> latest{0};
+        config.OnChange("rpcserver_slow_request_ms", [&](const ConfigSnapshot& now) {
+            latest = now.slow_request_ms;
+        });
+        assert(config.StartWatching());
+        
+        auto waitFor = [&](int expected) {
+            for (int i = 0; i < 200 && latest != expected; ++i) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            return latest == expected;
+        };
+        
+        // 原地改写
+        std::ofstream file2(test_config, std::ios::trunc);
+        file2 << "rpcserver_slow_request_ms=200\n";
+        file2.close();
+        assert(waitFor(200));
+        assert(config.Snapshot()->slow_request_ms == 200);
+        
+        // 写临时文件后 rename 替换
+        std::ofstream file3(temp_config);
+        file3 << "rpcserver_slow_request_ms=300\n";
+        file3.close();
+        assert(std::rename(temp_config, test_config) == 0);
+        assert(waitFor(300));
+        
+        // 目录中其他文件的变化不触发重新加载
+        uint64_t version = config.Snapshot()->version;
+        std::ofstream other("test_watch_other.conf");
+        other << "rpcserver_slow_request_ms=400\n";
+        other.close();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        assert(config.Snapshot()->version == version);
+        
+        config.StopWatching();
+        std::remove("test_watch_other.conf");
+        std::remove(test_config);
+        
+        std::cout << "Config file watching test passed!" << std::endl;
+    }
+    
+    static void testConcurrentReads() {
+        std::cout << "Testing concurrent reads during reload..." << std::endl;
+        
+        const char* test_config = "test_concurrent_config.conf";
+        auto writeConfig = [&](int port) {
+            std::ofstream file(test_config, std::ios::trunc);
+            file << "rpcserverip=127.0.0.1\n";
+            file << "rpcserverport=" << port << "\n";
+            file.close();
+        };
+        writeConfig(1000);
+        
+        Pconfig config;
+        assert(config.LoadConfigFile(test_config).isSuccess());
+        std::atomic<bool> done{false};
+        std::vector<std::thread> readers;
+        for (int t = 0; t < 4; ++t) {
+            readers.emplace_back([&] {
+                while (!done) {
+                    ConfigSnapshotPtr snapshot = config.Snapshot();
+                    assert(snapshot->rpcserver_ip == "127.0.0.1");
+                    assert(snapshot->rpcserver_port >= 1000 && snapshot->rpcserver_port < 1100);
+                }
+            });
+        }
+        for (int port = 1001; port < 1100; ++port) {
+            writeConfig(port);
+            assert(config.Reload().isSuccess());
+        }
+        done = true;
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        assert(config.Snapshot()->rpcserver_port == 1099);
+        
+        std::remove(test_config);
+        
+        std::cout << "Concurrent reads test passed!" << std::endl;
+    }
+
+    static void testSnapshotCache() {
+        std::cout << "Testing per-thread snapshot cache..." << std::endl;
+        
+        const char* config_a = "test_cache_a.conf";
+        const char* config_b = "test_cache_b.conf";
+        std::ofstream file_a(config_a);
+        file_a << "rpcserverport=1000\n";
+        file_a.close();
+        std::ofstream file_b(config_b);
+        file_b << "rpcserverport=2000\n";
+        file_b.close();
+        
+        // 版本相同的两个实例交替读取，各自拿到自己的快照
+        Pconfig a;
+        Pconfig b;
+        assert(a.LoadConfigFile(config_a).isSuccess());
+        assert(b.LoadConfigFile(config_b).isSuccess());
+        assert(a.Version() == 1 && b.Version() == 1);
+        for (int i = 0; i < 3; ++i) {
+            assert(a.Snapshot()->rpcserver_port == 1000);
+            assert(b.Snapshot()->rpcserver_port == 2000);
+        }
+        
+        // 版本未变时返回同一个快照；其他线程重新加载后本线程读到新快照
+        ConfigSnapshotPtr first = a.Snapshot();
+        assert(a.Snapshot() == first);
+        std::thread([&] { assert(a.LoadConfigFile(config_b).isSuccess()); }).join();
+        assert(a.Version() == 2);
+        assert(a.Snapshot() != first && a.Snapshot()->rpcserver_port == 2000);
+        
+        // 在同一地址上重新构造的实例不会读到前一个实例的缓存
+        std::optional<Pconfig> reused;
+        reused.emplace();
+        assert(reused->LoadConfigFile(config_a).isSuccess());
+        assert(reused->Snapshot()->rpcserver_port == 1000);
+        reused.emplace();
+        assert(reused->LoadConfigFile(config_b).isSuccess());
+        assert(reused->Version() == 1);
+        assert(reused->Snapshot()->rpcserver_port == 2000);
+        
+        std::remove(config_a);
+        std::remove(config_b);
+        
+        std::cout << "Per-thread snapshot cache test passed!" << std::endl;
+    }
+
+    static void testMethodSections() {
+        std::cout << "Testing per-service and per-method sections..." << std::endl;
+        
+        const char* test_config = "test_sections_config.conf";
+        std::ofstream file(test_config);
+        file << "rpcserverip=127.0.0.1\n";
+        file << "timeout_ms=1\n";
+        file << "checksum=crc32c\n";
+        file << "[UserService]\n";
+        file << "timeout_ms=500\n";
+        file << "max_retries=2\n";
+        file << "priority=low\n";
+        file << "[ UserService.Login ]\n";
+        file << "timeout_ms=100\n";
+        file << "executor=inline\n";
+        file << "priority=high\n";
+        file << "max_concurrency=64\n";
+        file << "checksum=none\n";
+        file << "[]\n";
+        file << "rpcserverport=8000\n";
+        file.close();
+        
+        Pconfig config;
+        assert(config.LoadConfigFile(test_config).isSuccess());
+        ConfigSnapshotPtr held = config.Snapshot();
+        const ConfigSnapshot& snapshot = *held;
+        
+        // 小节中的键带小节名前缀，[] 回到顶层
+        assert(snapshot.Get("UserService.timeout_ms") == "500");
+        assert(snapshot.Get("UserService.Login.executor") == "inline");
+        assert(snapshot.rpcserver_port == 8000);
+        assert(snapshot.Get("timeout_ms") == "1");
+        
+        // 方法小节优先，其余项继承服务小节
+        MethodProfile login = snapshot.ResolveMethod("UserService", "Login");
+        assert(login.timeout_ms == 100);
+        assert(login.run_inline);
+        assert(login.priority == 1);
+        assert(login.max_concurrency == 64);
+        assert(login.max_retries == 2);
+        assert(!login.checksum);
+        
+        MethodProfile reg = snapshot.ResolveMethod("UserService", "Register");
+        assert(reg.timeout_ms == 500);
+        assert(!reg.run_inline);
+        assert(reg.priority == 3);
+        assert(reg.max_concurrency == 0);
+        assert(reg.max_retries == 2);
+        assert(reg.checksum);
+        
+        // 没有小节的服务使用默认值，顶层的同名键不参与(checksum 除外，顶层即全局默认)
+        MethodProfile other = snapshot.ResolveMethod("OrderService", "Create");
+        assert(other.timeout_ms == 0 && other.priority == 0 && !other.run_inline);
+        assert(other.checksum);
+        
+        std::remove(test_config);
+        
+        std::cout << "Per-service and per-method sections test passed!" << std::endl;
+    }
 };
 
 int main() {
@@ -159,6 +528,13 @@ int main() {
         ConfigTest::testConfigWithSpecialCharacters();
         ConfigTest::testConfigWithComments();
         ConfigTest::testConfigReload();
+        ConfigTest::testTypedSnapshot();
+        ConfigTest::testChangeCallbacks();
+        ConfigTest::testCallbackReentry();
+        ConfigTest::testWatchFile();
+        ConfigTest::testConcurrentReads();
+        ConfigTest::testSnapshotCache();
+        ConfigTest::testMethodSections();
         
         std::cout << "All configuration tests passed!" << std::endl;
         return 0;
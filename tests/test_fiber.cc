@@ -0,0 +1,233 @@
+#include "fiber.h"
+#include <iostream>
+#include <cassert>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+class FiberTest {
+public:
+    static void testSpawnAndRun() {
+        std::cout << "Testing fiber spawn..." << std::endl;
+
+        std::atomic<int> counter{0};
+        {
+            FiberScheduler scheduler(2);
+            for (int i = 0; i < 100; ++i) {
+                scheduler.spawn([&counter]() {
+                    counter.fetch_add(1);
+                });
+            }
+        }
+        // 析构时等待所有纤程结束
+        assert(counter.load() == 100);
+
+        std::cout << "Fiber spawn test passed!" << std::endl;
+    }
+
+    static void testYieldInterleaves() {
+        std::cout << "Testing fiber yield..." << std::endl;
+
+        std::vector<int> order;
+        {
+            // 单个工作线程上，两个纤程通过yield交替执行。
+            // 由父纤程创建，保证两者都入队后才开始运行
+            FiberScheduler scheduler(1);
+            scheduler.spawn([&scheduler, &order]() {
+                for (int id = 0; id < 2; ++id) {
+                    scheduler.spawn([&order, id]() {
+                        for (int i = 0; i < 3; ++i) {
+                            order.push_back(id);
+                            fiber::yield();
+                        }
+                    });
+                }
+            });
+        }
+        std::vector<int> expected = {0, 1, 0, 1, 0, 1};
+        assert(order == expected);
+
+        std::cout << "Fiber yield test passed!" << std::endl;
+    }
+
+    static void testSleepDoesNotBlockThread() {
+        std::cout << "Testing many sleeping fibers on few threads..." << std::endl;
+
+        const int fibers = 10000;
+        std::atomic<int> woke{0};
+        auto start = std::chrono::steady_clock::now();
+        {
+            FiberScheduler scheduler(2);
+            for (int i = 0; i < fibers; ++i) {
+                scheduler.spawn([&woke]() {
+                    fiber::sleepFor(std::chrono::milliseconds(50));
+                    woke.fetch_add(1);
+                });
+            }
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start);
+
+        assert(woke.load() == fibers);
+        // 如果睡眠阻塞了工作线程，将需要 fibers * 50ms / 2
+        assert(elapsed.count() < 5000);
+
+        std::cout << "Sleeping fibers test passed! (" << elapsed.count() << "ms)" << std::endl;
+    }
+
+    static void testSocketWait() {
+        std::cout << "Testing fiber socket wait..." << std::endl;
+
+        int fds[2];
+        assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+        std::string received;
+        ssize_t timed_out_result = 0;
+        {
+            // 单线程：读端纤程挂起后，写端纤程才能运行
+            FiberScheduler scheduler(1);
+            scheduler.spawn([&]() {
+                char buf[16] = {0};
+                ssize_t n = fiber::recv(fds[0], buf, sizeof(buf), 0, 2000);
+                received.assign(buf, n > 0 ? n : 0);
+
+                timed_out_result = fiber::recv(fds[0], buf, sizeof(buf), 0, 20);
+            });
+            scheduler.spawn([&]() {
+                fiber::sleepFor(std::chrono::milliseconds(10));
+                fiber::send(fds[1], "ping", 4, 0);
+            });
+        }
+        assert(received == "ping");
+        assert(timed_out_result == -1);
+
+        close(fds[0]);
+        close(fds[1]);
+
+        std::cout << "Fiber socket wait test passed!" << std::endl;
+    }
+
+    static void testSharedFdWaiters() {
+        std::cout << "Testing fibers waiting on the same fd..." << std::endl;
+
+        int fds[2];
+        assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+        std::atomic<int> readable{0};
+        std::atomic<int> writable{0};
+        std::atomic<int> timed_out{0};
+        {
+            FiberScheduler scheduler(2);
+            // 两个纤程等同一个 fd 的可读事件，都应被唤醒
+            for (int i = 0; i < 2; ++i) {
+                scheduler.spawn([&]() {
+                    if (fiber::waitFd(fds[0], EPOLLIN, 2000) == 1) {
+                        readable.fetch_add(1);
+                    }
+                });
+            }
+            // 同一个 fd 上等可写的纤程立即返回，不影响读等待者
+            scheduler.spawn([&]() {
+                if (fiber::waitFd(fds[0], EPOLLOUT, 2000) == 1) {
+                    writable.fetch_add(1);
+                }
+            });
+            // 超时离开的等待者不能带走其他纤程的注册
+            scheduler.spawn([&]() {
+                if (fiber::waitFd(fds[0], EPOLLIN, 10) == 0) {
+                    timed_out.fetch_add(1);
+                }
+            });
+            scheduler.spawn([&]() {
+                fiber::sleepFor(std::chrono::milliseconds(50));
+                assert(writable.load() == 1);
+                assert(readable.load() == 0);
+                fiber::send(fds[1], "x", 1, 0);
+            });
+        }
+        assert(readable.load() == 2);
+        assert(writable.load() == 1);
+        assert(timed_out.load() == 1);
+
+        close(fds[0]);
+        close(fds[1]);
+
+        std::cout << "Shared fd waiters test passed!" << std::endl;
+    }
+
+    static void testNestedBlockingChain() {
+        std::cout << "Testing nested blocking calls..." << std::endl;
+
+        // 模拟深度调用链：每一层阻塞等待下一层的应答。
+        // 线程池需要与链深度相同的线程数，纤程只需一个线程。
+        const int depth = 200;
+        std::vector<int> pairs(depth * 2);
+        for (int i = 0; i < depth; ++i) {
+            assert(socketpair(AF_UNIX, SOCK_STREAM, 0, &pairs[i * 2]) == 0);
+        }
+
+        std::atomic<int> completed{0};
+        {
+            FiberScheduler scheduler(1);
+            for (int i = 0; i < depth; ++i) {
+                scheduler.spawn([&, i]() {
+                    char byte = 0;
+                    if (i + 1 < depth) {
+                        // 等待下一层完成
+                        assert(fiber::recv(pairs[(i + 1) * 2], &byte, 1, 0) == 1);
+                    }
+                    fiber::send(pairs[i * 2 + 1], "x", 1, 0);
+                    completed.fetch_add(1);
+                });
+            }
+            // 最外层的调用方是普通线程
+            char byte = 0;
+            assert(fiber::recv(pairs[0], &byte, 1, 0) == 1);
+        }
+        assert(completed.load() == depth);
+
+        for (int fd : pairs) {
+            close(fd);
+        }
+
+        std::cout << "Nested blocking chain test passed!" << std::endl;
+    }
+
+    static void testPlainThreadFallback() {
+        std::cout << "Testing fiber primitives outside a fiber..." << std::endl;
+
+        assert(!fiber::inFiber());
+        int fds[2];
+        assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+        assert(fiber::waitFd(fds[0], EPOLLIN, 10) == 0);
+        assert(fiber::send(fds[1], "ok", 2, 0) == 2);
+        char buf[4] = {0};
+        assert(fiber::recv(fds[0], buf, sizeof(buf), 0) == 2);
+
+        close(fds[0]);
+        close(fds[1]);
+
+        std::cout << "Plain thread fallback test passed!" << std::endl;
+    }
+};
+
+int main() {
+    std::cout << "Running fiber tests..." << std::endl;
+
+    FiberTest::testSpawnAndRun();
+    FiberTest::testYieldInterleaves();
+    FiberTest::testSleepDoesNotBlockThread();
+    FiberTest::testSocketWait();
+    FiberTest::testSharedFdWaiters();
+    FiberTest::testNestedBlockingChain();
+    FiberTest::testPlainThreadFallback();
+
+    std::cout << "All fiber tests passed!" << std::endl;
+    return 0;
+}
@@ -5,6 +5,18 @@
 #include "error.h"
 #include "logger.h"
 #include "network_utils.h"
+#include "header.pb.h"
+#include "registry.h"
+#include "rpc_frame.h"
+#include "trace.h"
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/descriptor.pb.h>
+#include <google/protobuf/dynamic_message.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
 #include <iostream>
 #include <cassert>
 #include <thread>
@@ -285,6 +297,243 @@ public:
         
         std::cout << "End-to-end scenario test passed!" << std::endl;
     }
+    
+    static void testResponseSizeLimit() {
+        std::cout << "Testing client response size limit..." << std::endl;
+        
+        const char* test_config = "response_limit_test.conf";
+        std::ofstream file(test_config);
+        file << "registry=memory\n";
+        file << "rpcclient_max_response_mb=1\n";
+        file.close();
+        const char* argv[] = {"test_program", "-i", test_config};
+        assert(Papplication::Init(3, const_cast<char**>(argv)).isSuccess());
+        
+        FakeBlobService service;
+        const google::protobuf::MethodDescriptor* method = service.method;
+        int listenfd = service.listenfd;
+        
+        // 第一个连接回一个声称 2MB 的响应头；客户端应断开它，第二次调用用新连接拿到正常响应
+        std::thread server([&] {
+            int first = accept(listenfd, nullptr, nullptr);
+            FakeBlobService::readRequest(first);
+            uint32_t length = 2u << 20;
+            assert(send(first, &length, sizeof(length), 0) == sizeof(length));
+            
+            int second = accept(listenfd, nullptr, nullptr);
+            FakeBlobService::readRequest(second);
+            std::unique_ptr<google::protobuf::Message> reply = service.newMessage();
+            reply->GetReflection()->SetString(reply.get(), method->output_type()->field(0),
+                                              std::string(1000, 'r'));
+            std::string frame;
+            assert(prpc::encodeResponseFrame(*reply, &frame));
+            assert(send(second, frame.data(), frame.size(), 0) ==
+                   static_cast<ssize_t>(frame.size()));
+            
+            char eof;
+            recv(first, &eof, 1, 0);
+            close(first);
+            close(second);
+        });
+        
+        {
+            Pchannel channel(false);
+            std::unique_ptr<google::protobuf::Message> request = service.newMessage();
+            std::unique_ptr<google::protobuf::Message> response = service.newMessage();
+            
+            Pcontroller oversized;
+            oversized.SetTimeout(2000);
+            channel.CallMethod(method, &oversized, request.get(), response.get(), nullptr);
+            assert(oversized.Failed());
+            assert(oversized.ErrorText().find("exceeds max_response_mb") != std::string::npos);
+            
+            Pcontroller controller;
+            controller.SetTimeout(2000);
+            channel.CallMethod(method, &controller, request.get(), response.get(), nullptr);
+            assert(!controller.Failed());
+            assert(response->GetReflection()->GetString(*response, method->output_type()->field(0))
+                   == std::string(1000, 'r'));
+        }
+        server.join();
+        std::remove(test_config);
+        
+        std::cout << "Client response size limit test passed!" << std::endl;
+    }
+    
+    static void testMethodTimeout() {
+        std::cout << "Testing configured method timeout..." << std::endl;
+        
+        const char* test_config = "method_timeout_test.conf";
+        std::ofstream file(test_config);
+        file << "registry=memory\n";
+        file << "[BlobService.Get]\n";
+        file << "timeout_ms=300\n";
+        file.close();
+        const char* argv[] = {"test_program", "-i", test_config};
+        assert(Papplication::Init(3, const_cast<char**>(argv)).isSuccess());
+        
+        // 服务端读到请求后不回复，直到客户端超时断开
+        FakeBlobService service;
+        std::atomic<uint32_t> header_timeout{0};
+        std::thread server([&] {
+            int fd = accept(service.listenfd, nullptr, nullptr);
+            header_timeout = FakeBlobService::readRequest(fd).timeout_ms();
+            char eof;
+            while (recv(fd, &eof, 1, 0) > 0) {
+            }
+            close(fd);
+        });
+        
+        {
+            Pchannel channel(false);
+            std::unique_ptr<google::protobuf::Message> request = service.newMessage();
+            std::unique_ptr<google::protobuf::Message> response = service.newMessage();
+            
+            // 未调用 SetTimeout 的 Pcontroller 使用方法的 timeout_ms，而不是默认的 5 秒
+            Pcontroller controller;
+            auto start = std::chrono::steady_clock::now();
+            channel.CallMethod(service.method, &controller, request.get(), response.get(),
+                               nullptr);
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            assert(controller.Failed());
+            assert(controller.ErrorText() == "recv timeout!");
+            assert(elapsed >= 250 && elapsed < 2000);
+        }
+        server.join();
+        assert(header_timeout == 300);
+        std::remove(test_config);
+        
+        std::cout << "Configured method timeout test passed!" << std::endl;
+    }
+
+    static void testDeadlinePropagation() {
+        std::cout << "Testing deadline propagation to nested calls..." << std::endl;
+        
+        const char* test_config = "deadline_test.conf";
+        std::ofstream file(test_config);
+        file << "registry=memory\n";
+        file.close();
+        const char* argv[] = {"test_program", "-i", test_config};
+        assert(Papplication::Init(3, const_cast<char**>(argv)).isSuccess());
+        
+        FakeBlobService service;
+        std::atomic<uint32_t> header_timeout{0};
+        std::thread server([&] {
+            int fd = accept(service.listenfd, nullptr, nullptr);
+            header_timeout = FakeBlobService::readRequest(fd).timeout_ms();
+            char eof;
+            while (recv(fd, &eof, 1, 0) > 0) {
+            }
+            close(fd);
+        });
+        
+        {
+            Pchannel channel(false);
+            std::unique_ptr<google::protobuf::Message> request = service.newMessage();
+            std::unique_ptr<google::protobuf::Message> response = service.newMessage();
+            
+            // 处理请求时发起的调用：自己的超时 5 秒，但所处理的请求只剩约 300ms
+            prpc::TraceContext serving;
+            serving.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(300);
+            {
+                prpc::ScopedTraceContext scope(serving);
+                Pcontroller controller;
+                controller.SetTimeout(5000);
+                auto start = std::chrono::steady_clock::now();
+                channel.CallMethod(service.method, &controller, request.get(), response.get(),
+                                   nullptr);
+                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+                assert(controller.Failed());
+                assert(controller.ErrorText() == "recv timeout!");
+                assert(elapsed >= 200 && elapsed < 2000);
+            }
+            
+            // 请求已经超时，嵌套调用不再发出
+            serving.deadline = std::chrono::steady_clock::now() - std::chrono::milliseconds(1);
+            prpc::ScopedTraceContext scope(serving);
+            Pcontroller expired;
+            channel.CallMethod(service.method, &expired, request.get(), response.get(), nullptr);
+            assert(expired.Failed());
+            assert(expired.ErrorText() == "deadline exceeded!");
+        }
+        server.join();
+        assert(header_timeout > 0 && header_timeout <= 300);
+        std::remove(test_config);
+        
+        std::cout << "Deadline propagation test passed!" << std::endl;
+    }
+
+private:
+    // 运行时构造的 limit.BlobService.Get，不依赖生成的代码。监听回环地址上的临时端口，
+    // 并登记到内存注册中心；配置中需要 registry=memory
+    struct FakeBlobService {
+        google::protobuf::DescriptorPool pool;
+        std::unique_ptr<google::protobuf::DynamicMessageFactory> factory;
+        const google::protobuf::MethodDescriptor* method = nullptr;
+        int listenfd = -1;
+        MemoryServiceRegistry registry;
+        
+        FakeBlobService() {
+            google::protobuf::FileDescriptorProto proto;
+            proto.set_name("fake_blob_service.proto");
+            proto.set_package("limit");
+            auto* blob = proto.add_message_type();
+            blob->set_name("Blob");
+            auto* field = blob->add_field();
+            field->set_name("data");
+            field->set_number(1);
+            field->set_type(google::protobuf::FieldDescriptorProto::TYPE_BYTES);
+            field->set_label(google::protobuf::FieldDescriptorProto::LABEL_OPTIONAL);
+            auto* service = proto.add_service();
+            service->set_name("BlobService");
+            auto* get = service->add_method();
+            get->set_name("Get");
+            get->set_input_type(".limit.Blob");
+            get->set_output_type(".limit.Blob");
+            const google::protobuf::FileDescriptor* file_desc = pool.BuildFile(proto);
+            assert(file_desc != nullptr);
+            method = file_desc->service(0)->method(0);
+            factory = std::make_unique<google::protobuf::DynamicMessageFactory>(&pool);
+            
+            listenfd = socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            assert(bind(listenfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+            assert(listen(listenfd, 4) == 0);
+            socklen_t addr_len = sizeof(addr);
+            getsockname(listenfd, reinterpret_cast<sockaddr*>(&addr), &addr_len);
+            registry.Register("BlobService", "Get",
+                              "127.0.0.1:" + std::to_string(ntohs(addr.sin_port)));
+        }
+        
+        ~FakeBlobService() {
+            close(listenfd);
+        }
+        
+        std::unique_ptr<google::protobuf::Message> newMessage() const {
+            return std::unique_ptr<google::protobuf::Message>(
+                factory->GetPrototype(method->input_type())->New());
+        }
+        
+        // 读完一个请求帧，返回其中的 RpcHeader
+        static Prpc::RpcHeader readRequest(int fd) {
+            char length_buf[prpc::kFrameLengthSize];
+            assert(recv(fd, length_buf, sizeof(length_buf), MSG_WAITALL) == sizeof(length_buf));
+            std::string header_str(prpc::decodeFrameLength(length_buf), '\0');
+            assert(recv(fd, &header_str[0], header_str.size(), MSG_WAITALL) ==
+                   static_cast<ssize_t>(header_str.size()));
+            Prpc::RpcHeader header;
+            assert(header.ParseFromString(header_str));
+            std::string args(header.args_size(), '\0');
+            if (!args.empty()) {
+                recv(fd, &args[0], args.size(), MSG_WAITALL);
+            }
+            return header;
+        }
+    };
 };
 
 int main() {
@@ -300,6 +549,9 @@ int main() {
         IntegrationTest::testResourceManagement();
         IntegrationTest::testConcurrentOperations();
         IntegrationTest::testEndToEndScenario();
+        IntegrationTest::testResponseSizeLimit();
+        IntegrationTest::testMethodTimeout();
+        IntegrationTest::testDeadlinePropagation();
         
         std::cout << "All integration tests passed!" << std::endl;
         return 0;
@@ -5,6 +5,10 @@
 #include <thread>
 #include <vector>
 #include <chrono>
+#include <fstream>
+#include <map>
+#include <cstdio>
+#include <unistd.h>
 
 class LoggerTest {
 public:
@@ -154,6 +158,342 @@ public:
         
         std::cout << "Log formatting test passed!" << std::endl;
     }
+    
+    static void testAsyncFileOutput() {
+        std::cout << "Testing async file output..." << std::endl;
+        
+        PLogger& logger = PLogger::getInstance();
+        logger.setLogLevel(INFO);
+        std::string path = "/tmp/prpc_logger_test_" + std::to_string(getpid()) + ".log";
+        std::remove(path.c_str());
+        assert(logger.setLogFile(path));
+        
+        // 多线程写入，每个线程内部的顺序必须保持
+        const int num_threads = 4;
+        const int messages_per_thread = 5000;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < num_threads; ++i) {
+            threads.emplace_back([i, messages_per_thread]() {
+                for (int j = 0; j < messages_per_thread; ++j) {
+                    LOG(INFO) << "async t" << i << " seq " << j;
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        LOG(ERROR) << "async error line";
+        logger.flush();
+        
+        std::ifstream in(path);
+        std::string line;
+        std::map<int, int> next_seq;
+        int total = 0;
+        bool saw_error = false;
+        while (std::getline(in, line)) {
+            if (line.find("async error line") != std::string::npos) {
+                assert(line.compare(0, 7, "[ERROR]") == 0);
+                saw_error = true;
+                continue;
+            }
+            int t = -1, seq = -1;
+            size_t pos = line.find("async t");
+            assert(pos != std::string::npos);
+            assert(sscanf(line.c_str() + pos, "async t%d seq %d", &t, &seq) == 2);
+            assert(next_seq[t] == seq);
+            next_seq[t] = seq + 1;
+            ++total;
+        }
+        assert(total == num_threads * messages_per_thread);
+        assert(saw_error);
+        
+        // 恢复控制台输出
+        assert(logger.setLogFile(""));
+        std::remove(path.c_str());
+        
+        std::cout << "Async file output test passed!" << std::endl;
+    }
+    
+    static void testDisabledLevelShortCircuit() {
+        std::cout << "Testing disabled log levels..." << std::endl;
+        
+        PLogger& logger = PLogger::getInstance();
+        int evaluations = 0;
+        auto expensive = [&evaluations]() {
+            ++evaluations;
+            return std::string("expensive");
+        };
+        
+        // 未启用的级别不对参数求值
+        logger.setLogLevel(INFO);
+        LOG(DEBUG) << "debug " << expensive();
+        assert(evaluations == 0);
+        LOG(INFO) << "info " << expensive();
+        assert(evaluations == 1);
+        
+        logger.setLogLevel(ERROR);
+        LOG(WARN) << "warn " << expensive();
+        assert(evaluations == 1);
+        assert(!PRPC_LOG_ENABLED(WARN));
+        assert(PRPC_LOG_ENABLED(FATAL));
+        
+        // 悬挂else不会与宏内的条件结合
+        bool branch = false;
+        if (false)
+            LOG(ERROR) << "never";
+        else
+            branch = true;
+        assert(branch);
+        
+        logger.setLogLevel(DEBUG);
+        LOG(DEBUG) << "debug enabled " << expensive();
+        assert(evaluations == 2);
+        logger.setLogLevel(INFO);
+        
+        LogLevel level;
+        assert(PLogger::parseLevel("WARN", level) && level == WARN);
+        assert(PLogger::parseLevel("debug", level) && level == DEBUG);
+        assert(!PLogger::parseLevel("verbose", level));
+        
+        // 对比启用与未启用时的调用开销
+        const int num_messages = 1000000;
+        std::string path = "/tmp/prpc_logger_level_" + std::to_string(getpid()) + ".log";
+        assert(logger.setLogFile(path));
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < num_messages; ++i) {
+            LOG(DEBUG) << "disabled message " << i;
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        auto disabled_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < num_messages / 10; ++i) {
+            LOG(INFO) << "enabled message " << i;
+        }
+        end = std::chrono::high_resolution_clock::now();
+        auto enabled_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        logger.flush();
+        assert(logger.setLogFile(""));
+        std::remove(path.c_str());
+        
+        std::cout << "Disabled LOG: " << (double)disabled_ns / num_messages << " ns/call, "
+                  << "enabled LOG: " << (double)enabled_ns / (num_messages / 10) << " ns/call" << std::endl;
+        
+        std::cout << "Disabled log level test passed!" << std::endl;
+    }
+    
+    static void testTimestampCache() {
+        std::cout << "Testing cached timestamps..." << std::endl;
+        
+        PLogger& logger = PLogger::getInstance();
+        logger.setLogLevel(INFO);
+        std::string path = "/tmp/prpc_logger_ts_" + std::to_string(getpid()) + ".log";
+        std::remove(path.c_str());
+        assert(logger.setLogFile(path));
+        
+        // 跨过秒边界，缓存的前缀必须随之更新
+        time_t begin = time(nullptr);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(1500);
+        while (std::chrono::steady_clock::now() < deadline) {
+            LOG(INFO) << "tick";
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        time_t finish = time(nullptr);
+        logger.flush();
+        assert(logger.setLogFile(""));
+        
+        std::ifstream in(path);
+        std::string line, previous;
+        std::map<std::string, int> seconds;
+        while (std::getline(in, line)) {
+            // [INFO][2006-01-02 15:04:05.123][file:line] tick
+            assert(line.compare(0, 7, "[INFO][") == 0);
+            assert(line.size() > 31 && line[26] == '.' && line[30] == ']');
+            std::string stamp = line.substr(7, 23);
+            assert(stamp >= previous);  // 同一线程内时间不倒退
+            previous = stamp;
+            seconds[stamp.substr(0, 19)]++;
+        }
+        std::remove(path.c_str());
+        
+        char first[32], last[32];
+        std::tm tm_buf;
+        strftime(first, sizeof(first), "%Y-%m-%d %H:%M:%S", localtime_r(&begin, &tm_buf));
+        strftime(last, sizeof(last), "%Y-%m-%d %H:%M:%S", localtime_r(&finish, &tm_buf));
+        assert(seconds.size() >= 2);
+        assert(seconds.begin()->first >= first);
+        assert(seconds.rbegin()->first <= last);
+        
+        std::cout << "Cached timestamp test passed!" << std::endl;
+    }
+    
+    static std::vector<std::string> readLines(const std::string& path) {
+        std::ifstream in(path);
+        std::vector<std::string> lines;
+        std::string line;
+        while (std::getline(in, line)) {
+            lines.push_back(line);
+        }
+        return lines;
+    }
+    
+    static void testRateLimitedMacros() {
+        std::cout << "Testing rate-limited log macros..." << std::endl;
+        
+        PLogger& logger = PLogger::getInstance();
+        logger.setLogLevel(INFO);
+        std::string path = "/tmp/prpc_logger_limit_" + std::to_string(getpid()) + ".log";
+        std::remove(path.c_str());
+        assert(logger.setLogFile(path));
+        
+        int evaluations = 0;
+        auto counted = [&evaluations](int i) {
+            ++evaluations;
+            return i;
+        };
+        
+        // 每10次输出一次，被抑制的调用不对参数求值
+        for (int i = 0; i < 35; ++i) {
+            LOG_EVERY_N(INFO, 10) << "every_n " << counted(i);
+        }
+        assert(evaluations == 4);
+        
+        for (int i = 0; i < 10; ++i) {
+            LOG_FIRST_N(INFO, 3) << "first_n " << i;
+        }
+        
+        // 时间窗口内只输出第一条
+        for (int i = 0; i < 1000; ++i) {
+            LOG_EVERY_T(INFO, 60.0) << "every_t " << i;
+        }
+        
+        // 令牌桶：突发5条，之后按速率放行
+        int attempts = 0;
+        auto start = std::chrono::steady_clock::now();
+        while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(300)) {
+            ++attempts;
+            LOG_RATE_LIMITED(INFO, 20, 5) << "bucket " << attempts;
+        }
+        
+        // 多线程同时命中同一调用点，计数不丢失
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([]() {
+                for (int i = 0; i < 10000; ++i) {
+                    LOG_EVERY_N(INFO, 1000) << "storm";
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        
+        // 分支中使用时 else 仍属于外层 if
+        bool branch = false;
+        if (false) {
+            LOG_EVERY_N(INFO, 2) << "never";
+        } else {
+            branch = true;
+        }
+        assert(branch);
+        
+        logger.flush();
+        auto lines = readLines(path);
+        int every_n = 0, first_n = 0, every_t = 0, bucket = 0, storm = 0;
+        uint64_t storm_suppressed = 0;
+        for (const auto& line : lines) {
+            if (line.find("every_n ") != std::string::npos) {
+                ++every_n;
+                if (every_n > 1) {
+                    assert(line.find("[suppressed 9 messages]") != std::string::npos);
+                }
+            } else if (line.find("first_n ") != std::string::npos) {
+                ++first_n;
+            } else if (line.find("every_t ") != std::string::npos) {
+                ++every_t;
+            } else if (line.find("bucket ") != std::string::npos) {
+                ++bucket;
+            } else if (line.find("] storm") != std::string::npos) {
+                ++storm;
+                size_t pos = line.find("[suppressed ");
+                if (pos != std::string::npos) {
+                    storm_suppressed += std::stoull(line.substr(pos + 12));
+                }
+            }
+        }
+        assert(every_n == 4);
+        assert(first_n == 3);
+        assert(every_t == 1);
+        // 5条突发 + 300ms * 20条/秒，留出调度误差
+        assert(bucket >= 6 && bucket <= 14);
+        assert(storm == 40);
+        assert(storm_suppressed == 40000 - 40 - 999);  // 最后一批尚未随日志报告
+        
+        assert(logger.setLogFile(""));
+        std::remove(path.c_str());
+        
+        std::cout << "Rate-limited macros test passed! (bucket admitted " << bucket
+                  << " of " << attempts << ")" << std::endl;
+    }
+    
+    static void testSuppressedSummary() {
+        std::cout << "Testing suppressed message summary..." << std::endl;
+        
+        PLogger& logger = PLogger::getInstance();
+        std::string path = "/tmp/prpc_logger_summary_" + std::to_string(getpid()) + ".log";
+        std::remove(path.c_str());
+        assert(logger.setLogFile(path));
+        
+        // 风暴结束后，刷新线程在调用点安静一段时间后补发汇总
+        for (int i = 0; i < 500; ++i) {
+            LOG_EVERY_T(ERROR, 60.0) << "storm once";
+        }
+        std::string summary;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (summary.empty() && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            logger.flush();
+            for (const auto& line : readLines(path)) {
+                // 前面测试的调用点也会陆续补发汇总
+                if (line.find("] suppressed 499 messages") != std::string::npos) {
+                    summary = line;
+                }
+            }
+        }
+        assert(summary.find("[ERROR]") == 0);
+        
+        assert(logger.setLogFile(""));
+        std::remove(path.c_str());
+        
+        std::cout << "Suppressed summary test passed!" << std::endl;
+    }
+    
+    static void testAsyncThroughput() {
+        std::cout << "Testing async logging throughput..." << std::endl;
+        
+        PLogger& logger = PLogger::getInstance();
+        logger.setLogLevel(INFO);
+        std::string path = "/tmp/prpc_logger_bench_" + std::to_string(getpid()) + ".log";
+        assert(logger.setLogFile(path));
+        
+        // 调用方只承担格式化和写入本线程缓冲区的开销
+        const int num_messages = 200000;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < num_messages; ++i) {
+            LOG(INFO) << "new connection accepted. fd=" << i;
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        logger.flush();
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+        
+        std::cout << "Logged " << num_messages << " messages at "
+                  << (double)num_messages / (duration.count() / 1000000.0) << " msgs/sec" << std::endl;
+        
+        assert(logger.setLogFile(""));
+        std::remove(path.c_str());
+        
+        std::cout << "Async throughput test passed!" << std::endl;
+    }
 };
 
 int main() {
@@ -168,6 +508,12 @@ int main() {
         LoggerTest::testLogFormatting();
         LoggerTest::testThreadSafety();
         LoggerTest::testPerformance();
+        LoggerTest::testAsyncFileOutput();
+        LoggerTest::testDisabledLevelShortCircuit();
+        LoggerTest::testTimestampCache();
+        LoggerTest::testRateLimitedMacros();
+        LoggerTest::testSuppressedSummary();
+        LoggerTest::testAsyncThroughput();
         
         std::cout << "All logger tests passed!" << std::endl;
         return 0;
@@ -0,0 +1,233 @@
+#include "metrics.h"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace prpc;
+
+class MetricsTest {
+public:
+    static bool near(double actual, double expected, double tolerance) {
+        return std::fabs(actual - expected) <= expected * tolerance;
+    }
+
+    static void testBucketBoundaries() {
+        std::cout << "Testing histogram bucket boundaries..." << std::endl;
+
+        for (uint64_t v = 0; v < 100000; v += (v < 1000 ? 1 : 37)) {
+            int index = metrics::bucketIndex(v);
+            assert(index >= 0 && index < metrics::kBucketCount);
+            assert(metrics::bucketLower(index) <= v);
+            assert(v < metrics::bucketUpper(index));
+        }
+        // 每个桶的宽度不超过下界的 1/16
+        for (int i = metrics::kSubBuckets; i < metrics::kBucketCount; ++i) {
+            uint64_t width = metrics::bucketUpper(i) - metrics::bucketLower(i);
+            assert(width * metrics::kSubBuckets <= metrics::bucketLower(i));
+            assert(metrics::bucketUpper(i - 1) == metrics::bucketLower(i));
+        }
+        assert(metrics::bucketIndex(UINT64_MAX) == metrics::kBucketCount - 1);
+
+        std::cout << "Bucket boundaries test passed!" << std::endl;
+    }
+
+    static void testPercentiles() {
+        std::cout << "Testing histogram percentiles..." << std::endl;
+
+        Histogram histogram;
+        assert(histogram.snapshot().percentile(0.5) == 0);
+        for (uint64_t v = 1; v <= 100000; ++v) {
+            histogram.record(v);
+        }
+        HistogramSnapshot snapshot = histogram.snapshot();
+        assert(snapshot.count == 100000);
+        assert(snapshot.sum == 100000ull * 100001 / 2);
+        assert(near(snapshot.mean(), 50000.5, 0.001));
+        assert(near(snapshot.percentile(0.5), 50000, 0.07));
+        assert(near(snapshot.percentile(0.9), 90000, 0.07));
+        assert(near(snapshot.percentile(0.99), 99000, 0.07));
+        assert(near(snapshot.percentile(0.999), 99900, 0.07));
+        assert(snapshot.percentile(0.5) <= snapshot.percentile(0.9));
+
+        std::cout << "p50=" << snapshot.percentile(0.5) << " p90=" << snapshot.percentile(0.9)
+                  << " p99=" << snapshot.percentile(0.99) << " p999=" << snapshot.percentile(0.999)
+                  << std::endl;
+        std::cout << "Percentiles test passed!" << std::endl;
+    }
+
+    static void testConcurrentRecording() {
+        std::cout << "Testing concurrent histogram recording..." << std::endl;
+
+        Histogram histogram;
+        const int num_threads = 20;   // 多于分片数，部分线程共享分片
+        const int per_thread = 20000;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < num_threads; ++t) {
+            threads.emplace_back([&histogram, t, per_thread]() {
+                for (int i = 0; i < per_thread; ++i) {
+                    histogram.record(static_cast<uint64_t>(t + 1));
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        HistogramSnapshot snapshot = histogram.snapshot();
+        assert(snapshot.count == static_cast<uint64_t>(num_threads * per_thread));
+        assert(snapshot.sum == static_cast<uint64_t>(per_thread) * num_threads * (num_threads + 1) / 2);
+        for (int t = 0; t < num_threads; ++t) {
+            assert(snapshot.buckets[metrics::bucketIndex(t + 1)] >= static_cast<uint64_t>(per_thread));
+        }
+
+        std::cout << "Concurrent recording test passed!" << std::endl;
+    }
+
+    static void testSlidingWindow() {
+        std::cout << "Testing histogram sliding window..." << std::endl;
+
+        auto t0 = metrics::Clock::now();
+        Histogram histogram;
+        for (int i = 0; i < 1000; ++i) {
+            histogram.record(100);
+        }
+
+        // 窗口起点早于创建时间时从零开始计算
+        HistogramSnapshot first = histogram.window(std::chrono::seconds(60), t0 + std::chrono::seconds(10));
+        assert(first.count == 1000);
+        assert(near(first.percentile(0.5), 100, 0.07));
+        assert(first.seconds <= 10.0);
+
+        for (int i = 0; i < 1000; ++i) {
+            histogram.record(10000);
+        }
+        // 起点为 t0+10s 的快照，之前的 1000 条不计入
+        HistogramSnapshot second = histogram.window(std::chrono::seconds(60), t0 + std::chrono::seconds(100));
+        assert(second.count == 1000);
+        assert(near(second.percentile(0.5), 10000, 0.07));
+        assert(near(second.seconds, 90, 0.01));
+        assert(near(second.rate(), 1000 / 90.0, 0.01));
+
+        // 之后没有新记录
+        HistogramSnapshot third = histogram.window(std::chrono::seconds(5), t0 + std::chrono::seconds(106));
+        assert(third.count == 0);
+        assert(third.percentile(0.99) == 0);
+
+        // 累计值不受窗口影响
+        assert(histogram.snapshot().count == 2000);
+
+        std::cout << "Sliding window test passed!" << std::endl;
+    }
+
+    static void testCountersAndErrors() {
+        std::cout << "Testing counters and error counters..." << std::endl;
+
+        auto t0 = metrics::Clock::now();
+        Counter counter;
+        counter.add(5);
+        Counter::Window window = counter.window(std::chrono::seconds(30), t0 + std::chrono::seconds(10));
+        assert(window.delta == 5);
+        counter.add();
+        window = counter.window(std::chrono::seconds(30), t0 + std::chrono::seconds(50));
+        assert(counter.value() == 6);
+        assert(window.delta == 1);
+        assert(near(window.rate(), 1 / 40.0, 0.01));
+
+        ErrorCounters errors;
+        assert(errors.counters().empty());
+        errors.add(ErrorCode::TIMEOUT_ERROR);
+        errors.add(ErrorCode::TIMEOUT_ERROR);
+        errors.add(ErrorCode::NETWORK_ERROR);
+        errors.add(ErrorCode::UNKNOWN_ERROR);
+        auto entries = errors.counters();
+        assert(entries.size() == 3);
+        assert(entries[0].first == ErrorCode::NETWORK_ERROR && entries[0].second->value() == 1);
+        assert(entries[1].first == ErrorCode::TIMEOUT_ERROR && entries[1].second->value() == 2);
+        assert(entries[2].first == ErrorCode::UNKNOWN_ERROR);
+        assert(errors.total() == 4);
+
+        std::cout << "Counters test passed!" << std::endl;
+    }
+
+    static void testRegistry() {
+        std::cout << "Testing metrics registry..." << std::endl;
+
+        auto& registry = MetricsRegistry::getInstance();
+        MethodStats& server = registry.method(MetricsRegistry::kServer, "UserService", "Login");
+        MethodStats& client = registry.method(MetricsRegistry::kClient, "UserService", "Login");
+        assert(&server != &client);
+        assert(&server == &registry.method(MetricsRegistry::kServer, "UserService", "Login"));
+        registry.method(MetricsRegistry::kServer, "UserService", "Logout");
+
+        server.latency_ns.record(1500);
+        server.errors.add(ErrorCode::SERVICE_ERROR);
+
+        std::vector<std::string> names;
+        registry.forEachMethod([&names](MetricsRegistry::Side side, const std::string& name, MethodStats&) {
+            names.push_back((side == MetricsRegistry::kServer ? "server " : "client ") + name);
+        });
+        assert(names.size() == 3);
+        assert(names[0] == "server UserService.Login");
+        assert(names[1] == "server UserService.Logout");
+        assert(names[2] == "client UserService.Login");
+        assert(server.latency_ns.snapshot().count == 1);
+        assert(server.errors.total() == 1);
+
+        std::cout << "Registry test passed!" << std::endl;
+    }
+
+    static void testRecordingCost() {
+        std::cout << "Testing histogram recording cost..." << std::endl;
+
+        Histogram histogram;
+        const int iterations = 2000000;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            histogram.record(static_cast<uint64_t>(i) * 37);
+        }
+        auto end = std::chrono::steady_clock::now();
+        double single_ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+
+        const int num_threads = 4;
+        std::vector<std::thread> threads;
+        start = std::chrono::steady_clock::now();
+        for (int t = 0; t < num_threads; ++t) {
+            threads.emplace_back([&histogram, iterations]() {
+                for (int i = 0; i < iterations / 4; ++i) {
+                    histogram.record(static_cast<uint64_t>(i) * 37);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        end = std::chrono::steady_clock::now();
+        double threaded_ns = std::chrono::duration<double, std::nano>(end - start).count() /
+                             (iterations / 4 * num_threads);
+
+        assert(histogram.snapshot().count == static_cast<uint64_t>(iterations * 2));
+        std::cout << "record(): " << single_ns << " ns/call single thread, " << threaded_ns
+                  << " ns/call with " << num_threads << " threads" << std::endl;
+        assert(single_ns < 1000);
+        std::cout << "Recording cost test passed!" << std::endl;
+    }
+};
+
+int main() {
+    std::cout << "Running metrics tests..." << std::endl;
+
+    MetricsTest::testBucketBoundaries();
+    MetricsTest::testPercentiles();
+    MetricsTest::testConcurrentRecording();
+    MetricsTest::testSlidingWindow();
+    MetricsTest::testCountersAndErrors();
+    MetricsTest::testRegistry();
+    MetricsTest::testRecordingCost();
+
+    std::cout << "All metrics tests passed!" << std::endl;
+    return 0;
+}
@@ -6,6 +6,8 @@
 #include <atomic>
 #include "object_pool.h"
 #include "message_pool.h"
+#include "pool_monitor.h"
+#include <sstream>
 
 using namespace prpc;
 
@@ -95,6 +97,400 @@ public:
         std::cout << "Object pool concurrency test passed!" << std::endl;
     }
     
+    static void testThreadLocalCache() {
+        std::cout << "Testing object pool thread-local caches..." << std::endl;
+        
+        // 关闭空闲清理，避免析构时等待清理线程
+        ObjectPool<TestObject> pool(
+            []() { return std::make_unique<TestObject>(); },
+            [](TestObject* obj) { obj->reset(); },
+            {0, 256, 0, true, true, 16}
+        );
+        
+        const int num_threads = 8;
+        const int operations_per_thread = 20000;
+        
+        auto run = [&pool, operations_per_thread](int threads) {
+            std::vector<std::thread> workers;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < threads; ++i) {
+                workers.emplace_back([&pool, operations_per_thread]() {
+                    for (int j = 0; j < operations_per_thread; ++j) {
+                        auto obj = pool.acquire();
+                        assert(obj);
+                        assert(obj->value == 0);
+                        obj->value = j;
+                    }
+                });
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+            return (double)threads * operations_per_thread / (duration.count() / 1000000.0);
+        };
+        
+        double single = run(1);
+        double multi = run(num_threads);
+        std::cout << "1 thread: " << single << " ops/sec, " << num_threads
+                  << " threads: " << multi << " ops/sec" << std::endl;
+        
+        // 线程退出后，其缓存中的对象和计数并入共享仓库
+        auto stats = pool.getStatistics();
+        assert(stats.total_acquired.load() == (uint64_t)(num_threads + 1) * operations_per_thread);
+        assert(stats.total_returned.load() == stats.total_acquired.load());
+        assert(stats.active_objects.load() == 0);
+        assert(stats.current_size.load() == stats.total_created.load() - stats.total_destroyed.load());
+        // 每个线程在本地循环复用同一个对象
+        assert(stats.total_created.load() <= (uint64_t)num_threads + 1);
+        
+        // clear之后线程缓存中的旧对象不再计入池大小
+        {
+            auto obj = pool.acquire();
+        }
+        pool.clear();
+        assert(pool.size() == 0);
+        auto obj = pool.acquire();
+        assert(obj);
+        
+        std::cout << "Object pool thread-local cache test passed!" << std::endl;
+    }
+    
+    static void testCachedObjectsAtCapacity() {
+        std::cout << "Testing acquire at max_size with objects cached by other threads..." << std::endl;
+        
+        // max_size 64：弹匣 8 个，每个线程最多缓存 16 个空闲对象
+        const size_t max_size = 64;
+        ObjectPool<TestObject> pool(
+            []() { return std::make_unique<TestObject>(); },
+            [](TestObject* obj) { obj->reset(); },
+            {0, max_size, 0, true, true, 16}
+        );
+        
+        // 4 个线程各借出 16 个后全部归还，空闲对象都留在各自的缓存中，线程保持存活
+        const int num_threads = 4;
+        std::atomic<int> filled{0};
+        std::atomic<bool> touch{false};
+        std::atomic<bool> done{false};
+        std::vector<std::thread> workers;
+        for (int i = 0; i < num_threads; ++i) {
+            workers.emplace_back([&]() {
+                {
+                    std::vector<ObjectPool<TestObject>::PooledObject> held;
+                    for (size_t j = 0; j < max_size / num_threads; ++j) {
+                        held.push_back(pool.acquire());
+                        assert(held.back());
+                    }
+                }
+                ++filled;
+                while (!touch) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                // 下次访问时响应交回请求
+                {
+                    auto obj = pool.acquire();
+                    assert(obj);
+                }
+                ++filled;
+                while (!done) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            });
+        }
+        while (filled < num_threads) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        auto stats = pool.getStatistics();
+        assert(stats.total_created.load() == max_size);
+        assert(stats.current_size.load() == max_size);
+        
+        // 池中全是空闲对象：不等待和带超时的获取都应成功
+        {
+            std::vector<ObjectPool<TestObject>::PooledObject> held;
+            for (size_t j = 0; j < max_size / num_threads; ++j) {
+                held.push_back(pool.acquire());
+                assert(held.back());
+            }
+            held.push_back(pool.acquire(50));
+            assert(held.back());
+            
+            // 各线程交回缓存后，超出上限的对象被销毁
+            touch = true;
+            while (filled < 2 * num_threads) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            stats = pool.getStatistics();
+            assert(stats.total_created.load() - stats.total_destroyed.load() <= max_size + held.size());
+        }
+        stats = pool.getStatistics();
+        assert(stats.total_created.load() - stats.total_destroyed.load() <= max_size);
+        assert(stats.active_objects.load() == 0);
+        done = true;
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        
+        std::cout << "Acquire at max_size with cached objects test passed!" << std::endl;
+    }
+    
+    static void testIdleReclamation() {
+        std::cout << "Testing shared idle reclamation..." << std::endl;
+        
+        size_t tasks_before = PoolReclaimer::getInstance().taskCount();
+        auto start = std::chrono::steady_clock::now();
+        {
+            // 关闭线程缓存，使归还的对象都进入共享仓库
+            ObjectPool<TestObject> pool(
+                []() { return std::make_unique<TestObject>(); },
+                [](TestObject* obj) { obj->reset(); },
+                {0, 100, 100, true, true, 0}
+            );
+            ObjectPool<TestObject> other(
+                []() { return std::make_unique<TestObject>(); },
+                nullptr,
+                {5, 100, 60000, true, true}
+            );
+            assert(PoolReclaimer::getInstance().taskCount() == tasks_before + 2);
+            
+            {
+                std::vector<ObjectPool<TestObject>::PooledObject> objects;
+                for (int i = 0; i < 40; ++i) {
+                    objects.push_back(pool.acquire());
+                }
+            }
+            assert(pool.getStatistics().current_size.load() == 40);
+            
+            // 超过空闲时间后被增量回收
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (pool.getStatistics().current_size.load() > 0 &&
+                   std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+            auto stats = pool.getStatistics();
+            assert(stats.current_size.load() == 0);
+            assert(stats.total_destroyed.load() == 40);
+            
+            // 空闲时间较长的池不受影响
+            assert(other.getStatistics().current_size.load() == 5);
+        }
+        // 析构不再等待清理线程的睡眠周期
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start);
+        assert(elapsed.count() < 5000);
+        assert(PoolReclaimer::getInstance().taskCount() == tasks_before);
+        
+        std::cout << "Shared idle reclamation test passed! (" << elapsed.count() << "ms)" << std::endl;
+    }
+    
+    static void testReclaimerRemoveWhileWaiting() {
+        std::cout << "Testing reclaimer task removal while waiting..." << std::endl;
+        
+        PoolReclaimer& reclaimer = PoolReclaimer::getInstance();
+        for (int round = 0; round < 5; ++round) {
+            // 回收线程正在等待这个任务的运行时间时将其注销，
+            // 随后新任务唤醒回收线程，它不能再访问已注销的任务
+            std::atomic<bool> removed_ran{false};
+            uint64_t id = reclaimer.add([&removed_ran]() {
+                removed_ran = true;
+                return std::chrono::milliseconds(1000);
+            }, std::chrono::milliseconds(100));
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            reclaimer.remove(id);
+            
+            std::atomic<bool> next_ran{false};
+            uint64_t next = reclaimer.add([&next_ran]() {
+                next_ran = true;
+                return std::chrono::milliseconds(1000);
+            }, std::chrono::milliseconds(20));
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (!next_ran && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+            reclaimer.remove(next);
+            assert(next_ran);
+            
+            // 越过被注销任务原来的运行时间
+            std::this_thread::sleep_for(std::chrono::milliseconds(120));
+            assert(!removed_ran);
+        }
+        
+        std::cout << "Reclaimer task removal while waiting test passed!" << std::endl;
+    }
+    
+    static void testReconfigure() {
+        std::cout << "Testing object pool reconfigure..." << std::endl;
+        
+        ObjectPool<TestObject> pool(
+            []() { return std::make_unique<TestObject>(); },
+            [](TestObject* obj) { obj->reset(); },
+            {50, 100, 0, true, true, 0}
+        );
+        assert(pool.getStatistics().current_size.load() == 50);
+        
+        // 缩小上限时立即销毁超出的空闲对象
+        auto config = pool.getConfig();
+        config.max_size = 20;
+        pool.reconfigure(config);
+        assert(pool.getConfig().max_size == 20);
+        assert(pool.getStatistics().current_size.load() == 20);
+        assert(pool.getStatistics().total_destroyed.load() == 30);
+        
+        {
+            std::vector<ObjectPool<TestObject>::PooledObject> objects;
+            for (int i = 0; i < 20; ++i) {
+                objects.push_back(pool.acquire());
+            }
+            assert(!pool.acquire());
+            
+            // 放大上限后可以继续获取
+            config.max_size = 40;
+            pool.reconfigure(config);
+            assert(pool.acquire());
+        }
+        
+        std::cout << "Object pool reconfigure test passed!" << std::endl;
+    }
+    
+    static void testAutoTune() {
+        std::cout << "Testing object pool auto-tune..." << std::endl;
+        
+        ObjectPool<TestObject>::Config config;
+        config.initial_size = 0;
+        config.max_size = 16;
+        config.max_idle_time_ms = 0;
+        config.magazine_size = 0;
+        config.auto_tune = true;
+        config.auto_tune_min = 4;
+        config.auto_tune_max = 256;
+        config.auto_tune_interval_ms = 20;
+        ObjectPool<TestObject> pool(
+            []() { return std::make_unique<TestObject>(); },
+            [](TestObject* obj) { obj->reset(); },
+            config
+        );
+        
+        auto waitFor = [&pool](auto predicate) {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (!predicate(pool) && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            return predicate(pool);
+        };
+        
+        {
+            // 需求超过上限：获取失败后上限翻倍
+            std::vector<ObjectPool<TestObject>::PooledObject> objects;
+            while (objects.size() < 100) {
+                auto obj = pool.acquire();
+                if (obj) {
+                    objects.push_back(std::move(obj));
+                } else {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                }
+            }
+            assert(pool.getConfig().max_size >= 100);
+        }
+        assert(pool.getStatistics().current_size.load() == 100);
+        
+        // 负载消失后上限回落，空闲对象被释放
+        bool shrunk = waitFor([](ObjectPool<TestObject>& p) {
+            return p.getConfig().max_size == 4 && p.getStatistics().current_size.load() <= 1;
+        });
+        assert(shrunk);
+        
+        // 关闭自动调优后上限保持不变
+        config = pool.getConfig();
+        config.auto_tune = false;
+        config.max_size = 8;
+        pool.reconfigure(config);
+        std::this_thread::sleep_for(std::chrono::milliseconds(60));
+        assert(pool.getConfig().max_size == 8);
+        
+        std::cout << "Object pool auto-tune test passed!" << std::endl;
+    }
+    
+    static void testBufferSizeClasses() {
+        std::cout << "Testing message pool buffer size classes..." << std::endl;
+        
+        auto& msg_pool = MessagePool::getInstance();
+        
+        assert(MessagePool::sizeClassFor(100) == 0);
+        assert(MessagePool::sizeClassFor(8192) == 1);
+        assert(MessagePool::sizeClassFor(20000) == 2);
+        assert(MessagePool::sizeClassFor(64 * 1024 * 1024) == 3);
+        
+        // 默认使用8K档
+        assert(msg_pool.acquireBuffer()->capacity() >= 8192);
+        assert(msg_pool.acquireBufferForMethod("Unknown.method")->capacity() >= 8192);
+        assert(msg_pool.acquireBufferFor(200 * 1024)->capacity() >= 1024 * 1024);
+        
+        // 按方法负载的90分位选择大小档
+        for (int i = 0; i < 95; ++i) {
+            msg_pool.recordPayload("Bulk.upload", 50 * 1024);
+        }
+        for (int i = 0; i < 5; ++i) {
+            msg_pool.recordPayload("Bulk.upload", 200);
+        }
+        assert(msg_pool.sizeClassForMethod("Bulk.upload") == 2);
+        assert(msg_pool.acquireBufferForMethod("Bulk.upload")->capacity() >= 64 * 1024);
+        
+        for (int i = 0; i < 100; ++i) {
+            msg_pool.recordPayload("User.login", 64);
+        }
+        assert(msg_pool.sizeClassForMethod("User.login") == 0);
+        
+        // 被撑大的缓冲区归还时收缩回所在档，空闲在线程缓存中时已经收缩
+        NetworkBuffer* idle = nullptr;
+        {
+            auto buffer = msg_pool.acquireBufferFor(512);
+            buffer->resize(100 * 1024);
+            idle = buffer.get();
+        }
+        assert(idle->capacity() < 100 * 1024);
+        assert(msg_pool.acquireBufferFor(512)->capacity() < 100 * 1024);
+        
+        auto buffer_config = msg_pool.getBufferPoolConfig(2);
+        assert(buffer_config.auto_tune);
+        
+        std::cout << "Message pool buffer size class test passed!" << std::endl;
+    }
+    
+    static void testPayloadHistogramDecay() {
+        std::cout << "Testing payload histogram decay..." << std::endl;
+        
+        auto& msg_pool = MessagePool::getInstance();
+        MessagePool::PayloadHistogram* histogram = msg_pool.payloadHistogram("Shift.method");
+        assert(histogram == msg_pool.payloadHistogram("Shift.method"));
+        assert(histogram->sizeClass() == MessagePool::kDefaultBufferClass);
+        
+        for (int i = 0; i < 2000; ++i) {
+            histogram->record(50 * 1024);
+        }
+        assert(msg_pool.sizeClassForMethod("Shift.method") == 2);
+        
+        // 负载变小后，旧记录按指数衰减，不会一直占着大档
+        for (int i = 0; i < 8 * 1024; ++i) {
+            msg_pool.recordPayload("Shift.method", 64);
+        }
+        assert(histogram->sizeClass() == 0);
+        
+        // 该档的池用尽时退化为不入池的缓冲区，请求路径不会拿到空对象
+        MessagePool::PayloadHistogram* huge = msg_pool.payloadHistogram("Huge.method");
+        huge->record(512 * 1024);
+        size_t max_size = msg_pool.getBufferPoolConfig(3).max_size;
+        std::vector<MessagePool::BufferPoolType::PooledObject> held;
+        for (size_t i = 0; i < max_size + 4; ++i) {
+            held.push_back(msg_pool.acquireBufferFor(*huge));
+            assert(held.back());
+            assert(held.back()->capacity() >= 1024 * 1024);
+        }
+        held.clear();
+        assert(msg_pool.getBufferStats(3).current_size.load() <= max_size);
+        
+        std::cout << "Payload histogram decay test passed!" << std::endl;
+    }
+    
     static void testMessagePool() {
         std::cout << "Testing message pool..." << std::endl;
         
@@ -128,6 +524,139 @@ public:
         std::cout << "Message pool test passed!" << std::endl;
     }
     
+    static void testPoolMetrics() {
+        std::cout << "Testing pool metrics export..." << std::endl;
+        
+        ObjectPool<TestObject>::Config config;
+        config.initial_size = 0;
+        config.max_size = 2;
+        config.magazine_size = 0;
+        auto pool = std::make_unique<ObjectPool<TestObject>>(
+            []() { return std::make_unique<TestObject>(); },
+            [](TestObject* obj) { obj->reset(); },
+            config
+        );
+        pool->exportMetrics("test_metrics");
+        
+        auto find = [](const std::string& name) {
+            PoolMetrics* found = nullptr;
+            MetricsRegistry::getInstance().forEachPool([&](const std::string& n, PoolMetrics& m) {
+                if (n == name) {
+                    found = &m;
+                }
+            });
+            return found;
+        };
+        PoolMetrics* metrics = find("test_metrics");
+        assert(metrics != nullptr);
+        
+        auto now = metrics::Clock::now();
+        {
+            auto first = pool->acquire();
+            auto second = pool->acquire();
+            assert(first && second);
+            // 池满：不等待的获取直接失败，带超时的获取等待后失败
+            assert(!pool->acquire());
+            assert(!pool->acquire(20));
+            
+            PoolSample sample = metrics->current();
+            assert(sample.active == 2);
+            assert(sample.max_size == 2);
+            assert(sample.rejected == 2);
+        }
+        for (int i = 0; i < 8; ++i) {
+            pool->acquire();
+        }
+        
+        // 窗口起点是注册时的空快照，计数都落在窗口内；失败的获取也计为未命中
+        auto window = metrics->window(std::chrono::seconds(60), now);
+        assert(window.delta.misses == 4);
+        assert(window.delta.hits == 8);
+        assert(window.delta.rejected == 2);
+        assert(window.delta.idle == 2);
+        assert(window.hitRate() == 8.0 / 12);
+        
+        HistogramSnapshot wait = metrics->acquire_wait_ns.snapshot();
+        assert(wait.count == 1);
+        assert(wait.percentile(0.5) >= 15e6);
+        
+        // 之后的窗口只包含新快照之后的增量
+        auto later = now + std::chrono::seconds(10);
+        metrics->window(std::chrono::seconds(5), later);
+        pool->acquire();
+        window = metrics->window(std::chrono::seconds(5), later + std::chrono::seconds(6));
+        assert(window.delta.hits == 1);
+        assert(window.delta.misses == 0);
+        assert(window.delta.rejected == 0);
+        assert(window.seconds == 6);
+        
+        std::ostringstream prometheus;
+        MetricsRegistry::getInstance().writePrometheus(prometheus, std::chrono::seconds(60));
+        std::string text = prometheus.str();
+        assert(text.find("prpc_object_pool_objects{pool=\"test_metrics\",state=\"idle\"} 2\n") != std::string::npos);
+        assert(text.find("prpc_object_pool_hits_total{pool=\"test_metrics\"} 9\n") != std::string::npos);
+        assert(text.find("prpc_object_pool_rejected_total{pool=\"test_metrics\"} 2\n") != std::string::npos);
+        assert(text.find("prpc_object_pool_acquire_wait_seconds_count{pool=\"test_metrics\"} 1\n") != std::string::npos);
+        
+        // 池析构后注销
+        pool.reset();
+        assert(find("test_metrics") == nullptr);
+        
+        std::cout << "Pool metrics export test passed!" << std::endl;
+    }
+    
+    static void testPoolMonitor() {
+        std::cout << "Testing pool monitor..." << std::endl;
+        
+        ObjectPool<TestObject>::Config config;
+        config.initial_size = 0;
+        config.max_size = 4;
+        config.magazine_size = 0;
+        ObjectPool<TestObject> pool(
+            []() { return std::make_unique<TestObject>(); },
+            [](TestObject* obj) { obj->reset(); },
+            config
+        );
+        pool.exportMetrics("test_monitor");
+        
+        auto& monitor = PoolMonitor::getInstance();
+        auto warningsFor = [&monitor](const std::string& name) {
+            std::vector<std::string> warnings;
+            for (const auto& warning : monitor.checkHealth().warnings) {
+                if (warning.compare(0, name.size() + 1, name + " ") == 0) {
+                    warnings.push_back(warning);
+                }
+            }
+            return warnings;
+        };
+        assert(warningsFor("test_monitor").empty());
+        
+        {
+            std::vector<ObjectPool<TestObject>::PooledObject> objects;
+            for (int i = 0; i < 4; ++i) {
+                objects.push_back(pool.acquire());
+            }
+            assert(!pool.acquire());
+            
+            // 全部在用且有失败的获取：使用率和拒绝两条告警
+            auto warnings = warningsFor("test_monitor");
+            assert(warnings.size() == 2);
+            assert(warnings[0].find("high usage: 100%") != std::string::npos);
+            assert(warnings[1].find("rejected 1") != std::string::npos);
+            
+            std::string report = monitor.generateReport();
+            assert(report.find("test_monitor") != std::string::npos);
+            assert(report.find("status: WARNING") != std::string::npos);
+        }
+        
+        // 对象归还后使用率告警消失，拒绝仍在窗口内
+        auto warnings = warningsFor("test_monitor");
+        assert(warnings.size() == 1);
+        assert(warnings[0].find("rejected") != std::string::npos);
+        
+        std::cout << "Pool monitor test passed!" << std::endl;
+    }
+    
     static void testPerformance() {
         std::cout << "Testing object pool performance..." << std::endl;
         
@@ -260,9 +789,39 @@ public:
         testConcurrency();
         std::cout << std::endl;
         
+        testThreadLocalCache();
+        std::cout << std::endl;
+        
+        testCachedObjectsAtCapacity();
+        std::cout << std::endl;
+        
+        testIdleReclamation();
+        std::cout << std::endl;
+        
+        testReclaimerRemoveWhileWaiting();
+        std::cout << std::endl;
+        
+        testReconfigure();
+        std::cout << std::endl;
+        
+        testAutoTune();
+        std::cout << std::endl;
+        
         testMessagePool();
         std::cout << std::endl;
         
+        testBufferSizeClasses();
+        std::cout << std::endl;
+        
+        testPayloadHistogramDecay();
+        std::cout << std::endl;
+        
+        testPoolMetrics();
+        std::cout << std::endl;
+        
+        testPoolMonitor();
+        std::cout << std::endl;
+        
         testPerformance();
         std::cout << std::endl;
         
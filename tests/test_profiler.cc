@@ -0,0 +1,169 @@
+#include "profiler.h"
+#include "threadpool.h"
+#include <iostream>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ProfilerTest {
+public:
+    // 对 folded stack 的每行求权重之和，并检查格式
+    static uint64_t totalWeight(const std::string& folded) {
+        std::istringstream lines(folded);
+        std::string line;
+        uint64_t total = 0;
+        while (std::getline(lines, line)) {
+            size_t space = line.rfind(' ');
+            assert(space != std::string::npos && space > 0);
+            total += std::stoull(line.substr(space + 1));
+        }
+        return total;
+    }
+
+    static void testCpuProfile() {
+        std::cout << "Testing CPU profile..." << std::endl;
+
+        std::atomic<bool> stop{false};
+        std::vector<std::thread> burners;
+        for (int i = 0; i < 2; ++i) {
+            burners.emplace_back([&stop] {
+                volatile uint64_t x = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    x = x * 6364136223846793005ull + 1;
+                }
+            });
+        }
+
+        // 同一时间只能有一个 CPU 剖析
+        std::thread second([] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            auto busy = prpc::CpuProfiler::collect(std::chrono::seconds(1), 99);
+            assert(!busy.isSuccess());
+            assert(busy.getErrorCode() == prpc::ErrorCode::RESOURCE_ERROR);
+        });
+
+        auto result = prpc::CpuProfiler::collect(std::chrono::seconds(1), 200);
+        second.join();
+        stop.store(true);
+        for (auto& burner : burners) {
+            burner.join();
+        }
+        assert(result.isSuccess());
+        // 两个线程忙 1 秒，200Hz 下应有约 400 个样本
+        uint64_t samples = totalWeight(result.getValue());
+        std::cout << "  " << samples << " samples" << std::endl;
+        assert(samples > 100);
+
+        assert(!prpc::CpuProfiler::collect(std::chrono::seconds(0), 99).isSuccess());
+        assert(!prpc::CpuProfiler::collect(std::chrono::seconds(1), 0).isSuccess());
+        assert(!prpc::CpuProfiler::collect(std::chrono::seconds(1), 100000).isSuccess());
+
+        // 采集结束后 SIGPROF 恢复原来的处理方式，进程不会被残留的信号终止
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        std::cout << "CPU profile test passed!" << std::endl;
+    }
+
+    static void testContentionProfile() {
+        std::cout << "Testing contention profile..." << std::endl;
+
+        std::mutex mutex;
+        std::atomic<bool> stop{false};
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([&] {
+                while (!stop.load()) {
+                    auto lock = prpc::profiledLock(mutex, "test.mutex");
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+                }
+            });
+        }
+        auto result = prpc::ContentionProfiler::collect(std::chrono::seconds(1), 1.0);
+        stop.store(true);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        assert(result.isSuccess());
+        const std::string& folded = result.getValue();
+        assert(folded.find("[lock:test.mutex] ") != std::string::npos);
+        // 4 个线程抢一把锁，1 秒内的等待总和在秒级
+        uint64_t waited_us = totalWeight(folded);
+        std::cout << "  " << waited_us << " us waited" << std::endl;
+        assert(waited_us > 500 * 1000);
+        assert(!prpc::ContentionProfiler::active());
+
+        assert(!prpc::ContentionProfiler::collect(std::chrono::seconds(1), 0).isSuccess());
+        assert(!prpc::ContentionProfiler::collect(std::chrono::seconds(1), 1.5).isSuccess());
+
+        std::cout << "Contention profile test passed!" << std::endl;
+    }
+
+    static void testThreadPoolContention() {
+        std::cout << "Testing thread pool queue contention..." << std::endl;
+
+        std::atomic<bool> stop{false};
+        std::string folded;
+        {
+            ThreadPool pool(4);
+            std::vector<std::thread> producers;
+            for (int i = 0; i < 4; ++i) {
+                producers.emplace_back([&] {
+                    while (!stop.load()) {
+                        pool.submit([] {});
+                    }
+                });
+            }
+            auto result = prpc::ContentionProfiler::collect(std::chrono::seconds(1), 0.5);
+            stop.store(true);
+            for (auto& producer : producers) {
+                producer.join();
+            }
+            assert(result.isSuccess());
+            folded = result.getValue();
+        }
+        assert(folded.find("[lock:threadpool.queue] ") != std::string::npos);
+
+        std::cout << "Thread pool queue contention test passed!" << std::endl;
+    }
+
+    static void testUncontendedCost() {
+        std::cout << "Testing uncontended lock overhead..." << std::endl;
+
+        std::mutex mutex;
+        const int iterations = 1000000;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            std::unique_lock<std::mutex> lock(mutex);
+        }
+        auto plain = std::chrono::steady_clock::now() - start;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            auto lock = prpc::profiledLock(mutex, "test.uncontended");
+        }
+        auto profiled = std::chrono::steady_clock::now() - start;
+        std::cout << "  unique_lock: "
+                  << std::chrono::duration<double, std::nano>(plain).count() / iterations
+                  << " ns, profiledLock: "
+                  << std::chrono::duration<double, std::nano>(profiled).count() / iterations
+                  << " ns" << std::endl;
+
+        std::cout << "Uncontended lock overhead test passed!" << std::endl;
+    }
+};
+
+int main() {
+    std::cout << "Running profiler tests..." << std::endl;
+
+    ProfilerTest::testCpuProfile();
+    ProfilerTest::testContentionProfile();
+    ProfilerTest::testThreadPoolContention();
+    ProfilerTest::testUncontendedCost();
+
+    std::cout << "All profiler tests passed!" << std::endl;
+    return 0;
+}
@@ -19,8 +19,23 @@ public:
     
     static void testServiceRegistration() {
         std::cout << "Testing Provider service registration..." << std::endl;
-        // 测试服务注册功能
-        assert(true); // 占位测试
+        // 内存注册中心：同一进程内的实例共享一张表
+        MemoryServiceRegistry caller;
+        {
+            MemoryServiceRegistry provider;
+            provider.Start();
+            provider.Register("UserService", "Login", "127.0.0.1:8000");
+            assert(caller.Lookup("UserService", "Login") == "127.0.0.1:8000");
+            assert(caller.Lookup("UserService", "Register").empty());
+
+            // 其他实例登记的方法同样可见
+            MemoryServiceRegistry other;
+            other.Register("UserService", "Register", "127.0.0.1:8001");
+            assert(caller.Lookup("UserService", "Register") == "127.0.0.1:8001");
+        }
+        // 与 zookeeper 的临时节点一样，注册方销毁后登记随之消失
+        assert(caller.Lookup("UserService", "Login").empty());
+        assert(caller.Lookup("UserService", "Register").empty());
         std::cout << "Provider service registration test passed!" << std::endl;
     }
     
@@ -0,0 +1,121 @@
+// header.pb.{h,cc} 随仓库提交，构建时只有 header.proto 比它们新才重新运行 protoc，
+// 这里检查提交的生成代码与 header.proto 一致，避免修改了 .proto 却忘了更新生成代码
+#include "header.pb.h"
+#include <google/protobuf/compiler/importer.h>
+#include <google/protobuf/descriptor.pb.h>
+#include <google/protobuf/dynamic_message.h>
+#include <google/protobuf/util/message_differencer.h>
+#include <iostream>
+#include <cassert>
+#include <memory>
+#include <string>
+
+#ifndef PRPC_PROTO_DIR
+#define PRPC_PROTO_DIR "../src"
+#endif
+
+namespace pb = google::protobuf;
+
+class ProtoErrorPrinter : public pb::compiler::MultiFileErrorCollector {
+public:
+#if GOOGLE_PROTOBUF_VERSION >= 4022000
+    void RecordError(absl::string_view filename, int line, int column,
+                     absl::string_view message) override {
+#else
+    void AddError(const std::string& filename, int line, int column,
+                  const std::string& message) override {
+#endif
+        std::cerr << filename << ":" << line + 1 << ":" << column + 1 << ": " << message << std::endl;
+    }
+};
+
+class RpcHeaderTest {
+public:
+    static void testDescriptorMatchesProto() {
+        std::cout << "Testing generated descriptor against header.proto..." << std::endl;
+
+        const pb::FileDescriptor* parsed = importProto();
+        pb::FileDescriptorProto expected;
+        parsed->CopyTo(&expected);
+        pb::FileDescriptorProto generated;
+        Prpc::RpcHeader::descriptor()->file()->CopyTo(&generated);
+
+        // 生成代码内嵌的描述符不带 json_name，是否填充它随 protobuf 版本不同
+        pb::util::MessageDifferencer differencer;
+        differencer.IgnoreField(pb::FieldDescriptorProto::descriptor()->FindFieldByName("json_name"));
+        std::string differences;
+        differencer.ReportDifferencesToString(&differences);
+        bool same = differencer.Compare(expected, generated);
+        if (!same) {
+            std::cerr << "header.pb.* is out of date with header.proto:\n" << differences;
+        }
+        assert(same);
+
+        std::cout << "Generated descriptor test passed!" << std::endl;
+    }
+
+    static void testWireCompatibleWithProto() {
+        std::cout << "Testing generated code on the wire..." << std::endl;
+
+        // 按 header.proto 构造的消息给每个字段赋不同的非默认值，
+        // 生成代码解析后再序列化，结果应逐字节相同
+        const pb::Descriptor* type = importProto()->FindMessageTypeByName("RpcHeader");
+        assert(type != nullptr);
+        pb::DynamicMessageFactory factory;
+        std::unique_ptr<pb::Message> dynamic(factory.GetPrototype(type)->New());
+        const pb::Reflection* reflection = dynamic->GetReflection();
+        for (int i = 0; i < type->field_count(); ++i) {
+            const pb::FieldDescriptor* field = type->field(i);
+            uint64_t value = 1000 + i;
+            switch (field->cpp_type()) {
+                case pb::FieldDescriptor::CPPTYPE_STRING:
+                    reflection->SetString(dynamic.get(), field, field->name() + "-value");
+                    break;
+                case pb::FieldDescriptor::CPPTYPE_UINT32:
+                    reflection->SetUInt32(dynamic.get(), field, value);
+                    break;
+                case pb::FieldDescriptor::CPPTYPE_UINT64:
+                    reflection->SetUInt64(dynamic.get(), field, value << 32);
+                    break;
+                case pb::FieldDescriptor::CPPTYPE_BOOL:
+                    reflection->SetBool(dynamic.get(), field, true);
+                    break;
+                default:
+                    std::cerr << "unhandled field type: " << field->name() << std::endl;
+                    assert(false);
+            }
+        }
+        std::string bytes = dynamic->SerializeAsString();
+
+        Prpc::RpcHeader header;
+        assert(header.ParseFromString(bytes));
+        assert(header.service_name() == "service_name-value");
+        assert(header.SerializeAsString() == bytes);
+
+        std::cout << "Generated code wire test passed!" << std::endl;
+    }
+
+private:
+    static const pb::FileDescriptor* importProto() {
+        static pb::compiler::DiskSourceTree tree;
+        static ProtoErrorPrinter error_printer;
+        static std::unique_ptr<pb::compiler::Importer> importer;
+        if (!importer) {
+            tree.MapPath("", PRPC_PROTO_DIR);
+            importer = std::make_unique<pb::compiler::Importer>(&tree, &error_printer);
+        }
+        const pb::FileDescriptor* file = importer->Import("header.proto");
+        assert(file != nullptr);
+        return file;
+    }
+};
+
+int main() {
+    std::cout << "Running rpc header tests..." << std::endl;
+
+    RpcHeaderTest::testDescriptorMatchesProto();
+    RpcHeaderTest::testWireCompatibleWithProto();
+
+    std::cout << "All rpc header tests passed!" << std::endl;
+    return 0;
+}
@@ -0,0 +1,250 @@
+#include "slab_pool.h"
+#include <iostream>
+#include <cassert>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <random>
+#include <unordered_map>
+
+using namespace prpc;
+
+// 模拟每连接上下文
+struct ConnContext {
+    int fd;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    std::string peer;
+
+    static std::atomic<int> alive;
+
+    ConnContext() : ConnContext(-1, "") {}
+    ConnContext(int f, std::string p) : fd(f), bytes_in(0), bytes_out(0), peer(std::move(p)) {
+        alive.fetch_add(1);
+    }
+    ~ConnContext() {
+        alive.fetch_sub(1);
+    }
+};
+
+std::atomic<int> ConnContext::alive{0};
+
+class SlabPoolTest {
+public:
+    static void testCreateAndGet() {
+        std::cout << "Testing slab pool create/get..." << std::endl;
+
+        SlabPool<ConnContext> pool;
+        auto handle = pool.create(7, "127.0.0.1:9000");
+        assert(handle != SlabPool<ConnContext>::kInvalidHandle);
+
+        ConnContext* ctx = pool.get(handle);
+        assert(ctx);
+        assert(ctx->fd == 7);
+        assert(ctx->peer == "127.0.0.1:9000");
+        assert(pool.size() == 1);
+        assert(pool.capacity() == 256);
+
+        assert(!pool.valid(SlabPool<ConnContext>::kInvalidHandle));
+        assert(pool.get(SlabPool<ConnContext>::kInvalidHandle) == nullptr);
+
+        std::cout << "Slab pool create/get test passed!" << std::endl;
+    }
+
+    static void testStaleHandles() {
+        std::cout << "Testing slab pool stale handles..." << std::endl;
+
+        SlabPool<ConnContext> pool;
+        auto first = pool.create(1, "a");
+        assert(pool.destroy(first));
+        assert(!pool.valid(first));
+        assert(pool.get(first) == nullptr);
+        assert(!pool.destroy(first));  // 重复销毁被拒绝
+
+        // 槽位被复用后，旧句柄仍然无效
+        auto second = pool.create(2, "b");
+        assert((second & SlabPool<ConnContext>::kIndexMask) == (first & SlabPool<ConnContext>::kIndexMask));
+        assert(second != first);
+        assert(pool.get(first) == nullptr);
+        assert(pool.get(second)->fd == 2);
+
+        std::cout << "Slab pool stale handle test passed!" << std::endl;
+    }
+
+    static void testGenerationWrap() {
+        std::cout << "Testing slab pool generation wrap..." << std::endl;
+
+        // 8位代数：一个槽位可用128次，之后退役
+        using WrapPool = SlabPool<ConnContext, 1, uint8_t>;
+        WrapPool pool(2);
+        std::vector<WrapPool::Handle> stale;
+        for (int i = 0; i < 128; ++i) {
+            auto handle = pool.create(i, "");
+            assert(handle != WrapPool::kInvalidHandle);
+            assert(stale.empty() || (handle & WrapPool::kIndexMask) == (stale[0] & WrapPool::kIndexMask));
+            assert(pool.destroy(handle));
+            stale.push_back(handle);
+        }
+        assert(pool.retired() == 1);
+        assert(pool.capacity() == 1);
+
+        // 退役后换用新槽位，所有旧句柄都不会因代数回绕而重新生效
+        auto fresh = pool.create(1000, "");
+        assert(fresh != WrapPool::kInvalidHandle);
+        assert((fresh & WrapPool::kIndexMask) != (stale[0] & WrapPool::kIndexMask));
+        for (auto handle : stale) {
+            assert(!pool.valid(handle));
+            assert(handle != fresh);
+        }
+        assert(pool.get(fresh)->fd == 1000);
+        assert(pool.destroy(fresh));
+
+        // 槽位都退役后池耗尽，而不是复用旧代数
+        for (int i = 0; i < 127; ++i) {
+            assert(pool.destroy(pool.create(i, "")));
+        }
+        assert(pool.retired() == 2);
+        assert(pool.create(0, "") == WrapPool::kInvalidHandle);
+        assert(pool.size() == 0);
+        assert(ConnContext::alive.load() == 0);
+
+        std::cout << "Slab pool generation wrap test passed!" << std::endl;
+    }
+
+    static void testContiguousLayout() {
+        std::cout << "Testing slab pool layout..." << std::endl;
+
+        using SmallChunkPool = SlabPool<ConnContext, 64>;
+        SmallChunkPool pool;
+        std::vector<SmallChunkPool::Handle> handles;
+        for (int i = 0; i < 64; ++i) {
+            handles.push_back(pool.create(i, ""));
+        }
+        // 同一块内的对象连续存放，块起始按缓存行对齐
+        uintptr_t base = reinterpret_cast<uintptr_t>(pool.get(handles[0]));
+        assert(base % SmallChunkPool::kCacheLine == 0);
+        ptrdiff_t stride = reinterpret_cast<char*>(pool.get(handles[1])) -
+                           reinterpret_cast<char*>(pool.get(handles[0]));
+        for (int i = 1; i < 64; ++i) {
+            assert(reinterpret_cast<char*>(pool.get(handles[i])) -
+                   reinterpret_cast<char*>(pool.get(handles[i - 1])) == stride);
+        }
+        assert(pool.capacity() == 64);
+
+        pool.create(64, "");
+        assert(pool.capacity() == 128);
+
+        std::cout << "Slab pool layout test passed!" << std::endl;
+    }
+
+    static void testCapacityLimit() {
+        std::cout << "Testing slab pool capacity limit..." << std::endl;
+
+        int before = ConnContext::alive.load();
+        {
+            using TinyPool = SlabPool<ConnContext, 16>;
+            TinyPool pool(32);
+            for (int i = 0; i < 32; ++i) {
+                assert(pool.create(i, "") != TinyPool::kInvalidHandle);
+            }
+            assert(pool.create(32, "") == TinyPool::kInvalidHandle);
+            assert(ConnContext::alive.load() == before + 32);
+        }
+        // 析构时销毁仍存活的对象
+        assert(ConnContext::alive.load() == before);
+
+        std::cout << "Slab pool capacity limit test passed!" << std::endl;
+    }
+
+    static void testConcurrentLookup() {
+        std::cout << "Testing slab pool concurrent lookup..." << std::endl;
+
+        SlabPool<ConnContext> pool;
+        std::vector<SlabPool<ConnContext>::Handle> stable;
+        for (int i = 0; i < 100; ++i) {
+            stable.push_back(pool.create(i, ""));
+        }
+
+        std::atomic<bool> done{false};
+        std::thread churn([&]() {
+            // 其他句柄的创建和销毁不影响查找，块只增不减
+            for (int i = 0; i < 20000; ++i) {
+                auto h = pool.create(-1, "");
+                pool.destroy(h);
+            }
+            done.store(true);
+        });
+
+        uint64_t lookups = 0;
+        while (!done.load()) {
+            for (int i = 0; i < 100; ++i) {
+                assert(pool.get(stable[i])->fd == i);
+                ++lookups;
+            }
+        }
+        churn.join();
+        assert(pool.size() == 100);
+
+        std::cout << "Slab pool concurrent lookup test passed! (" << lookups << " lookups)" << std::endl;
+    }
+
+    static void testPerformance() {
+        std::cout << "Testing slab pool lookup performance..." << std::endl;
+
+        // 对比按句柄查找与反应器目前按fd查哈希表的方式
+        const int connections = 10000;
+        const int lookups = 1000000;
+        SlabPool<ConnContext> slab;
+        std::unordered_map<int, std::unique_ptr<ConnContext>> table;
+        std::vector<SlabPool<ConnContext>::Handle> handles;
+        for (int i = 0; i < connections; ++i) {
+            handles.push_back(slab.create(i, ""));
+            table[i] = std::make_unique<ConnContext>(i, "");
+        }
+
+        std::mt19937 rng(42);
+        std::vector<int> order(lookups);
+        for (auto& idx : order) {
+            idx = rng() % connections;
+        }
+
+        uint64_t sum = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int idx : order) {
+            sum += slab.get(handles[idx])->fd;
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        auto slab_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+        start = std::chrono::high_resolution_clock::now();
+        for (int idx : order) {
+            sum -= table.find(idx)->second->fd;
+        }
+        end = std::chrono::high_resolution_clock::now();
+        auto table_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        assert(sum == 0);
+
+        std::cout << "Handle lookup: " << (double)lookups / (slab_us / 1000000.0) << " ops/sec, "
+                  << "hash table lookup: " << (double)lookups / (table_us / 1000000.0) << " ops/sec" << std::endl;
+
+        std::cout << "Slab pool lookup performance test passed!" << std::endl;
+    }
+};
+
+int main() {
+    std::cout << "Running slab pool tests..." << std::endl;
+
+    SlabPoolTest::testCreateAndGet();
+    SlabPoolTest::testStaleHandles();
+    SlabPoolTest::testGenerationWrap();
+    SlabPoolTest::testContiguousLayout();
+    SlabPoolTest::testCapacityLimit();
+    SlabPoolTest::testConcurrentLookup();
+    SlabPoolTest::testPerformance();
+
+    std::cout << "All slab pool tests passed!" << std::endl;
+    return 0;
+}
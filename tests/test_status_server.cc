@@ -0,0 +1,183 @@
+#include "status_server.h"
+#include "metrics.h"
+#include <iostream>
+#include <cassert>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+class StatusServerTest {
+public:
+    // 发送原始请求，返回完整响应
+    static std::string request(uint16_t port, const std::string& raw) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        assert(fd >= 0);
+        sockaddr_in addr;
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+        assert(connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0);
+        assert(send(fd, raw.data(), raw.size(), 0) == static_cast<ssize_t>(raw.size()));
+        std::string response;
+        char buf[4096];
+        ssize_t n;
+        while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+            response.append(buf, n);
+        }
+        close(fd);
+        return response;
+    }
+
+    static std::string get(uint16_t port, const std::string& path) {
+        return request(port, "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    }
+
+    static std::string body(const std::string& response) {
+        size_t pos = response.find("\r\n\r\n");
+        assert(pos != std::string::npos);
+        return response.substr(pos + 4);
+    }
+
+    static void testServePages() {
+        std::cout << "Testing status server pages..." << std::endl;
+
+        StatusServer server;
+        int calls = 0;
+        server.AddPage("/hello", "greeting", "text/plain", [&calls]() {
+            ++calls;
+            return std::string("hello world\n");
+        });
+        server.AddPage("/hidden", "", "text/plain", []() { return std::string("x"); });
+        server.AddPage("/echo", "", "text/plain", [](const StatusServer::Params& params) {
+            std::string out;
+            for (const auto& param : params) {
+                out += param.first + "=" + param.second + "\n";
+            }
+            return out;
+        });
+        server.AddPage("/boom", "fails", "text/plain", []() -> std::string {
+            throw std::runtime_error("page failed");
+        });
+        assert(server.Start("127.0.0.1", 0));
+        uint16_t port = server.GetPort();
+        assert(port != 0);
+
+        std::string response = get(port, "/hello?verbose=1");
+        assert(response.compare(0, 15, "HTTP/1.1 200 OK") == 0);
+        assert(response.find("Content-Length: 12\r\n") != std::string::npos);
+        assert(response.find("Connection: close\r\n") != std::string::npos);
+        assert(body(response) == "hello world\n");
+        assert(calls == 1);
+
+        // HEAD 只返回头部
+        response = request(port, "HEAD /hello HTTP/1.1\r\n\r\n");
+        assert(response.find("Content-Length: 12\r\n") != std::string::npos);
+        assert(body(response).empty());
+
+        // 查询参数经过 URL 解码
+        assert(body(get(port, "/echo?seconds=5&name=a%20b+c&flag")) == "flag=\nname=a b c\nseconds=5\n");
+        assert(body(get(port, "/echo")).empty());
+
+        // 首页列出带标题的页面
+        std::string index = body(get(port, "/"));
+        assert(index.find("/hello\tgreeting") != std::string::npos);
+        assert(index.find("/hidden") == std::string::npos);
+
+        assert(get(port, "/missing").compare(0, 12, "HTTP/1.1 404") == 0);
+        assert(request(port, "POST /hello HTTP/1.1\r\n\r\n").compare(0, 12, "HTTP/1.1 405") == 0);
+        assert(request(port, "garbage\r\n\r\n").compare(0, 12, "HTTP/1.1 400") == 0);
+        response = get(port, "/boom");
+        assert(response.compare(0, 12, "HTTP/1.1 500") == 0);
+        assert(body(response) == "page failed\n");
+
+        server.Stop();
+        std::cout << "Status server pages test passed!" << std::endl;
+    }
+
+    static void testPrometheusExposition() {
+        std::cout << "Testing Prometheus exposition..." << std::endl;
+
+        auto& registry = prpc::MetricsRegistry::getInstance();
+        prpc::MethodStats& stats = registry.method(prpc::MetricsRegistry::kServer, "EchoService", "Echo");
+        for (int i = 0; i < 100; ++i) {
+            stats.latency_ns.record(2000000);   // 2ms
+            stats.request_bytes.record(64);
+        }
+        stats.errors.add(prpc::ErrorCode::TIMEOUT_ERROR);
+        registry.serverErrors().add(prpc::ErrorCode::SERVICE_ERROR);
+
+        std::ostringstream out;
+        registry.writePrometheus(out, std::chrono::seconds(60));
+        std::string text = out.str();
+        assert(text.find("# TYPE prpc_server_latency_seconds summary") != std::string::npos);
+        assert(text.find("prpc_server_latency_seconds{method=\"EchoService.Echo\",quantile=\"0.99\"} 0.002") !=
+               std::string::npos);
+        assert(text.find("prpc_server_latency_seconds_count{method=\"EchoService.Echo\"} 100") !=
+               std::string::npos);
+        assert(text.find("prpc_server_request_bytes_sum{method=\"EchoService.Echo\"} 6400") !=
+               std::string::npos);
+        assert(text.find("prpc_server_errors_total{method=\"EchoService.Echo\",code=\"TIMEOUT_ERROR\"} 1") !=
+               std::string::npos);
+        assert(text.find("prpc_server_frame_errors_total{code=\"SERVICE_ERROR\"} 1") != std::string::npos);
+        // 客户端没有排队时间
+        assert(text.find("prpc_client_queue_wait_seconds") == std::string::npos);
+
+        // 每个指标族的样本连续出现
+        std::istringstream lines(text);
+        std::string line, current;
+        std::vector<std::string> families;
+        while (std::getline(lines, line)) {
+            if (line.compare(0, 7, "# TYPE ") == 0) {
+                current = line.substr(7, line.find(' ', 7) - 7);
+                for (const auto& family : families) {
+                    assert(family != current);
+                }
+                families.push_back(current);
+            } else if (line[0] != '#') {
+                assert(line.compare(0, current.size(), current) == 0);
+            }
+        }
+
+        std::ostringstream table;
+        registry.writeText(table, std::chrono::seconds(60));
+        assert(table.str().find("EchoService.Echo") != std::string::npos);
+
+        std::cout << "Prometheus exposition test passed!" << std::endl;
+    }
+
+    static void testSlowRequestLog() {
+        std::cout << "Testing slow request log..." << std::endl;
+
+        prpc::SlowRequestLog log(3);
+        log.setThreshold(std::chrono::milliseconds(10));
+        assert(!log.isSlow(9 * 1000 * 1000));
+        assert(log.isSlow(10 * 1000 * 1000));
+        for (int i = 0; i < 5; ++i) {
+            prpc::SlowRequestLog::Entry entry;
+            entry.method = "S.M" + std::to_string(i);
+            log.record(entry);
+        }
+        auto entries = log.recent();
+        assert(entries.size() == 3);
+        assert(entries[0].method == "S.M4");
+        assert(entries[2].method == "S.M2");
+
+        std::cout << "Slow request log test passed!" << std::endl;
+    }
+};
+
+int main() {
+    std::cout << "Running status server tests..." << std::endl;
+
+    StatusServerTest::testServePages();
+    StatusServerTest::testPrometheusExposition();
+    StatusServerTest::testSlowRequestLog();
+
+    std::cout << "All status server tests passed!" << std::endl;
+    return 0;
+}
@@ -1,4 +1,6 @@
 #include "threadpool.h"
+#include <sched.h>
+#include <algorithm>
 #include <iostream>
 #include <cassert>
 #include <vector>
@@ -245,6 +247,157 @@ public:
         
         std::cout << "Different return types test passed!" << std::endl;
     }
+
+    // 用单线程池并先占住工作线程，使后续任务全部排队后再统一调度
+    static std::vector<int> runQueued(ThreadPool& pool, const std::vector<int>& levels) {
+        std::vector<int> order;
+        std::mutex order_mutex;
+        std::promise<void> gate;
+        std::promise<void> started;
+        std::shared_future<void> gate_future = gate.get_future().share();
+        auto blocker = pool.submit([gate_future, &started]() {
+            started.set_value();
+            gate_future.wait();
+        });
+        started.get_future().wait();
+        
+        std::vector<std::future<void>> futures;
+        for (size_t i = 0; i < levels.size(); ++i) {
+            futures.push_back(pool.submitWithPriority(levels[i], [i, &order, &order_mutex]() {
+                std::lock_guard<std::mutex> lock(order_mutex);
+                order.push_back(static_cast<int>(i));
+            }));
+        }
+        gate.set_value();
+        blocker.get();
+        for (auto& future : futures) {
+            future.get();
+        }
+        return order;
+    }
+    
+    static void testStrictPriority() {
+        std::cout << "Testing strict priority scheduling..." << std::endl;
+        
+        ThreadPool pool(1);
+        auto order = runQueued(pool, {ThreadPool::kLow, ThreadPool::kNormal,
+                                      ThreadPool::kHigh, ThreadPool::kLow,
+                                      ThreadPool::kHigh});
+        std::vector<int> expected = {2, 4, 1, 0, 3};
+        assert(order == expected);
+        
+        std::cout << "Strict priority test passed!" << std::endl;
+    }
+    
+    static void testWeightedPriority() {
+        std::cout << "Testing weighted priority scheduling..." << std::endl;
+        
+        ThreadPool pool(1);
+        pool.setQueuePolicy(ThreadPool::QueuePolicy::kWeighted, {2, 1, 1});
+        
+        // 4个高优先级任务(0-3)与2个低优先级任务(4-5)
+        auto order = runQueued(pool, {ThreadPool::kHigh, ThreadPool::kHigh,
+                                      ThreadPool::kHigh, ThreadPool::kHigh,
+                                      ThreadPool::kLow, ThreadPool::kLow});
+        // 每轮高优先级最多执行2个，随后让出给低优先级
+        std::vector<int> expected = {0, 1, 4, 2, 3, 5};
+        assert(order == expected);
+        
+        std::cout << "Weighted priority test passed!" << std::endl;
+    }
+    
+    static void testEarliestDeadlineFirst() {
+        std::cout << "Testing earliest deadline first scheduling..." << std::endl;
+        
+        ThreadPool pool(1);
+        pool.setQueuePolicy(ThreadPool::QueuePolicy::kEarliestDeadline);
+        pool.setStarvationLimit(std::chrono::milliseconds(500));
+        
+        std::vector<int> order;
+        std::mutex order_mutex;
+        std::promise<void> gate;
+        std::promise<void> started;
+        std::shared_future<void> gate_future = gate.get_future().share();
+        auto blocker = pool.submit([gate_future, &started]() {
+            started.set_value();
+            gate_future.wait();
+        });
+        started.get_future().wait();
+        
+        auto record = [&order, &order_mutex](int id) {
+            std::lock_guard<std::mutex> lock(order_mutex);
+            order.push_back(id);
+        };
+        auto now = ThreadPool::Clock::now();
+        std::vector<std::future<void>> futures;
+        // 截止时间为2秒的任务受饥饿保护，会被提前到500ms
+        futures.push_back(pool.submitWithDeadline(now + std::chrono::seconds(2),
+                                                  ThreadPool::kNormal, record, 0));
+        futures.push_back(pool.submitWithDeadline(now + std::chrono::milliseconds(100),
+                                                  ThreadPool::kNormal, record, 1));
+        futures.push_back(pool.submitWithDeadline(now + std::chrono::milliseconds(2),
+                                                  ThreadPool::kNormal, record, 2));
+        futures.push_back(pool.submitWithDeadline(now + std::chrono::milliseconds(800),
+                                                  ThreadPool::kNormal, record, 3));
+        // 高优先级任务视为已到期
+        futures.push_back(pool.submitWithPriority(ThreadPool::kHigh, record, 4));
+        
+        gate.set_value();
+        blocker.get();
+        for (auto& future : futures) {
+            future.get();
+        }
+        
+        std::vector<int> expected = {4, 2, 1, 0, 3};
+        assert(order == expected);
+        
+        std::cout << "Earliest deadline first test passed!" << std::endl;
+    }
+    
+    static void testCpuListParsing() {
+        std::cout << "Testing cpu list parsing..." << std::endl;
+        
+        auto cpus = prpc::affinity::parseCpuList("0-3, 8,10-11,2");
+        std::vector<int> expected = {0, 1, 2, 3, 8, 10, 11};
+        assert(cpus == expected);
+        
+        assert(prpc::affinity::parseCpuList("").empty());
+        assert(prpc::affinity::parseCpuList("3-1").empty());
+        assert(prpc::affinity::parseCpuList("abc").empty());
+        
+        std::cout << "Cpu list parsing test passed!" << std::endl;
+    }
+    
+    static void testPinnedWorkers() {
+        std::cout << "Testing pinned workers..." << std::endl;
+        
+        // 从本进程允许运行的CPU中取最多两个，容器或 taskset 限制的 cpuset 可能不含CPU 0
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        assert(sched_getaffinity(0, sizeof(allowed), &allowed) == 0);
+        std::vector<int> cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE && cpus.size() < 2; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                cpus.push_back(cpu);
+            }
+        }
+        assert(!cpus.empty());
+        
+        // 工作线程绑定到这些CPU，任务只能在其中之一上执行
+        ThreadPool pool(2, cpus);
+        assert(pool.size() == 2);
+        
+        std::vector<std::future<int>> futures;
+        for (int i = 0; i < 10; ++i) {
+            futures.push_back(pool.submit([]() { return sched_getcpu(); }));
+        }
+        for (auto& future : futures) {
+            int cpu = future.get();
+            assert(std::find(cpus.begin(), cpus.end(), cpu) != cpus.end());
+        }
+        
+        std::cout << "Pinned workers test passed!" << std::endl;
+    }
 };
 
 int main() {
@@ -258,6 +411,11 @@ int main() {
         ThreadPoolTest::testTaskExecution();
         ThreadPoolTest::testExceptionHandling();
         ThreadPoolTest::testDifferentReturnTypes();
+        ThreadPoolTest::testStrictPriority();
+        ThreadPoolTest::testWeightedPriority();
+        ThreadPoolTest::testEarliestDeadlineFirst();
+        ThreadPoolTest::testCpuListParsing();
+        ThreadPoolTest::testPinnedWorkers();
         ThreadPoolTest::testPerformance();
         ThreadPoolTest::testThreadPoolDestruction();
         
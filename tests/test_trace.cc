@@ -0,0 +1,274 @@
+#include "trace.h"
+#include "fiber.h"
+#include "header.pb.h"
+#include <iostream>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+class TraceTest {
+public:
+    // 把导出的 span 收集到内存里
+    class CollectSink : public prpc::SpanSink {
+    public:
+        explicit CollectSink(std::vector<prpc::Span>* spans, int* batches)
+            : spans_(spans), batches_(batches) {}
+
+        void exportSpans(const std::vector<prpc::Span>& spans) override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            spans_->insert(spans_->end(), spans.begin(), spans.end());
+            ++*batches_;
+        }
+
+    private:
+        std::mutex mutex_;
+        std::vector<prpc::Span>* spans_;
+        int* batches_;
+    };
+
+    static prpc::Span makeSpan(uint64_t trace_id, const std::string& name) {
+        prpc::Span span;
+        span.trace_id = trace_id;
+        span.span_id = prpc::Tracer::newId();
+        span.name = name;
+        span.start_us = prpc::Tracer::nowUs();
+        return span;
+    }
+
+    static void testDropWithoutSink() {
+        std::cout << "Testing span drop without sink..." << std::endl;
+
+        auto& tracer = prpc::Tracer::getInstance();
+        uint64_t before = tracer.dropped();
+        tracer.submit(makeSpan(1, "S.M"));
+        assert(tracer.dropped() == before + 1);
+
+        std::cout << "Span drop without sink test passed!" << std::endl;
+    }
+
+    static void testSampling() {
+        std::cout << "Testing root sampling..." << std::endl;
+
+        auto& tracer = prpc::Tracer::getInstance();
+
+        // 采样率为0：不追踪
+        tracer.setSampleRate(0);
+        assert(!tracer.newSpan(prpc::TraceContext()).valid());
+
+        // 调用方已携带 trace 时沿用 trace_id 和采样标记，只换 span_id
+        prpc::TraceContext parent;
+        parent.trace_id = 42;
+        parent.span_id = 7;
+        parent.sampled = true;
+        prpc::TraceContext child = tracer.newSpan(parent);
+        assert(child.trace_id == 42 && child.sampled);
+        assert(child.span_id != 0 && child.span_id != 7);
+        parent.sampled = false;
+        assert(!tracer.newSpan(parent).sampled);
+
+        tracer.setSampleRate(1);
+        assert(tracer.getSampleRate() == 1.0);
+        for (int i = 0; i < 100; ++i) {
+            prpc::TraceContext root = tracer.newSpan(prpc::TraceContext());
+            assert(root.valid() && root.sampled && root.span_id != 0);
+        }
+
+        // 部分采样：未采样的根 span 仍然带 id，以便下游沿用决策
+        tracer.setSampleRate(0.25);
+        assert(tracer.getSampleRate() > 0.2499 && tracer.getSampleRate() < 0.2501);
+        const int total = 100000;
+        int sampled = 0;
+        for (int i = 0; i < total; ++i) {
+            prpc::TraceContext root = tracer.newSpan(prpc::TraceContext());
+            assert(root.valid());
+            sampled += root.sampled;
+        }
+        assert(sampled > total * 0.23 && sampled < total * 0.27);
+
+        tracer.setSampleRate(0);
+        std::cout << "Root sampling test passed!" << std::endl;
+    }
+
+    static void testScopedContext() {
+        std::cout << "Testing scoped trace context..." << std::endl;
+
+        assert(!prpc::Tracer::current().valid());
+        prpc::TraceContext outer{1, 11, true};
+        {
+            prpc::ScopedTraceContext outerScope(outer);
+            assert(prpc::Tracer::current().span_id == 11);
+            {
+                prpc::ScopedTraceContext innerScope(prpc::TraceContext{1, 12, true});
+                assert(prpc::Tracer::current().span_id == 12);
+            }
+            assert(prpc::Tracer::current().span_id == 11);
+
+            // 其他线程看不到这个上下文
+            std::thread([] { assert(!prpc::Tracer::current().valid()); }).join();
+        }
+        assert(!prpc::Tracer::current().valid());
+
+        std::cout << "Scoped trace context test passed!" << std::endl;
+    }
+
+    static void testFiberIsolation() {
+        std::cout << "Testing fiber-local trace context..." << std::endl;
+
+        // 纤程挂起后可能在另一个工作线程上恢复，上下文必须跟着纤程走
+        std::atomic<int> mismatches{0};
+        {
+            FiberScheduler scheduler(4);
+            for (uint64_t i = 1; i <= 64; ++i) {
+                scheduler.spawn([i, &mismatches] {
+                    prpc::ScopedTraceContext scope(prpc::TraceContext{i, i * 100, false});
+                    for (int round = 0; round < 5; ++round) {
+                        fiber::sleepFor(std::chrono::milliseconds(1));
+                        prpc::TraceContext context = prpc::Tracer::current();
+                        if (context.trace_id != i || context.span_id != i * 100) {
+                            mismatches.fetch_add(1);
+                        }
+                    }
+                });
+            }
+        }
+        assert(mismatches.load() == 0);
+
+        std::cout << "Fiber-local trace context test passed!" << std::endl;
+    }
+
+    static void testBatchExport() {
+        std::cout << "Testing batched span export..." << std::endl;
+
+        auto& tracer = prpc::Tracer::getInstance();
+        std::vector<prpc::Span> spans;
+        int batches = 0;
+        tracer.setSink(std::unique_ptr<prpc::SpanSink>(new CollectSink(&spans, &batches)));
+
+        // 批量满时后台线程立即导出，不必等待定时器
+        for (int i = 0; i < 256; ++i) {
+            tracer.submit(makeSpan(9, "S.Batch"));
+        }
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+        while (std::chrono::steady_clock::now() < deadline) {
+            tracer.flush();    // 与后台导出串行，之后读取是安全的
+            if (spans.size() == 256) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        assert(spans.size() == 256);
+
+        // flush 立即导出不足一批的 span
+        prpc::Span last = makeSpan(10, "S.Flush");
+        last.kind = prpc::Span::kClient;
+        last.error = prpc::ErrorCode::TIMEOUT_ERROR;
+        tracer.submit(last);
+        tracer.flush();
+        assert(spans.size() == 257);
+        assert(spans.back().name == "S.Flush");
+        assert(spans.back().error == prpc::ErrorCode::TIMEOUT_ERROR);
+
+        tracer.setSink(nullptr);
+        std::cout << "Batched span export test passed!" << std::endl;
+    }
+
+    static void testFileSink() {
+        std::cout << "Testing file span sink..." << std::endl;
+
+        std::string path = "/tmp/prpc_test_trace_" + std::to_string(getpid()) + ".jsonl";
+        auto sink = prpc::FileSpanSink::open(path);
+        assert(sink);
+        assert(!prpc::FileSpanSink::open("/nonexistent/dir/trace.jsonl"));
+
+        auto& tracer = prpc::Tracer::getInstance();
+        tracer.setSink(std::move(sink));
+        prpc::Span span = makeSpan(0xabcdef, "EchoService.Echo");
+        span.parent_span_id = 0x1234;
+        span.duration_us = 150;
+        tracer.submit(span);
+        tracer.setSink(nullptr);    // 换掉目标前先写出排队的 span
+
+        std::ifstream in(path);
+        std::string line;
+        assert(std::getline(in, line));
+        assert(line.find("\"trace_id\":\"0000000000abcdef\"") != std::string::npos);
+        assert(line.find("\"parent_id\":\"0000000000001234\"") != std::string::npos);
+        assert(line.find("\"name\":\"EchoService.Echo\"") != std::string::npos);
+        assert(line.find("\"kind\":\"server\"") != std::string::npos);
+        assert(line.find("\"duration_us\":150") != std::string::npos);
+        assert(line.find("\"error\":\"\"") != std::string::npos);
+        assert(!std::getline(in, line));
+        std::remove(path.c_str());
+
+        std::cout << "File span sink test passed!" << std::endl;
+    }
+
+    static void testHeaderRoundTrip() {
+        std::cout << "Testing trace fields in rpc header..." << std::endl;
+
+        Prpc::RpcHeader header;
+        header.set_service_name("S");
+        header.set_method_name("M");
+        header.set_args_size(3);
+        std::string untraced;
+        assert(header.SerializeToString(&untraced));
+
+        header.set_trace_id(0xfedcba9876543210ull);
+        header.set_span_id(5);
+        header.set_sampled(true);
+        std::string traced;
+        assert(header.SerializeToString(&traced));
+
+        Prpc::RpcHeader parsed;
+        assert(parsed.ParseFromString(traced));
+        assert(parsed.trace_id() == 0xfedcba9876543210ull);
+        assert(parsed.span_id() == 5);
+        assert(parsed.sampled());
+
+        // 未追踪的请求头不带这些字段，旧版本服务端也能解析
+        assert(parsed.ParseFromString(untraced));
+        assert(parsed.trace_id() == 0 && !parsed.sampled());
+
+        std::cout << "Trace fields in rpc header test passed!" << std::endl;
+    }
+
+    static void testUntracedCost() {
+        std::cout << "Testing untraced call overhead..." << std::endl;
+
+        auto& tracer = prpc::Tracer::getInstance();
+        tracer.setSampleRate(0);
+        const int iterations = 1000000;
+        int valid = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            valid += tracer.newSpan(prpc::Tracer::current()).valid();
+        }
+        double ns = std::chrono::duration<double, std::nano>(
+                        std::chrono::steady_clock::now() - start).count() / iterations;
+        assert(valid == 0);
+        std::cout << "  current()+newSpan() with tracing off: " << ns << " ns" << std::endl;
+
+        std::cout << "Untraced call overhead test passed!" << std::endl;
+    }
+};
+
+int main() {
+    std::cout << "Running trace tests..." << std::endl;
+
+    TraceTest::testDropWithoutSink();
+    TraceTest::testSampling();
+    TraceTest::testScopedContext();
+    TraceTest::testFiberIsolation();
+    TraceTest::testBatchExport();
+    TraceTest::testFileSink();
+    TraceTest::testHeaderRoundTrip();
+    TraceTest::testUntracedCost();
+
+    std::cout << "All trace tests passed!" << std::endl;
+    return 0;
+}
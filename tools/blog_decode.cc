@@ -0,0 +1,20 @@
+// 把 BLOG 写出的二进制日志文件渲染为文本
+// 用法: prpc_blog_decode <binary_log_file>
+#include <iostream>
+#include <string>
+
+#include "binary_log.h"
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::cerr << "usage: " << argv[0] << " <binary_log_file>" << std::endl;
+        return 2;
+    }
+
+    std::string error;
+    if (!blog::decodeFile(argv[1], std::cout, &error)) {
+        std::cerr << argv[1] << ": " << error << std::endl;
+        return 1;
+    }
+    return 0;
+}
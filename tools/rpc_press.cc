@@ -0,0 +1,627 @@
+// 压测工具：运行时加载 .proto，从文件读取请求(protobuf 文本格式或 JSON)，
+// 经 Pchannel 以固定 QPS 或固定并发调用目标方法，每个统计周期输出一行吞吐、延迟分位数和错误，
+// 结束时输出汇总和按错误码、错误信息分类的错误数
+//
+// 用法: prpc_rpc_press (--proto=FILE | --protoset=FILE) --method=[PACKAGE.]SERVICE.METHOD --input=FILE
+//                      (--server=IP:PORT | --config=FILE) [选项]
+//   --proto=FILE         定义服务的 .proto 文件
+//   --proto_path=DIR     import 的搜索目录，可重复，默认为 --proto 所在目录
+//   --protoset=FILE      代替 --proto：protoc --include_imports --descriptor_set_out 生成的描述文件
+//   --method=NAME        目标方法，包名可省略
+//   --input=FILE         请求文件，按顺序循环使用。文本格式每条请求之间用只有 --- 的行分隔；
+//                        JSON 格式为依次排列的 JSON 对象(每行一个或跨行均可)
+//   --format=text|json   请求文件格式，默认按扩展名：.json/.jsonl 为 json，其余为 text
+//   --server=IP:PORT     直接压测这个地址，不经过注册中心
+//   --config=FILE        prpc 配置文件，经配置的注册中心查找服务地址
+//   --qps=N              总请求速率。0 为闭环(默认)：每个调用线程收到响应后立即发起下一次；
+//                        大于 0 为开环：请求按固定间隔排定，延迟从排定时间算起，
+//                        并发数不够导致的发送推迟也计入延迟
+//   --concurrency=N      调用线程数，即同时进行的调用数上限，默认 1
+//   --connections=N      连接数，默认与并发数相同。同一连接上的调用串行进行
+//   --timeout_ms=N       单次调用超时，默认 1000，0 为不设置
+//   --duration=S         压测时长(秒)，默认 0 表示直到 Ctrl-C
+//   --interval=S         统计周期(秒)，默认 1
+//
+// 延迟分位数来自 prpc::Histogram，相对误差不超过 1/16
+#include <getopt.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <google/protobuf/compiler/importer.h>
+#include <google/protobuf/descriptor.pb.h>
+#include <google/protobuf/dynamic_message.h>
+#include <google/protobuf/text_format.h>
+#include <google/protobuf/util/json_util.h>
+
+#include "application.h"
+#include "controller.h"
+#include "metrics.h"
+#include "registry.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+namespace pb = google::protobuf;
+
+std::atomic<bool> g_stop{false};
+
+void onSignal(int) {
+    g_stop.store(true);
+}
+
+struct Options {
+    std::string proto;
+    std::vector<std::string> proto_paths;
+    std::string protoset;
+    std::string method;
+    std::string input;
+    std::string format;
+    std::string server;
+    std::string config;
+    uint64_t qps = 0;           // 0 为闭环
+    uint64_t concurrency = 1;
+    uint64_t connections = 0;   // 0 为与并发数相同
+    int timeout_ms = 1000;
+    double duration_s = 0;      // 0 为直到 Ctrl-C
+    double interval_s = 1;
+};
+
+void usage(const char* program) {
+    std::cerr << "usage: " << program
+              << " (--proto=FILE | --protoset=FILE) --method=[PACKAGE.]SERVICE.METHOD --input=FILE\n"
+                 "       (--server=IP:PORT | --config=FILE) [--proto_path=DIR]... [--format=text|json]\n"
+                 "       [--qps=N] [--concurrency=N] [--connections=N] [--timeout_ms=N]\n"
+                 "       [--duration=S] [--interval=S]\n";
+}
+
+bool parseCount(const char* text, uint64_t& value) {
+    char* end = nullptr;
+    unsigned long long parsed = strtoull(text, &end, 10);
+    if (*text == '\0' || *end != '\0') {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    static const option kOptions[] = {
+        {"proto", required_argument, nullptr, 'p'},
+        {"proto_path", required_argument, nullptr, 'I'},
+        {"protoset", required_argument, nullptr, 'S'},
+        {"method", required_argument, nullptr, 'm'},
+        {"input", required_argument, nullptr, 'i'},
+        {"format", required_argument, nullptr, 'f'},
+        {"server", required_argument, nullptr, 's'},
+        {"config", required_argument, nullptr, 'C'},
+        {"qps", required_argument, nullptr, 'q'},
+        {"concurrency", required_argument, nullptr, 'c'},
+        {"connections", required_argument, nullptr, 'n'},
+        {"timeout_ms", required_argument, nullptr, 't'},
+        {"duration", required_argument, nullptr, 'd'},
+        {"interval", required_argument, nullptr, 'v'},
+        {nullptr, 0, nullptr, 0},
+    };
+    int o;
+    uint64_t value;
+    while ((o = getopt_long(argc, argv, "", kOptions, nullptr)) != -1) {
+        switch (o) {
+            case 'p':
+                options.proto = optarg;
+                break;
+            case 'I':
+                options.proto_paths.push_back(optarg);
+                break;
+            case 'S':
+                options.protoset = optarg;
+                break;
+            case 'm':
+                options.method = optarg;
+                break;
+            case 'i':
+                options.input = optarg;
+                break;
+            case 'f':
+                options.format = optarg;
+                break;
+            case 's':
+                options.server = optarg;
+                break;
+            case 'C':
+                options.config = optarg;
+                break;
+            case 'q':
+                if (!parseCount(optarg, options.qps)) return false;
+                break;
+            case 'c':
+                if (!parseCount(optarg, options.concurrency)) return false;
+                break;
+            case 'n':
+                if (!parseCount(optarg, options.connections)) return false;
+                break;
+            case 't':
+                if (!parseCount(optarg, value)) return false;
+                options.timeout_ms = static_cast<int>(value);
+                break;
+            case 'd':
+                options.duration_s = atof(optarg);
+                break;
+            case 'v':
+                options.interval_s = atof(optarg);
+                break;
+            default:
+                return false;
+        }
+    }
+    if (options.format.empty()) {
+        const std::string& input = options.input;
+        bool json = (input.size() > 5 && input.compare(input.size() - 5, 5, ".json") == 0) ||
+                    (input.size() > 6 && input.compare(input.size() - 6, 6, ".jsonl") == 0);
+        options.format = json ? "json" : "text";
+    }
+    if (options.proto_paths.empty() && !options.proto.empty()) {
+        size_t slash = options.proto.rfind('/');
+        options.proto_paths.push_back(slash == std::string::npos ? "." : options.proto.substr(0, slash));
+    }
+    if (options.connections == 0) {
+        options.connections = options.concurrency;
+    }
+    return optind == argc && (options.proto.empty() != options.protoset.empty()) &&
+           !options.method.empty() &&
+           !options.input.empty() && (options.format == "text" || options.format == "json") &&
+           (options.server.empty() != options.config.empty()) && options.concurrency > 0 &&
+           options.duration_s >= 0 && options.interval_s > 0;
+}
+
+// .proto 的语法错误输出到标准错误
+class ProtoErrorPrinter : public pb::compiler::MultiFileErrorCollector {
+public:
+#if GOOGLE_PROTOBUF_VERSION >= 4022000
+    void RecordError(absl::string_view filename, int line, int column,
+                     absl::string_view message) override {
+#else
+    void AddError(const std::string& filename, int line, int column,
+                  const std::string& message) override {
+#endif
+        std::cerr << filename << ":" << line + 1 << ":" << column + 1 << ": " << message << std::endl;
+    }
+};
+
+// 服务定义：--proto 在运行时解析，--protoset 为 protoc --include_imports --descriptor_set_out 的输出
+struct Schema {
+    pb::compiler::DiskSourceTree tree;
+    ProtoErrorPrinter error_printer;
+    std::unique_ptr<pb::compiler::Importer> importer;
+    pb::DescriptorPool protoset_pool;
+    const pb::DescriptorPool* pool = nullptr;
+    std::vector<std::string> packages;      // 方法名省略包名时依次尝试
+};
+
+bool loadSchema(const Options& options, Schema& schema) {
+    if (!options.proto.empty()) {
+        for (const auto& path : options.proto_paths) {
+            schema.tree.MapPath("", path);
+        }
+        std::string virtual_file;
+        std::string shadowing;
+        if (schema.tree.DiskFileToVirtualFile(options.proto, &virtual_file, &shadowing) !=
+            pb::compiler::DiskSourceTree::SUCCESS) {
+            std::cerr << options.proto << ": not found under --proto_path" << std::endl;
+            return false;
+        }
+        schema.importer = std::make_unique<pb::compiler::Importer>(&schema.tree, &schema.error_printer);
+        const pb::FileDescriptor* file = schema.importer->Import(virtual_file);
+        if (file == nullptr) {
+            return false;
+        }
+        schema.pool = schema.importer->pool();
+        schema.packages.push_back(std::string(file->package()));
+        return true;
+    }
+
+    std::ifstream in(options.protoset, std::ios::binary);
+    pb::FileDescriptorSet set;
+    if (!in || !set.ParseFromIstream(&in)) {
+        std::cerr << options.protoset << ": not a FileDescriptorSet" << std::endl;
+        return false;
+    }
+    // protoc 按依赖顺序输出文件
+    for (const auto& file : set.file()) {
+        if (schema.protoset_pool.BuildFile(file) == nullptr) {
+            std::cerr << options.protoset << ": cannot build " << file.name() << std::endl;
+            return false;
+        }
+        schema.packages.push_back(file.package());
+    }
+    schema.pool = &schema.protoset_pool;
+    return true;
+}
+
+const pb::MethodDescriptor* findMethod(const Options& options, const Schema& schema) {
+    const pb::MethodDescriptor* method = schema.pool->FindMethodByName(options.method);
+    for (size_t i = 0; method == nullptr && i < schema.packages.size(); ++i) {
+        if (!schema.packages[i].empty()) {
+            method = schema.pool->FindMethodByName(schema.packages[i] + "." + options.method);
+        }
+    }
+    if (method == nullptr) {
+        std::cerr << options.method << ": no such method" << std::endl;
+    }
+    return method;
+}
+
+// 把请求文件切分成单条请求的文本
+std::vector<std::string> splitRequests(const std::string& content, const std::string& format) {
+    std::vector<std::string> items;
+    if (format == "text") {
+        std::istringstream in(content);
+        std::string line;
+        std::string current;
+        while (std::getline(in, line)) {
+            if (line == "---") {
+                items.push_back(current);
+                current.clear();
+            } else {
+                current += line;
+                current += '\n';
+            }
+        }
+        if (current.find_first_not_of(" \t\r\n") != std::string::npos || items.empty()) {
+            items.push_back(current);
+        }
+        return items;
+    }
+    // JSON：按括号深度找出每个顶层对象，跳过字符串内的括号
+    int depth = 0;
+    bool in_string = false;
+    bool escaped = false;
+    size_t begin = 0;
+    for (size_t i = 0; i < content.size(); ++i) {
+        char c = content[i];
+        if (in_string) {
+            if (escaped) {
+                escaped = false;
+            } else if (c == '\\') {
+                escaped = true;
+            } else if (c == '"') {
+                in_string = false;
+            }
+        } else if (c == '"') {
+            in_string = true;
+        } else if (c == '{') {
+            if (depth++ == 0) {
+                begin = i;
+            }
+        } else if (c == '}' && depth > 0 && --depth == 0) {
+            items.push_back(content.substr(begin, i - begin + 1));
+        }
+    }
+    return items;
+}
+
+bool loadRequests(const Options& options, const pb::Message& prototype,
+                  std::vector<std::unique_ptr<pb::Message>>& requests) {
+    std::ifstream in(options.input);
+    if (!in) {
+        std::cerr << options.input << ": cannot open" << std::endl;
+        return false;
+    }
+    std::stringstream content;
+    content << in.rdbuf();
+    std::vector<std::string> items = splitRequests(content.str(), options.format);
+    for (size_t i = 0; i < items.size(); ++i) {
+        std::unique_ptr<pb::Message> request(prototype.New());
+        if (options.format == "text") {
+            if (!pb::TextFormat::ParseFromString(items[i], request.get())) {
+                std::cerr << options.input << ": request " << i + 1 << " is not a valid "
+                          << prototype.GetTypeName() << std::endl;
+                return false;
+            }
+        } else {
+            auto status = pb::util::JsonStringToMessage(items[i], request.get());
+            if (!status.ok()) {
+                std::cerr << options.input << ": request " << i + 1 << ": " << status.ToString()
+                          << std::endl;
+                return false;
+            }
+        }
+        requests.push_back(std::move(request));
+    }
+    if (requests.empty()) {
+        std::cerr << options.input << ": no requests" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// --server 使用进程内注册中心，--config 使用配置的注册中心
+bool initApplication(const Options& options, char* program, std::unique_ptr<ServiceRegistry>& direct,
+                     const pb::MethodDescriptor* method) {
+    std::string path = options.config;
+    char temp[] = "/tmp/prpc_rpc_press.XXXXXX";
+    if (!options.server.empty()) {
+        int fd = mkstemp(temp);
+        if (fd < 0) {
+            return false;
+        }
+        close(fd);
+        std::ofstream config(temp);
+        config << "registry=memory\n"
+               << "log_level=warn\n";
+        path = temp;
+    }
+    char flag[] = "-i";
+    char* args[] = {program, flag, &path[0], nullptr};
+    auto result = Papplication::Init(3, args);
+    if (!options.server.empty()) {
+        unlink(temp);
+    }
+    if (!result.isSuccess()) {
+        std::cerr << result.getErrorMessage() << std::endl;
+        return false;
+    }
+    if (!options.server.empty()) {
+        direct = std::make_unique<MemoryServiceRegistry>();
+        direct->Register(std::string(method->service()->name()), std::string(method->name()),
+                         options.server);
+    }
+    return true;
+}
+
+// 一条连接：Pchannel 为每个目标地址缓存一个 socket，同一连接上的调用必须串行
+struct Connection {
+    Pchannel channel{false};
+    std::mutex mutex;
+};
+
+// 调用失败的错误信息及次数，只在失败时加锁
+class ErrorTexts {
+public:
+    void add(const std::string& text) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = counts_.find(text);
+        if (it != counts_.end()) {
+            ++it->second;
+        } else if (counts_.size() < kMaxTexts) {
+            counts_[text] = 1;
+        } else {
+            ++counts_["(other)"];
+        }
+    }
+
+    std::map<std::string, uint64_t> counts() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return counts_;
+    }
+
+private:
+    static constexpr size_t kMaxTexts = 16;
+    std::mutex mutex_;
+    std::map<std::string, uint64_t> counts_;
+};
+
+struct Press {
+    const pb::MethodDescriptor* method;
+    const pb::Message* response_prototype;
+    std::vector<std::unique_ptr<pb::Message>> requests;
+    std::vector<std::unique_ptr<Connection>> connections;
+    prpc::Histogram latency;                // 成功的调用，开环时从排定时间算起
+    std::atomic<uint64_t> succeeded{0};
+    std::atomic<uint64_t> next_slot{0};
+    ErrorTexts error_texts;
+    Clock::time_point start;
+    Clock::time_point end;
+};
+
+void runWorker(Press& press, const Options& options, uint64_t worker) {
+    Connection& connection = *press.connections[worker % press.connections.size()];
+    std::unique_ptr<pb::Message> response(press.response_prototype->New());
+    auto interval = options.qps > 0 ? std::chrono::nanoseconds(1000000000 / options.qps)
+                                    : std::chrono::nanoseconds(0);
+    Pcontroller controller;
+    size_t next_request = worker;
+    uint64_t succeeded = 0;
+    while (!g_stop.load(std::memory_order_relaxed)) {
+        Clock::time_point intended;
+        if (options.qps > 0) {
+            // 过载时排定时间落后于当前时间，到结束时间仍未发出的请求不再发送
+            intended = press.start + interval * press.next_slot.fetch_add(1, std::memory_order_relaxed);
+            if (intended >= press.end || Clock::now() >= press.end) {
+                break;
+            }
+            std::this_thread::sleep_until(intended);
+        } else {
+            intended = Clock::now();
+            if (intended >= press.end) {
+                break;
+            }
+        }
+
+        const pb::Message& request = *press.requests[next_request % press.requests.size()];
+        next_request += options.concurrency;
+        controller.Reset();
+        if (options.timeout_ms > 0) {
+            controller.SetTimeout(options.timeout_ms);
+        }
+        {
+            std::lock_guard<std::mutex> lock(connection.mutex);
+            connection.channel.CallMethod(press.method, &controller, &request, response.get(),
+                                          nullptr);
+        }
+        if (controller.Failed()) {
+            press.error_texts.add(controller.ErrorText());
+            continue;
+        }
+        press.latency.recordDuration(Clock::now() - intended);
+        // 成功数按批发布，减少共享计数器上的写
+        if (++succeeded == 64) {
+            press.succeeded.fetch_add(succeeded, std::memory_order_relaxed);
+            succeeded = 0;
+        }
+    }
+    press.succeeded.fetch_add(succeeded, std::memory_order_relaxed);
+}
+
+// 按错误码的累计错误数，来自 Pchannel 的客户端指标
+std::map<prpc::ErrorCode, uint64_t> errorCounts(prpc::MethodStats& stats) {
+    std::map<prpc::ErrorCode, uint64_t> counts;
+    for (const auto& entry : stats.errors.counters()) {
+        counts[entry.first] = entry.second->value();
+    }
+    return counts;
+}
+
+std::string formatMs(double ns) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(ns < 1e7 ? 3 : 1) << ns / 1e6 << "ms";
+    return out.str();
+}
+
+void printLatency(std::ostream& out, const prpc::HistogramSnapshot& latency) {
+    out << "p50=" << formatMs(latency.percentile(0.5)) << " p90=" << formatMs(latency.percentile(0.9))
+        << " p99=" << formatMs(latency.percentile(0.99))
+        << " p999=" << formatMs(latency.percentile(0.999));
+}
+
+void printErrors(std::ostream& out, const std::map<prpc::ErrorCode, uint64_t>& counts,
+                 const std::map<prpc::ErrorCode, uint64_t>& base) {
+    for (const auto& entry : counts) {
+        auto it = base.find(entry.first);
+        uint64_t delta = entry.second - (it == base.end() ? 0 : it->second);
+        if (delta > 0) {
+            out << " " << prpc::ErrorCodeToString(entry.first) << "=" << delta;
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    Schema schema;
+    if (!loadSchema(options, schema)) {
+        return 1;
+    }
+    Press press;
+    press.method = findMethod(options, schema);
+    if (press.method == nullptr) {
+        return 1;
+    }
+    pb::DynamicMessageFactory factory;
+    if (!loadRequests(options, *factory.GetPrototype(press.method->input_type()), press.requests)) {
+        return 1;
+    }
+    press.response_prototype = factory.GetPrototype(press.method->output_type());
+
+    std::unique_ptr<ServiceRegistry> direct;
+    if (!initApplication(options, argv[0], direct, press.method)) {
+        return 1;
+    }
+    for (uint64_t i = 0; i < options.connections; ++i) {
+        press.connections.push_back(std::make_unique<Connection>());
+    }
+    prpc::MethodStats& client_stats = prpc::MetricsRegistry::getInstance().method(
+        prpc::MetricsRegistry::kClient, std::string(press.method->service()->name()),
+        std::string(press.method->name()));
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    std::cout << "pressing " << press.method->full_name() << " with " << press.requests.size()
+              << " request(s), " << options.concurrency << " caller(s) on " << options.connections
+              << " connection(s), "
+              << (options.qps > 0 ? "qps " + std::to_string(options.qps) : std::string("closed loop"))
+              << std::endl;
+
+    press.start = Clock::now();
+    press.end = options.duration_s > 0
+                    ? press.start + std::chrono::duration_cast<Clock::duration>(
+                                        std::chrono::duration<double>(options.duration_s))
+                    : Clock::time_point::max();
+    std::vector<std::thread> workers;
+    for (uint64_t w = 0; w < options.concurrency; ++w) {
+        workers.emplace_back(runWorker, std::ref(press), std::cref(options), w);
+    }
+
+    // 每个周期输出与上一周期快照的差
+    auto period = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(options.interval_s));
+    auto next_report = press.start + period;
+    auto last_time = press.start;
+    prpc::HistogramSnapshot last_latency = press.latency.snapshot();
+    uint64_t last_succeeded = 0;
+    std::map<prpc::ErrorCode, uint64_t> last_errors = errorCounts(client_stats);
+    while (!g_stop.load() && Clock::now() < press.end) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        auto now = Clock::now();
+        if (now < next_report) {
+            continue;
+        }
+        next_report += period;
+        prpc::HistogramSnapshot latency = press.latency.snapshot();
+        prpc::HistogramSnapshot delta = latency;
+        delta.subtract(last_latency);
+        uint64_t succeeded = press.succeeded.load(std::memory_order_relaxed);
+        std::map<prpc::ErrorCode, uint64_t> errors = errorCounts(client_stats);
+        double seconds = std::chrono::duration<double>(now - last_time).count();
+        double elapsed = std::chrono::duration<double>(now - press.start).count();
+
+        std::cout << "[" << std::fixed << std::setprecision(0) << std::setw(5) << elapsed << "s] "
+                  << "qps=" << std::setprecision(0) << (succeeded - last_succeeded) / seconds << " ";
+        printLatency(std::cout, delta);
+        printErrors(std::cout, errors, last_errors);
+        std::cout << std::endl;
+
+        last_time = now;
+        last_latency = std::move(latency);
+        last_succeeded = succeeded;
+        last_errors = std::move(errors);
+    }
+    g_stop.store(true);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - press.start).count();
+    prpc::HistogramSnapshot latency = press.latency.snapshot();
+    std::map<prpc::ErrorCode, uint64_t> errors = errorCounts(client_stats);
+    uint64_t failed = 0;
+    for (const auto& entry : errors) {
+        failed += entry.second;
+    }
+    std::cout << "\nsummary: " << std::fixed << std::setprecision(1) << seconds << "s, "
+              << latency.count << " succeeded, " << failed << " failed, qps="
+              << std::setprecision(0) << latency.count / seconds << "\n  latency ";
+    printLatency(std::cout, latency);
+    std::cout << " mean=" << formatMs(latency.mean()) << "\n";
+    if (failed > 0) {
+        std::cout << "  errors:";
+        printErrors(std::cout, errors, {});
+        std::cout << "\n";
+        for (const auto& entry : press.error_texts.counts()) {
+            std::cout << "    " << std::setw(8) << entry.second << "  " << entry.first << "\n";
+        }
+    }
+    std::cout.flush();
+    return failed > 0 && latency.count == 0 ? 1 : 0;
+}
@@ -0,0 +1,385 @@
+// 回放 provider 抓取的流量(capture_file)：按原始到达间隔或按比例压缩，把请求帧原样重新发给测试中的 provider，
+// 输出总体和每个方法的延迟分布，用于比较不同版本在同一份真实流量下的表现。
+// 请求帧不需要 .proto：RpcHeader 和参数按抓到的字节发送，只清除其中的 trace 上下文
+//
+// 用法: prpc_rpc_replay --capture=FILE --server=IP:PORT [选项]
+//   --speed=X            回放速度倍数，默认 1 为原始间隔，2 为两倍速；0 为不等待，尽快发送
+//   --connections=N      连接数，即同时进行的请求数上限，默认 8。同一连接上的请求串行进行，
+//                        连接都忙时请求推迟发送，延迟从排定时间算起，推迟的时间也计入延迟
+//   --timeout_ms=N       等待响应的超时，默认 1000
+//   --label=TEXT         写入结果的标签，例如版本号
+//   --output=FILE        JSON 结果文件，不指定时只输出文本摘要
+//
+// 延迟分位数来自 prpc::Histogram，相对误差不超过 1/16
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "capture.h"
+#include "fiber.h"
+#include "header.pb.h"
+#include "metrics.h"
+#include "rpc_frame.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string capture;
+    std::string server;
+    double speed = 1;           // 0 为不等待
+    uint64_t connections = 8;
+    int timeout_ms = 1000;
+    std::string label;
+    std::string output;
+};
+
+void usage(const char* program) {
+    std::cerr << "usage: " << program
+              << " --capture=FILE --server=IP:PORT [--speed=X] [--connections=N]\n"
+                 "       [--timeout_ms=N] [--label=TEXT] [--output=FILE]\n";
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    static const option kOptions[] = {
+        {"capture", required_argument, nullptr, 'c'},
+        {"server", required_argument, nullptr, 's'},
+        {"speed", required_argument, nullptr, 'x'},
+        {"connections", required_argument, nullptr, 'n'},
+        {"timeout_ms", required_argument, nullptr, 't'},
+        {"label", required_argument, nullptr, 'l'},
+        {"output", required_argument, nullptr, 'o'},
+        {nullptr, 0, nullptr, 0},
+    };
+    int o;
+    while ((o = getopt_long(argc, argv, "", kOptions, nullptr)) != -1) {
+        switch (o) {
+            case 'c':
+                options.capture = optarg;
+                break;
+            case 's':
+                options.server = optarg;
+                break;
+            case 'x':
+                options.speed = atof(optarg);
+                break;
+            case 'n':
+                options.connections = strtoull(optarg, nullptr, 10);
+                break;
+            case 't':
+                options.timeout_ms = atoi(optarg);
+                break;
+            case 'l':
+                options.label = optarg;
+                break;
+            case 'o':
+                options.output = optarg;
+                break;
+            default:
+                return false;
+        }
+    }
+    return optind == argc && !options.capture.empty() &&
+           options.server.find(':') != std::string::npos && options.speed >= 0 &&
+           options.connections > 0 && options.timeout_ms > 0;
+}
+
+// 一个方法的回放结果
+struct MethodResult {
+    prpc::Histogram latency;        // 收到响应的请求，从排定时间算起
+    std::atomic<uint64_t> errors{0};
+    std::atomic<uint64_t> max_ns{0};
+};
+
+// 编码好的请求帧
+struct Frame {
+    uint64_t offset_ns;             // 相对第一帧
+    size_t method;                  // methods 中的下标
+    std::string bytes;
+};
+
+void recordError(MethodResult& result) {
+    result.errors.fetch_add(1, std::memory_order_relaxed);
+}
+
+void recordLatency(MethodResult& result, uint64_t ns) {
+    result.latency.record(ns);
+    uint64_t max = result.max_ns.load(std::memory_order_relaxed);
+    while (ns > max && !result.max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+}
+
+struct Replay {
+    std::vector<Frame> frames;
+    std::vector<std::string> methods;                       // Service.Method
+    std::vector<std::unique_ptr<MethodResult>> results;     // 与 methods 对应
+    MethodResult total;                                     // 所有方法合计
+    std::atomic<size_t> next{0};
+    std::atomic<uint64_t> connect_errors{0};
+    Clock::time_point start;
+};
+
+bool loadFrames(const Options& options, Replay& replay, double* captured_seconds) {
+    std::vector<prpc::CapturedFrame> captured;
+    std::string error;
+    if (!prpc::readCaptureFile(options.capture, nullptr, &captured, &error)) {
+        std::cerr << options.capture << ": " << error << std::endl;
+        return false;
+    }
+    if (captured.empty()) {
+        std::cerr << options.capture << ": no frames" << std::endl;
+        return false;
+    }
+    std::map<std::string, size_t> index;
+    uint64_t first = captured.front().arrival_ns;
+    for (size_t i = 0; i < captured.size(); ++i) {
+        Prpc::RpcHeader header;
+        if (!header.ParseFromString(captured[i].header)) {
+            std::cerr << options.capture << ": frame " << i + 1 << " has a bad header, skipped"
+                      << std::endl;
+            continue;
+        }
+        // 回放的请求不加入抓取时的 trace
+        header.clear_trace_id();
+        header.clear_span_id();
+        header.clear_sampled();
+        std::string method = header.service_name() + "." + header.method_name();
+        auto it = index.find(method);
+        if (it == index.end()) {
+            it = index.emplace(method, replay.methods.size()).first;
+            replay.methods.push_back(method);
+            replay.results.push_back(std::make_unique<MethodResult>());
+        }
+        Frame frame;
+        frame.offset_ns = captured[i].arrival_ns - first;
+        frame.method = it->second;
+        prpc::encodeRequestFrame(header, captured[i].args, &frame.bytes);
+        replay.frames.push_back(std::move(frame));
+    }
+    *captured_seconds = (captured.back().arrival_ns - first) / 1e9;
+    return !replay.frames.empty();
+}
+
+int connectTo(const std::string& server, int timeout_ms) {
+    size_t colon = server.rfind(':');
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(atoi(server.c_str() + colon + 1)));
+    if (inet_pton(AF_INET, server.substr(0, colon).c_str(), &addr.sin_addr) != 1) {
+        return -1;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 发送一帧并读完响应；失败时连接已不可用
+bool roundTrip(int fd, const std::string& frame, std::string& response) {
+    if (fiber::send(fd, frame.data(), frame.size(), 0) < 0) {
+        return false;
+    }
+    char length_buf[prpc::kFrameLengthSize];
+    if (fiber::recvAll(fd, length_buf, sizeof(length_buf), 0) <= 0) {
+        return false;
+    }
+    response.resize(prpc::decodeFrameLength(length_buf));
+    return response.empty() || fiber::recvAll(fd, &response[0], response.size(), 0) > 0;
+}
+
+void runConnection(Replay& replay, const Options& options) {
+    int fd = -1;
+    std::string response;
+    while (true) {
+        size_t i = replay.next.fetch_add(1, std::memory_order_relaxed);
+        if (i >= replay.frames.size()) {
+            break;
+        }
+        const Frame& frame = replay.frames[i];
+        Clock::time_point intended = Clock::now();
+        if (options.speed > 0) {
+            intended = replay.start + std::chrono::nanoseconds(
+                                          static_cast<int64_t>(frame.offset_ns / options.speed));
+            std::this_thread::sleep_until(intended);
+        }
+        MethodResult& result = *replay.results[frame.method];
+        if (fd < 0) {
+            fd = connectTo(options.server, options.timeout_ms);
+            if (fd < 0) {
+                replay.connect_errors.fetch_add(1, std::memory_order_relaxed);
+                recordError(result);
+                recordError(replay.total);
+                continue;
+            }
+        }
+        if (!roundTrip(fd, frame.bytes, response)) {
+            // provider 在请求无法处理时关闭连接，下一帧重新连接
+            recordError(result);
+            recordError(replay.total);
+            close(fd);
+            fd = -1;
+            continue;
+        }
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - intended)
+                          .count();
+        recordLatency(result, ns);
+        recordLatency(replay.total, ns);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+struct Row {
+    std::string method;
+    prpc::HistogramSnapshot latency;
+    uint64_t errors;
+    uint64_t max_ns;
+};
+
+std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+void writeJson(std::ostream& out, const Options& options, double captured_seconds,
+               double seconds, const std::vector<Row>& rows) {
+    std::time_t now = std::time(nullptr);
+    std::tm tm;
+    gmtime_r(&now, &tm);
+    char timestamp[32];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &tm);
+
+    out << std::fixed << std::setprecision(1);
+    out << "{\n"
+        << "  \"label\": " << jsonString(options.label) << ",\n"
+        << "  \"timestamp\": \"" << timestamp << "\",\n"
+        << "  \"capture\": " << jsonString(options.capture) << ",\n"
+        << "  \"speed\": " << options.speed << ",\n"
+        << "  \"connections\": " << options.connections << ",\n"
+        << "  \"captured_s\": " << captured_seconds << ",\n"
+        << "  \"replayed_s\": " << seconds << ",\n"
+        << "  \"methods\": [";
+    for (size_t i = 0; i < rows.size(); ++i) {
+        const Row& r = rows[i];
+        out << (i == 0 ? "\n" : ",\n")
+            << "    {\"method\": " << jsonString(r.method)
+            << ", \"requests\": " << r.latency.count
+            << ", \"errors\": " << r.errors
+            << ", \"latency_us\": {\"mean\": " << r.latency.mean() / 1e3
+            << ", \"p50\": " << r.latency.percentile(0.5) / 1e3
+            << ", \"p90\": " << r.latency.percentile(0.9) / 1e3
+            << ", \"p99\": " << r.latency.percentile(0.99) / 1e3
+            << ", \"p999\": " << r.latency.percentile(0.999) / 1e3
+            << ", \"max\": " << r.max_ns / 1e3 << "}}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 2;
+    }
+    Replay replay;
+    double captured_seconds = 0;
+    if (!loadFrames(options, replay, &captured_seconds)) {
+        return 1;
+    }
+    std::cerr << "replaying " << replay.frames.size() << " frames (" << std::fixed
+              << std::setprecision(1) << captured_seconds << "s captured) of "
+              << replay.methods.size() << " method(s) against " << options.server << " on "
+              << options.connections << " connection(s)" << std::endl;
+
+    replay.start = Clock::now();
+    std::vector<std::thread> workers;
+    for (uint64_t i = 0; i < options.connections; ++i) {
+        workers.emplace_back(runConnection, std::ref(replay), std::cref(options));
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - replay.start).count();
+
+    // 第一行为所有方法合计
+    std::vector<Row> rows;
+    rows.push_back({"*", replay.total.latency.snapshot(), replay.total.errors.load(),
+                    replay.total.max_ns.load()});
+    for (size_t i = 0; i < replay.methods.size(); ++i) {
+        MethodResult& result = *replay.results[i];
+        rows.push_back({replay.methods[i], result.latency.snapshot(), result.errors.load(),
+                        result.max_ns.load()});
+    }
+
+    std::cerr << "replayed in " << seconds << "s, " << replay.connect_errors.load()
+              << " connect errors\n";
+    std::cerr << std::left << std::setw(32) << "method" << std::right << std::setw(10) << "requests"
+              << std::setw(8) << "errors" << std::setw(10) << "p50_us" << std::setw(10) << "p90_us"
+              << std::setw(10) << "p99_us" << std::setw(10) << "p999_us" << std::setw(10)
+              << "max_us" << "\n";
+    for (const Row& r : rows) {
+        std::cerr << std::left << std::setw(32) << r.method << std::right << std::setw(10)
+                  << r.latency.count << std::setw(8) << r.errors << std::setprecision(0)
+                  << std::setw(10) << r.latency.percentile(0.5) / 1e3 << std::setw(10)
+                  << r.latency.percentile(0.9) / 1e3 << std::setw(10)
+                  << r.latency.percentile(0.99) / 1e3 << std::setw(10)
+                  << r.latency.percentile(0.999) / 1e3 << std::setw(10) << r.max_ns / 1e3 << "\n";
+    }
+    std::cerr.flush();
+
+    if (!options.output.empty()) {
+        std::ofstream out(options.output);
+        writeJson(out, options, captured_seconds, seconds, rows);
+        if (!out) {
+            std::cerr << options.output << ": write failed" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}